@@ -40,64 +40,99 @@ struct JsonWriter
 
 	SigMap sigmap;
 	int sigidcounter;
-	dict<SigBit, string> sigids;
+	dict<SigBit, int> sigids;
 	pool<Aig> aig_models;
 
+	// AIG models of the cells of the last module written, in the order they
+	// were first used
+	vector<Aig> module_aig_models;
+
+	// The output is collected here and written to f in large blocks. When
+	// module_buffer is set, the output of a module is kept until the caller
+	// writes it (see write_design).
+	string out;
+	bool module_buffer = false;
+
 	JsonWriter(std::ostream &f, bool use_selection, bool aig_mode, bool compat_int_mode) :
 			f(f), use_selection(use_selection), aig_mode(aig_mode),
 			compat_int_mode(compat_int_mode) { }
 
-	string get_string(string str)
+	void flush()
+	{
+		f.write(out.data(), out.size());
+		out.clear();
+	}
+
+	void flush_if_full()
+	{
+		if (!module_buffer && GetSize(out) >= (1 << 20))
+			flush();
+	}
+
+	void put_int(int64_t value)
+	{
+		char buffer[24], *p = buffer + sizeof(buffer);
+		uint64_t v = value < 0 ? -(uint64_t)value : value;
+		do {
+			*--p = '0' + v % 10;
+			v /= 10;
+		} while (v != 0);
+		if (value < 0)
+			*--p = '-';
+		out.append(p, buffer + sizeof(buffer));
+	}
+
+	void put_string(const string &str)
 	{
-		string newstr = "\"";
+		out += '"';
 		for (char c : str) {
 			if (c == '\\')
-				newstr += "\\\\";
+				out += "\\\\";
 			else if (c == '"')
-				newstr += "\\\"";
+				out += "\\\"";
 			else if (c == '\b')
-				newstr += "\\b";
+				out += "\\b";
 			else if (c == '\f')
-				newstr += "\\f";
+				out += "\\f";
 			else if (c == '\n')
-				newstr += "\\n";
+				out += "\\n";
 			else if (c == '\r')
-				newstr += "\\r";
+				out += "\\r";
 			else if (c == '\t')
-				newstr += "\\t";
+				out += "\\t";
 			else if (c < 0x20)
-				newstr += stringf("\\u%04X", c);
+				out += stringf("\\u%04X", c);
 			else
-				newstr += c;
+				out += c;
 		}
-		return newstr + "\"";
+		out += '"';
 	}
 
-	string get_name(IdString name)
+	void put_name(IdString name)
 	{
-		return get_string(RTLIL::unescape_id(name));
+		put_string(RTLIL::unescape_id(name));
 	}
 
-	string get_bits(SigSpec sig)
+	void put_bits(SigSpec sig)
 	{
 		bool first = true;
-		string str = "[";
+		out += "[";
 		for (auto bit : sigmap(sig)) {
-			str += first ? " " : ", ";
+			out += first ? " " : ", ";
 			first = false;
-			if (sigids.count(bit) == 0) {
-				string &s = sigids[bit];
-				if (bit.wire == nullptr) {
-					if (bit == State::S0) s = "\"0\"";
-					else if (bit == State::S1) s = "\"1\"";
-					else if (bit == State::Sz) s = "\"z\"";
-					else s = "\"x\"";
-				} else
-					s = stringf("%d", sigidcounter++);
+			if (bit.wire == nullptr) {
+				if (bit == State::S0) out += "\"0\"";
+				else if (bit == State::S1) out += "\"1\"";
+				else if (bit == State::Sz) out += "\"z\"";
+				else out += "\"x\"";
+				continue;
 			}
-			str += sigids[bit];
+			auto it = sigids.find(bit);
+			if (it == sigids.end())
+				it = sigids.emplace(bit, sigidcounter++).first;
+			put_int(it->second);
 		}
-		return str + " ]";
+		out += " ]";
 	}
 
 	void write_parameter_value(const Const &value)
@@ -118,14 +153,14 @@ struct JsonWriter
 			}
 			if (state < 2)
 				str += " ";
-			f << get_string(str);
+			put_string(str);
 		} else if (compat_int_mode && GetSize(value) <= 32 && value.is_fully_def()) {
 			if ((value.flags & RTLIL::ConstFlags::CONST_FLAG_SIGNED) != 0)
-				f << stringf("%d", value.as_int());
+				put_int(value.as_int());
 			else
-				f << stringf("%u", value.as_int());
+				put_int((uint32_t)value.as_int());
 		} else {
-			f << get_string(value.as_string());
+			put_string(value.as_string());
 		}
 	}
 
@@ -133,61 +168,82 @@ struct JsonWriter
 	{
 		bool first = true;
 		for (auto &param : parameters) {
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s%s: ", for_module ? "" : "    ", get_name(param.first).c_str());
+			out += first ? "\n" : ",\n";
+			out += for_module ? "        " : "            ";
+			put_name(param.first);
+			out += ": ";
 			write_parameter_value(param.second);
 			first = false;
 		}
 	}
 
+	void write_wire_flags(Wire *w)
+	{
+		if (w->start_offset) {
+			out += "          \"offset\": ";
+			put_int(w->start_offset);
+			out += ",\n";
+		}
+		if (w->upto)
+			out += "          \"upto\": 1,\n";
+		if (w->is_signed)
+			out += "          \"signed\": 1,\n";
+	}
+
+	void check_module(Module *module)
+	{
+		if (module->has_processes()) {
+			log_error("Module %s contains processes, which are not supported by JSON backend (run `proc` first).\n", log_id(module));
+		}
+	}
+
 	void write_module(Module *module_)
 	{
 		module = module_;
 		log_assert(module->design == design);
 		sigmap.set(module);
 		sigids.clear();
+		module_aig_models.clear();
 
 		// reserve 0 and 1 to avoid confusion with "0" and "1"
 		sigidcounter = 2;
 
-		if (module->has_processes()) {
-			log_error("Module %s contains processes, which are not supported by JSON backend (run `proc` first).\n", log_id(module));
-		}
-
-		f << stringf("    %s: {\n", get_name(module->name).c_str());
+		out += "    ";
+		put_name(module->name);
+		out += ": {\n";
 
-		f << stringf("      \"attributes\": {");
+		out += "      \"attributes\": {";
 		write_parameters(module->attributes, /*for_module=*/true);
-		f << stringf("\n      },\n");
+		out += "\n      },\n";
 
 		if (module->parameter_default_values.size()) {
-			f << stringf("      \"parameter_default_values\": {");
+			out += "      \"parameter_default_values\": {";
 			write_parameters(module->parameter_default_values, /*for_module=*/true);
-			f << stringf("\n      },\n");
+			out += "\n      },\n";
 		}
 
-		f << stringf("      \"ports\": {");
+		out += "      \"ports\": {";
 		bool first = true;
 		for (auto n : module->ports) {
 			Wire *w = module->wire(n);
 			if (use_selection && !module->selected(w))
 				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(n).c_str());
-			f << stringf("          \"direction\": \"%s\",\n", w->port_input ? w->port_output ? "inout" : "input" : "output");
-			if (w->start_offset)
-				f << stringf("          \"offset\": %d,\n", w->start_offset);
-			if (w->upto)
-				f << stringf("          \"upto\": 1,\n");
-			if (w->is_signed)
-				f << stringf("          \"signed\": %d,\n", w->is_signed);
-			f << stringf("          \"bits\": %s\n", get_bits(w).c_str());
-			f << stringf("        }");
+			out += first ? "\n" : ",\n";
+			out += "        ";
+			put_name(n);
+			out += ": {\n";
+			out += "          \"direction\": \"";
+			out += w->port_input ? w->port_output ? "inout" : "input" : "output";
+			out += "\",\n";
+			write_wire_flags(w);
+			out += "          \"bits\": ";
+			put_bits(w);
+			out += "\n        }";
 			first = false;
 		}
-		f << stringf("\n      },\n");
+		out += "\n      },\n";
 
-		f << stringf("      \"cells\": {");
+		out += "      \"cells\": {";
 		first = true;
 		for (auto c : module->cells()) {
 			if (use_selection && !module->selected(c))
@@ -196,94 +252,120 @@ struct JsonWriter
 			// will break JSON netlist consumers like nextpnr
 			if (c->type == ID($scopeinfo))
 				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(c->name).c_str());
-			f << stringf("          \"hide_name\": %s,\n", c->name[0] == '$' ? "1" : "0");
-			f << stringf("          \"type\": %s,\n", get_name(c->type).c_str());
+			out += first ? "\n" : ",\n";
+			out += "        ";
+			put_name(c->name);
+			out += ": {\n";
+			out += "          \"hide_name\": ";
+			out += c->name[0] == '$' ? "1" : "0";
+			out += ",\n";
+			out += "          \"type\": ";
+			put_name(c->type);
+			out += ",\n";
 			if (aig_mode) {
 				Aig aig(c);
 				if (!aig.name.empty()) {
-					f << stringf("          \"model\": \"%s\",\n", aig.name.c_str());
-					aig_models.insert(aig);
+					out += "          \"model\": \"" + aig.name + "\",\n";
+					module_aig_models.push_back(aig);
 				}
 			}
-			f << stringf("          \"parameters\": {");
+			out += "          \"parameters\": {";
 			write_parameters(c->parameters);
-			f << stringf("\n          },\n");
-			f << stringf("          \"attributes\": {");
+			out += "\n          },\n";
+			out += "          \"attributes\": {";
 			write_parameters(c->attributes);
-			f << stringf("\n          },\n");
+			out += "\n          },\n";
 			if (c->known()) {
-				f << stringf("          \"port_directions\": {");
+				out += "          \"port_directions\": {";
 				bool first2 = true;
 				for (auto &conn : c->connections()) {
-					string direction = "output";
+					const char *direction = "output";
 					if (c->input(conn.first))
 						direction = c->output(conn.first) ? "inout" : "input";
-					f << stringf("%s\n", first2 ? "" : ",");
-					f << stringf("            %s: \"%s\"", get_name(conn.first).c_str(), direction.c_str());
+					out += first2 ? "\n" : ",\n";
+					out += "            ";
+					put_name(conn.first);
+					out += ": \"";
+					out += direction;
+					out += "\"";
 					first2 = false;
 				}
-				f << stringf("\n          },\n");
+				out += "\n          },\n";
 			}
-			f << stringf("          \"connections\": {");
+			out += "          \"connections\": {";
 			bool first2 = true;
 			for (auto &conn : c->connections()) {
-				f << stringf("%s\n", first2 ? "" : ",");
-				f << stringf("            %s: %s", get_name(conn.first).c_str(), get_bits(conn.second).c_str());
+				out += first2 ? "\n" : ",\n";
+				out += "            ";
+				put_name(conn.first);
+				out += ": ";
+				put_bits(conn.second);
 				first2 = false;
 			}
-			f << stringf("\n          }\n");
-			f << stringf("        }");
+			out += "\n          }\n";
+			out += "        }";
 			first = false;
+			flush_if_full();
 		}
-		f << stringf("\n      },\n");
+		out += "\n      },\n";
 
 		if (!module->memories.empty()) {
-			f << stringf("      \"memories\": {");
+			out += "      \"memories\": {";
 			first = true;
 			for (auto &it : module->memories) {
 				if (use_selection && !module->selected(it.second))
 					continue;
-				f << stringf("%s\n", first ? "" : ",");
-				f << stringf("        %s: {\n", get_name(it.second->name).c_str());
-				f << stringf("          \"hide_name\": %s,\n", it.second->name[0] == '$' ? "1" : "0");
-				f << stringf("          \"attributes\": {");
+				out += first ? "\n" : ",\n";
+				out += "        ";
+				put_name(it.second->name);
+				out += ": {\n";
+				out += "          \"hide_name\": ";
+				out += it.second->name[0] == '$' ? "1" : "0";
+				out += ",\n";
+				out += "          \"attributes\": {";
 				write_parameters(it.second->attributes);
-				f << stringf("\n          },\n");
-				f << stringf("          \"width\": %d,\n", it.second->width);
-				f << stringf("          \"start_offset\": %d,\n", it.second->start_offset);
-				f << stringf("          \"size\": %d\n", it.second->size);
-				f << stringf("        }");
+				out += "\n          },\n";
+				out += "          \"width\": ";
+				put_int(it.second->width);
+				out += ",\n";
+				out += "          \"start_offset\": ";
+				put_int(it.second->start_offset);
+				out += ",\n";
+				out += "          \"size\": ";
+				put_int(it.second->size);
+				out += "\n";
+				out += "        }";
 				first = false;
 			}
-			f << stringf("\n      },\n");
+			out += "\n      },\n";
 		}
 
-		f << stringf("      \"netnames\": {");
+		out += "      \"netnames\": {";
 		first = true;
 		for (auto w : module->wires()) {
 			if (use_selection && !module->selected(w))
 				continue;
-			f << stringf("%s\n", first ? "" : ",");
-			f << stringf("        %s: {\n", get_name(w->name).c_str());
-			f << stringf("          \"hide_name\": %s,\n", w->name[0] == '$' ? "1" : "0");
-			f << stringf("          \"bits\": %s,\n", get_bits(w).c_str());
-			if (w->start_offset)
-				f << stringf("          \"offset\": %d,\n", w->start_offset);
-			if (w->upto)
-				f << stringf("          \"upto\": 1,\n");
-			if (w->is_signed)
-				f << stringf("          \"signed\": %d,\n", w->is_signed);
-			f << stringf("          \"attributes\": {");
+			out += first ? "\n" : ",\n";
+			out += "        ";
+			put_name(w->name);
+			out += ": {\n";
+			out += "          \"hide_name\": ";
+			out += w->name[0] == '$' ? "1" : "0";
+			out += ",\n";
+			out += "          \"bits\": ";
+			put_bits(w);
+			out += ",\n";
+			write_wire_flags(w);
+			out += "          \"attributes\": {";
 			write_parameters(w->attributes);
-			f << stringf("\n          }\n");
-			f << stringf("        }");
+			out += "\n          }\n";
+			out += "        }";
 			first = false;
+			flush_if_full();
 		}
-		f << stringf("\n      }\n");
+		out += "\n      }\n";
 
-		f << stringf("    }");
+		out += "    }";
 	}
 
 	void write_design(Design *design_)
@@ -291,48 +373,92 @@ struct JsonWriter
 		design = design_;
 		design->sort();
 
-		f << stringf("{\n");
-		f << stringf("  \"creator\": %s,\n", get_string(yosys_version_str).c_str());
-		f << stringf("  \"modules\": {\n");
+		out += "{\n";
+		out += "  \"creator\": ";
+		put_string(yosys_version_str);
+		out += ",\n";
+		out += "  \"modules\": {\n";
 		vector<Module*> modules = use_selection ? design->selected_modules() : design->modules();
-		bool first_module = true;
-		for (auto mod : modules) {
-			if (!first_module)
-				f << stringf(",\n");
-			write_module(mod);
-			first_module = false;
+
+		// With several threads, the modules are rendered in parallel into
+		// buffers of their own, which are then written in order. Only
+		// yosys_threads modules are rendered at a time to bound the memory
+		// used for the buffers.
+		int batch_size = 1;
+		if (yosys_threads > 1 && !yosys_threads_active)
+			batch_size = yosys_threads;
+
+		for (int start = 0; start < GetSize(modules); start += batch_size)
+		{
+			int count = std::min(batch_size, GetSize(modules) - start);
+
+			if (count == 1) {
+				check_module(modules[start]);
+				if (start != 0)
+					out += ",\n";
+				write_module(modules[start]);
+				for (auto &aig : module_aig_models)
+					aig_models.insert(aig);
+				flush_if_full();
+				continue;
+			}
+
+			for (int i = start; i < start + count; i++)
+				check_module(modules[i]);
+
+			std::vector<std::unique_ptr<JsonWriter>> writers;
+			for (int i = 0; i < count; i++) {
+				writers.emplace_back(new JsonWriter(f, use_selection, aig_mode, compat_int_mode));
+				writers.back()->design = design;
+				writers.back()->module_buffer = true;
+			}
+
+			yosys_parallel_for(count, [&](int i) {
+				writers[i]->write_module(modules[start + i]);
+			});
+
+			for (int i = 0; i < count; i++) {
+				if (start + i != 0)
+					out += ",\n";
+				flush();
+				writers[i]->flush();
+				for (auto &aig : writers[i]->module_aig_models)
+					aig_models.insert(aig);
+			}
 		}
-		f << stringf("\n  }");
+
+		out += "\n  }";
 		if (!aig_models.empty()) {
-			f << stringf(",\n  \"models\": {\n");
+			out += ",\n  \"models\": {\n";
 			bool first_model = true;
 			for (auto &aig : aig_models) {
 				if (!first_model)
-					f << stringf(",\n");
-				f << stringf("    \"%s\": [\n", aig.name.c_str());
+					out += ",\n";
+				out += "    \"" + aig.name + "\": [\n";
 				int node_idx = 0;
 				for (auto &node : aig.nodes) {
 					if (node_idx != 0)
-						f << stringf(",\n");
-					f << stringf("      /* %3d */ [ ", node_idx);
+						out += ",\n";
+					out += stringf("      /* %3d */ [ ", node_idx);
 					if (node.portbit >= 0)
-						f << stringf("\"%sport\", \"%s\", %d", node.inverter ? "n" : "",
+						out += stringf("\"%sport\", \"%s\", %d", node.inverter ? "n" : "",
 								log_id(node.portname), node.portbit);
 					else if (node.left_parent < 0 && node.right_parent < 0)
-						f << stringf("\"%s\"", node.inverter ? "true" : "false");
+						out += stringf("\"%s\"", node.inverter ? "true" : "false");
 					else
-						f << stringf("\"%s\", %d, %d", node.inverter ? "nand" : "and", node.left_parent, node.right_parent);
+						out += stringf("\"%s\", %d, %d", node.inverter ? "nand" : "and", node.left_parent, node.right_parent);
 					for (auto &op : node.outports)
-						f << stringf(", \"%s\", %d", log_id(op.first), op.second);
-					f << stringf(" ]");
+						out += stringf(", \"%s\", %d", log_id(op.first), op.second);
+					out += " ]";
 					node_idx++;
 				}
-				f << stringf("\n    ]");
+				out += "\n    ]";
 				first_model = false;
 			}
-			f << stringf("\n  }");
+			out += "\n  }";
 		}
-		f << stringf("\n}\n");
+		out += "\n}\n";
+		flush();
 	}
 };
 
@@ -353,6 +479,9 @@ struct JsonBackend : public Backend {
 		log("        emit 32-bit or smaller fully-defined parameter values directly\n");
 		log("        as JSON numbers (for compatibility with old parsers)\n");
 		log("\n");
+		log("When yosys is run with more than one thread (see 'yosys -j'), the modules are\n");
+		log("rendered in parallel. The output does not depend on the number of threads.\n");
+		log("\n");
 		log("\n");
 		log("The general syntax of the JSON output created by this command is as follows:\n");
 		log("\n");
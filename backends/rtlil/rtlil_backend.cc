@@ -23,6 +23,7 @@
  */
 
 #include "rtlil_backend.h"
+#include "rtlil_binary.h"
 #include "kernel/yosys.h"
 #include <errno.h>
 
@@ -431,10 +432,18 @@ struct RTLILBackend : public Backend {
 		log("    -selected\n");
 		log("        only write selected parts of the design.\n");
 		log("\n");
+		log("    -binary\n");
+		log("        write a compact binary encoding of RTLIL instead of text. Binary files\n");
+		log("        are much smaller and faster to read than text files, which makes them\n");
+		log("        suitable for checkpointing a design. read_rtlil detects them\n");
+		log("        automatically. With -selected only modules selected as a whole are\n");
+		log("        written.\n");
+		log("\n");
 	}
 	void execute(std::ostream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		bool selected = false;
+		bool binary = false;
 
 		log_header(design, "Executing RTLIL backend.\n");
 
@@ -445,13 +454,21 @@ struct RTLILBackend : public Backend {
 				selected = true;
 				continue;
 			}
+			if (arg == "-binary") {
+				binary = true;
+				continue;
+			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, binary);
 
 		design->sort();
 
 		log("Output filename: %s\n", filename.c_str());
+		if (binary) {
+			RTLIL_BINARY::write_design(*f, design, selected);
+			return;
+		}
 		*f << stringf("# Generated by %s\n", yosys_version_str);
 		RTLIL_BACKEND::dump_design(*f, design, selected, true, false);
 	}
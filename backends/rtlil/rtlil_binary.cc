@@ -0,0 +1,822 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  File layout (all integers are LEB128 varints, signed ones are zigzag
+ *  encoded):
+ *
+ *    magic      "\x89RTLIL\r\n\x1a\n"
+ *    version    currently 1
+ *    autoidx
+ *    modules    count, then the name and section size of each module
+ *    sections   the module sections, back to back and in the same order
+ *
+ *  Every module section starts with its own string table (the count, then
+ *  the length and characters of each IdString), followed by the module
+ *  attributes, a list of the port wires and the contents of the module.
+ *  Sections don't refer to each other, so a module can be decoded on its
+ *  own or copied unchanged from one file to another.
+ *
+ *  IdStrings are stored as indices into the string table. Wires are
+ *  numbered in the order they appear in their module section, SigChunks
+ *  refer to them by that number plus one and use zero for constants.
+ *  Constant bits are packed eight per byte when they are all 0 or 1 and
+ *  two per byte otherwise. Objects are stored in the order they were added
+ *  to their containers, so a design is read back in the same order.
+ *
+ */
+
+#include "backends/rtlil/rtlil_binary.h"
+#include <string.h>
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+const char magic[] = "\x89RTLIL\r\n\x1a\n";
+const int magic_len = sizeof(magic) - 1;
+const int format_version = 1;
+
+enum WireFlags {
+	WIRE_UPTO = 1,
+	WIRE_SIGNED = 2,
+	WIRE_INPUT = 4,
+	WIRE_OUTPUT = 8
+};
+
+// hashlib containers iterate in reverse insertion order
+template<typename C>
+std::vector<typename C::const_iterator> insertion_order(const C &container)
+{
+	std::vector<typename C::const_iterator> order;
+	for (auto it = container.begin(); it != container.end(); ++it)
+		order.push_back(it);
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+struct StringTable
+{
+	dict<RTLIL::IdString, int> index;
+	std::vector<RTLIL::IdString> strings;
+
+	std::string encode()
+	{
+		std::string buf;
+		auto put = [&](uint64_t value) {
+			while (value >= 0x80) {
+				buf += char(value | 0x80);
+				value >>= 7;
+			}
+			buf += char(value);
+		};
+		put(strings.size());
+		for (auto &name : strings) {
+			const char *str = name.c_str();
+			size_t len = strlen(str);
+			put(len);
+			buf.append(str, len);
+		}
+		return buf;
+	}
+
+	int lookup(RTLIL::IdString name)
+	{
+		auto it = index.find(name);
+		if (it == index.end()) {
+			it = index.emplace(name, GetSize(strings)).first;
+			strings.push_back(name);
+		}
+		return it->second;
+	}
+};
+
+struct BinaryWriter
+{
+	std::string buf;
+	StringTable &table;
+	dict<const RTLIL::Wire*, int> wire_index;
+	RTLIL::Module *module = nullptr;
+
+	BinaryWriter(StringTable &table) : table(table) { }
+
+	void u(uint64_t value)
+	{
+		while (value >= 0x80) {
+			buf += char(value | 0x80);
+			value >>= 7;
+		}
+		buf += char(value);
+	}
+
+	void s(int64_t value)
+	{
+		u((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+
+	void id(RTLIL::IdString name)
+	{
+		u(table.lookup(name));
+	}
+
+	void bits(const std::vector<RTLIL::State> &bits)
+	{
+		bool binary = true;
+		for (auto bit : bits)
+			if (bit != RTLIL::State::S0 && bit != RTLIL::State::S1) {
+				binary = false;
+				break;
+			}
+
+		u(uint64_t(bits.size()) << 1 | (binary ? 0 : 1));
+
+		int per_byte = binary ? 8 : 2, shift = binary ? 1 : 4;
+		for (size_t i = 0; i < bits.size(); i += per_byte) {
+			unsigned char byte = 0;
+			for (size_t j = 0; j < size_t(per_byte) && i + j < bits.size(); j++)
+				byte |= (unsigned char)bits[i + j] << (j * shift);
+			buf += char(byte);
+		}
+	}
+
+	void constant(const RTLIL::Const &value)
+	{
+		u(value.flags);
+		bits(value.bits);
+	}
+
+	void sigspec(const RTLIL::SigSpec &sig)
+	{
+		const std::vector<RTLIL::SigChunk> &chunks = sig.chunks();
+		u(chunks.size());
+		for (auto &chunk : chunks) {
+			if (chunk.wire == nullptr) {
+				u(0);
+				bits(chunk.data);
+				continue;
+			}
+			auto it = wire_index.find(chunk.wire);
+			if (it == wire_index.end())
+				log_error("Signal %s in module %s refers to a wire outside of the module.\n",
+						log_signal(sig), log_id(module));
+			u(it->second + 1);
+			u(chunk.offset);
+			u(chunk.width);
+		}
+	}
+
+	void sigsigs(const std::vector<RTLIL::SigSig> &sigsigs)
+	{
+		u(sigsigs.size());
+		for (auto &it : sigsigs) {
+			sigspec(it.first);
+			sigspec(it.second);
+		}
+	}
+
+	void attributes(const RTLIL::AttrObject *obj)
+	{
+		u(obj->attributes.size());
+		for (auto it : insertion_order(obj->attributes)) {
+			id(it->first);
+			constant(it->second);
+		}
+	}
+
+	void case_rule(const RTLIL::CaseRule *cs)
+	{
+		attributes(cs);
+		u(cs->compare.size());
+		for (auto &sig : cs->compare)
+			sigspec(sig);
+		sigsigs(cs->actions);
+		u(cs->switches.size());
+		for (auto sw : cs->switches)
+			switch_rule(sw);
+	}
+
+	void switch_rule(const RTLIL::SwitchRule *sw)
+	{
+		attributes(sw);
+		sigspec(sw->signal);
+		u(sw->cases.size());
+		for (auto cs : sw->cases)
+			case_rule(cs);
+	}
+
+	void sync_rule(const RTLIL::SyncRule *sync)
+	{
+		u(sync->type);
+		sigspec(sync->signal);
+		sigsigs(sync->actions);
+		u(sync->mem_write_actions.size());
+		for (auto &act : sync->mem_write_actions) {
+			attributes(&act);
+			id(act.memid);
+			sigspec(act.address);
+			sigspec(act.data);
+			sigspec(act.enable);
+			constant(act.priority_mask);
+		}
+	}
+
+	void wire_header(const RTLIL::Wire *wire)
+	{
+		id(wire->name);
+		u(wire->width);
+		s(wire->start_offset);
+		u(wire->port_id);
+		u((wire->upto ? WIRE_UPTO : 0) | (wire->is_signed ? WIRE_SIGNED : 0) |
+				(wire->port_input ? WIRE_INPUT : 0) | (wire->port_output ? WIRE_OUTPUT : 0));
+	}
+
+	void write_module(RTLIL::Module *mod)
+	{
+		module = mod;
+
+		attributes(module);
+
+		std::vector<const RTLIL::Wire*> port_wires;
+		for (auto it : insertion_order(module->wires_))
+			if (it->second->port_input || it->second->port_output)
+				port_wires.push_back(it->second);
+		u(port_wires.size());
+		for (auto wire : port_wires)
+			wire_header(wire);
+
+		u(module->avail_parameters.size());
+		for (auto &param : module->avail_parameters)
+			id(param);
+		u(module->parameter_default_values.size());
+		for (auto it : insertion_order(module->parameter_default_values)) {
+			id(it->first);
+			constant(it->second);
+		}
+
+		u(module->wires_.size());
+		for (auto it : insertion_order(module->wires_)) {
+			const RTLIL::Wire *wire = it->second;
+			int index = GetSize(wire_index);
+			wire_index[wire] = index;
+			wire_header(wire);
+			attributes(wire);
+		}
+
+		u(module->memories.size());
+		for (auto it : insertion_order(module->memories)) {
+			const RTLIL::Memory *memory = it->second;
+			id(memory->name);
+			u(memory->width);
+			s(memory->start_offset);
+			u(memory->size);
+			attributes(memory);
+		}
+
+		u(module->cells_.size());
+		for (auto it : insertion_order(module->cells_)) {
+			const RTLIL::Cell *cell = it->second;
+			id(cell->name);
+			id(cell->type);
+			attributes(cell);
+			u(cell->parameters.size());
+			for (auto param : insertion_order(cell->parameters)) {
+				id(param->first);
+				constant(param->second);
+			}
+			u(cell->connections().size());
+			for (auto conn : insertion_order(cell->connections())) {
+				id(conn->first);
+				sigspec(conn->second);
+			}
+		}
+
+		sigsigs(module->connections());
+
+		u(module->processes.size());
+		for (auto it : insertion_order(module->processes)) {
+			const RTLIL::Process *proc = it->second;
+			id(proc->name);
+			attributes(proc);
+			case_rule(&proc->root_case);
+			u(proc->syncs.size());
+			for (auto sync : proc->syncs)
+				sync_rule(sync);
+		}
+	}
+};
+
+void write_varint(std::ostream &f, uint64_t value)
+{
+	while (value >= 0x80) {
+		f.put(char(value | 0x80));
+		value >>= 7;
+	}
+	f.put(char(value));
+}
+
+uint64_t read_varint(std::istream &f)
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int c = f.get();
+		if (c == EOF)
+			break;
+		value |= uint64_t(c & 0x7f) << shift;
+		if (!(c & 0x80))
+			return value;
+	}
+	log_error("Binary RTLIL error: unexpected end of file.\n");
+}
+
+struct BinaryReader
+{
+	const unsigned char *ptr, *end;
+	std::vector<std::pair<const char*, int>> string_refs;
+	std::vector<RTLIL::IdString> strings;
+	std::vector<RTLIL::Wire*> wires;
+	RTLIL::IdString module_name;
+
+	BinaryReader(const std::string &buf, RTLIL::IdString module_name) :
+			ptr((const unsigned char*)buf.data()), end(ptr + buf.size()), module_name(module_name) { }
+
+	[[noreturn]] void corrupt()
+	{
+		log_error("Binary RTLIL error: section of module %s is corrupt.\n", log_id(module_name));
+	}
+
+	uint64_t u()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64 && ptr != end; shift += 7) {
+			unsigned char c = *ptr++;
+			value |= uint64_t(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return value;
+		}
+		corrupt();
+	}
+
+	int64_t s()
+	{
+		uint64_t value = u();
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+
+	int size()
+	{
+		uint64_t value = u();
+		if (value > uint64_t(INT_MAX))
+			corrupt();
+		return int(value);
+	}
+
+	int integer()
+	{
+		int64_t value = s();
+		if (value < INT_MIN || value > INT_MAX)
+			corrupt();
+		return int(value);
+	}
+
+	// the IdStrings are only created when used, which keeps reading the
+	// module attributes of a lazily loaded module cheap
+	void string_table()
+	{
+		int count = size();
+		string_refs.reserve(std::min(count, int(end - ptr)));
+		for (int i = 0; i < count; i++) {
+			int len = size();
+			if (len > end - ptr || (len > 0 && *ptr != '\\' && *ptr != '$'))
+				corrupt();
+			string_refs.push_back({(const char*)ptr, len});
+			ptr += len;
+		}
+		strings.resize(count);
+	}
+
+	RTLIL::IdString id()
+	{
+		uint64_t index = u();
+		if (index >= strings.size())
+			corrupt();
+		RTLIL::IdString &name = strings[index];
+		if (name.empty() && string_refs[index].second > 0)
+			name = std::string(string_refs[index].first, string_refs[index].second);
+		return name;
+	}
+
+	void bits(std::vector<RTLIL::State> &bits)
+	{
+		uint64_t value = u();
+		uint64_t count = value >> 1;
+		bool binary = !(value & 1);
+		int per_byte = binary ? 8 : 2, shift = binary ? 1 : 4;
+		unsigned char mask = binary ? 1 : 15;
+
+		if ((count + per_byte - 1) / per_byte > uint64_t(end - ptr))
+			corrupt();
+
+		bits.resize(count);
+		for (uint64_t i = 0; i < count; i += per_byte) {
+			unsigned char byte = *ptr++;
+			for (uint64_t j = 0; j < uint64_t(per_byte) && i + j < count; j++) {
+				unsigned char state = (byte >> (j * shift)) & mask;
+				if (state > RTLIL::State::Sm)
+					corrupt();
+				bits[i + j] = RTLIL::State(state);
+			}
+		}
+	}
+
+	RTLIL::Const constant()
+	{
+		RTLIL::Const value;
+		value.flags = size();
+		bits(value.bits);
+		return value;
+	}
+
+	RTLIL::SigSpec sigspec()
+	{
+		int count = size();
+		std::vector<RTLIL::SigChunk> chunks;
+		chunks.reserve(std::min(count, int(end - ptr)));
+		for (int i = 0; i < count; i++) {
+			uint64_t index = u();
+			if (index == 0) {
+				RTLIL::Const value;
+				bits(value.bits);
+				chunks.push_back(RTLIL::SigChunk(value));
+				continue;
+			}
+			if (index > wires.size())
+				corrupt();
+			RTLIL::Wire *wire = wires[index - 1];
+			int offset = size(), width = size();
+			if (width > wire->width || offset > wire->width - width)
+				corrupt();
+			chunks.push_back(RTLIL::SigChunk(wire, offset, width));
+		}
+		return chunks;
+	}
+
+	void sigsigs(std::vector<RTLIL::SigSig> &sigsigs)
+	{
+		int count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::SigSpec first = sigspec();
+			RTLIL::SigSpec second = sigspec();
+			sigsigs.push_back(RTLIL::SigSig(first, second));
+		}
+	}
+
+	void attributes(dict<RTLIL::IdString, RTLIL::Const> &attributes)
+	{
+		int count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::IdString name = id();
+			attributes[name] = constant();
+		}
+	}
+
+	void case_rule(RTLIL::CaseRule *cs)
+	{
+		attributes(cs->attributes);
+		int count = size();
+		for (int i = 0; i < count; i++)
+			cs->compare.push_back(sigspec());
+		sigsigs(cs->actions);
+		count = size();
+		for (int i = 0; i < count; i++) {
+			cs->switches.push_back(new RTLIL::SwitchRule);
+			switch_rule(cs->switches.back());
+		}
+	}
+
+	void switch_rule(RTLIL::SwitchRule *sw)
+	{
+		attributes(sw->attributes);
+		sw->signal = sigspec();
+		int count = size();
+		for (int i = 0; i < count; i++) {
+			sw->cases.push_back(new RTLIL::CaseRule);
+			case_rule(sw->cases.back());
+		}
+	}
+
+	void sync_rule(RTLIL::SyncRule *sync)
+	{
+		int type = size();
+		if (type > RTLIL::SyncType::STi)
+			corrupt();
+		sync->type = RTLIL::SyncType(type);
+		sync->signal = sigspec();
+		sigsigs(sync->actions);
+		int count = size();
+		for (int i = 0; i < count; i++) {
+			sync->mem_write_actions.push_back(RTLIL::MemWriteAction());
+			RTLIL::MemWriteAction &act = sync->mem_write_actions.back();
+			attributes(act.attributes);
+			act.memid = id();
+			act.address = sigspec();
+			act.data = sigspec();
+			act.enable = sigspec();
+			act.priority_mask = constant();
+		}
+	}
+
+	RTLIL::Wire *wire_header(RTLIL::Module *module)
+	{
+		RTLIL::IdString name = id();
+		int width = size();
+		int start_offset = integer();
+		int port_id = size();
+		int flags = size();
+
+		if (module == nullptr)
+			return nullptr;
+		if (module->wire(name) != nullptr)
+			corrupt();
+
+		RTLIL::Wire *wire = module->addWire(name, width);
+		wire->start_offset = start_offset;
+		wire->port_id = port_id;
+		wire->upto = (flags & WIRE_UPTO) != 0;
+		wire->is_signed = (flags & WIRE_SIGNED) != 0;
+		wire->port_input = (flags & WIRE_INPUT) != 0;
+		wire->port_output = (flags & WIRE_OUTPUT) != 0;
+		return wire;
+	}
+
+	// Adds the port wires to a stub, or skips them for a null module.
+	void port_wires(RTLIL::Module *module)
+	{
+		int count = size();
+		for (int i = 0; i < count; i++)
+			wire_header(module);
+	}
+
+	// the module attributes and port wires have already been read by the caller
+	void read_module(RTLIL::Module *module)
+	{
+		int count = size();
+		for (int i = 0; i < count; i++)
+			module->avail_parameters(id());
+		count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::IdString name = id();
+			module->parameter_default_values[name] = constant();
+		}
+
+		count = size();
+		wires.reserve(std::min(count, int(end - ptr)));
+		for (int i = 0; i < count; i++) {
+			RTLIL::Wire *wire = wire_header(module);
+			attributes(wire->attributes);
+			wires.push_back(wire);
+		}
+
+		count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::Memory *memory = new RTLIL::Memory;
+			memory->name = id();
+			if (module->memories.count(memory->name)) {
+				delete memory;
+				corrupt();
+			}
+			module->memories[memory->name] = memory;
+			memory->width = size();
+			memory->start_offset = integer();
+			memory->size = size();
+			attributes(memory->attributes);
+		}
+
+		count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::IdString name = id();
+			if (module->cell(name) != nullptr)
+				corrupt();
+			RTLIL::Cell *cell = module->addCell(name, id());
+			attributes(cell->attributes);
+			int params = size();
+			for (int j = 0; j < params; j++) {
+				RTLIL::IdString param = id();
+				cell->parameters[param] = constant();
+			}
+			int ports = size();
+			for (int j = 0; j < ports; j++) {
+				RTLIL::IdString port = id();
+				cell->setPort(port, sigspec());
+			}
+		}
+
+		count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::SigSpec lhs = sigspec();
+			RTLIL::SigSpec rhs = sigspec();
+			if (GetSize(lhs) != GetSize(rhs))
+				corrupt();
+			module->connect(lhs, rhs);
+		}
+
+		count = size();
+		for (int i = 0; i < count; i++) {
+			RTLIL::IdString name = id();
+			if (module->processes.count(name))
+				corrupt();
+			RTLIL::Process *proc = module->addProcess(name);
+			attributes(proc->attributes);
+			case_rule(&proc->root_case);
+			int syncs = size();
+			for (int j = 0; j < syncs; j++) {
+				proc->syncs.push_back(new RTLIL::SyncRule);
+				sync_rule(proc->syncs.back());
+			}
+		}
+
+		if (ptr != end)
+			corrupt();
+	}
+};
+
+} // namespace
+
+void RTLIL_BINARY::write_design(std::ostream &f, RTLIL::Design *design, bool only_selected)
+{
+	std::vector<RTLIL::Module*> modules;
+	std::vector<std::string> sections;
+
+	// this looks at modules_ directly, as modules that were read lazily and
+	// never loaded are copied as they are
+	for (auto it : insertion_order(design->modules_)) {
+		RTLIL::Module *module = it->second;
+		if (only_selected && !design->selected_whole_module(module)) {
+			if (design->selected_module(module))
+				log_warning("Ignoring partially selected module %s.\n", log_id(module));
+			continue;
+		}
+		modules.push_back(module);
+		sections.push_back(encode_module(module));
+	}
+
+	f.write(magic, magic_len);
+	write_varint(f, format_version);
+	write_varint(f, autoidx);
+
+	write_varint(f, modules.size());
+	for (int i = 0; i < GetSize(modules); i++) {
+		const char *name = modules[i]->name.c_str();
+		size_t len = strlen(name);
+		write_varint(f, len);
+		f.write(name, len);
+		write_varint(f, sections[i].size());
+	}
+
+	for (auto &section : sections)
+		f.write(section.data(), section.size());
+}
+
+void RTLIL_BINARY::read_design(std::istream &f, RTLIL::Design *design, bool flag_nooverwrite, bool flag_overwrite, bool flag_lib, bool flag_lazy)
+{
+	char header[magic_len];
+	f.read(header, magic_len);
+	if (f.gcount() != magic_len || memcmp(header, magic, magic_len))
+		log_error("Binary RTLIL error: invalid file header.\n");
+
+	uint64_t version = read_varint(f);
+	if (version != format_version)
+		log_error("Binary RTLIL error: unsupported format version %llu.\n", (unsigned long long)version);
+
+	uint64_t file_autoidx = read_varint(f);
+	if (file_autoidx > uint64_t(INT_MAX))
+		log_error("Binary RTLIL error: invalid autoidx.\n");
+	autoidx = max(autoidx, int(file_autoidx));
+
+	std::vector<std::pair<RTLIL::IdString, uint64_t>> sections;
+	std::string buf;
+	uint64_t count = read_varint(f);
+	for (uint64_t i = 0; i < count; i++) {
+		buf.resize(read_varint(f));
+		f.read(&buf[0], buf.size());
+		if (f.gcount() != std::streamsize(buf.size()))
+			log_error("Binary RTLIL error: unexpected end of file.\n");
+		if (buf.empty() || (buf[0] != '\\' && buf[0] != '$'))
+			log_error("Binary RTLIL error: invalid module name `%s'.\n", buf.c_str());
+		uint64_t size = read_varint(f);
+		sections.push_back({RTLIL::IdString(buf), size});
+	}
+
+	for (auto &it : sections)
+	{
+		RTLIL::IdString name = it.first;
+
+		buf.resize(it.second);
+		f.read(&buf[0], buf.size());
+		if (f.gcount() != std::streamsize(buf.size()))
+			log_error("Binary RTLIL error: unexpected end of file.\n");
+
+		BinaryReader reader(buf, name);
+		dict<RTLIL::IdString, RTLIL::Const> attributes;
+		reader.string_table();
+		reader.attributes(attributes);
+
+		bool delete_current_module = false;
+		if (design->has(name)) {
+			// only the attributes are needed, so a lazily read module isn't loaded
+			RTLIL::Module *existing_mod = design->modules_.at(name);
+			if (!flag_overwrite && (flag_lib || (attributes.count(ID::blackbox) && attributes.at(ID::blackbox).as_bool()))) {
+				log("Ignoring blackbox re-definition of module %s.\n", name.c_str());
+				delete_current_module = true;
+			} else if (!flag_nooverwrite && !flag_overwrite && !existing_mod->get_bool_attribute(ID::blackbox)) {
+				log_error("RTLIL error: redefinition of module %s.\n", name.c_str());
+			} else if (flag_nooverwrite) {
+				log("Ignoring re-definition of module %s.\n", name.c_str());
+				delete_current_module = true;
+			} else {
+				log("Replacing existing%s module %s.\n", existing_mod->get_bool_attribute(ID::blackbox) ? " blackbox" : "", name.c_str());
+				design->remove(existing_mod);
+			}
+		}
+
+		if (delete_current_module)
+			continue;
+
+		RTLIL::Module *module = new RTLIL::Module;
+		module->name = name;
+		module->attributes.swap(attributes);
+
+		if (flag_lazy && !flag_lib) {
+			reader.port_wires(module);
+			module->fixup_ports();
+			module->lazy_section_.swap(buf);
+			module->lazy_stub_ = true;
+			design->add(module);
+			continue;
+		}
+
+		design->add(module);
+		reader.port_wires(nullptr);
+		reader.read_module(module);
+		module->fixup_ports();
+		if (flag_lib)
+			module->makeblackbox();
+	}
+}
+
+void RTLIL_BINARY::load_module(RTLIL::Module *module)
+{
+	std::string section;
+	section.swap(module->lazy_section_);
+
+	// the port wires of the stub are created again in their original order
+	pool<RTLIL::Wire*> stub_wires;
+	for (auto wire : module->wires())
+		stub_wires.insert(wire);
+	module->remove(stub_wires);
+
+	BinaryReader reader(section, module->name);
+	reader.string_table();
+	module->attributes.clear();
+	reader.attributes(module->attributes);
+	reader.port_wires(nullptr);
+	reader.read_module(module);
+	module->fixup_ports();
+}
+
+std::string RTLIL_BINARY::encode_module(RTLIL::Module *module)
+{
+	if (!module->lazy_section_.empty())
+		return module->lazy_section_;
+
+	StringTable table;
+	BinaryWriter writer(table);
+	writer.write_module(module);
+	return table.encode() + writer.buf;
+}
+
+void RTLIL_BINARY::decode_module(const std::string &section, RTLIL::Module *module)
+{
+	BinaryReader reader(section, module->name);
+	reader.string_table();
+	reader.attributes(module->attributes);
+	reader.port_wires(nullptr);
+	reader.read_module(module);
+	module->fixup_ports();
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,61 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A compact binary encoding of RTLIL, used as a fast checkpoint format
+ *  by "write_rtlil -binary" and "read_rtlil".
+ *
+ */
+
+#ifndef RTLIL_BINARY_H
+#define RTLIL_BINARY_H
+
+#include "kernel/yosys.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_BINARY {
+	// The first byte of the magic number, which can't start a text RTLIL file.
+	static const int magic_first_byte = 0x89;
+
+	// Writes all modules of the design, or with only_selected set the modules
+	// that are selected as a whole.
+	void write_design(std::ostream &f, RTLIL::Design *design, bool only_selected);
+
+	// Reads a design written by write_design(). The flags have the same
+	// meaning as the options of read_rtlil with the same names. With
+	// flag_lazy set the modules are added as stubs that only have their name,
+	// attributes and port wires, and keep their encoded contents in
+	// lazy_section_.
+	void read_design(std::istream &f, RTLIL::Design *design, bool flag_nooverwrite, bool flag_overwrite, bool flag_lib, bool flag_lazy);
+
+	// Decodes the contents of a stub added by read_design(). This is called
+	// by RTLIL::Design when the module is accessed for the first time.
+	void load_module(RTLIL::Module *module);
+
+	// Encodes a single module, without its name. This is the same encoding
+	// that write_design() uses for the contents of a module.
+	std::string encode_module(RTLIL::Module *module);
+
+	// Fills the empty module with the contents encoded by encode_module().
+	void decode_module(const std::string &section, RTLIL::Module *module);
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -30,6 +30,7 @@
 #include "kernel/yosys.h"
 #include "libs/sha1/sha1.h"
 #include "ast.h"
+#include "backends/rtlil/rtlil_binary.h"
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -1914,6 +1915,258 @@ void AstModule::loadconfig() const
 	flag_autowire = autowire;
 }
 
+namespace {
+
+// writes an AST as a sequence of varints, storing each distinct string once
+struct AstEncoder
+{
+	std::string buf;
+	dict<std::string, int> strings;
+
+	void u(uint64_t value)
+	{
+		while (value >= 0x80) {
+			buf += char(value | 0x80);
+			value >>= 7;
+		}
+		buf += char(value);
+	}
+
+	void s(int64_t value)
+	{
+		u((uint64_t(value) << 1) ^ uint64_t(value >> 63));
+	}
+
+	void str(const std::string &value)
+	{
+		auto it = strings.find(value);
+		if (it != strings.end()) {
+			u(uint64_t(it->second) << 1 | 1);
+			return;
+		}
+		int index = GetSize(strings);
+		strings[value] = index;
+		u(uint64_t(value.size()) << 1);
+		buf += value;
+	}
+
+	// id2ast is not stored: the ASTs kept by AstModule are copies made
+	// before simplify(), which sets id2ast again
+	void node(const AstNode *node)
+	{
+		u(node->type);
+		str(node->str);
+		u(node->bits.size());
+		for (auto bit : node->bits)
+			buf += char(bit);
+
+		bool flags[] = {node->is_input, node->is_output, node->is_reg, node->is_logic, node->is_signed,
+				node->is_string, node->is_wand, node->is_wor, node->range_valid, node->range_swapped,
+				node->was_checked, node->is_unsized, node->is_custom_type, node->is_enum, node->basic_prep,
+				node->lookahead, node->in_lvalue, node->in_param, node->in_lvalue_from_above, node->in_param_from_above};
+		uint64_t mask = 0;
+		for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+			mask |= uint64_t(flags[i]) << i;
+		u(mask);
+
+		s(node->port_id);
+		s(node->range_left);
+		s(node->range_right);
+		u(node->integer);
+		uint64_t realvalue;
+		memcpy(&realvalue, &node->realvalue, sizeof(realvalue));
+		u(realvalue);
+
+		u(node->dimensions.size());
+		for (auto &dim : node->dimensions) {
+			s(dim.range_right);
+			s(dim.range_width);
+			u(dim.range_swapped);
+		}
+		s(node->unpacked_dimensions);
+
+		str(node->filename);
+		u(node->location.first_line);
+		u(node->location.first_column);
+		u(node->location.last_line);
+		u(node->location.last_column);
+
+		u(node->attributes.size());
+		for (auto &it : node->attributes) {
+			str(it.first.str());
+			this->node(it.second);
+		}
+		u(node->children.size());
+		for (auto child : node->children)
+			this->node(child);
+	}
+};
+
+struct AstDecoder
+{
+	const char *ptr, *end;
+	std::vector<std::string> strings;
+
+	AstDecoder(const std::string &data) : ptr(data.data()), end(data.data() + data.size()) { }
+
+	[[noreturn]] void corrupt()
+	{
+		log_error("Encoded module is corrupt.\n");
+	}
+
+	uint64_t u()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64 && ptr != end; shift += 7) {
+			unsigned char c = *ptr++;
+			value |= uint64_t(c & 0x7f) << shift;
+			if (!(c & 0x80))
+				return value;
+		}
+		corrupt();
+	}
+
+	int64_t s()
+	{
+		uint64_t value = u();
+		return int64_t(value >> 1) ^ -int64_t(value & 1);
+	}
+
+	size_t size()
+	{
+		uint64_t value = u();
+		if (value > uint64_t(end - ptr))
+			corrupt();
+		return value;
+	}
+
+	std::string str()
+	{
+		uint64_t value = u();
+		if (value & 1) {
+			if ((value >> 1) >= strings.size())
+				corrupt();
+			return strings[value >> 1];
+		}
+		if ((value >> 1) > uint64_t(end - ptr))
+			corrupt();
+		strings.push_back(std::string(ptr, value >> 1));
+		ptr += value >> 1;
+		return strings.back();
+	}
+
+	AstNode *node()
+	{
+		AstNode *node = new AstNode(AstNodeType(u()));
+		node->str = str();
+		node->bits.resize(size());
+		for (auto &bit : node->bits) {
+			unsigned char c = *ptr++;
+			if (c > RTLIL::State::Sm)
+				corrupt();
+			bit = RTLIL::State(c);
+		}
+
+		bool *flags[] = {&node->is_input, &node->is_output, &node->is_reg, &node->is_logic, &node->is_signed,
+				&node->is_string, &node->is_wand, &node->is_wor, &node->range_valid, &node->range_swapped,
+				&node->was_checked, &node->is_unsized, &node->is_custom_type, &node->is_enum, &node->basic_prep,
+				&node->lookahead, &node->in_lvalue, &node->in_param, &node->in_lvalue_from_above, &node->in_param_from_above};
+		uint64_t mask = u();
+		for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+			*flags[i] = (mask >> i) & 1;
+
+		node->port_id = s();
+		node->range_left = s();
+		node->range_right = s();
+		node->integer = u();
+		uint64_t realvalue = u();
+		memcpy(&node->realvalue, &realvalue, sizeof(realvalue));
+
+		node->dimensions.resize(size());
+		for (auto &dim : node->dimensions) {
+			dim.range_right = s();
+			dim.range_width = s();
+			dim.range_swapped = u();
+		}
+		node->unpacked_dimensions = s();
+
+		node->filename = str();
+		node->location.first_line = u();
+		node->location.first_column = u();
+		node->location.last_line = u();
+		node->location.last_column = u();
+
+		size_t count = size();
+		for (size_t i = 0; i < count; i++) {
+			RTLIL::IdString name = str();
+			AstNode *&attr = node->attributes[name];
+			delete attr;
+			attr = this->node();
+		}
+		count = size();
+		node->children.reserve(count);
+		for (size_t i = 0; i < count; i++)
+			node->children.push_back(this->node());
+		return node;
+	}
+};
+
+} // namespace
+
+std::string AST::encode_module(RTLIL::Module *module)
+{
+	AstModule *ast_module = dynamic_cast<AstModule*>(module);
+
+	AstEncoder encoder;
+	std::string section = RTLIL_BINARY::encode_module(module);
+	encoder.u(section.size());
+	encoder.buf += section;
+
+	if (ast_module == nullptr || ast_module->ast == nullptr) {
+		encoder.u(0);
+		return encoder.buf;
+	}
+
+	bool flags[] = {ast_module->nolatches, ast_module->nomeminit, ast_module->nomem2reg, ast_module->mem2reg,
+			ast_module->noblackbox, ast_module->lib, ast_module->nowb, ast_module->noopt, ast_module->icells,
+			ast_module->pwires, ast_module->autowire};
+	uint64_t mask = 1;
+	for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+		mask |= uint64_t(flags[i]) << (i + 1);
+	encoder.u(mask);
+	encoder.node(ast_module->ast);
+	return encoder.buf;
+}
+
+RTLIL::Module *AST::decode_module(RTLIL::IdString name, const std::string &data)
+{
+	AstDecoder decoder(data);
+	size_t section_size = decoder.size();
+	std::string section(decoder.ptr, section_size);
+	decoder.ptr += section_size;
+	uint64_t mask = decoder.u();
+
+	RTLIL::Module *module;
+	if (mask & 1) {
+		AstModule *ast_module = new AstModule;
+		bool *flags[] = {&ast_module->nolatches, &ast_module->nomeminit, &ast_module->nomem2reg, &ast_module->mem2reg,
+				&ast_module->noblackbox, &ast_module->lib, &ast_module->nowb, &ast_module->noopt, &ast_module->icells,
+				&ast_module->pwires, &ast_module->autowire};
+		for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++)
+			*flags[i] = (mask >> (i + 1)) & 1;
+		ast_module->ast = decoder.node();
+		module = ast_module;
+	} else {
+		module = new RTLIL::Module;
+	}
+	if (decoder.ptr != decoder.end)
+		decoder.corrupt();
+
+	module->name = name;
+	RTLIL_BINARY::decode_module(section, module);
+	return module;
+}
+
 void AstNode::input_error(const char *format, ...) const
 {
 	va_list ap;
@@ -406,6 +406,11 @@ namespace AST
 		void loadconfig() const;
 	};
 
+	// encode a module into a byte string (including the AST and options of an AstModule) and create a
+	// new module from such a string, e.g. to pass modules between processes (see "read_verilog -j")
+	std::string encode_module(RTLIL::Module *module);
+	RTLIL::Module *decode_module(RTLIL::IdString name, const std::string &data);
+
 	// this must be set by the language frontend before parsing the sources
 	// the AstNode constructor then uses current_filename and get_line_num()
 	// to initialize the filename and linenum properties of new nodes
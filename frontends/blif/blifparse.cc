@@ -23,39 +23,72 @@ YOSYS_NAMESPACE_BEGIN
 
 const int lut_input_plane_limit = 12;
 
-static bool read_next_line(char *&buffer, size_t &buffer_size, int &line_count, std::istream &f)
+// Splits a BLIF file that is already in memory into lines. The current line
+// is kept in a buffer that is reused for all lines, since tokenizing it writes
+// null characters into it.
+struct BlifLineReader
 {
-	string strbuf;
-	int buffer_len = 0;
-	buffer[0] = 0;
+	const char *ptr, *end;
+	std::vector<char> buffer;
+	char *token_ptr = nullptr;
+	int line_count = 0;
 
-	while (1)
-	{
-		buffer_len += strlen(buffer + buffer_len);
-		while (buffer_len > 0 && (buffer[buffer_len-1] == ' ' || buffer[buffer_len-1] == '\t' ||
-				buffer[buffer_len-1] == '\r' || buffer[buffer_len-1] == '\n'))
-			buffer[--buffer_len] = 0;
-
-		if (buffer_size-buffer_len < 4096) {
-			buffer_size *= 2;
-			buffer = (char*)realloc(buffer, buffer_size);
-		}
+	BlifLineReader(const char *begin, const char *end) : ptr(begin), end(end) { }
 
-		if (buffer_len == 0 || buffer[buffer_len-1] == '\\') {
-			if (buffer_len > 0 && buffer[buffer_len-1] == '\\')
-				buffer[--buffer_len] = 0;
+	// Reads the next line that isn't empty, without trailing whitespace and
+	// joined with the following lines if it ends with a backslash.
+	bool next_line()
+	{
+		buffer.clear();
+		while (1)
+		{
 			line_count++;
-			if (!std::getline(f, strbuf))
+			if (ptr == end)
 				return false;
-			while (buffer_size-buffer_len < strbuf.size()+1) {
-				buffer_size *= 2;
-				buffer = (char*)realloc(buffer, buffer_size);
-			}
-			strcpy(buffer+buffer_len, strbuf.c_str());
-		} else
-			return true;
+
+			const char *eol = (const char*)memchr(ptr, '\n', end - ptr);
+			const char *line_end = eol ? eol : end;
+			buffer.insert(buffer.end(), ptr, line_end);
+			ptr = eol ? eol + 1 : end;
+
+			while (!buffer.empty() && (buffer.back() == ' ' || buffer.back() == '\t' || buffer.back() == '\r'))
+				buffer.pop_back();
+
+			if (!buffer.empty() && buffer.back() == '\\')
+				buffer.pop_back();
+			else if (!buffer.empty())
+				break;
+		}
+		buffer.push_back(0);
+		token_ptr = buffer.data();
+		return true;
 	}
-}
+
+	char *line()
+	{
+		return buffer.data();
+	}
+
+	// Returns the next token of the current line and terminates it with a null
+	// character, like strtok() does.
+	char *next_token(const char *sep = " \t\r\n")
+	{
+		char *p = token_ptr;
+		while (*p && strchr(sep, *p))
+			p++;
+		if (*p == 0) {
+			token_ptr = p;
+			return nullptr;
+		}
+		char *token = p;
+		while (*p && !strchr(sep, *p))
+			p++;
+		if (*p)
+			*p++ = 0;
+		token_ptr = p;
+		return token;
+	}
+};
 
 static std::pair<RTLIL::IdString, int> wideports_split(std::string name)
 {
@@ -85,10 +118,19 @@ failed:
 }
 
 void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
+{
+	FileContents contents;
+	contents.read(f);
+	parse_blif(design, contents, dff_name, run_clean, sop_mode, wideports);
+}
+
+void parse_blif(RTLIL::Design *design, const FileContents &contents, IdString dff_name, bool run_clean, bool sop_mode, bool wideports)
 {
 	RTLIL::Module *module = nullptr;
 	RTLIL::Const *lutptr = NULL;
 	RTLIL::Cell *sopcell = NULL;
+	RTLIL::Const *sop_table = NULL;
+	int sop_width = 0, sop_depth = 0;
 	RTLIL::Cell *lastcell = nullptr;
 	RTLIL::State lut_default_state = RTLIL::State::Sx;
 	std::string err_reason;
@@ -108,8 +150,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					len++;
 
 				if (len > 0) {
-					string num_str = wire_name.substr(i+1, len);
-					int num = atoi(num_str.c_str()) & 0x0fffffff;
+					int num = atoi(wire_name.c_str() + i+1) & 0x0fffffff;
 					blif_maxnum = std::max(blif_maxnum, num);
 				}
 			}
@@ -129,20 +170,22 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 	dict<RTLIL::IdString, std::pair<int, bool>> wideports_cache;
 
-	size_t buffer_size = 4096;
-	char *buffer = (char*)malloc(buffer_size);
-	int line_count = 0;
+	std::vector<RTLIL::SigBit> names_bits;
+
+	BlifLineReader reader(contents.begin(), contents.end());
+	int &line_count = reader.line_count;
+	char *buffer;
 
 	while (1)
 	{
-		if (!read_next_line(buffer, buffer_size, line_count, f)) {
+		if (!reader.next_line()) {
 			if (module != nullptr)
 				goto error;
-			free(buffer);
 			return;
 		}
 
 	continue_without_read:
+		buffer = reader.line();
 		if (buffer[0] == '#')
 			continue;
 
@@ -157,18 +200,20 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			}
 
 			if (sopcell) {
+				sopcell->parameters[ID::DEPTH] = sop_depth;
 				sopcell = NULL;
+				sop_table = NULL;
 				sopmode = -1;
 			}
 
-			char *cmd = strtok(buffer, " \t\r\n");
+			char *cmd = reader.next_token();
 
 			if (!strcmp(cmd, ".model")) {
 				if (module != nullptr)
 					goto error;
 				module = new RTLIL::Module;
 				lastcell = nullptr;
-				char *name = strtok(NULL, " \t\r\n");
+				char *name = reader.next_token();
 				if (name == nullptr)
 					goto error;
 				module->name = RTLIL::escape_id(name);
@@ -269,7 +314,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			if (!strcmp(cmd, ".inputs") || !strcmp(cmd, ".outputs"))
 			{
 				char *p;
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
+				while ((p = reader.next_token()) != NULL)
 				{
 					RTLIL::IdString wire_name(stringf("\\%s", p));
 					RTLIL::Wire *wire = module->wire(wire_name);
@@ -295,7 +340,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".cname"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = reader.next_token();
 				if (p == NULL)
 					goto error;
 
@@ -310,8 +355,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			}
 
 			if (!strcmp(cmd, ".attr") || !strcmp(cmd, ".param")) {
-				char *n = strtok(NULL, " \t\r\n");
-				char *v = strtok(NULL, "\r\n");
+				char *n = reader.next_token();
+				char *v = reader.next_token("\r\n");
 				IdString id_n = RTLIL::escape_id(n);
 				Const const_v;
 				if (v[0] == '"') {
@@ -343,11 +388,11 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".latch"))
 			{
-				char *d = strtok(NULL, " \t\r\n");
-				char *q = strtok(NULL, " \t\r\n");
-				char *edge = strtok(NULL, " \t\r\n");
-				char *clock = strtok(NULL, " \t\r\n");
-				char *init = strtok(NULL, " \t\r\n");
+				char *d = reader.next_token();
+				char *q = reader.next_token();
+				char *edge = reader.next_token();
+				char *clock = reader.next_token();
+				char *init = reader.next_token();
 				RTLIL::Cell *cell = nullptr;
 
 				if (clock == nullptr && edge != nullptr) {
@@ -388,7 +433,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".gate") || !strcmp(cmd, ".subckt"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = reader.next_token();
 				if (p == NULL)
 					goto error;
 
@@ -398,7 +443,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 				dict<RTLIL::IdString, dict<int, SigBit>> cell_wideports_cache;
 
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
+				while ((p = reader.next_token()) != NULL)
 				{
 					char *q = strchr(p, '=');
 					if (q == NULL || !q[0])
@@ -457,11 +502,11 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 			if (!strcmp(cmd, ".barbuf") || !strcmp(cmd, ".conn"))
 			{
-				char *p = strtok(NULL, " \t\r\n");
+				char *p = reader.next_token();
 				if (p == NULL)
 					goto error;
 
-				char *q = strtok(NULL, " \t\r\n");
+				char *q = reader.next_token();
 				if (q == NULL)
 					goto error;
 
@@ -472,18 +517,22 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 			if (!strcmp(cmd, ".names"))
 			{
 				char *p;
-				RTLIL::SigSpec input_sig, output_sig;
-				while ((p = strtok(NULL, " \t\r\n")) != NULL)
-					input_sig.append(blif_wire(p));
-				output_sig = input_sig.extract(input_sig.size()-1, 1);
-				input_sig = input_sig.extract(0, input_sig.size()-1);
+				names_bits.clear();
+				while ((p = reader.next_token()) != NULL)
+					names_bits.push_back(blif_wire(p));
+				if (names_bits.empty())
+					goto error;
+				RTLIL::SigBit output_bit = names_bits.back();
+				names_bits.pop_back();
+				RTLIL::SigSpec input_sig(names_bits), output_sig(output_bit);
 
 				if (input_sig.size() == 0)
 				{
 					RTLIL::State state = RTLIL::State::Sa;
 					while (1) {
-						if (!read_next_line(buffer, buffer_size, line_count, f))
+						if (!reader.next_line())
 							goto error;
+						buffer = reader.line();
 						for (int i = 0; buffer[i]; i++) {
 							if (buffer[i] == ' ' || buffer[i] == '\t')
 								continue;
@@ -508,7 +557,7 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 				finished_parsing_constval:
 					if (state == RTLIL::State::Sa)
 						state = RTLIL::State::S0;
-					if (output_sig.as_wire()->name == ID($undef))
+					if (output_bit.wire->name == ID($undef))
 						state = RTLIL::State::Sx;
 					module->connect(RTLIL::SigSig(output_sig, state));
 					goto continue_without_read;
@@ -522,6 +571,9 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					sopcell->parameters[ID::TABLE] = RTLIL::Const();
 					sopcell->setPort(ID::A, input_sig);
 					sopcell->setPort(ID::Y, output_sig);
+					sop_table = &sopcell->parameters.at(ID::TABLE);
+					sop_width = input_sig.size();
+					sop_depth = 0;
 					sopmode = -1;
 					lastcell = sopcell;
 				}
@@ -535,8 +587,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 					RTLIL::Cell *cell = module->addCell(NEW_ID, ID($lut));
 					cell->parameters[ID::WIDTH] = RTLIL::Const(input_sig.size());
 					cell->parameters[ID::LUT] = RTLIL::Const(RTLIL::State::Sx, 1 << input_sig.size());
-					cell->setPort(ID::A, input_sig);
-					cell->setPort(ID::Y, output_sig);
+					cell->setPort(ID::A, std::move(input_sig));
+					cell->setPort(ID::Y, std::move(output_sig));
 					lutptr = &cell->parameters.at(ID::LUT);
 					lut_default_state = RTLIL::State::Sx;
 					lastcell = cell;
@@ -550,8 +602,8 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 		if (lutptr == NULL && sopcell == NULL)
 			goto error;
 
-		char *input = strtok(buffer, " \t\r\n");
-		char *output = strtok(NULL, " \t\r\n");
+		char *input = reader.next_token();
+		char *output = reader.next_token();
 
 		if (input == NULL || output == NULL || (strcmp(output, "0") && strcmp(output, "1")))
 			goto error;
@@ -560,22 +612,22 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 		if (sopcell)
 		{
-			log_assert(sopcell->parameters[ID::WIDTH].as_int() == input_len);
-			sopcell->parameters[ID::DEPTH] = sopcell->parameters[ID::DEPTH].as_int() + 1;
+			log_assert(sop_width == input_len);
+			sop_depth++;
 
 			for (int i = 0; i < input_len; i++)
 				switch (input[i]) {
 					case '0':
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S1);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
+						sop_table->bits.push_back(State::S1);
+						sop_table->bits.push_back(State::S0);
 						break;
 					case '1':
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S1);
+						sop_table->bits.push_back(State::S0);
+						sop_table->bits.push_back(State::S1);
 						break;
 					default:
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
-						sopcell->parameters[ID::TABLE].bits.push_back(State::S0);
+						sop_table->bits.push_back(State::S0);
+						sop_table->bits.push_back(State::S0);
 						break;
 				}
 
@@ -593,20 +645,30 @@ void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name, bool
 
 		if (lutptr)
 		{
-			if (input_len > lut_input_plane_limit)
+			if (input_len > lut_input_plane_limit || (1 << input_len) != GetSize(lutptr->bits))
 				goto error;
 
-			for (int i = 0; i < (1 << input_len); i++) {
-				for (int j = 0; j < input_len; j++) {
-					char c1 = input[j];
-					if (c1 != '-') {
-						char c2 = (i & (1 << j)) != 0 ? '1' : '0';
-						if (c1 != c2)
-							goto try_next_value;
-					}
+			// set the entries for all inputs that match the cube, by
+			// counting through the bits that don't care
+			int care = 0, value = 0;
+			for (int j = 0; j < input_len; j++) {
+				if (input[j] == '-')
+					continue;
+				care |= 1 << j;
+				if (input[j] == '1')
+					value |= 1 << j;
+				else if (input[j] != '0')
+					care = -1;
+			}
+
+			if (care >= 0) {
+				RTLIL::State state = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
+				int dont_care = ((1 << input_len) - 1) & ~care;
+				for (int i = dont_care; ; i = (i - 1) & dont_care) {
+					lutptr->bits[value | i] = state;
+					if (i == 0)
+						break;
 				}
-				lutptr->bits.at(i) = !strcmp(output, "0") ? RTLIL::State::S0 : RTLIL::State::S1;
-			try_next_value:;
 			}
 
 			lut_default_state = !strcmp(output, "0") ? RTLIL::State::S1 : RTLIL::State::S0;
@@ -661,7 +723,11 @@ struct BlifFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		parse_blif(design, *f, "", true, sop_mode, wideports);
+		FileContents contents;
+		if (dynamic_cast<std::ifstream*>(f) == nullptr || !contents.map(filename))
+			contents.read(*f);
+
+		parse_blif(design, contents, "", true, sop_mode, wideports);
 	}
 } BlifFrontend;
 
@@ -26,6 +26,8 @@ YOSYS_NAMESPACE_BEGIN
 
 extern void parse_blif(RTLIL::Design *design, std::istream &f, IdString dff_name,
 		bool run_clean = false, bool sop_mode = false, bool wideports = false);
+extern void parse_blif(RTLIL::Design *design, const FileContents &contents, IdString dff_name,
+		bool run_clean = false, bool sop_mode = false, bool wideports = false);
 
 YOSYS_NAMESPACE_END
 
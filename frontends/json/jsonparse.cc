@@ -21,233 +21,311 @@
 
 YOSYS_NAMESPACE_BEGIN
 
-struct JsonNode
+// A JSON reader that works in place on the contents of the file. The values
+// of a dict are recorded as positions in the file and only parsed when they
+// are used, so that the design can be built directly from the file without
+// creating a tree of the whole document first. It accepts the same (sloppy)
+// syntax as the tree based reader it replaces: separators are treated like
+// white space and numbers are integers or reals in plain decimal notation.
+
+struct JsonValue
 {
 	char type; // S=String, N=Number, A=Array, D=Dict
 	string data_string;
 	int64_t data_number;
-	vector<JsonNode*> data_array;
-	dict<string, JsonNode*> data_dict;
-	vector<string> data_dict_keys;
+};
 
-	JsonNode(std::istream &f)
-	{
-		type = 0;
-		data_number = 0;
+// The entries of a JSON dict with the position of their values. Like the
+// dict<> of the tree based reader, a key that appears more than once keeps
+// the place of its first appearance and gets the last value.
+struct JsonDict
+{
+	vector<std::pair<string, const char*>> entries;
+	// indices into entries in file order, including repeated keys
+	vector<int> order;
+	dict<string, int> index;
 
-		while (1)
-		{
-			int ch = f.get();
+	void clear()
+	{
+		entries.clear();
+		order.clear();
+		index.clear();
+	}
 
-			if (ch == EOF)
-				log_error("Unexpected EOF in JSON file.\n");
+	int find(const string &key) const
+	{
+		if (entries.size() <= 16) {
+			for (int i = 0; i < GetSize(entries); i++)
+				if (entries[i].first == key)
+					return i;
+			return -1;
+		}
+		auto it = index.find(key);
+		return it == index.end() ? -1 : it->second;
+	}
 
-			if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
-				continue;
+	void add(string &key, const char *value)
+	{
+		int i = find(key);
+		if (i < 0) {
+			i = GetSize(entries);
+			if (i >= 16) {
+				if (i == 16)
+					for (int j = 0; j < i; j++)
+						index[entries[j].first] = j;
+				index[key] = i;
+			}
+			entries.push_back({string(), value});
+			entries.back().first.swap(key);
+		} else {
+			entries[i].second = value;
+		}
+		order.push_back(i);
+	}
 
-			if (ch == '"')
-			{
-				type = 'S';
+	bool count(const string &key) const
+	{
+		return find(key) >= 0;
+	}
 
-				while (1)
-				{
-					ch = f.get();
-
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON string.\n");
-
-					if (ch == '"')
-						break;
-
-					if (ch == '\\') {
-						ch = f.get();
-
-						switch (ch) {
-							case EOF: log_error("Unexpected EOF in JSON string.\n"); break;
-							case '"':
-							case '/':
-							case '\\':           break;
-							case 'b': ch = '\b'; break;
-							case 'f': ch = '\f'; break;
-							case 'n': ch = '\n'; break;
-							case 'r': ch = '\r'; break;
-							case 't': ch = '\t'; break;
-							case 'u':
-								int val = 0;
-								for (int i = 0; i < 4; i++) {
-									ch = f.get();
-									val <<= 4;
-									if (ch >= '0' && '9' >= ch) {
-										val += ch - '0';
-									} else if (ch >= 'A' && 'F' >= ch) {
-										val += 10 + ch - 'A';
-									} else if (ch >= 'a' && 'f' >= ch) {
-										val += 10 + ch - 'a';
-									} else
-										log_error("Unexpected non-digit character in \\uXXXX sequence: %c.\n", ch);
-								}
-								if (val < 128)
-									ch = val;
-								else
-									log_error("Unsupported \\uXXXX sequence in JSON string: %04X.\n", val);
-								break;
-						}
-					}
+	const char *at(const string &key) const
+	{
+		return entries.at(find(key)).second;
+	}
+};
 
-					data_string += ch;
-				}
+struct JsonReader
+{
+	const char *ptr, *end;
+	string scratch;
 
-				break;
-			}
+	JsonReader(const char *begin, const char *end) : ptr(begin), end(end) { }
 
-			if (('0' <= ch && ch <= '9') || ch == '-')
-			{
-				bool negative = false;
-				type = 'N';
-				if (ch == '-') {
-					data_number = 0;
-				       	negative = true;
-				} else {
-					data_number = ch - '0';
-				}
+	// skips white space and the given separator and returns the next character
+	int skip(char separator = ' ')
+	{
+		while (ptr != end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n' || *ptr == separator))
+			ptr++;
+		return ptr == end ? EOF : (unsigned char)*ptr;
+	}
 
-				data_string += ch;
+	int next_value(char separator = ' ')
+	{
+		int ch = skip(separator);
+		if (ch == EOF)
+			log_error("Unexpected EOF in JSON file.\n");
+		return ch;
+	}
 
-				while (1)
-				{
-					ch = f.get();
+	// the type of the value at the current position
+	char type()
+	{
+		int ch = next_value();
+		if (ch == '"')
+			return 'S';
+		if (('0' <= ch && ch <= '9') || ch == '-')
+			return 'N';
+		if (ch == '[')
+			return 'A';
+		if (ch == '{')
+			return 'D';
+		log_error("Unexpected character in JSON file: '%c'\n", ch);
+	}
 
-					if (ch == EOF)
-						break;
+	char type_at(const char *pos)
+	{
+		ptr = pos;
+		return type();
+	}
 
-					if (ch == '.')
-						goto parse_real;
+	void parse_string(string &str)
+	{
+		str.clear();
+		ptr++;
 
-					if (ch < '0' || '9' < ch) {
-						f.unget();
-						break;
-					}
+		while (1)
+		{
+			const char *start = ptr;
+			while (ptr != end && *ptr != '"' && *ptr != '\\')
+				ptr++;
+			str.append(start, ptr);
 
-					data_number = data_number*10 + (ch - '0');
-					data_string += ch;
-				}
+			if (ptr == end)
+				log_error("Unexpected EOF in JSON string.\n");
 
-				data_number = negative ? -data_number : data_number;
-				data_string = "";
+			if (*ptr++ == '"')
 				break;
 
-			parse_real:
-				type = 'S';
-				data_number = 0;
-				data_string += ch;
-
-				while (1)
-				{
-					ch = f.get();
-
-					if (ch == EOF)
-						break;
-
-					if (ch < '0' || '9' < ch) {
-						f.unget();
-						break;
+			int ch = ptr == end ? EOF : (unsigned char)*ptr++;
+			switch (ch) {
+				case EOF: log_error("Unexpected EOF in JSON string.\n"); break;
+				case 'b': ch = '\b'; break;
+				case 'f': ch = '\f'; break;
+				case 'n': ch = '\n'; break;
+				case 'r': ch = '\r'; break;
+				case 't': ch = '\t'; break;
+				case 'u': {
+					int val = 0;
+					for (int i = 0; i < 4; i++) {
+						ch = ptr == end ? EOF : (unsigned char)*ptr++;
+						val <<= 4;
+						if (ch >= '0' && '9' >= ch) {
+							val += ch - '0';
+						} else if (ch >= 'A' && 'F' >= ch) {
+							val += 10 + ch - 'A';
+						} else if (ch >= 'a' && 'f' >= ch) {
+							val += 10 + ch - 'a';
+						} else
+							log_error("Unexpected non-digit character in \\uXXXX sequence: %c.\n", ch);
 					}
-
-					data_string += ch;
+					if (val < 128)
+						ch = val;
+					else
+						log_error("Unsupported \\uXXXX sequence in JSON string: %04X.\n", val);
+					break;
 				}
-
-				break;
 			}
 
-			if (ch == '[')
-			{
-				type = 'A';
-
-				while (1)
-				{
-					ch = f.get();
-
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON file.\n");
-
-					if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ',')
-						continue;
-
-					if (ch == ']')
-						break;
-
-					f.unget();
-					data_array.push_back(new JsonNode(f));
-				}
+			str += ch;
+		}
+	}
 
-				break;
-			}
+	void parse_number(JsonValue &value)
+	{
+		const char *start = ptr;
+		bool negative = *ptr == '-';
+
+		value.type = 'N';
+		value.data_number = 0;
+		for (ptr++; ptr != end && '0' <= *ptr && *ptr <= '9'; ptr++) { }
+		for (const char *p = start + negative; p != ptr; p++)
+			value.data_number = value.data_number*10 + (*p - '0');
+
+		if (ptr != end && *ptr == '.') {
+			for (ptr++; ptr != end && '0' <= *ptr && *ptr <= '9'; ptr++) { }
+			value.type = 'S';
+			value.data_number = 0;
+			value.data_string.assign(start, ptr);
+			return;
+		}
 
-			if (ch == '{')
-			{
-				type = 'D';
+		value.data_number = negative ? -value.data_number : value.data_number;
+		value.data_string.clear();
+	}
 
-				while (1)
-				{
-					ch = f.get();
+	// Parses a string or a number. Arrays and dicts are skipped and only
+	// their type is returned.
+	void parse_value(JsonValue &value)
+	{
+		value.type = type();
+		if (value.type == 'S')
+			parse_string(value.data_string);
+		else if (value.type == 'N')
+			parse_number(value);
+		else
+			skip_value();
+	}
 
-					if (ch == EOF)
-						log_error("Unexpected EOF in JSON file.\n");
+	void parse_value_at(JsonValue &value, const char *pos)
+	{
+		ptr = pos;
+		parse_value(value);
+	}
 
-					if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ',')
-						continue;
+	void skip_value()
+	{
+		char t = type();
+
+		if (t == 'S') {
+			const char *start = ptr;
+			for (ptr++; ptr != end && *ptr != '"' && *ptr != '\\'; ptr++) { }
+			if (ptr == end)
+				log_error("Unexpected EOF in JSON string.\n");
+			if (*ptr == '\\') {
+				// let the full parser check the escape sequences
+				ptr = start;
+				parse_string(scratch);
+			} else
+				ptr++;
+		} else
+		if (t == 'N') {
+			for (ptr++; ptr != end && '0' <= *ptr && *ptr <= '9'; ptr++) { }
+			if (ptr != end && *ptr == '.')
+				for (ptr++; ptr != end && '0' <= *ptr && *ptr <= '9'; ptr++) { }
+		} else
+		if (t == 'A') {
+			ptr++;
+			while (next_value(',') != ']')
+				skip_value();
+			ptr++;
+		} else
+			parse_dict(nullptr);
+	}
 
-					if (ch == '}')
-						break;
+	// Records the entries of the dict at the current position in dict (if
+	// not null) and moves past it. The values are only checked for syntax
+	// errors.
+	void parse_dict(JsonDict *dict)
+	{
+		string key;
+		ptr++;
 
-					f.unget();
-					JsonNode key(f);
+		while (1)
+		{
+			int ch = next_value(',');
 
-					while (1)
-					{
-						ch = f.get();
+			if (ch == '}')
+				break;
 
-						if (ch == EOF)
-							log_error("Unexpected EOF in JSON file.\n");
+			bool string_key = ch == '"';
+			if (string_key && dict)
+				parse_string(key);
+			else
+				skip_value();
 
-						if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == ':')
-							continue;
+			next_value(':');
+			const char *value = ptr;
+			skip_value();
 
-						f.unget();
-						break;
-					}
+			if (!string_key)
+				log_error("Unexpected non-string key in JSON dict.\n");
 
-					JsonNode *value = new JsonNode(f);
+			if (dict)
+				dict->add(key, value);
+		}
 
-					if (key.type != 'S')
-						log_error("Unexpected non-string key in JSON dict.\n");
+		ptr++;
+	}
 
-					data_dict[key.data_string] = value;
-					data_dict_keys.push_back(key.data_string);
-				}
+	void parse_dict_at(JsonDict &dict, const char *pos)
+	{
+		dict.clear();
+		ptr = pos;
+		parse_dict(&dict);
+	}
 
-				break;
-			}
+	void parse_array_at(vector<JsonValue> &values, const char *pos)
+	{
+		int count = 0;
+		ptr = pos + 1;
 
-			log_error("Unexpected character in JSON file: '%c'\n", ch);
+		while (next_value(',') != ']') {
+			if (count == GetSize(values))
+				values.emplace_back();
+			parse_value(values[count++]);
 		}
-	}
 
-	~JsonNode()
-	{
-		for (auto it : data_array)
-			delete it;
-		for (auto &it : data_dict)
-			delete it.second;
+		values.resize(count);
+		ptr++;
 	}
 };
 
-Const json_parse_attr_param_value(JsonNode *node)
+Const json_parse_attr_param_value(const JsonValue &node)
 {
 	Const value;
 
-	if (node->type == 'S') {
-		string &s = node->data_string;
+	if (node.type == 'S') {
+		const string &s = node.data_string;
 		size_t cursor = s.find_first_not_of("01xz");
 		if (cursor == string::npos) {
 			value = Const::from_string(s);
@@ -257,15 +335,15 @@ Const json_parse_attr_param_value(JsonNode *node)
 			value = Const(s);
 		}
 	} else
-	if (node->type == 'N') {
-		value = Const(node->data_number, 32);
-		if (node->data_number < 0)
+	if (node.type == 'N') {
+		value = Const(node.data_number, 32);
+		if (node.data_number < 0)
 			value.flags |= RTLIL::CONST_FLAG_SIGNED;
 	} else
-	if (node->type == 'A') {
+	if (node.type == 'A') {
 		log_error("JSON attribute or parameter value is an array.\n");
 	} else
-	if (node->type == 'D') {
+	if (node.type == 'D') {
 		log_error("JSON attribute or parameter value is a dict.\n");
 	} else {
 		log_abort();
@@ -274,20 +352,40 @@ Const json_parse_attr_param_value(JsonNode *node)
 	return value;
 }
 
-void json_parse_attr_param(dict<IdString, Const> &results, JsonNode *node)
+void json_parse_attr_param(dict<IdString, Const> &results, JsonReader &reader, const char *pos)
 {
-	if (node->type != 'D')
+	if (reader.type_at(pos) != 'D')
 		log_error("JSON attributes or parameters node is not a dictionary.\n");
 
-	for (auto it : node->data_dict)
+	JsonDict node;
+	JsonValue value_node;
+	reader.parse_dict_at(node, pos);
+
+	// same order as iterating over a dict<> filled in file order
+	for (auto it = node.entries.rbegin(); it != node.entries.rend(); ++it)
 	{
-		IdString key = RTLIL::escape_id(it.first.c_str());
-		Const value = json_parse_attr_param_value(it.second);
+		IdString key = RTLIL::escape_id(it->first.c_str());
+		reader.parse_value_at(value_node, it->second);
+		Const value = json_parse_attr_param_value(value_node);
 		results[key] = value;
 	}
 }
 
-void json_import(Design *design, string &modname, JsonNode *node)
+bool json_parse_number(JsonReader &reader, const JsonDict &node, const char *key, int64_t &result)
+{
+	if (node.count(key) == 0)
+		return false;
+
+	JsonValue val;
+	reader.parse_value_at(val, node.at(key));
+	if (val.type != 'N')
+		return false;
+
+	result = val.data_number;
+	return true;
+}
+
+void json_import(Design *design, const string &modname, JsonReader &reader, const char *pos)
 {
 	log("Importing module %s from JSON tree.\n", modname.c_str());
 
@@ -299,98 +397,104 @@ void json_import(Design *design, string &modname, JsonNode *node)
 
 	design->add(module);
 
-	if (node->data_dict.count("attributes"))
-		json_parse_attr_param(module->attributes, node->data_dict.at("attributes"));
+	// a module node that isn't a dict is imported as an empty module
+	JsonDict node;
+	if (reader.type_at(pos) == 'D')
+		reader.parse_dict_at(node, pos);
+
+	if (node.count("attributes"))
+		json_parse_attr_param(module->attributes, reader, node.at("attributes"));
 
 	dict<int, SigBit> signal_bits;
+	JsonDict items_node, item_node;
+	vector<JsonValue> bits;
+	int64_t number;
 
-	if (node->data_dict.count("ports"))
+	if (node.count("ports"))
 	{
-		JsonNode *ports_node = node->data_dict.at("ports");
+		const char *ports_pos = node.at("ports");
 
-		if (ports_node->type != 'D')
+		if (reader.type_at(ports_pos) != 'D')
 			log_error("JSON ports node is not a dictionary.\n");
 
-		for (int port_id = 1; port_id <= GetSize(ports_node->data_dict_keys); port_id++)
+		reader.parse_dict_at(items_node, ports_pos);
+		JsonDict &port_node = item_node;
+		JsonValue port_direction_node;
+
+		for (int port_id = 1; port_id <= GetSize(items_node.order); port_id++)
 		{
-			IdString port_name = RTLIL::escape_id(ports_node->data_dict_keys[port_id-1].c_str());
-			JsonNode *port_node = ports_node->data_dict.at(ports_node->data_dict_keys[port_id-1]);
+			auto &port_entry = items_node.entries[items_node.order[port_id-1]];
+			IdString port_name = RTLIL::escape_id(port_entry.first.c_str());
 
-			if (port_node->type != 'D')
+			if (reader.type_at(port_entry.second) != 'D')
 				log_error("JSON port node '%s' is not a dictionary.\n", log_id(port_name));
 
-			if (port_node->data_dict.count("direction") == 0)
+			reader.parse_dict_at(port_node, port_entry.second);
+
+			if (port_node.count("direction") == 0)
 				log_error("JSON port node '%s' has no direction attribute.\n", log_id(port_name));
 
-			if (port_node->data_dict.count("bits") == 0)
+			if (port_node.count("bits") == 0)
 				log_error("JSON port node '%s' has no bits attribute.\n", log_id(port_name));
 
-			JsonNode *port_direction_node = port_node->data_dict.at("direction");
-			JsonNode *port_bits_node = port_node->data_dict.at("bits");
+			reader.parse_value_at(port_direction_node, port_node.at("direction"));
 
-			if (port_direction_node->type != 'S')
+			if (port_direction_node.type != 'S')
 				log_error("JSON port node '%s' has non-string direction attribute.\n", log_id(port_name));
 
-			if (port_bits_node->type != 'A')
+			if (reader.type_at(port_node.at("bits")) != 'A')
 				log_error("JSON port node '%s' has non-array bits attribute.\n", log_id(port_name));
 
+			reader.parse_array_at(bits, port_node.at("bits"));
+
 			Wire *port_wire = module->wire(port_name);
 
 			if (port_wire == nullptr)
-				port_wire = module->addWire(port_name, GetSize(port_bits_node->data_array));
+				port_wire = module->addWire(port_name, GetSize(bits));
 
-			if (port_node->data_dict.count("upto") != 0) {
-				JsonNode *val = port_node->data_dict.at("upto");
-				if (val->type == 'N')
-					port_wire->upto = val->data_number != 0;
-			}
+			if (json_parse_number(reader, port_node, "upto", number))
+				port_wire->upto = number != 0;
 
-			if (port_node->data_dict.count("signed") != 0) {
-				JsonNode *val = port_node->data_dict.at("signed");
-				if (val->type == 'N')
-					port_wire->is_signed = val->data_number != 0;
-			}
+			if (json_parse_number(reader, port_node, "signed", number))
+				port_wire->is_signed = number != 0;
 
-			if (port_node->data_dict.count("offset") != 0) {
-				JsonNode *val = port_node->data_dict.at("offset");
-				if (val->type == 'N')
-					port_wire->start_offset = val->data_number;
-			}
+			if (json_parse_number(reader, port_node, "offset", number))
+				port_wire->start_offset = number;
 
-			if (port_direction_node->data_string == "input") {
+			if (port_direction_node.data_string == "input") {
 				port_wire->port_input = true;
 			} else
-			if (port_direction_node->data_string == "output") {
+			if (port_direction_node.data_string == "output") {
 				port_wire->port_output = true;
 			} else
-			if (port_direction_node->data_string == "inout") {
+			if (port_direction_node.data_string == "inout") {
 				port_wire->port_input = true;
 				port_wire->port_output = true;
 			} else
-				log_error("JSON port node '%s' has invalid '%s' direction attribute.\n", log_id(port_name), port_direction_node->data_string.c_str());
+				log_error("JSON port node '%s' has invalid '%s' direction attribute.\n", log_id(port_name), port_direction_node.data_string.c_str());
 
 			port_wire->port_id = port_id;
 
-			for (int i = 0; i < GetSize(port_bits_node->data_array); i++)
+			for (int i = 0; i < GetSize(bits); i++)
 			{
-				JsonNode *bitval_node = port_bits_node->data_array.at(i);
+				JsonValue &bitval_node = bits.at(i);
 				SigBit sigbit(port_wire, i);
 
-				if (bitval_node->type == 'S') {
-					if (bitval_node->data_string == "0")
+				if (bitval_node.type == 'S') {
+					if (bitval_node.data_string == "0")
 						module->connect(sigbit, State::S0);
-					else if (bitval_node->data_string == "1")
+					else if (bitval_node.data_string == "1")
 						module->connect(sigbit, State::S1);
-					else if (bitval_node->data_string == "x")
+					else if (bitval_node.data_string == "x")
 						module->connect(sigbit, State::Sx);
-					else if (bitval_node->data_string == "z")
+					else if (bitval_node.data_string == "z")
 						module->connect(sigbit, State::Sz);
 					else
 						log_error("JSON port node '%s' has invalid '%s' bit string value on bit %d.\n",
-								log_id(port_name), bitval_node->data_string.c_str(), i);
+								log_id(port_name), bitval_node.data_string.c_str(), i);
 				} else
-				if (bitval_node->type == 'N') {
-					int bitidx = bitval_node->data_number;
+				if (bitval_node.type == 'N') {
+					int bitidx = bitval_node.data_number;
 					if (signal_bits.count(bitidx)) {
 						if (port_wire->port_output) {
 							module->connect(sigbit, signal_bits.at(bitidx));
@@ -409,66 +513,64 @@ void json_import(Design *design, string &modname, JsonNode *node)
 		module->fixup_ports();
 	}
 
-	if (node->data_dict.count("netnames"))
+	if (node.count("netnames"))
 	{
-		JsonNode *netnames_node = node->data_dict.at("netnames");
+		const char *netnames_pos = node.at("netnames");
 
-		if (netnames_node->type != 'D')
+		if (reader.type_at(netnames_pos) != 'D')
 			log_error("JSON netnames node is not a dictionary.\n");
 
-		for (auto &net : netnames_node->data_dict)
+		reader.parse_dict_at(items_node, netnames_pos);
+		JsonDict &net_node = item_node;
+
+		for (auto net = items_node.entries.rbegin(); net != items_node.entries.rend(); ++net)
 		{
-			IdString net_name = RTLIL::escape_id(net.first.c_str());
-			JsonNode *net_node = net.second;
+			IdString net_name = RTLIL::escape_id(net->first.c_str());
 
-			if (net_node->type != 'D')
+			if (reader.type_at(net->second) != 'D')
 				log_error("JSON netname node '%s' is not a dictionary.\n", log_id(net_name));
 
-			if (net_node->data_dict.count("bits") == 0)
-				log_error("JSON netname node '%s' has no bits attribute.\n", log_id(net_name));
+			reader.parse_dict_at(net_node, net->second);
 
-			JsonNode *bits_node = net_node->data_dict.at("bits");
+			if (net_node.count("bits") == 0)
+				log_error("JSON netname node '%s' has no bits attribute.\n", log_id(net_name));
 
-			if (bits_node->type != 'A')
+			if (reader.type_at(net_node.at("bits")) != 'A')
 				log_error("JSON netname node '%s' has non-array bits attribute.\n", log_id(net_name));
 
+			reader.parse_array_at(bits, net_node.at("bits"));
+
 			Wire *wire = module->wire(net_name);
 
 			if (wire == nullptr)
-				wire = module->addWire(net_name, GetSize(bits_node->data_array));
+				wire = module->addWire(net_name, GetSize(bits));
 
-			if (net_node->data_dict.count("upto") != 0) {
-				JsonNode *val = net_node->data_dict.at("upto");
-				if (val->type == 'N')
-					wire->upto = val->data_number != 0;
-			}
+			if (json_parse_number(reader, net_node, "upto", number))
+				wire->upto = number != 0;
 
-			if (net_node->data_dict.count("offset") != 0) {
-				JsonNode *val = net_node->data_dict.at("offset");
-				if (val->type == 'N')
-					wire->start_offset = val->data_number;
-			}
+			if (json_parse_number(reader, net_node, "offset", number))
+				wire->start_offset = number;
 
-			for (int i = 0; i < GetSize(bits_node->data_array); i++)
+			for (int i = 0; i < GetSize(bits); i++)
 			{
-				JsonNode *bitval_node = bits_node->data_array.at(i);
+				JsonValue &bitval_node = bits.at(i);
 				SigBit sigbit(wire, i);
 
-				if (bitval_node->type == 'S') {
-					if (bitval_node->data_string == "0")
+				if (bitval_node.type == 'S') {
+					if (bitval_node.data_string == "0")
 						module->connect(sigbit, State::S0);
-					else if (bitval_node->data_string == "1")
+					else if (bitval_node.data_string == "1")
 						module->connect(sigbit, State::S1);
-					else if (bitval_node->data_string == "x")
+					else if (bitval_node.data_string == "x")
 						module->connect(sigbit, State::Sx);
-					else if (bitval_node->data_string == "z")
+					else if (bitval_node.data_string == "z")
 						module->connect(sigbit, State::Sz);
 					else
 						log_error("JSON netname node '%s' has invalid '%s' bit string value on bit %d.\n",
-								log_id(net_name), bitval_node->data_string.c_str(), i);
+								log_id(net_name), bitval_node.data_string.c_str(), i);
 				} else
-				if (bitval_node->type == 'N') {
-					int bitidx = bitval_node->data_number;
+				if (bitval_node.type == 'N') {
+					int bitidx = bitval_node.data_number;
 					if (signal_bits.count(bitidx)) {
 						if (sigbit != signal_bits.at(bitidx))
 							module->connect(sigbit, signal_bits.at(bitidx));
@@ -479,75 +581,84 @@ void json_import(Design *design, string &modname, JsonNode *node)
 					log_error("JSON netname node '%s' has invalid bit value on bit %d.\n", log_id(net_name), i);
 			}
 
-			if (net_node->data_dict.count("attributes"))
-				json_parse_attr_param(wire->attributes, net_node->data_dict.at("attributes"));
+			if (net_node.count("attributes"))
+				json_parse_attr_param(wire->attributes, reader, net_node.at("attributes"));
 		}
 	}
 
-	if (node->data_dict.count("cells"))
+	if (node.count("cells"))
 	{
-		JsonNode *cells_node = node->data_dict.at("cells");
+		const char *cells_pos = node.at("cells");
 
-		if (cells_node->type != 'D')
+		if (reader.type_at(cells_pos) != 'D')
 			log_error("JSON cells node is not a dictionary.\n");
 
-		for (auto &cell_node_it : cells_node->data_dict)
+		reader.parse_dict_at(items_node, cells_pos);
+		JsonDict &cell_node = item_node;
+		JsonDict connections_node;
+		JsonValue type_node;
+
+		for (auto cell_node_it = items_node.entries.rbegin(); cell_node_it != items_node.entries.rend(); ++cell_node_it)
 		{
-			IdString cell_name = RTLIL::escape_id(cell_node_it.first.c_str());
-			JsonNode *cell_node = cell_node_it.second;
+			IdString cell_name = RTLIL::escape_id(cell_node_it->first.c_str());
 
-			if (cell_node->type != 'D')
+			if (reader.type_at(cell_node_it->second) != 'D')
 				log_error("JSON cells node '%s' is not a dictionary.\n", log_id(cell_name));
 
-			if (cell_node->data_dict.count("type") == 0)
+			reader.parse_dict_at(cell_node, cell_node_it->second);
+
+			if (cell_node.count("type") == 0)
 				log_error("JSON cells node '%s' has no type attribute.\n", log_id(cell_name));
 
-			JsonNode *type_node = cell_node->data_dict.at("type");
+			reader.parse_value_at(type_node, cell_node.at("type"));
 
-			if (type_node->type != 'S')
+			if (type_node.type != 'S')
 				log_error("JSON cells node '%s' has a non-string type.\n", log_id(cell_name));
 
-			IdString cell_type = RTLIL::escape_id(type_node->data_string.c_str());
+			IdString cell_type = RTLIL::escape_id(type_node.data_string.c_str());
 
 			Cell *cell = module->addCell(cell_name, cell_type);
 
-			if (cell_node->data_dict.count("connections") == 0)
+			if (cell_node.count("connections") == 0)
 				log_error("JSON cells node '%s' has no connections attribute.\n", log_id(cell_name));
 
-			JsonNode *connections_node = cell_node->data_dict.at("connections");
+			const char *connections_pos = cell_node.at("connections");
 
-			if (connections_node->type != 'D')
+			if (reader.type_at(connections_pos) != 'D')
 				log_error("JSON cells node '%s' has non-dictionary connections attribute.\n", log_id(cell_name));
 
-			for (auto &conn_it : connections_node->data_dict)
+			reader.parse_dict_at(connections_node, connections_pos);
+
+			for (auto conn_it = connections_node.entries.rbegin(); conn_it != connections_node.entries.rend(); ++conn_it)
 			{
-				IdString conn_name = RTLIL::escape_id(conn_it.first.c_str());
-				JsonNode *conn_node = conn_it.second;
+				IdString conn_name = RTLIL::escape_id(conn_it->first.c_str());
 
-				if (conn_node->type != 'A')
+				if (reader.type_at(conn_it->second) != 'A')
 					log_error("JSON cells node '%s' connection '%s' is not an array.\n", log_id(cell_name), log_id(conn_name));
 
+				reader.parse_array_at(bits, conn_it->second);
+
 				SigSpec sig;
 
-				for (int i = 0; i < GetSize(conn_node->data_array); i++)
+				for (int i = 0; i < GetSize(bits); i++)
 				{
-					JsonNode *bitval_node = conn_node->data_array.at(i);
+					JsonValue &bitval_node = bits.at(i);
 
-					if (bitval_node->type == 'S') {
-						if (bitval_node->data_string == "0")
+					if (bitval_node.type == 'S') {
+						if (bitval_node.data_string == "0")
 							sig.append(State::S0);
-						else if (bitval_node->data_string == "1")
+						else if (bitval_node.data_string == "1")
 							sig.append(State::S1);
-						else if (bitval_node->data_string == "x")
+						else if (bitval_node.data_string == "x")
 							sig.append(State::Sx);
-						else if (bitval_node->data_string == "z")
+						else if (bitval_node.data_string == "z")
 							sig.append(State::Sz);
 						else
 							log_error("JSON cells node '%s' connection '%s' has invalid '%s' bit string value on bit %d.\n",
-									log_id(cell_name), log_id(conn_name), bitval_node->data_string.c_str(), i);
+									log_id(cell_name), log_id(conn_name), bitval_node.data_string.c_str(), i);
 					} else
-					if (bitval_node->type == 'N') {
-						int bitidx = bitval_node->data_number;
+					if (bitval_node.type == 'N') {
+						int bitidx = bitval_node.data_number;
 						if (signal_bits.count(bitidx) == 0)
 							signal_bits[bitidx] = module->addWire(NEW_ID);
 						sig.append(signal_bits.at(bitidx));
@@ -560,55 +671,57 @@ void json_import(Design *design, string &modname, JsonNode *node)
 				cell->setPort(conn_name, sig);
 			}
 
-			if (cell_node->data_dict.count("attributes"))
-				json_parse_attr_param(cell->attributes, cell_node->data_dict.at("attributes"));
+			if (cell_node.count("attributes"))
+				json_parse_attr_param(cell->attributes, reader, cell_node.at("attributes"));
 
-			if (cell_node->data_dict.count("parameters"))
-				json_parse_attr_param(cell->parameters, cell_node->data_dict.at("parameters"));
+			if (cell_node.count("parameters"))
+				json_parse_attr_param(cell->parameters, reader, cell_node.at("parameters"));
 		}
 	}
 
-	if (node->data_dict.count("memories"))
+	if (node.count("memories"))
 	{
-		JsonNode *memories_node = node->data_dict.at("memories");
+		const char *memories_pos = node.at("memories");
 
-		if (memories_node->type != 'D')
+		if (reader.type_at(memories_pos) != 'D')
 			log_error("JSON memories node is not a dictionary.\n");
 
-		for (auto &memory_node_it : memories_node->data_dict)
+		reader.parse_dict_at(items_node, memories_pos);
+		JsonDict &memory_node = item_node;
+		JsonValue val;
+
+		for (auto memory_node_it = items_node.entries.rbegin(); memory_node_it != items_node.entries.rend(); ++memory_node_it)
 		{
-			IdString memory_name = RTLIL::escape_id(memory_node_it.first.c_str());
-			JsonNode *memory_node = memory_node_it.second;
+			IdString memory_name = RTLIL::escape_id(memory_node_it->first.c_str());
 
 			RTLIL::Memory *mem = new RTLIL::Memory;
 			mem->name = memory_name;
 
-			if (memory_node->type != 'D')
+			if (reader.type_at(memory_node_it->second) != 'D')
 				log_error("JSON memory node '%s' is not a dictionary.\n", log_id(memory_name));
 
-			if (memory_node->data_dict.count("width") == 0)
+			reader.parse_dict_at(memory_node, memory_node_it->second);
+
+			if (memory_node.count("width") == 0)
 				log_error("JSON memory node '%s' has no width attribute.\n", log_id(memory_name));
-			JsonNode *width_node = memory_node->data_dict.at("width");
-			if (width_node->type != 'N')
+			reader.parse_value_at(val, memory_node.at("width"));
+			if (val.type != 'N')
 				log_error("JSON memory node '%s' has a non-number width.\n", log_id(memory_name));
-			mem->width = width_node->data_number;
+			mem->width = val.data_number;
 
-			if (memory_node->data_dict.count("size") == 0)
+			if (memory_node.count("size") == 0)
 				log_error("JSON memory node '%s' has no size attribute.\n", log_id(memory_name));
-			JsonNode *size_node = memory_node->data_dict.at("size");
-			if (size_node->type != 'N')
+			reader.parse_value_at(val, memory_node.at("size"));
+			if (val.type != 'N')
 				log_error("JSON memory node '%s' has a non-number size.\n", log_id(memory_name));
-			mem->size = size_node->data_number;
+			mem->size = val.data_number;
 
 			mem->start_offset = 0;
-			if (memory_node->data_dict.count("start_offset") != 0) {
-				JsonNode *val = memory_node->data_dict.at("start_offset");
-				if (val->type == 'N')
-					mem->start_offset = val->data_number;
-			}
+			if (json_parse_number(reader, memory_node, "start_offset", number))
+				mem->start_offset = number;
 
-			if (memory_node->data_dict.count("attributes"))
-				json_parse_attr_param(mem->attributes, memory_node->data_dict.at("attributes"));
+			if (memory_node.count("attributes"))
+				json_parse_attr_param(mem->attributes, reader, memory_node.at("attributes"));
 
 			module->memories[mem->name] = mem;
 		}
@@ -617,6 +730,7 @@ void json_import(Design *design, string &modname, JsonNode *node)
 	// remove duplicates from connections array
 	pool<RTLIL::SigSig> unique_connections(module->connections_.begin(), module->connections_.end());
 	module->connections_ = std::vector<RTLIL::SigSig>(unique_connections.begin(), unique_connections.end());
+	module->connections_changed();
 }
 
 struct JsonFrontend : public Frontend {
@@ -646,20 +760,32 @@ struct JsonFrontend : public Frontend {
 		}
 		extra_args(f, filename, args, argidx);
 
-		JsonNode root(*f);
+		// plain files are opened as std::ifstream by extra_args()
+		FileContents contents;
+		if (dynamic_cast<std::ifstream*>(f) == nullptr || !contents.map(filename))
+			contents.read(*f);
 
-		if (root.type != 'D')
+		JsonReader reader(contents.begin(), contents.end());
+		JsonDict root;
+
+		if (reader.type() != 'D')
 			log_error("JSON root node is not a dictionary.\n");
 
-		if (root.data_dict.count("modules") != 0)
+		// this checks the syntax of the whole file
+		reader.parse_dict(&root);
+
+		if (root.count("modules") != 0)
 		{
-			JsonNode *modules = root.data_dict.at("modules");
+			const char *modules_pos = root.at("modules");
 
-			if (modules->type != 'D')
+			if (reader.type_at(modules_pos) != 'D')
 				log_error("JSON modules node is not a dictionary.\n");
 
-			for (auto &it : modules->data_dict)
-				json_import(design, it.first, it.second);
+			JsonDict modules;
+			reader.parse_dict_at(modules, modules_pos);
+
+			for (auto it = modules.entries.rbegin(); it != modules.entries.rend(); ++it)
+				json_import(design, it->first, reader, it->second);
 		}
 	}
 } JsonFrontend;
@@ -488,6 +488,14 @@ struct LibertyFrontend : public Frontend {
 		log("    -setattr <attribute_name>\n");
 		log("        set the specified attribute (to the value 1) on all loaded modules\n");
 		log("\n");
+		log("Parsing large liberty files takes a while. When the scratchpad variable\n");
+		log("'liberty.cache_dir' is set to a directory (e.g. with 'scratchpad -set\n");
+		log("liberty.cache_dir <dir>'), the parsed file is stored in a cache file in that\n");
+		log("directory, and later runs load it from there as long as the absolute path,\n");
+		log("size, modification time (including the nanoseconds, where the file system\n");
+		log("stores them) and the SHA1 hash of the contents of the liberty file are the\n");
+		log("same. The cache is shared by read_liberty, dfflibmap and stat -liberty.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -546,7 +554,7 @@ struct LibertyFrontend : public Frontend {
 
 		log_header(design, "Executing Liberty frontend: %s\n", filename.c_str());
 
-		LibertyParser parser(*f);
+		LibertyParser parser(*f, filename, {}, design->scratchpad_get_string("liberty.cache_dir"));
 		int cell_count = 0;
 
 		std::map<std::string, std::tuple<int, int, bool>> global_type_map;
@@ -0,0 +1,766 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A hand-written parser for the RTLIL text representation that works on
+ *  a file mapped into memory. It accepts the same language as the flex and
+ *  bison based parser in rtlil_lexer.l and rtlil_parser.y and creates the
+ *  same design, but tokenizes in place and builds the design objects
+ *  directly, without copying every token to the heap first.
+ *
+ */
+
+#include "rtlil_frontend.h"
+#include "kernel/log.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace RTLIL_FRONTEND {
+
+struct FastParser
+{
+	enum TokenType {
+		TOK_EOF, TOK_EOL, TOK_KEYWORD, TOK_ID, TOK_VALUE, TOK_INT, TOK_STRING, TOK_CHAR, TOK_INVALID
+	};
+
+	const char *ptr, *end;
+	int line = 1;
+
+	// the current token, text points into the mapped file
+	TokenType tok = TOK_EOF;
+	const char *text = nullptr;
+	int len = 0;
+	int integer = 0;
+
+	RTLIL::Design *design;
+	RTLIL::Module *module = nullptr;
+	RTLIL::Process *process = nullptr;
+	std::vector<std::vector<RTLIL::SwitchRule*>*> switch_stack;
+	std::vector<RTLIL::CaseRule*> case_stack;
+	dict<RTLIL::IdString, RTLIL::Const> attrbuf;
+	std::string strbuf, idbuf;
+
+	FastParser(RTLIL::Design *design, const char *begin, const char *end) : ptr(begin), end(end), design(design) { }
+
+	[[noreturn]] void error(const std::string &msg)
+	{
+		log_error("Parser error in line %d: %s\n", line, msg.c_str());
+	}
+
+	[[noreturn]] void syntax_error()
+	{
+		error("syntax error, unexpected " + token_str());
+	}
+
+	std::string token_str()
+	{
+		switch (tok) {
+			case TOK_EOF: return "end of file";
+			case TOK_EOL: return "end of line";
+			case TOK_STRING: return "string";
+			default: return std::string(text, len);
+		}
+	}
+
+	// Tokenizer, matching the rules in rtlil_lexer.l
+
+	void next()
+	{
+		while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+			ptr++;
+
+		if (ptr < end && *ptr == '#')
+			while (ptr < end && *ptr != '\n')
+				ptr++;
+
+		text = ptr;
+
+		if (ptr == end) {
+			tok = TOK_EOF;
+			len = 0;
+			return;
+		}
+
+		char ch = *ptr;
+
+		if (ch == '\r' || ch == '\n') {
+			// empty and comment lines are part of the same token
+			while (ptr < end) {
+				if (*ptr == '#') {
+					while (ptr < end && *ptr != '\n')
+						ptr++;
+					continue;
+				}
+				if (*ptr == '\n')
+					line++;
+				else if (*ptr != '\r' && *ptr != ' ' && *ptr != '\t')
+					break;
+				ptr++;
+			}
+			tok = TOK_EOL;
+			len = ptr - text;
+			return;
+		}
+
+		if ('a' <= ch && ch <= 'z') {
+			while (ptr < end && 'a' <= *ptr && *ptr <= 'z')
+				ptr++;
+			tok = TOK_KEYWORD;
+			len = ptr - text;
+			return;
+		}
+
+		if (ch == '\\' || ch == '$') {
+			while (ptr < end && *ptr != ' ' && *ptr != '\t' && *ptr != '\r' && *ptr != '\n')
+				ptr++;
+			len = ptr - text;
+			tok = len > 1 ? TOK_ID : TOK_CHAR;
+			if (tok == TOK_CHAR)
+				ptr = text + 1, len = 1;
+			return;
+		}
+
+		if (('0' <= ch && ch <= '9') || (ch == '-' && ptr+1 < end && '0' <= ptr[1] && ptr[1] <= '9')) {
+			const char *p = ptr + (ch == '-');
+			while (p < end && '0' <= *p && *p <= '9')
+				p++;
+			if (ch != '-' && p < end && *p == '\'') {
+				p++;
+				while (p < end && (*p == '0' || *p == '1' || *p == 'x' || *p == 'z' || *p == 'm' || *p == '-'))
+					p++;
+				ptr = p;
+				tok = TOK_VALUE;
+				len = ptr - text;
+				return;
+			}
+			ptr = p;
+			len = ptr - text;
+			int64_t value = parse_decimal(text + (ch == '-'), ptr);
+			if (ch == '-')
+				value = -value;
+			tok = value < INT_MIN || value > INT_MAX ? TOK_INVALID : TOK_INT;
+			integer = value;
+			return;
+		}
+
+		if (ch == '"') {
+			next_string();
+			return;
+		}
+
+		ptr++;
+		tok = TOK_CHAR;
+		len = 1;
+	}
+
+	// saturates well outside of the int range
+	static int64_t parse_decimal(const char *p, const char *end)
+	{
+		int64_t value = 0;
+		for (; p < end; p++)
+			value = std::min(value * 10 + (*p - '0'), int64_t(1) << 40);
+		return value;
+	}
+
+	void next_string()
+	{
+		strbuf.clear();
+		for (ptr++; ptr < end && *ptr != '"'; ptr++) {
+			char ch = *ptr;
+			if (ch == '\n')
+				line++;
+			if (ch == '\\' && ptr+1 < end && ptr[1] != '\n') {
+				ch = *++ptr;
+				if (ch == 'n')
+					ch = '\n';
+				else if (ch == 't')
+					ch = '\t';
+				else if ('0' <= ch && ch <= '7') {
+					ch = ch - '0';
+					for (int i = 0; i < 2 && ptr+1 < end && '0' <= ptr[1] && ptr[1] <= '7'; i++)
+						ch = ch * 8 + *++ptr - '0';
+				}
+			}
+			strbuf += ch;
+		}
+		if (ptr == end)
+			error("unterminated string");
+		ptr++;
+
+		// the string is passed on as a C string
+		size_t nul = strbuf.find('\0');
+		if (nul != std::string::npos)
+			strbuf.resize(nul);
+
+		tok = TOK_STRING;
+		text = strbuf.data();
+		len = GetSize(strbuf);
+	}
+
+	bool is_keyword(const char *keyword)
+	{
+		return tok == TOK_KEYWORD && !strncmp(text, keyword, len) && keyword[len] == 0;
+	}
+
+	bool is_char(char ch)
+	{
+		return tok == TOK_CHAR && *text == ch;
+	}
+
+	void expect_keyword(const char *keyword)
+	{
+		if (!is_keyword(keyword))
+			syntax_error();
+		next();
+	}
+
+	void expect_char(char ch)
+	{
+		if (!is_char(ch))
+			syntax_error();
+		next();
+	}
+
+	void expect_eol()
+	{
+		if (tok != TOK_EOL)
+			syntax_error();
+		next();
+	}
+
+	int expect_int()
+	{
+		if (tok != TOK_INT)
+			syntax_error();
+		int value = integer;
+		next();
+		return value;
+	}
+
+	RTLIL::IdString expect_id()
+	{
+		if (tok != TOK_ID)
+			syntax_error();
+		idbuf.assign(text, len);
+		RTLIL::IdString id(idbuf.c_str());
+		next();
+		return id;
+	}
+
+	void check_attrbuf()
+	{
+		if (attrbuf.size() != 0)
+			error("dangling attribute");
+	}
+
+	// Grammar, matching the rules in rtlil_parser.y
+
+	RTLIL::Const parse_constant()
+	{
+		RTLIL::Const value;
+
+		if (tok == TOK_VALUE) {
+			const char *tick = text;
+			while (*tick != '\'')
+				tick++;
+			int width = std::min(parse_decimal(text, tick), int64_t(INT_MAX));
+			const char *msb = tick + 1, *lsb = text + len - 1;
+			int num_bits = text + len - msb;
+
+			auto state = [](char ch) {
+				switch (ch) {
+					case '0': return RTLIL::S0;
+					case '1': return RTLIL::S1;
+					case 'z': return RTLIL::Sz;
+					case '-': return RTLIL::Sa;
+					case 'm': return RTLIL::Sm;
+					default: return RTLIL::Sx;
+				}
+			};
+
+			RTLIL::State padding = num_bits ? state(*msb) : RTLIL::Sx;
+			if (padding == RTLIL::S1)
+				padding = RTLIL::S0;
+
+			if (width > 0) {
+				value.bits.reserve(width);
+				for (int i = 0; i < width; i++)
+					value.bits.push_back(i < num_bits ? state(lsb[-i]) : padding);
+			}
+			next();
+			return value;
+		}
+
+		if (tok == TOK_INT) {
+			value = RTLIL::Const(integer, 32);
+			next();
+			return value;
+		}
+
+		if (tok == TOK_STRING) {
+			value = RTLIL::Const(strbuf);
+			next();
+			return value;
+		}
+
+		syntax_error();
+	}
+
+	RTLIL::SigSpec parse_sigspec()
+	{
+		RTLIL::SigSpec sig;
+
+		if (tok == TOK_ID) {
+			RTLIL::IdString name = expect_id();
+			RTLIL::Wire *wire = module->wire(name);
+			if (wire == nullptr)
+				error(stringf("RTLIL error: wire %s not found", name.c_str()));
+			// select single bits without building the whole wire first
+			if (is_char('[')) {
+				const char *saved_ptr = ptr, *saved_text = text;
+				int saved_line = line;
+				next();
+				if (tok == TOK_INT) {
+					int index = integer;
+					next();
+					if (is_char(']')) {
+						if (index >= wire->width || index < 0)
+							error("bit index out of range");
+						next();
+						sig = RTLIL::SigSpec(wire, index);
+						goto selections;
+					}
+				}
+				ptr = saved_ptr, text = saved_text, line = saved_line;
+				tok = TOK_CHAR, len = 1;
+			}
+			sig = RTLIL::SigSpec(wire);
+		} else if (is_char('{')) {
+			next();
+			std::vector<RTLIL::SigSpec> parts;
+			while (!is_char('}'))
+				parts.push_back(parse_sigspec());
+			next();
+			for (auto it = parts.rbegin(); it != parts.rend(); it++)
+				sig.append(*it);
+		} else {
+			sig = parse_constant();
+		}
+
+	selections:
+		while (is_char('[')) {
+			next();
+			int msb = expect_int();
+			if (is_char(':')) {
+				next();
+				int lsb = expect_int();
+				expect_char(']');
+				if (msb >= sig.size() || msb < 0 || msb < lsb)
+					error("invalid slice");
+				sig = sig.extract(lsb, msb - lsb + 1);
+			} else {
+				expect_char(']');
+				if (msb >= sig.size() || msb < 0)
+					error("bit index out of range");
+				sig = sig.extract(msb);
+			}
+		}
+
+		return sig;
+	}
+
+	void parse_attr_stmt()
+	{
+		expect_keyword("attribute");
+		RTLIL::IdString name = expect_id();
+		attrbuf[name] = parse_constant();
+		expect_eol();
+	}
+
+	void parse_module()
+	{
+		expect_keyword("module");
+		RTLIL::IdString name = expect_id();
+		expect_eol();
+
+		bool delete_current_module = false;
+		if (design->has(name)) {
+			RTLIL::Module *existing_mod = design->module(name);
+			if (!flag_overwrite && (flag_lib || (attrbuf.count(ID::blackbox) && attrbuf.at(ID::blackbox).as_bool()))) {
+				log("Ignoring blackbox re-definition of module %s.\n", name.c_str());
+				delete_current_module = true;
+			} else if (!flag_nooverwrite && !flag_overwrite && !existing_mod->get_bool_attribute(ID::blackbox)) {
+				error(stringf("RTLIL error: redefinition of module %s.", name.c_str()));
+			} else if (flag_nooverwrite) {
+				log("Ignoring re-definition of module %s.\n", name.c_str());
+				delete_current_module = true;
+			} else {
+				log("Replacing existing%s module %s.\n", existing_mod->get_bool_attribute(ID::blackbox) ? " blackbox" : "", name.c_str());
+				design->remove(existing_mod);
+			}
+		}
+
+		module = new RTLIL::Module;
+		module->name = name;
+		module->attributes.swap(attrbuf);
+		attrbuf.clear();
+		if (!delete_current_module)
+			design->add(module);
+
+		while (!is_keyword("end"))
+		{
+			if (is_keyword("parameter")) {
+				next();
+				RTLIL::IdString param = expect_id();
+				module->avail_parameters(param);
+				if (tok != TOK_EOL)
+					module->parameter_default_values[param] = parse_constant();
+				expect_eol();
+			}
+			else if (is_keyword("attribute"))
+				parse_attr_stmt();
+			else if (is_keyword("wire"))
+				parse_wire();
+			else if (is_keyword("memory"))
+				parse_memory();
+			else if (is_keyword("cell"))
+				parse_cell();
+			else if (is_keyword("process"))
+				parse_process();
+			else if (is_keyword("connect")) {
+				next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				expect_eol();
+				check_attrbuf();
+				module->connect(lhs, rhs);
+			}
+			else
+				syntax_error();
+		}
+
+		check_attrbuf();
+		next();
+		module->fixup_ports();
+		if (delete_current_module)
+			delete module;
+		else if (flag_lib)
+			module->makeblackbox();
+		module = nullptr;
+		expect_eol();
+	}
+
+	void parse_wire()
+	{
+		expect_keyword("wire");
+
+		int width = 1, start_offset = 0, port_id = 0;
+		bool upto = false, is_signed = false, port_input = false, port_output = false;
+
+		while (tok == TOK_KEYWORD) {
+			if (is_keyword("width")) {
+				next();
+				if (tok == TOK_INVALID || tok == TOK_KEYWORD)
+					error("RTLIL error: invalid wire width");
+				width = expect_int();
+			} else if (is_keyword("upto")) {
+				next();
+				upto = true;
+			} else if (is_keyword("signed")) {
+				next();
+				is_signed = true;
+			} else if (is_keyword("offset")) {
+				next();
+				start_offset = expect_int();
+			} else if (is_keyword("input") || is_keyword("output") || is_keyword("inout")) {
+				port_input = !is_keyword("output");
+				port_output = !is_keyword("input");
+				next();
+				port_id = expect_int();
+			} else
+				syntax_error();
+		}
+
+		RTLIL::IdString name = expect_id();
+		expect_eol();
+
+		if (module->wire(name) != nullptr)
+			error(stringf("RTLIL error: redefinition of wire %s.", name.c_str()));
+
+		RTLIL::Wire *wire = module->addWire(name, width);
+		wire->attributes.swap(attrbuf);
+		attrbuf.clear();
+		wire->start_offset = start_offset;
+		wire->port_id = port_id;
+		wire->port_input = port_input;
+		wire->port_output = port_output;
+		wire->upto = upto;
+		wire->is_signed = is_signed;
+	}
+
+	void parse_memory()
+	{
+		expect_keyword("memory");
+
+		RTLIL::Memory *memory = new RTLIL::Memory;
+		memory->attributes.swap(attrbuf);
+		attrbuf.clear();
+
+		while (tok == TOK_KEYWORD) {
+			if (is_keyword("width")) {
+				next();
+				memory->width = expect_int();
+			} else if (is_keyword("size")) {
+				next();
+				memory->size = expect_int();
+			} else if (is_keyword("offset")) {
+				next();
+				memory->start_offset = expect_int();
+			} else
+				syntax_error();
+		}
+
+		RTLIL::IdString name = expect_id();
+		expect_eol();
+
+		if (module->memories.count(name) != 0)
+			error(stringf("RTLIL error: redefinition of memory %s.", name.c_str()));
+		memory->name = name;
+		module->memories[name] = memory;
+	}
+
+	void parse_cell()
+	{
+		expect_keyword("cell");
+		RTLIL::IdString type = expect_id();
+		RTLIL::IdString name = expect_id();
+		expect_eol();
+
+		if (module->cell(name) != nullptr)
+			error(stringf("RTLIL error: redefinition of cell %s.", name.c_str()));
+		RTLIL::Cell *cell = module->addCell(name, type);
+		cell->attributes.swap(attrbuf);
+		attrbuf.clear();
+
+		while (!is_keyword("end"))
+		{
+			if (is_keyword("parameter")) {
+				next();
+				int flags = 0;
+				if (is_keyword("signed")) {
+					next();
+					flags = RTLIL::CONST_FLAG_SIGNED;
+				} else if (is_keyword("real")) {
+					next();
+					flags = RTLIL::CONST_FLAG_REAL;
+				}
+				RTLIL::IdString param = expect_id();
+				RTLIL::Const &value = cell->parameters[param];
+				value = parse_constant();
+				value.flags |= flags;
+				expect_eol();
+			} else if (is_keyword("connect")) {
+				next();
+				RTLIL::IdString port = expect_id();
+				if (cell->hasPort(port))
+					error(stringf("RTLIL error: redefinition of cell port %s.", port.c_str()));
+				cell->setPort(port, parse_sigspec());
+				expect_eol();
+			} else
+				syntax_error();
+		}
+
+		next();
+		expect_eol();
+	}
+
+	void parse_process()
+	{
+		expect_keyword("process");
+		RTLIL::IdString name = expect_id();
+		expect_eol();
+
+		if (module->processes.count(name) != 0)
+			error(stringf("RTLIL error: redefinition of process %s.", name.c_str()));
+		process = module->addProcess(name);
+		process->attributes.swap(attrbuf);
+		attrbuf.clear();
+		switch_stack.clear();
+		switch_stack.push_back(&process->root_case.switches);
+		case_stack.clear();
+		case_stack.push_back(&process->root_case);
+
+		parse_case_body();
+
+		while (is_keyword("sync"))
+		{
+			next();
+			RTLIL::SyncRule *rule = new RTLIL::SyncRule;
+			process->syncs.push_back(rule);
+
+			if (is_keyword("always") || is_keyword("global") || is_keyword("init")) {
+				rule->type = is_keyword("always") ? RTLIL::STa : is_keyword("global") ? RTLIL::STg : RTLIL::STi;
+				next();
+			} else {
+				if (is_keyword("low"))
+					rule->type = RTLIL::ST0;
+				else if (is_keyword("high"))
+					rule->type = RTLIL::ST1;
+				else if (is_keyword("posedge"))
+					rule->type = RTLIL::STp;
+				else if (is_keyword("negedge"))
+					rule->type = RTLIL::STn;
+				else if (is_keyword("edge"))
+					rule->type = RTLIL::STe;
+				else
+					syntax_error();
+				next();
+				rule->signal = parse_sigspec();
+			}
+			expect_eol();
+
+			while (1)
+			{
+				if (is_keyword("update")) {
+					next();
+					RTLIL::SigSpec lhs = parse_sigspec();
+					RTLIL::SigSpec rhs = parse_sigspec();
+					expect_eol();
+					rule->actions.push_back(RTLIL::SigSig(lhs, rhs));
+				} else if (is_keyword("attribute") || is_keyword("memwr")) {
+					while (is_keyword("attribute"))
+						parse_attr_stmt();
+					expect_keyword("memwr");
+					RTLIL::MemWriteAction act;
+					act.attributes.swap(attrbuf);
+					attrbuf.clear();
+					act.memid = expect_id();
+					act.address = parse_sigspec();
+					act.data = parse_sigspec();
+					act.enable = parse_sigspec();
+					act.priority_mask = parse_constant();
+					expect_eol();
+					rule->mem_write_actions.push_back(std::move(act));
+				} else
+					break;
+			}
+		}
+
+		expect_keyword("end");
+		expect_eol();
+		process = nullptr;
+	}
+
+	void parse_case_body()
+	{
+		while (1)
+		{
+			if (is_keyword("attribute"))
+				parse_attr_stmt();
+			else if (is_keyword("switch"))
+				parse_switch();
+			else if (is_keyword("assign")) {
+				next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				expect_eol();
+				check_attrbuf();
+				case_stack.back()->actions.push_back(RTLIL::SigSig(lhs, rhs));
+			} else
+				break;
+		}
+	}
+
+	void parse_switch()
+	{
+		expect_keyword("switch");
+		RTLIL::SwitchRule *rule = new RTLIL::SwitchRule;
+		rule->signal = parse_sigspec();
+		expect_eol();
+		rule->attributes.swap(attrbuf);
+		attrbuf.clear();
+		switch_stack.back()->push_back(rule);
+
+		while (is_keyword("attribute"))
+			parse_attr_stmt();
+
+		while (is_keyword("case"))
+		{
+			next();
+			RTLIL::CaseRule *case_rule = new RTLIL::CaseRule;
+			case_rule->attributes.swap(attrbuf);
+			attrbuf.clear();
+			rule->cases.push_back(case_rule);
+			switch_stack.push_back(&case_rule->switches);
+			case_stack.push_back(case_rule);
+
+			if (tok != TOK_EOL) {
+				case_rule->compare.push_back(parse_sigspec());
+				while (is_char(',')) {
+					next();
+					case_rule->compare.push_back(parse_sigspec());
+				}
+			}
+			expect_eol();
+
+			parse_case_body();
+			switch_stack.pop_back();
+			case_stack.pop_back();
+		}
+
+		expect_keyword("end");
+		expect_eol();
+	}
+
+	void parse()
+	{
+		next();
+		if (tok == TOK_EOL)
+			next();
+
+		while (tok != TOK_EOF)
+		{
+			if (is_keyword("module"))
+				parse_module();
+			else if (is_keyword("attribute"))
+				parse_attr_stmt();
+			else if (is_keyword("autoidx")) {
+				next();
+				autoidx = max(autoidx, expect_int());
+				expect_eol();
+			} else
+				syntax_error();
+		}
+
+		check_attrbuf();
+	}
+};
+
+bool fast_parse_file(const std::string &filename, RTLIL::Design *design)
+{
+	FileContents contents;
+	if (!contents.map(filename))
+		return false;
+
+	FastParser(design, contents.begin(), contents.end()).parse();
+	return true;
+}
+
+}
+
+YOSYS_NAMESPACE_END
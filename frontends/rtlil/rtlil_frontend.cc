@@ -25,6 +25,7 @@
 #include "rtlil_frontend.h"
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "backends/rtlil/rtlil_binary.h"
 
 void rtlil_frontend_yyerror(char const *s)
 {
@@ -55,12 +56,29 @@ struct RTLILFrontend : public Frontend {
 		log("    -lib\n");
 		log("        only create empty blackbox modules\n");
 		log("\n");
+		log("    -legacy\n");
+		log("        use the flex and bison based parser. By default plain files are read\n");
+		log("        with a faster hand-written parser that maps the file into memory.\n");
+		log("        Other inputs (compressed files, here-documents and stdin) always use\n");
+		log("        the flex and bison based parser.\n");
+		log("\n");
+		log("    -lazy\n");
+		log("        only decode the modules of a binary file (see below) when they are\n");
+		log("        accessed for the first time, e.g. because they are selected for a\n");
+		log("        pass. Modules that are never accessed are written back unchanged by\n");
+		log("        'write_rtlil -binary'. This speeds up runs that only work on a few\n");
+		log("        modules of a large design. Text files are always read completely.\n");
+		log("\n");
+		log("Files written with 'write_rtlil -binary' are detected automatically.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		RTLIL_FRONTEND::flag_nooverwrite = false;
 		RTLIL_FRONTEND::flag_overwrite = false;
 		RTLIL_FRONTEND::flag_lib = false;
+		bool flag_legacy = false;
+		bool flag_lazy = false;
 
 		log_header(design, "Executing RTLIL frontend.\n");
 
@@ -81,12 +99,31 @@ struct RTLILFrontend : public Frontend {
 				RTLIL_FRONTEND::flag_lib = true;
 				continue;
 			}
+			if (arg == "-legacy") {
+				flag_legacy = true;
+				continue;
+			}
+			if (arg == "-lazy") {
+				flag_lazy = true;
+				continue;
+			}
 			break;
 		}
-		extra_args(f, filename, args, argidx);
+		extra_args(f, filename, args, argidx, true);
 
 		log("Input filename: %s\n", filename.c_str());
 
+		if (f->peek() == RTLIL_BINARY::magic_first_byte) {
+			RTLIL_BINARY::read_design(*f, design, RTLIL_FRONTEND::flag_nooverwrite,
+					RTLIL_FRONTEND::flag_overwrite, RTLIL_FRONTEND::flag_lib, flag_lazy);
+			return;
+		}
+
+		// plain files are opened as std::ifstream by extra_args()
+		if (!flag_legacy && dynamic_cast<std::ifstream*>(f) != nullptr &&
+				RTLIL_FRONTEND::fast_parse_file(filename, design))
+			return;
+
 		RTLIL_FRONTEND::lexin = f;
 		RTLIL_FRONTEND::current_design = design;
 		rtlil_frontend_yydebug = false;
@@ -35,6 +35,10 @@ namespace RTLIL_FRONTEND {
 	extern bool flag_nooverwrite;
 	extern bool flag_overwrite;
 	extern bool flag_lib;
+
+	// Parses the file with the hand-written parser in rtlil_fast_parser.cc.
+	// Returns false if the file can't be mapped into memory.
+	bool fast_parse_file(const std::string &filename, RTLIL::Design *design);
 }
 
 YOSYS_NAMESPACE_END
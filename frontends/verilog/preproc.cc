@@ -35,7 +35,10 @@
 #include "preproc.h"
 #include "verilog_frontend.h"
 #include "kernel/log.h"
+#include "libs/sha1/sha1.h"
 #include <assert.h>
+#include <fstream>
+#include <sstream>
 #include <stack>
 #include <stdarg.h>
 #include <stdio.h>
@@ -385,7 +388,7 @@ void define_map_t::log() const
 	}
 }
 
-static void input_file(std::istream &f, std::string filename)
+static void input_file(std::istream &f, std::string filename, std::string *contents = nullptr)
 {
 	char buffer[513];
 	int rc;
@@ -397,6 +400,8 @@ static void input_file(std::istream &f, std::string filename)
 	while ((rc = readsome(f, buffer, sizeof(buffer)-1)) > 0) {
 		buffer[rc] = 0;
 		input_buffer.insert(it, buffer);
+		if (contents != nullptr)
+			contents->append(buffer, rc);
 	}
 	input_buffer.insert(it, "\n`file_pop\n");
 }
@@ -744,13 +749,279 @@ read_define(const std::string &filename,
 	}
 }
 
+static std::string open_include_file(std::ifstream &ff, const std::string &fn, const std::string &filename,
+		const std::list<std::string> &include_dirs)
+{
+	ff.clear();
+	std::string fixed_fn = fn;
+	ff.open(fixed_fn.c_str());
+
+	bool filename_path_sep_found;
+	bool fn_relative;
+#ifdef _WIN32
+	// Both forward and backslash are acceptable separators on Windows.
+	filename_path_sep_found = (filename.find_first_of("/\\") != std::string::npos);
+	// Easier just to invert the check for an absolute path (e.g. C:\ or C:/)
+	fn_relative = !(fn[1] == ':' && (fn[2] == '/' || fn[2] == '\\'));
+#else
+	filename_path_sep_found = (filename.find('/') != std::string::npos);
+	fn_relative = (fn[0] != '/');
+#endif
+
+	if (ff.fail() && fn.size() > 0 && fn_relative && filename_path_sep_found) {
+		// if the include file was not found, it is not given with an absolute path, and the
+		// currently read file is given with a path, then try again relative to its directory
+		ff.clear();
+#ifdef _WIN32
+		fixed_fn = filename.substr(0, filename.find_last_of("/\\")+1) + fn;
+#else
+		fixed_fn = filename.substr(0, filename.rfind('/')+1) + fn;
+#endif
+		ff.open(fixed_fn);
+	}
+	if (ff.fail() && fn.size() > 0 && fn_relative) {
+		// if the include file was not found and it is not given with an absolute path, then
+		// search it in the include path
+		for (auto incdir : include_dirs) {
+			ff.clear();
+			fixed_fn = incdir + '/' + fn;
+			ff.open(fixed_fn);
+			if (!ff.fail()) break;
+		}
+	}
+	return fixed_fn;
+}
+
+/*
+The preprocessor cache stores the output for a file under the SHA1 of
+everything the output depends on besides the included files: the file name and
+contents, the defines when preprocessing starts, the include directories and
+the SystemVerilog mode. The cache file holds the magic line and that hash,
+then for every `include the name of the file that contains it, the name as
+written, the file that was found and the SHA1 of its contents, and finally the
+side effects (`resetall and the global defines after the file) and the output.
+An entry is only used when every `include still finds the same file with the
+same contents. Numbers are stored as LEB128 varints and strings as their size
+followed by their contents.
+*/
+static const char preproc_cache_magic[] = "Yosys Verilog preprocessor cache 1\n";
+
+struct PreprocCacheInclude
+{
+	std::string filename, fn, fixed_fn, hash;
+};
+
+struct PreprocCacheWriter
+{
+	std::string out;
+
+	void put_count(size_t count)
+	{
+		while (count >= 0x80) {
+			out += char(count | 0x80);
+			count >>= 7;
+		}
+		out += char(count);
+	}
+
+	void put_string(const std::string &str)
+	{
+		put_count(str.size());
+		out += str;
+	}
+
+	void put_defines(const define_map_t &defines)
+	{
+		put_count(defines.defines.size());
+		for (auto &it : defines.defines) {
+			put_string(it.first);
+			put_string(it.second->body);
+			put_count(it.second->has_args ? it.second->args.args.size() + 1 : 0);
+			if (it.second->has_args)
+				for (auto &arg : it.second->args.args) {
+					put_string(arg.name);
+					put_count(arg.has_default);
+					put_string(arg.default_value);
+				}
+		}
+	}
+};
+
+struct PreprocCacheReader
+{
+	const char *ptr, *end;
+
+	bool get_count(size_t &count)
+	{
+		count = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (ptr == end)
+				return false;
+			unsigned char byte = *ptr++;
+			count |= size_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool get_string(std::string &str)
+	{
+		size_t size;
+		if (!get_count(size) || size > size_t(end - ptr))
+			return false;
+		str.assign(ptr, size);
+		ptr += size;
+		return true;
+	}
+
+	bool get_defines(define_map_t &defines)
+	{
+		size_t count, arg_count, has_default;
+		std::string name, body, arg_name, default_value;
+		if (!get_count(count))
+			return false;
+		defines.clear();
+		for (size_t i = 0; i < count; i++) {
+			if (!get_string(name) || !get_string(body) || !get_count(arg_count))
+				return false;
+			arg_map_t args;
+			for (size_t j = 1; j < arg_count; j++) {
+				if (!get_string(arg_name) || !get_count(has_default) || !get_string(default_value) || args.find(arg_name))
+					return false;
+				args.add_arg(arg_name, has_default ? default_value.c_str() : nullptr);
+			}
+			defines.add(name, body, arg_count ? &args : nullptr);
+		}
+		return true;
+	}
+};
+
+static std::string preproc_cache_key(const std::string &filename, const std::string &contents, const define_map_t &pre_defines,
+		const define_map_t &global_defines_cache, const std::list<std::string> &include_dirs)
+{
+	PreprocCacheWriter writer;
+	writer.put_string(filename);
+	writer.put_string(contents);
+	writer.put_defines(pre_defines);
+	writer.put_defines(global_defines_cache);
+	writer.put_count(include_dirs.size());
+	for (auto &dir : include_dirs)
+		writer.put_string(dir);
+	writer.put_count(sv_mode);
+	return sha1(writer.out);
+}
+
+static bool load_preproc_cache(const std::string &cache_file, const std::string &key, const std::list<std::string> &include_dirs,
+		define_map_t &global_defines_cache, std::string &output)
+{
+	FileContents contents;
+	if (!contents.map(cache_file))
+		return false;
+
+	size_t magic_size = strlen(preproc_cache_magic);
+	if (contents.size() < magic_size || memcmp(contents.begin(), preproc_cache_magic, magic_size) != 0)
+		return false;
+
+	PreprocCacheReader reader;
+	reader.ptr = contents.begin() + magic_size;
+	reader.end = contents.end();
+
+	std::string cached_key;
+	size_t count;
+	if (!reader.get_string(cached_key) || cached_key != key || !reader.get_count(count))
+		return false;
+
+	std::vector<std::string> included_files;
+	for (size_t i = 0; i < count; i++) {
+		PreprocCacheInclude include;
+		if (!reader.get_string(include.filename) || !reader.get_string(include.fn) ||
+				!reader.get_string(include.fixed_fn) || !reader.get_string(include.hash))
+			return false;
+		std::ifstream ff;
+		std::string fixed_fn = open_include_file(ff, include.fn, include.filename, include_dirs);
+		if (ff.fail()) {
+			if (!include.fixed_fn.empty())
+				return false;
+			continue;
+		}
+		std::string include_contents(std::istreambuf_iterator<char>(ff), {});
+		if (fixed_fn != include.fixed_fn || sha1(include_contents) != include.hash)
+			return false;
+		included_files.push_back(fixed_fn);
+	}
+
+	size_t resetall;
+	define_map_t defines;
+	if (!reader.get_count(resetall) || !reader.get_defines(defines) || !reader.get_string(output) || reader.ptr != reader.end)
+		return false;
+
+	if (resetall)
+		default_nettype_wire = true;
+	global_defines_cache.clear();
+	global_defines_cache.merge(defines);
+	for (auto &fn : included_files)
+		yosys_input_files.insert(fn);
+	return true;
+}
+
+static bool save_preproc_cache(const std::string &cache_file, const std::string &key, const std::vector<PreprocCacheInclude> &includes,
+		bool resetall, const define_map_t &global_defines_cache, const std::string &output)
+{
+	PreprocCacheWriter writer;
+	writer.out = preproc_cache_magic;
+	writer.put_string(key);
+	writer.put_count(includes.size());
+	for (auto &include : includes) {
+		writer.put_string(include.filename);
+		writer.put_string(include.fn);
+		writer.put_string(include.fixed_fn);
+		writer.put_string(include.hash);
+	}
+	writer.put_count(resetall);
+	writer.put_defines(global_defines_cache);
+	writer.put_string(output);
+
+	// write to a temporary file first, so that concurrent runs never see a
+	// partially written cache file
+	std::string cache_dir = cache_file.substr(0, cache_file.rfind('/'));
+	create_directory(cache_dir);
+	std::string temp_file = make_temp_file(cache_file + ".XXXXXX");
+	std::ofstream f(temp_file, std::ofstream::binary | std::ofstream::trunc);
+	f.write(writer.out.data(), writer.out.size());
+	f.close();
+
+	if (f.fail() || rename(temp_file.c_str(), cache_file.c_str()) != 0) {
+		remove(temp_file.c_str());
+		log_warning("Can't write Verilog preprocessor cache file `%s'.\n", cache_file.c_str());
+		return false;
+	}
+	return true;
+}
+
 std::string
 frontend_verilog_preproc(std::istream                 &f,
                          std::string                   filename,
                          const define_map_t           &pre_defines,
                          define_map_t                 &global_defines_cache,
-                         const std::list<std::string> &include_dirs)
+                         const std::list<std::string> &include_dirs,
+                         const std::string             &cache_dir)
 {
+	std::string contents, cache_key, cache_file;
+	std::vector<PreprocCacheInclude> cache_includes;
+	bool resetall = false;
+
+	if (!cache_dir.empty()) {
+		contents.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		cache_key = preproc_cache_key(filename, contents, pre_defines, global_defines_cache, include_dirs);
+		cache_file = cache_dir + "/" + cache_key + ".vpp";
+		std::string output;
+		if (load_preproc_cache(cache_file, cache_key, include_dirs, global_defines_cache, output)) {
+			log("Loaded preprocessed `%s' from cache file `%s'.\n", filename.c_str(), cache_file.c_str());
+			return output;
+		}
+	}
+
 	define_map_t defines;
 	defines.merge(pre_defines);
 	defines.merge(global_defines_cache);
@@ -773,7 +1044,11 @@ frontend_verilog_preproc(std::istream                 &f,
 	input_buffer.clear();
 	input_buffer_charp = 0;
 
-	input_file(f, filename);
+	if (!cache_file.empty()) {
+		std::istringstream contents_stream(contents);
+		input_file(contents_stream, filename);
+	} else
+		input_file(f, filename);
 
 	while (!input_buffer.empty())
 	{
@@ -872,49 +1147,17 @@ frontend_verilog_preproc(std::istream                 &f,
 					fn = fn.substr(0, pos) + fn.substr(pos+1);
 			}
 			std::ifstream ff;
-			ff.clear();
-			std::string fixed_fn = fn;
-			ff.open(fixed_fn.c_str());
-
-			bool filename_path_sep_found;
-			bool fn_relative;
-#ifdef _WIN32
-			// Both forward and backslash are acceptable separators on Windows.
-			filename_path_sep_found = (filename.find_first_of("/\\") != std::string::npos);
-			// Easier just to invert the check for an absolute path (e.g. C:\ or C:/)
-			fn_relative = !(fn[1] == ':' && (fn[2] == '/' || fn[2] == '\\'));
-#else
-			filename_path_sep_found = (filename.find('/') != std::string::npos);
-			fn_relative = (fn[0] != '/');
-#endif
-
-			if (ff.fail() && fn.size() > 0 && fn_relative && filename_path_sep_found) {
-				// if the include file was not found, it is not given with an absolute path, and the
-				// currently read file is given with a path, then try again relative to its directory
-				ff.clear();
-#ifdef _WIN32
-				fixed_fn = filename.substr(0, filename.find_last_of("/\\")+1) + fn;
-#else
-				fixed_fn = filename.substr(0, filename.rfind('/')+1) + fn;
-#endif
-				ff.open(fixed_fn);
-			}
-			if (ff.fail() && fn.size() > 0 && fn_relative) {
-				// if the include file was not found and it is not given with an absolute path, then
-				// search it in the include path
-				for (auto incdir : include_dirs) {
-					ff.clear();
-					fixed_fn = incdir + '/' + fn;
-					ff.open(fixed_fn);
-					if (!ff.fail()) break;
-				}
-			}
+			std::string fixed_fn = open_include_file(ff, fn, filename, include_dirs);
+			std::string include_contents;
 			if (ff.fail()) {
 				output_code.push_back("`file_notfound " + fn);
+				fixed_fn.clear();
 			} else {
-				input_file(ff, fixed_fn);
+				input_file(ff, fixed_fn, cache_file.empty() ? nullptr : &include_contents);
 				yosys_input_files.insert(fixed_fn);
 			}
+			if (!cache_file.empty())
+				cache_includes.push_back({filename, fn, fixed_fn, fixed_fn.empty() ? std::string() : sha1(include_contents)});
 			continue;
 		}
 
@@ -962,6 +1205,7 @@ frontend_verilog_preproc(std::istream                 &f,
 
 		if (tok == "`resetall") {
 			default_nettype_wire = true;
+			resetall = true;
 			continue;
 		}
 
@@ -994,6 +1238,9 @@ frontend_verilog_preproc(std::istream                 &f,
 	input_buffer.clear();
 	input_buffer_charp = 0;
 
+	if (!cache_file.empty() && save_preproc_cache(cache_file, cache_key, cache_includes, resetall, global_defines_cache, output))
+		log("Stored preprocessed `%s' in cache file `%s'.\n", filename.c_str(), cache_file.c_str());
+
 	return output;
 }
 
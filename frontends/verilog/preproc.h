@@ -71,7 +71,8 @@ frontend_verilog_preproc(std::istream                 &f,
                          std::string                   filename,
                          const define_map_t           &pre_defines,
                          define_map_t                 &global_defines_cache,
-                         const std::list<std::string> &include_dirs);
+                         const std::list<std::string> &include_dirs,
+                         const std::string             &cache_dir);
 
 YOSYS_NAMESPACE_END
 
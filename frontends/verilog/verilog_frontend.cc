@@ -32,6 +32,15 @@
 #include "libs/sha1/sha1.h"
 #include <stdarg.h>
 
+#if defined(YOSYS_ENABLE_THREADS) && !defined(_WIN32) && !defined(__wasm)
+#  define VERILOG_FRONTEND_JOBS
+#  include <errno.h>
+#  include <poll.h>
+#  include <signal.h>
+#  include <sys/wait.h>
+#  include <unistd.h>
+#endif
+
 YOSYS_NAMESPACE_BEGIN
 using namespace VERILOG_FRONTEND;
 
@@ -63,6 +72,344 @@ static void add_package_types(dict<std::string, AST::AstNode *> &user_types, std
 	}
 }
 
+#ifdef VERILOG_FRONTEND_JOBS
+// Parses and elaborates the preprocessed files of "read_verilog -j" in worker
+// processes. Each file is handled by a child process of a worker, so that it
+// sees the design as it was when the workers were started. The child sends
+// back its log output and the new modules, which are added to the design in
+// the order of the files. Files that can't be handled this way are read
+// again in the main process.
+struct VerilogJobs
+{
+	struct Worker {
+		pid_t pid;
+		int fd;
+		std::string buffer;
+		size_t offset;
+		bool eof;
+	};
+
+	RTLIL::Design *design;
+	int jobs, file_count;
+	std::function<void(int)> read_code;
+
+	std::vector<Worker> workers;
+	int first_file = 0;
+
+	// modules added or replaced by the files merged so far
+	pool<RTLIL::IdString> read_modules;
+
+	VerilogJobs(RTLIL::Design *design, int jobs, int file_count, std::function<void(int)> read_code) :
+			design(design), jobs(jobs), file_count(file_count), read_code(read_code) { }
+
+	~VerilogJobs()
+	{
+		stop();
+	}
+
+	static void put(std::string &buf, uint64_t value)
+	{
+		while (value >= 0x80) {
+			buf += char(value | 0x80);
+			value >>= 7;
+		}
+		buf += char(value);
+	}
+
+	static void put(std::string &buf, const std::string &value)
+	{
+		put(buf, value.size());
+		buf += value;
+	}
+
+	struct Reader {
+		const char *ptr, *end;
+
+		Reader(const std::string &buf) : ptr(buf.data()), end(buf.data() + buf.size()) { }
+
+		uint64_t u()
+		{
+			uint64_t value = 0;
+			for (int shift = 0; shift < 64 && ptr != end; shift += 7) {
+				unsigned char c = *ptr++;
+				value |= uint64_t(c & 0x7f) << shift;
+				if (!(c & 0x80))
+					return value;
+			}
+			log_error("Corrupt result from Verilog worker process.\n");
+		}
+
+		std::string str()
+		{
+			uint64_t size = u();
+			if (size > uint64_t(end - ptr))
+				log_error("Corrupt result from Verilog worker process.\n");
+			ptr += size;
+			return std::string(ptr - size, size);
+		}
+	};
+
+	static bool write_record(int fd, const std::string &record)
+	{
+		uint64_t size = record.size();
+		std::string data((const char*)&size, sizeof(size));
+		data += record;
+
+		for (size_t done = 0; done < data.size();) {
+			ssize_t count = write(fd, data.data() + done, data.size() - done);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			done += count;
+		}
+		return true;
+	}
+
+	// Runs in a child of a worker and returns the result for one file, or
+	// an empty record if the file needs to be read in the main process.
+	std::string run_file(int index)
+	{
+		dict<RTLIL::IdString, RTLIL::Module*> old_modules;
+		for (auto &it : design->modules_)
+			old_modules[it.first] = it.second;
+		size_t old_packages = design->verilog_packages.size();
+		size_t old_globals = design->verilog_globals.size();
+		size_t old_bindings = design->bindings_.size();
+
+		LogBuffer buffer;
+		buffer.begin();
+		bool ok = true;
+		try {
+			read_code(index);
+		} catch (log_buffered_error_exception&) {
+			ok = false;
+		}
+		buffer.end();
+
+		// errors are reported by the main process, and packages, global
+		// declarations and bindings affect the files that follow
+		if (!ok || design->verilog_packages.size() != old_packages || design->verilog_globals.size() != old_globals ||
+				design->bindings_.size() != old_bindings)
+			return std::string();
+
+		std::vector<RTLIL::IdString> removed;
+		for (auto &it : old_modules)
+			if (design->modules_.count(it.first) == 0 || design->modules_.at(it.first) != it.second)
+				removed.push_back(it.first);
+
+		std::vector<RTLIL::Module*> added;
+		for (auto &it : design->modules_) {
+			auto old = old_modules.find(it.first);
+			if (old == old_modules.end() || old->second != it.second) {
+				if (!it.second->bindings_.empty())
+					return std::string();
+				added.push_back(it.second);
+			}
+		}
+		std::reverse(added.begin(), added.end());
+
+		std::string record;
+		put(record, 1);
+		put(record, buffer.debug_suppressed);
+		put(record, buffer.entries.size());
+		for (auto &entry : buffer.entries) {
+			put(record, entry.kind);
+			put(record, entry.prefix);
+			put(record, entry.text);
+		}
+		put(record, autoidx);
+		put(record, removed.size());
+		for (auto name : removed)
+			put(record, name.str());
+		put(record, added.size());
+		for (auto module : added) {
+			put(record, module->name.str());
+			put(record, AST::encode_module(module));
+		}
+		return record;
+	}
+
+	[[noreturn]] void run_worker(int index, int stride, int fd)
+	{
+		for (; index < file_count; index += stride)
+		{
+			pid_t pid = fork();
+			if (pid == 0)
+				_exit(write_record(fd, run_file(index)) ? 0 : 1);
+
+			int status = 0;
+			while (pid > 0 && waitpid(pid, &status, 0) < 0 && errno == EINTR) { }
+			if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				if (!write_record(fd, std::string()))
+					_exit(1);
+		}
+		_exit(0);
+	}
+
+	// starts the workers for the files from index on
+	void start(int index)
+	{
+		first_file = index;
+		int count = std::min(jobs, file_count - index);
+
+		for (int i = 0; i < count; i++)
+		{
+			int fds[2];
+			if (pipe(fds) != 0)
+				log_error("Can't create pipe for Verilog worker process: %s\n", strerror(errno));
+
+			pid_t pid = fork();
+			if (pid < 0)
+				log_error("Can't create Verilog worker process: %s\n", strerror(errno));
+			if (pid == 0) {
+				close(fds[0]);
+				for (auto &worker : workers)
+					close(worker.fd);
+				run_worker(index + i, count, fds[1]);
+			}
+
+			close(fds[1]);
+			workers.push_back({pid, fds[0], std::string(), 0, false});
+		}
+	}
+
+	void stop()
+	{
+		for (auto &worker : workers) {
+			kill(worker.pid, SIGKILL);
+			close(worker.fd);
+			while (waitpid(worker.pid, nullptr, 0) < 0 && errno == EINTR) { }
+		}
+		workers.clear();
+	}
+
+	// reads from all workers until the result for the given file has
+	// arrived, returns false if its worker exited without sending it
+	bool receive(int index, std::string &record)
+	{
+		Worker &worker = workers[(index - first_file) % GetSize(workers)];
+
+		while (1)
+		{
+			uint64_t size;
+			if (worker.buffer.size() - worker.offset >= sizeof(size)) {
+				memcpy(&size, worker.buffer.data() + worker.offset, sizeof(size));
+				if (worker.buffer.size() - worker.offset - sizeof(size) >= size) {
+					record = worker.buffer.substr(worker.offset + sizeof(size), size);
+					worker.offset += sizeof(size) + size;
+					if (worker.offset > worker.buffer.size() / 2) {
+						worker.buffer.erase(0, worker.offset);
+						worker.offset = 0;
+					}
+					return true;
+				}
+			}
+			if (worker.eof)
+				return false;
+
+			std::vector<struct pollfd> fds;
+			std::vector<Worker*> polled;
+			for (auto &w : workers)
+				if (!w.eof) {
+					fds.push_back({w.fd, POLLIN, 0});
+					polled.push_back(&w);
+				}
+			if (poll(fds.data(), fds.size(), -1) < 0) {
+				if (errno == EINTR)
+					continue;
+				log_error("Can't wait for Verilog worker processes: %s\n", strerror(errno));
+			}
+
+			for (size_t i = 0; i < fds.size(); i++) {
+				if (fds[i].revents == 0)
+					continue;
+				char chunk[65536];
+				ssize_t count = read(fds[i].fd, chunk, sizeof(chunk));
+				if (count > 0)
+					polled[i]->buffer.append(chunk, count);
+				else if (count == 0 || errno != EINTR)
+					polled[i]->eof = true;
+			}
+		}
+	}
+
+	bool merge(const std::string &record)
+	{
+		Reader reader(record);
+		if (record.empty() || reader.u() != 1)
+			return false;
+
+		LogBuffer buffer;
+		buffer.debug_suppressed = reader.u();
+		buffer.entries.resize(reader.u());
+		for (auto &entry : buffer.entries) {
+			entry.kind = LogBuffer::kind_t(reader.u());
+			entry.prefix = reader.str();
+			entry.text = reader.str();
+		}
+		int file_autoidx = reader.u();
+
+		pool<RTLIL::IdString> removed;
+		for (int count = reader.u(); count > 0; count--)
+			removed.insert(reader.str());
+		std::vector<std::pair<RTLIL::IdString, std::string>> added;
+		for (int count = reader.u(); count > 0; count--) {
+			RTLIL::IdString name = reader.str();
+			added.push_back({name, reader.str()});
+		}
+
+		// the worker could not see the modules of the other files
+		for (auto name : removed)
+			if (read_modules.count(name) || !design->has(name))
+				return false;
+		for (auto &it : added)
+			if (read_modules.count(it.first) || (design->has(it.first) && !removed.count(it.first)))
+				return false;
+
+		buffer.replay();
+		for (auto name : removed)
+			design->remove(design->modules_.at(name));
+		for (auto &it : added) {
+			design->add(AST::decode_module(it.first, it.second));
+			read_modules.insert(it.first);
+		}
+		autoidx = std::max(autoidx, file_autoidx);
+		return true;
+	}
+
+	void read_file(int index)
+	{
+		std::string record;
+		if (!workers.empty() && receive(index, record) && merge(record))
+			return;
+
+		dict<RTLIL::IdString, RTLIL::Module*> old_modules;
+		for (auto &it : design->modules_)
+			old_modules[it.first] = it.second;
+		size_t old_packages = design->verilog_packages.size();
+		size_t old_globals = design->verilog_globals.size();
+		size_t old_bindings = design->bindings_.size();
+
+		read_code(index);
+
+		for (auto &it : design->modules_) {
+			auto old = old_modules.find(it.first);
+			if (old == old_modules.end() || old->second != it.second)
+				read_modules.insert(it.first);
+		}
+
+		// restart the workers, so that the remaining files see the changes
+		if (design->verilog_packages.size() != old_packages || design->verilog_globals.size() != old_globals ||
+				design->bindings_.size() != old_bindings) {
+			stop();
+			if (index + 1 < file_count)
+				start(index + 1);
+		}
+	}
+};
+#endif
+
 struct VerilogFrontend : public Frontend {
 	VerilogFrontend() : Frontend("verilog", "read modules from Verilog file") { }
 	void help() override
@@ -210,6 +557,16 @@ struct VerilogFrontend : public Frontend {
 		log("    -noautowire\n");
 		log("        make the default of `default_nettype be \"none\" instead of \"wire\".\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        when reading several files, preprocess them one after another and\n");
+		log("        then parse and elaborate them in up to N worker processes. The\n");
+		log("        modules are added to the design in the order of the files. Each\n");
+		log("        file is elaborated without seeing the modules of the other files\n");
+		log("        of this command, as with files that are read before the modules\n");
+		log("        they instantiate. Files that declare packages or other global\n");
+		log("        items are read by the main process, and the files after them are\n");
+		log("        parsed again. (only supported on systems with fork())\n");
+		log("\n");
 		log("    -setattr <attribute_name>\n");
 		log("        set the specified attribute (to the value 1) on all loaded modules\n");
 		log("\n");
@@ -233,6 +590,13 @@ struct VerilogFrontend : public Frontend {
 		log("SYNTHESIS or FORMAL is defined automatically, unless -nosynthesis is used.\n");
 		log("In addition, read_verilog always defines the macro YOSYS.\n");
 		log("\n");
+		log("When the scratchpad variable 'verilog.preproc_cache_dir' is set to a directory\n");
+		log("(e.g. with 'scratchpad -set verilog.preproc_cache_dir <dir>'), the output of\n");
+		log("the preprocessor is stored in a cache file in that directory, and later runs\n");
+		log("load it from there instead of preprocessing the file again. The cache file is\n");
+		log("used as long as the file, the defines, the include directories and the\n");
+		log("contents of all included files are the same.\n");
+		log("\n");
 		log("See the Yosys README file for a list of non-standard Verilog features\n");
 		log("supported by the Yosys Verilog front-end.\n");
 		log("\n");
@@ -262,7 +626,9 @@ struct VerilogFrontend : public Frontend {
 		bool flag_noblackbox = false;
 		bool flag_nowb = false;
 		bool flag_nosynthesis = false;
+		int jobs = 1;
 		define_map_t defines_map;
+		std::string preproc_cache_dir = design->scratchpad_get_string("verilog.preproc_cache_dir");
 
 		std::list<std::string> include_dirs;
 		std::list<std::string> attributes;
@@ -428,6 +794,15 @@ struct VerilogFrontend : public Frontend {
 				default_nettype_wire = false;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				const char *value = args[++argidx].c_str();
+				char *end;
+				long n = strtol(value, &end, 10);
+				if (*value == 0 || *end != 0 || n < 1 || n > INT_MAX)
+					log_cmd_error("Invalid number of jobs: %s\n", value);
+				jobs = n;
+				continue;
+			}
 			if (arg == "-setattr" && argidx+1 < args.size()) {
 				attributes.push_back(RTLIL::escape_id(args[++argidx]));
 				continue;
@@ -472,67 +847,153 @@ struct VerilogFrontend : public Frontend {
 		log("Parsing %s%s input from `%s' to AST representation.\n",
 				formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", filename.c_str());
 
-		AST::current_filename = filename;
-		AST::set_line_num = &frontend_verilog_yyset_lineno;
-		AST::get_line_num = &frontend_verilog_yyget_lineno;
+		// parses the preprocessed code of a file and adds its modules to the design
+		auto read_code = [&](std::istream *code, const std::string &code_filename) {
+			AST::current_filename = code_filename;
+			AST::set_line_num = &frontend_verilog_yyset_lineno;
+			AST::get_line_num = &frontend_verilog_yyget_lineno;
 
-		current_ast = new AST::AstNode(AST::AST_DESIGN);
+			current_ast = new AST::AstNode(AST::AST_DESIGN);
+			lexin = code;
 
-		lexin = f;
-		std::string code_after_preproc;
+			// make package typedefs available to parser
+			add_package_types(pkg_user_types, design->verilog_packages);
 
-		if (!flag_nopp) {
-			code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, *design->verilog_defines, include_dirs);
-			if (flag_ppdump)
-				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
-			lexin = new std::istringstream(code_after_preproc);
-		}
+			UserTypeMap global_types_map;
+			for (auto def : design->verilog_globals) {
+				if (def->type == AST::AST_TYPEDEF) {
+					global_types_map[def->str] = def;
+				}
+			}
 
-		// make package typedefs available to parser
-		add_package_types(pkg_user_types, design->verilog_packages);
+			log_assert(user_type_stack.empty());
+			// use previous global typedefs as bottom level of user type stack
+			user_type_stack.push_back(std::move(global_types_map));
+			// add a new empty type map to allow overriding existing global definitions
+			user_type_stack.push_back(UserTypeMap());
 
-		UserTypeMap global_types_map;
-		for (auto def : design->verilog_globals) {
-			if (def->type == AST::AST_TYPEDEF) {
-				global_types_map[def->str] = def;
+			frontend_verilog_yyset_lineno(1);
+			frontend_verilog_yyrestart(NULL);
+			frontend_verilog_yyparse();
+			frontend_verilog_yylex_destroy();
+
+			for (auto &child : current_ast->children) {
+				if (child->type == AST::AST_MODULE)
+					for (auto &attr : attributes)
+						if (child->attributes.count(attr) == 0)
+							child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
 			}
-		}
 
-		log_assert(user_type_stack.empty());
-		// use previous global typedefs as bottom level of user type stack
-		user_type_stack.push_back(std::move(global_types_map));
-		// add a new empty type map to allow overriding existing global definitions
-		user_type_stack.push_back(UserTypeMap());
-
-		frontend_verilog_yyset_lineno(1);
-		frontend_verilog_yyrestart(NULL);
-		frontend_verilog_yyparse();
-		frontend_verilog_yylex_destroy();
-
-		for (auto &child : current_ast->children) {
-			if (child->type == AST::AST_MODULE)
-				for (auto &attr : attributes)
-					if (child->attributes.count(attr) == 0)
-						child->attributes[attr] = AST::AstNode::mkconst_int(1, false);
+			if (flag_nodpi)
+				error_on_dpi_function(current_ast);
+
+			AST::process(design, current_ast, flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
+					flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire);
+
+			// only the previous and new global type maps remain
+			log_assert(user_type_stack.size() == 2);
+			user_type_stack.clear();
+
+			delete current_ast;
+			current_ast = NULL;
+		};
+
+#ifdef VERILOG_FRONTEND_JOBS
+		if (jobs > 1 && !next_args.empty() && !frontend_verilog_yydebug)
+		{
+			struct Input {
+				std::string filename, code;
+				LogBuffer open_log, preproc_log;
+			};
+			std::vector<Input> inputs;
+			int file_count = 0;
+
+			// the files are preprocessed in order, so that macros defined in
+			// one file are visible in the files after it
+			std::vector<std::string> file_args = next_args;
+			std::istream *file = f;
+			while (1)
+			{
+				inputs.emplace_back();
+				Input &input = inputs.back();
+				bool ok = true;
+
+				if (file == nullptr) {
+					input.open_log.begin();
+					try {
+						extra_args(file, input.filename, file_args, argidx);
+					} catch (log_buffered_error_exception&) {
+						ok = false;
+					}
+					input.open_log.end();
+					file_args = next_args;
+				} else
+					input.filename = filename;
+
+				if (ok) {
+					input.preproc_log.begin();
+					try {
+						if (flag_nopp)
+							input.code.assign(std::istreambuf_iterator<char>(*file), std::istreambuf_iterator<char>());
+						else
+							input.code = frontend_verilog_preproc(*file, input.filename, defines_map, *design->verilog_defines, include_dirs, preproc_cache_dir);
+						if (flag_ppdump)
+							log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", input.code.c_str());
+					} catch (log_buffered_error_exception&) {
+						ok = false;
+					}
+					input.preproc_log.end();
+				}
+
+				if (file != f)
+					delete file;
+				file = nullptr;
+				if (!ok)
+					break;
+				file_count++;
+				if (file_args.empty())
+					break;
+			}
+			next_args.clear();
+
+			// a file that failed to open or preprocess is last and only reports its error
+			VerilogJobs verilog_jobs(design, jobs, file_count, [&](int index) {
+				std::istringstream code(inputs[index].code);
+				read_code(&code, inputs[index].filename);
+			});
+			verilog_jobs.start(0);
+
+			for (int i = 0; i < GetSize(inputs); i++) {
+				Input &input = inputs[i];
+				if (i > 0) {
+					input.open_log.replay();
+					log_header(design, "Executing Verilog-2005 frontend: %s\n", input.filename.c_str());
+					log("Parsing %s%s input from `%s' to AST representation.\n",
+							formal_mode ? "formal " : "", sv_mode ? "SystemVerilog" : "Verilog", input.filename.c_str());
+				}
+				input.preproc_log.replay();
+				verilog_jobs.read_file(i);
+				log("Successfully finished Verilog frontend.\n");
+			}
+			return;
 		}
+#endif
 
-		if (flag_nodpi)
-			error_on_dpi_function(current_ast);
+		lexin = f;
+		std::string code_after_preproc;
 
-		AST::process(design, current_ast, flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
-				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, lib_mode, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, default_nettype_wire);
+		if (!flag_nopp) {
+			code_after_preproc = frontend_verilog_preproc(*f, filename, defines_map, *design->verilog_defines, include_dirs, preproc_cache_dir);
+			if (flag_ppdump)
+				log("-- Verilog code after preprocessor --\n%s-- END OF DUMP --\n", code_after_preproc.c_str());
+			lexin = new std::istringstream(code_after_preproc);
+		}
 
+		read_code(lexin, filename);
 
 		if (!flag_nopp)
 			delete lexin;
 
-		// only the previous and new global type maps remain
-		log_assert(user_type_stack.size() == 2);
-		user_type_stack.clear();
-
-		delete current_ast;
-		current_ast = NULL;
-
 		log("Successfully finished Verilog frontend.\n");
 	}
 } VerilogFrontend;
@@ -97,6 +97,66 @@ static RTLIL::Const big2const(const BigInteger &val, int result_len, int undef_b
 	return result;
 }
 
+// Narrow fully defined constants are very common when folding constants in
+// netlists. For those the arithmetic functions below work on native 64 bit
+// integers instead of going through BigInteger.
+
+static bool const2word(const RTLIL::Const &val, bool as_signed, uint64_t &word)
+{
+	size_t num_bits = val.bits.size();
+
+	if (num_bits > 64)
+		return false;
+
+	word = 0;
+	for (size_t i = 0; i < num_bits; i++)
+		if (val.bits[i] == RTLIL::State::S1)
+			word |= uint64_t(1) << i;
+		else if (val.bits[i] != RTLIL::State::S0)
+			return false;
+
+	if (as_signed && num_bits > 0 && num_bits < 64 && val.bits[num_bits-1] == RTLIL::State::S1)
+		word |= ~uint64_t(0) << num_bits;
+
+	return true;
+}
+
+static RTLIL::Const word2const(uint64_t word, int result_len)
+{
+	RTLIL::Const result(RTLIL::State::S0, result_len);
+	for (int i = 0; i < result_len && i < 64; i++)
+		if ((word >> i) & 1)
+			result.bits[i] = RTLIL::State::S1;
+	return result;
+}
+
+// Splits 64 bits of a constant, starting at `offset`, into two bitplanes: a bit is
+// set in `one` for State::S1 and in `zero` for State::S0. All other states are
+// treated as undefined and set in neither plane, as are bits beyond the end.
+
+static void const2planes(const RTLIL::Const &val, size_t offset, uint64_t &one, uint64_t &zero)
+{
+	size_t num_bits = std::min(val.bits.size() - std::min(val.bits.size(), offset), size_t(64));
+	const RTLIL::State *bits = val.bits.data() + offset;
+
+	one = 0;
+	zero = 0;
+
+	for (size_t i = 0; i < num_bits; i++) {
+		one |= uint64_t(bits[i] == RTLIL::State::S1) << i;
+		zero |= uint64_t(bits[i] == RTLIL::State::S0) << i;
+	}
+}
+
+static void planes2const(RTLIL::Const &val, size_t offset, uint64_t one, uint64_t zero)
+{
+	size_t num_bits = std::min(val.bits.size() - offset, size_t(64));
+	RTLIL::State *bits = val.bits.data() + offset;
+
+	for (size_t i = 0; i < num_bits; i++)
+		bits[i] = (one >> i) & 1 ? RTLIL::State::S1 : (zero >> i) & 1 ? RTLIL::State::S0 : RTLIL::State::Sx;
+}
+
 static RTLIL::State logic_and(RTLIL::State a, RTLIL::State b)
 {
 	if (a == RTLIL::State::S0) return RTLIL::State::S0;
@@ -122,13 +182,6 @@ static RTLIL::State logic_xor(RTLIL::State a, RTLIL::State b)
 	return a != b ? RTLIL::State::S1 : RTLIL::State::S0;
 }
 
-static RTLIL::State logic_xnor(RTLIL::State a, RTLIL::State b)
-{
-	if (a != RTLIL::State::S0 && a != RTLIL::State::S1) return RTLIL::State::Sx;
-	if (b != RTLIL::State::S0 && b != RTLIL::State::S1) return RTLIL::State::Sx;
-	return a == b ? RTLIL::State::S1 : RTLIL::State::S0;
-}
-
 RTLIL::Const RTLIL::const_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
 {
 	if (result_len < 0)
@@ -138,19 +191,43 @@ RTLIL::Const RTLIL::const_not(const RTLIL::Const &arg1, const RTLIL::Const&, boo
 	extend_u0(arg1_ext, result_len, signed1);
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		if (i >= arg1_ext.bits.size())
-			result.bits[i] = RTLIL::State::S0;
-		else if (arg1_ext.bits[i] == RTLIL::State::S0)
-			result.bits[i] = RTLIL::State::S1;
-		else if (arg1_ext.bits[i] == RTLIL::State::S1)
-			result.bits[i] = RTLIL::State::S0;
+	for (size_t i = 0; i < size_t(result_len); i += 64) {
+		uint64_t one, zero;
+		const2planes(arg1_ext, i, one, zero);
+		planes2const(result, i, zero, one);
 	}
 
 	return result;
 }
 
-static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL::State),
+// Bitwise logic functions on the bitplanes of 64 bits of each operand, with the
+// same handling of undefined bits as logic_and() etc. above.
+
+static void planes_and(uint64_t a1, uint64_t a0, uint64_t b1, uint64_t b0, uint64_t &y1, uint64_t &y0)
+{
+	y1 = a1 & b1;
+	y0 = a0 | b0;
+}
+
+static void planes_or(uint64_t a1, uint64_t a0, uint64_t b1, uint64_t b0, uint64_t &y1, uint64_t &y0)
+{
+	y1 = a1 | b1;
+	y0 = a0 & b0;
+}
+
+static void planes_xor(uint64_t a1, uint64_t a0, uint64_t b1, uint64_t b0, uint64_t &y1, uint64_t &y0)
+{
+	uint64_t defined = (a1 | a0) & (b1 | b0);
+	y1 = defined & (a1 ^ b1);
+	y0 = defined & ~(a1 ^ b1);
+}
+
+static void planes_xnor(uint64_t a1, uint64_t a0, uint64_t b1, uint64_t b0, uint64_t &y1, uint64_t &y0)
+{
+	planes_xor(a1, a0, b1, b0, y0, y1);
+}
+
+static RTLIL::Const logic_wrapper(void(*planes_func)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t&, uint64_t&),
 		RTLIL::Const arg1, RTLIL::Const arg2, bool signed1, bool signed2, int result_len = -1)
 {
 	if (result_len < 0)
@@ -160,10 +237,12 @@ static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL:
 	extend_u0(arg2, result_len, signed2);
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
-	for (size_t i = 0; i < size_t(result_len); i++) {
-		RTLIL::State a = i < arg1.bits.size() ? arg1.bits[i] : RTLIL::State::S0;
-		RTLIL::State b = i < arg2.bits.size() ? arg2.bits[i] : RTLIL::State::S0;
-		result.bits[i] = logic_func(a, b);
+	for (size_t i = 0; i < size_t(result_len); i += 64) {
+		uint64_t a1, a0, b1, b0, y1, y0;
+		const2planes(arg1, i, a1, a0);
+		const2planes(arg2, i, b1, b0);
+		planes_func(a1, a0, b1, b0, y1, y0);
+		planes2const(result, i, y1, y0);
 	}
 
 	return result;
@@ -171,32 +250,50 @@ static RTLIL::Const logic_wrapper(RTLIL::State(*logic_func)(RTLIL::State, RTLIL:
 
 RTLIL::Const RTLIL::const_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_and, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper(planes_and, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_or, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper(planes_or, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_xor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_xor, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper(planes_xor, arg1, arg2, signed1, signed2, result_len);
 }
 
 RTLIL::Const RTLIL::const_xnor(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_wrapper(logic_xnor, arg1, arg2, signed1, signed2, result_len);
+	return logic_wrapper(planes_xnor, arg1, arg2, signed1, signed2, result_len);
 }
 
-static RTLIL::Const logic_reduce_wrapper(RTLIL::State initial, RTLIL::State(*logic_func)(RTLIL::State, RTLIL::State), const RTLIL::Const &arg1, int result_len)
+static void reduce_planes(const RTLIL::Const &arg1, bool &any_one, bool &any_zero, bool &any_undef, bool &parity)
 {
-	RTLIL::State temp = initial;
+	uint64_t one_acc = 0, zero_acc = 0, undef_acc = 0, parity_acc = 0;
+
+	for (size_t i = 0; i < arg1.bits.size(); i += 64) {
+		uint64_t one, zero;
+		const2planes(arg1, i, one, zero);
+		uint64_t mask = arg1.bits.size() - i < 64 ? ~(~uint64_t(0) << (arg1.bits.size() - i)) : ~uint64_t(0);
+		one_acc |= one;
+		zero_acc |= zero;
+		undef_acc |= ~(one | zero) & mask;
+		parity_acc ^= one;
+	}
+
+	for (int shift = 32; shift > 0; shift >>= 1)
+		parity_acc ^= parity_acc >> shift;
 
-	for (size_t i = 0; i < arg1.bits.size(); i++)
-		temp = logic_func(temp, arg1.bits[i]);
+	any_one = one_acc != 0;
+	any_zero = zero_acc != 0;
+	any_undef = undef_acc != 0;
+	parity = parity_acc & 1;
+}
 
-	RTLIL::Const result(temp);
+static RTLIL::Const bit2const(RTLIL::State bit, int result_len)
+{
+	RTLIL::Const result(bit);
 	while (int(result.bits.size()) < result_len)
 		result.bits.push_back(RTLIL::State::S0);
 	return result;
@@ -204,75 +301,60 @@ static RTLIL::Const logic_reduce_wrapper(RTLIL::State initial, RTLIL::State(*log
 
 RTLIL::Const RTLIL::const_reduce_and(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S1, logic_and, arg1, result_len);
+	bool any_one, any_zero, any_undef, parity;
+	reduce_planes(arg1, any_one, any_zero, any_undef, parity);
+	return bit2const(any_zero ? RTLIL::State::S0 : any_undef ? RTLIL::State::Sx : RTLIL::State::S1, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_or(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_or, arg1, result_len);
+	bool any_one, any_zero, any_undef, parity;
+	reduce_planes(arg1, any_one, any_zero, any_undef, parity);
+	return bit2const(any_one ? RTLIL::State::S1 : any_undef ? RTLIL::State::Sx : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_xor(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_xor, arg1, result_len);
+	bool any_one, any_zero, any_undef, parity;
+	reduce_planes(arg1, any_one, any_zero, any_undef, parity);
+	return bit2const(any_undef ? RTLIL::State::Sx : parity ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_reduce_xnor(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	RTLIL::Const buffer = logic_reduce_wrapper(RTLIL::State::S0, logic_xor, arg1, result_len);
-	if (!buffer.bits.empty()) {
-		if (buffer.bits.front() == RTLIL::State::S0)
-			buffer.bits.front() = RTLIL::State::S1;
-		else if (buffer.bits.front() == RTLIL::State::S1)
-			buffer.bits.front() = RTLIL::State::S0;
-	}
-	return buffer;
+	bool any_one, any_zero, any_undef, parity;
+	reduce_planes(arg1, any_one, any_zero, any_undef, parity);
+	return bit2const(any_undef ? RTLIL::State::Sx : parity ? RTLIL::State::S0 : RTLIL::State::S1, result_len);
 }
 
-RTLIL::Const RTLIL::const_reduce_bool(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
+RTLIL::Const RTLIL::const_reduce_bool(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
-	return logic_reduce_wrapper(RTLIL::State::S0, logic_or, arg1, result_len);
+	return RTLIL::const_reduce_or(arg1, arg2, signed1, signed2, result_len);
 }
 
-RTLIL::Const RTLIL::const_logic_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool signed1, bool, int result_len)
-{
-	int undef_bit_pos_a = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	RTLIL::Const result(a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S1 : RTLIL::State::S0);
+// The logic functions only need to know whether an operand is zero, which is
+// the case iff it does not contain a 1 bit (regardless of signedness).
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+static RTLIL::State const2logic(const RTLIL::Const &arg1)
+{
+	bool any_one, any_zero, any_undef, parity;
+	reduce_planes(arg1, any_one, any_zero, any_undef, parity);
+	return any_one ? RTLIL::State::S1 : any_undef ? RTLIL::State::Sx : RTLIL::State::S0;
 }
 
-RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
+RTLIL::Const RTLIL::const_logic_not(const RTLIL::Const &arg1, const RTLIL::Const&, bool, bool, int result_len)
 {
-	int undef_bit_pos_a = -1, undef_bit_pos_b = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	BigInteger b = const2big(arg2, signed2, undef_bit_pos_b);
-
-	RTLIL::State bit_a = a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::Const result(logic_and(bit_a, bit_b));
-
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+	return bit2const(logic_xor(const2logic(arg1), RTLIL::State::S1), result_len);
 }
 
-RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
+RTLIL::Const RTLIL::const_logic_and(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool, int result_len)
 {
-	int undef_bit_pos_a = -1, undef_bit_pos_b = -1;
-	BigInteger a = const2big(arg1, signed1, undef_bit_pos_a);
-	BigInteger b = const2big(arg2, signed2, undef_bit_pos_b);
-
-	RTLIL::State bit_a = a.isZero() ? undef_bit_pos_a >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::State bit_b = b.isZero() ? undef_bit_pos_b >= 0 ? RTLIL::State::Sx : RTLIL::State::S0 : RTLIL::State::S1;
-	RTLIL::Const result(logic_or(bit_a, bit_b));
+	return bit2const(logic_and(const2logic(arg1), const2logic(arg2)), result_len);
+}
 
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool, bool, int result_len)
+{
+	return bit2const(logic_or(const2logic(arg1), const2logic(arg2)), result_len);
 }
 
 // Shift `arg1` by `arg2` bits.
@@ -282,13 +364,32 @@ RTLIL::Const RTLIL::const_logic_or(const RTLIL::Const &arg1, const RTLIL::Const
 // bounds are filled with the leftmost bit of `arg1` (arithmetic shift).
 static RTLIL::Const const_shift_worker(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool sign_ext, bool signed2, int direction, int result_len, RTLIL::State vacant_bits = RTLIL::State::S0)
 {
-	int undef_bit_pos = -1;
-	BigInteger offset = const2big(arg2, signed2, undef_bit_pos) * direction;
-
 	if (result_len < 0)
 		result_len = arg1.bits.size();
 
 	RTLIL::Const result(RTLIL::State::Sx, result_len);
+
+	uint64_t offset_word;
+	if (arg2.bits.size() < 64 && const2word(arg2, signed2, offset_word)) {
+		int64_t offset = int64_t(offset_word) * direction;
+		// Any offset beyond these bounds gives the same result, and clamping
+		// keeps `i + offset` from overflowing for huge shift amounts.
+		offset = std::max(std::min(offset, int64_t(arg1.bits.size())), -int64_t(result_len));
+		for (int i = 0; i < result_len; i++) {
+			int64_t pos = i + offset;
+			if (pos < 0)
+				result.bits[i] = vacant_bits;
+			else if (pos >= int64_t(arg1.bits.size()))
+				result.bits[i] = sign_ext ? arg1.bits.back() : vacant_bits;
+			else
+				result.bits[i] = arg1.bits[pos];
+		}
+		return result;
+	}
+
+	int undef_bit_pos = -1;
+	BigInteger offset = const2big(arg2, signed2, undef_bit_pos) * direction;
+
 	if (undef_bit_pos >= 0)
 		return result;
 
@@ -343,24 +444,24 @@ RTLIL::Const RTLIL::const_shiftx(const RTLIL::Const &arg1, const RTLIL::Const &a
 
 RTLIL::Const RTLIL::const_lt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (arg1.bits.size() < 64 && arg2.bits.size() < 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return bit2const(int64_t(a) < int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) < const2big(arg2, signed2, undef_bit_pos);
-	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
-
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+	return bit2const(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_le(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (arg1.bits.size() < 64 && arg2.bits.size() < 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return bit2const(int64_t(a) <= int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) <= const2big(arg2, signed2, undef_bit_pos);
-	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
-
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+	return bit2const(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_eq(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
@@ -428,45 +529,66 @@ RTLIL::Const RTLIL::const_nex(const RTLIL::Const &arg1, const RTLIL::Const &arg2
 
 RTLIL::Const RTLIL::const_ge(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (arg1.bits.size() < 64 && arg2.bits.size() < 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return bit2const(int64_t(a) >= int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) >= const2big(arg2, signed2, undef_bit_pos);
-	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
-
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+	return bit2const(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_gt(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	uint64_t a, b;
+	if (arg1.bits.size() < 64 && arg2.bits.size() < 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return bit2const(int64_t(a) > int64_t(b) ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
+
 	int undef_bit_pos = -1;
 	bool y = const2big(arg1, signed1, undef_bit_pos) > const2big(arg2, signed2, undef_bit_pos);
-	RTLIL::Const result(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0);
-
-	while (int(result.bits.size()) < result_len)
-		result.bits.push_back(RTLIL::State::S0);
-	return result;
+	return bit2const(undef_bit_pos >= 0 ? RTLIL::State::Sx : y ? RTLIL::State::S1 : RTLIL::State::S0, result_len);
 }
 
 RTLIL::Const RTLIL::const_add(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	if (result_len < 0)
+		result_len = max(arg1.bits.size(), arg2.bits.size());
+
+	uint64_t a, b;
+	if (result_len <= 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a + b, result_len);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) + const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
+	return big2const(y, result_len, undef_bit_pos);
 }
 
 RTLIL::Const RTLIL::const_sub(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	if (result_len < 0)
+		result_len = max(arg1.bits.size(), arg2.bits.size());
+
+	uint64_t a, b;
+	if (result_len <= 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a - b, result_len);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) - const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), undef_bit_pos);
+	return big2const(y, result_len, undef_bit_pos);
 }
 
 RTLIL::Const RTLIL::const_mul(const RTLIL::Const &arg1, const RTLIL::Const &arg2, bool signed1, bool signed2, int result_len)
 {
+	if (result_len < 0)
+		result_len = max(arg1.bits.size(), arg2.bits.size());
+
+	uint64_t a, b;
+	if (result_len <= 64 && const2word(arg1, signed1, a) && const2word(arg2, signed2, b))
+		return word2const(a * b, result_len);
+
 	int undef_bit_pos = -1;
 	BigInteger y = const2big(arg1, signed1, undef_bit_pos) * const2big(arg2, signed2, undef_bit_pos);
-	return big2const(y, result_len >= 0 ? result_len : max(arg1.bits.size(), arg2.bits.size()), min(undef_bit_pos, 0));
+	return big2const(y, result_len, min(undef_bit_pos, 0));
 }
 
 // truncating division
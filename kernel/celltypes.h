@@ -62,11 +62,11 @@ struct CellTypes
 		cell_types[ct.type] = ct;
 	}
 
-	void setup_module(RTLIL::Module *module)
+	void setup_module(const RTLIL::Module *module)
 	{
 		pool<RTLIL::IdString> inputs, outputs;
 		for (RTLIL::IdString wire_name : module->ports) {
-			RTLIL::Wire *wire = module->wire(wire_name);
+			const RTLIL::Wire *wire = module->wire(wire_name);
 			if (wire->port_input)
 				inputs.insert(wire->name);
 			if (wire->port_output)
@@ -77,7 +77,9 @@ struct CellTypes
 
 	void setup_design(RTLIL::Design *design)
 	{
-		for (auto module : design->modules())
+		// the stubs of modules read with "read_rtlil -lazy" have their port
+		// wires, so they don't need to be loaded here
+		for (auto module : design->module_stubs())
 			setup_module(module);
 	}
 
@@ -273,7 +273,11 @@ int main(int argc, char **argv)
 		printf("        annotate all log messages with a time stamp\n");
 		printf("\n");
 		printf("    -d\n");
-		printf("        print more detailed timing stats at exit\n");
+		printf("        print more detailed timing and memory stats at exit\n");
+		printf("\n");
+		printf("    -B perffile\n");
+		printf("        write the timing and memory stats of each pass as JSON to the\n");
+		printf("        specified file at exit\n");
 		printf("\n");
 		printf("    -l logfile\n");
 		printf("        write log messages to the specified file\n");
@@ -307,6 +311,13 @@ int main(int argc, char **argv)
 		printf("        enters TCL interatcive shell mode\n");
 #endif
 		printf("\n");
+#ifdef YOSYS_ENABLE_THREADS
+		printf("    -j threads\n");
+		printf("        use up to the specified number of threads for passes that can process\n");
+		printf("        modules in parallel (default: 1). the resulting netlist is equivalent but\n");
+		printf("        not necessarily identical to the one created by a single-threaded run\n");
+		printf("\n");
+#endif
 		printf("    -p command\n");
 		printf("        execute the commands (to chain commands, separate them with semicolon + whitespace: 'cmd1; cmd2')\n");
 		printf("\n");
@@ -379,7 +390,7 @@ int main(int argc, char **argv)
 	}
 
 	int opt;
-	while ((opt = getopt(argc, argv, "MXAQTVCSgm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:e:r:D:P:E:x:B:")) != -1)
+	while ((opt = getopt(argc, argv, "MXAQTVCSgm:f:Hh:b:o:p:l:L:qv:tds:c:W:w:e:r:D:P:E:x:B:j:")) != -1)
 	{
 		switch (opt)
 		{
@@ -460,6 +471,7 @@ int main(int argc, char **argv)
 			break;
 		case 'd':
 			timing_details = true;
+			MemoryStats::sample_rss = true;
 			break;
 		case 's':
 			scriptfile = optarg;
@@ -516,10 +528,18 @@ int main(int argc, char **argv)
 			break;
 		case 'B':
 			perffile = optarg;
+			MemoryStats::sample_rss = true;
 			break;
 		case 'C':
 			run_tcl_shell = true;
 			break;
+		case 'j':
+			yosys_threads = atoi(optarg);
+			if (yosys_threads < 1) {
+				fprintf(stderr, "Invalid number of threads: %s\n", optarg);
+				exit(1);
+			}
+			break;
 		case '\001':
 			frontend_files.push_back(optarg);
 			break;
@@ -744,12 +764,20 @@ int main(int argc, char **argv)
 				timedat.insert(make_tuple(it.second->runtime_ns + 1, it.second->call_counter, it.first));
 			}
 
+		bool alloc_tracking = MemoryStats::alloc_tracking();
+
 		if (timing_details)
 		{
 			log("Time spent:\n");
 			for (auto it = timedat.rbegin(); it != timedat.rend(); it++) {
-				log("%5d%% %5d calls %8.3f sec %s\n", int(100*std::get<0>(*it) / total_ns),
-						std::get<1>(*it), std::get<0>(*it) / 1000000000.0, std::get<2>(*it).c_str());
+				Pass *pass = pass_register.at(std::get<2>(*it));
+				std::string allocinfo;
+				if (alloc_tracking)
+					allocinfo = stringf(" %10.2f MB alloc %10lld allocs", pass->alloc_bytes / 1048576.0,
+							(long long)pass->alloc_count);
+				log("%5d%% %5d calls %8.3f sec %9.2f MB rss %9.2f MB peak%s %s\n", int(100*std::get<0>(*it) / total_ns),
+						std::get<1>(*it), std::get<0>(*it) / 1000000000.0, pass->rss_delta_bytes / 1048576.0,
+						pass->peak_rss_delta_bytes / 1048576.0, allocinfo.c_str(), std::get<2>(*it).c_str());
 			}
 		}
 		else
@@ -775,15 +803,21 @@ int main(int argc, char **argv)
 			fprintf(f, "{\n");
 			fprintf(f, "  \"generator\": \"%s\",\n", yosys_version_str);
 			fprintf(f, "  \"total_ns\": %" PRIu64 ",\n", total_ns);
+			fprintf(f, "  \"alloc_tracking\": %s,\n", alloc_tracking ? "true" : "false");
 			fprintf(f, "  \"passes\": {");
 
 			bool first = true;
 			for (auto it = timedat.rbegin(); it != timedat.rend(); it++) {
 				if (!first)
 					fprintf(f, ",");
+				Pass *pass = pass_register.at(std::get<2>(*it));
 				fprintf(f, "\n    \"%s\": {\n", std::get<2>(*it).c_str());
 				fprintf(f, "      \"runtime_ns\": %" PRIu64 ",\n", std::get<0>(*it));
-				fprintf(f, "      \"num_calls\": %u\n", std::get<1>(*it));
+				fprintf(f, "      \"num_calls\": %u,\n", std::get<1>(*it));
+				fprintf(f, "      \"rss_delta_bytes\": %" PRId64 ",\n", pass->rss_delta_bytes);
+				fprintf(f, "      \"peak_rss_delta_bytes\": %" PRId64 ",\n", pass->peak_rss_delta_bytes);
+				fprintf(f, "      \"alloc_bytes\": %" PRId64 ",\n", pass->alloc_bytes);
+				fprintf(f, "      \"num_allocs\": %" PRId64 "\n", pass->alloc_count);
 				fprintf(f, "    }");
 				first = false;
 			}
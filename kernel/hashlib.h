@@ -16,8 +16,17 @@
 #include <algorithm>
 #include <string>
 #include <vector>
+#include <limits>
+#include <type_traits>
 
 #include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
 
 namespace hashlib {
 
@@ -25,18 +34,52 @@ const int hashtable_size_trigger = 2;
 const int hashtable_size_factor = 3;
 
 // The XOR version of DJB2
-inline unsigned int mkhash(unsigned int a, unsigned int b) {
+inline unsigned int mkhash_djb2(unsigned int a, unsigned int b) {
 	return ((a << 5) + a) ^ b;
 }
 
-// traditionally 5381 is used as starting value for the djb2 hash
-const unsigned int mkhash_init = 5381;
-
 // The ADD version of DJB2
+inline unsigned int mkhash_djb2_add(unsigned int a, unsigned int b) {
+	return ((a << 5) + a) + b;
+}
+
+// A 64 bit multiply-xorshift mixer. Unlike DJB2 every input bit affects
+// most of the output bits, e.g. the hashes of the bits of a wide bus are
+// spread over the whole table, at the cost of a 64 bit multiplication.
+inline unsigned int mkhash_mulxor(unsigned int a, unsigned int b) {
+	uint64_t v = (uint64_t)a << 32 | b;
+	v ^= v >> 29;
+	v *= 0xbf58476d1ce4e5b9ull;
+	v ^= v >> 32;
+	return (unsigned int)v;
+}
+
+// The hash core used by mkhash() and mkhash_add() is selected at compile time:
+// DJB2 by default, or the multiply-xorshift mixer if HASHLIB_MKHASH_MULXOR is
+// defined. The 'hashbench' command reports how well the selected core spreads
+// the keys of a design.
+// Note that the order of some containers sorted by hash (e.g. std::set<SigSpec>)
+// depends on this choice.
+
+#ifdef HASHLIB_MKHASH_MULXOR
+inline unsigned int mkhash(unsigned int a, unsigned int b) {
+	return mkhash_mulxor(a, b);
+}
+inline unsigned int mkhash_add(unsigned int a, unsigned int b) {
+	return mkhash_mulxor(a, b);
+}
+#else
+inline unsigned int mkhash(unsigned int a, unsigned int b) {
+	return mkhash_djb2(a, b);
+}
 // (use this version for cache locality in b)
 inline unsigned int mkhash_add(unsigned int a, unsigned int b) {
-	return ((a << 5) + a) + b;
+	return mkhash_djb2_add(a, b);
 }
+#endif
+
+// traditionally 5381 is used as starting value for the djb2 hash
+const unsigned int mkhash_init = 5381;
 
 inline unsigned int mkhash_xorshift(unsigned int a) {
 	if (sizeof(a) == 4) {
@@ -211,13 +254,243 @@ inline int hashtable_size(int min_size)
 	throw std::length_error("hash table exceeded maximum size.");
 }
 
+// By default dict<> and pool<> find their entries through a table of bucket
+// heads and a chain of `next` links in the entries. Containers with an OPS type
+// wrapped in hash_open_ops<> use an open addressing table instead, which needs
+// fewer cache misses per lookup on large containers. The entries vector, and
+// with it the iteration order, is the same for both kinds of index. Whether it
+// pays off depends on the keys, see the "hashbench" command.
+//
+// e.g. dict<RTLIL::SigBit, int, hash_open_ops<hash_ops<RTLIL::SigBit>>>
+
+template<typename OPS> struct hash_open_ops : OPS {
+	static const bool open_addressing = true;
+};
+
+template<typename OPS, typename = void> struct use_open_index : std::false_type { };
+template<typename OPS> struct use_open_index<OPS, typename std::enable_if<OPS::open_addressing>::type> : std::true_type { };
+
+// The table of the open addressing index is made of 64 byte chunks that are
+// aligned to cache lines. Each chunk holds a tag byte and an entry index for
+// 12 slots. The tag of a used slot has the high bit set and 7 bits of the hash
+// of its entry, so a lookup compares the tags of all slots of a chunk at once
+// (with SSE2 or NEON where available) and only looks at the entries whose tag
+// matches. An entry that doesn't fit into its home chunk goes into one of the
+// following chunks, and every chunk it skips counts it in its overflow byte.
+// A lookup stops at the first chunk without overflow, and erasing an entry
+// decrements the counts again, so no tombstones are needed.
+class open_index
+{
+	enum : int { chunk_slots = 12, overflow_pos = 15 };
+
+	struct chunk_t {
+		// tags of the slots (0 for an empty slot), then three unused bytes
+		// and the overflow count, which sticks at 255 once it got there
+		unsigned char tags[16];
+		int indices[chunk_slots];
+	};
+
+	std::vector<char> storage;
+	chunk_t *chunks = nullptr;
+	size_t num_chunks = 0;
+	int num_used = 0;
+
+#if defined(__SSE2__)
+	typedef unsigned int mask_t;
+	static const int mask_shift = 0;
+
+	static mask_t match(const chunk_t &chunk, unsigned char tag) {
+		__m128i tags = _mm_load_si128((const __m128i*)chunk.tags);
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(tags, _mm_set1_epi8(tag))) & ((1 << chunk_slots) - 1);
+	}
+#elif defined(__ARM_NEON)
+	// vshrn turns the 0x00/0xff bytes of the comparison into one nibble per slot
+	typedef uint64_t mask_t;
+	static const int mask_shift = 2;
+
+	static mask_t match(const chunk_t &chunk, unsigned char tag) {
+		uint8x16_t eq = vceqq_u8(vld1q_u8(chunk.tags), vdupq_n_u8(tag));
+		uint64_t nibbles = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+		return nibbles & 0x0000111111111111ull;
+	}
+#else
+	typedef unsigned int mask_t;
+	static const int mask_shift = 0;
+
+	static mask_t match(const chunk_t &chunk, unsigned char tag) {
+		mask_t mask = 0;
+		for (int i = 0; i < chunk_slots; i++)
+			if (chunk.tags[i] == tag)
+				mask |= 1u << i;
+		return mask;
+	}
+#endif
+
+	static int first_slot(mask_t mask) {
+#if defined(__GNUC__)
+		return __builtin_ctzll(mask) >> mask_shift;
+#else
+		int i = 0;
+		while (((mask >> i) & 1) == 0)
+			i++;
+		return i >> mask_shift;
+#endif
+	}
+
+	// many hash_ops functions yield values that differ only in the lowest
+	// bits for related keys (e.g. the bits of a wire), or that are multiples
+	// of the alignment (pointers), so the hash is mixed before it picks the
+	// home chunk and the tag
+	static unsigned int mix_hash(unsigned int hash) {
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6b;
+		hash ^= hash >> 13;
+		hash *= 0xc2b2ae35;
+		hash ^= hash >> 16;
+		return hash;
+	}
+
+	static unsigned char tag_of(unsigned int mixed) {
+		return 0x80 | (mixed >> 25);
+	}
+
+	void allocate(size_t n) {
+		storage.assign((n + 1) * sizeof(chunk_t), 0);
+		uintptr_t addr = (uintptr_t)storage.data();
+		chunks = (chunk_t*)((addr + sizeof(chunk_t) - 1) & ~uintptr_t(sizeof(chunk_t) - 1));
+		num_chunks = n;
+	}
+
+public:
+	open_index() { }
+
+	open_index(const open_index &other) {
+		*this = other;
+	}
+
+	open_index &operator=(const open_index &other) {
+		if (this == &other)
+			return *this;
+		if (other.num_chunks == 0) {
+			clear();
+			return *this;
+		}
+		allocate(other.num_chunks);
+		memcpy(chunks, other.chunks, num_chunks * sizeof(chunk_t));
+		num_used = other.num_used;
+		return *this;
+	}
+
+	bool empty() const { return num_chunks == 0; }
+
+	// true if another entry can not be added without exceeding 5/6 used slots
+	bool full() const { return (size_t(num_used) + 1) * 6 > num_chunks * chunk_slots * 5; }
+
+	int operator[](int slot) const { return chunks[slot / chunk_slots].indices[slot % chunk_slots]; }
+	int &operator[](int slot) { return chunks[slot / chunk_slots].indices[slot % chunk_slots]; }
+
+	void clear() {
+		storage.clear();
+		storage.shrink_to_fit();
+		chunks = nullptr;
+		num_chunks = 0;
+		num_used = 0;
+	}
+
+	// empties the table and sizes it for num_entries entries, half of the slots are used then
+	void reset(int num_entries) {
+		size_t n = 1;
+		while (n * chunk_slots < 2 * size_t(num_entries))
+			n *= 2;
+		if (n * chunk_slots > size_t(std::numeric_limits<int>::max()))
+			throw std::length_error("hash table exceeded maximum size.");
+		allocate(n);
+		num_used = 0;
+	}
+
+	void swap(open_index &other) {
+		storage.swap(other.storage);
+		std::swap(chunks, other.chunks);
+		std::swap(num_chunks, other.num_chunks);
+		std::swap(num_used, other.num_used);
+	}
+
+	// returns the slot of the entry for which is_match(index) is true, or -1
+	template<typename MATCH>
+	int find(unsigned int hash, MATCH is_match) const {
+		if (num_chunks == 0)
+			return -1;
+		unsigned int mixed = mix_hash(hash);
+		unsigned char tag = tag_of(mixed);
+		size_t mask = num_chunks - 1, pos = mixed & mask;
+		for (size_t i = 0; i < num_chunks; i++, pos = (pos + 1) & mask) {
+			const chunk_t &chunk = chunks[pos];
+			for (mask_t m = match(chunk, tag); m != 0; m &= m - 1) {
+				int slot = first_slot(m);
+				if (is_match(chunk.indices[slot]))
+					return pos * chunk_slots + slot;
+			}
+			if (chunk.tags[overflow_pos] == 0)
+				break;
+		}
+		return -1;
+	}
+
+	int find_index(unsigned int hash, int index) const {
+		return find(hash, [index](int i) { return i == index; });
+	}
+
+	// the caller must make sure that the table is not full()
+	void insert(unsigned int hash, int index) {
+		unsigned int mixed = mix_hash(hash);
+		size_t mask = num_chunks - 1, pos = mixed & mask;
+		while (1) {
+			chunk_t &chunk = chunks[pos];
+			mask_t m = match(chunk, 0);
+			if (m != 0) {
+				int slot = first_slot(m);
+				chunk.tags[slot] = tag_of(mixed);
+				chunk.indices[slot] = index;
+				num_used++;
+				return;
+			}
+			if (chunk.tags[overflow_pos] != 255)
+				chunk.tags[overflow_pos]++;
+			pos = (pos + 1) & mask;
+		}
+	}
+
+	// the hash must be the one of the entry in the slot
+	void erase(unsigned int hash, int slot) {
+		size_t mask = num_chunks - 1, pos = mix_hash(hash) & mask;
+		for (; pos != size_t(slot / chunk_slots); pos = (pos + 1) & mask)
+			if (chunks[pos].tags[overflow_pos] != 255)
+				chunks[pos].tags[overflow_pos]--;
+		chunks[pos].tags[slot % chunk_slots] = 0;
+		num_used--;
+	}
+};
+
+template<bool> struct open_index_base {
+	void copy_open_index(const open_index_base&) { }
+	void swap_open_index(open_index_base&) { }
+	void clear_open_index() { }
+};
+
+template<> struct open_index_base<true> {
+	open_index oindex;
+	void copy_open_index(const open_index_base &other) { oindex = other.oindex; }
+	void swap_open_index(open_index_base &other) { oindex.swap(other.oindex); }
+	void clear_open_index() { oindex.clear(); }
+};
+
 template<typename K, typename T, typename OPS = hash_ops<K>> class dict;
 template<typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
 template<typename K, typename OPS = hash_ops<K>> class pool;
 template<typename K, typename OPS = hash_ops<K>> class mfp;
 
 template<typename K, typename T, typename OPS>
-class dict
+class dict : open_index_base<use_open_index<OPS>::value>
 {
 	struct entry_t
 	{
@@ -230,6 +503,8 @@ class dict
 		bool operator<(const entry_t &other) const { return udata.first < other.udata.first; }
 	};
 
+	typedef typename use_open_index<OPS>::type index_tag;
+
 	std::vector<int> hashtable;
 	std::vector<entry_t> entries;
 	OPS ops;
@@ -244,13 +519,37 @@ class dict
 
 	int do_hash(const K &key) const
 	{
+		if (index_tag::value)
+			return ops.hash(key);
 		unsigned int hash = 0;
 		if (!hashtable.empty())
 			hash = ops.hash(key) % (unsigned int)(hashtable.size());
 		return hash;
 	}
 
+	// copies the index along with the entries instead of rehashing them
+	void do_copy(const dict &other)
+	{
+		if (this == &other)
+			return;
+		entries = other.entries;
+		hashtable = other.hashtable;
+		this->copy_open_index(other);
+	}
+
 	void do_rehash()
+	{
+		do_rehash(index_tag());
+	}
+
+	void do_rehash(std::true_type)
+	{
+		this->oindex.reset(entries.size());
+		for (int i = 0; i < int(entries.size()); i++)
+			this->oindex.insert(ops.hash(entries[i].udata.first), i);
+	}
+
+	void do_rehash(std::false_type)
 	{
 		hashtable.clear();
 		hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
@@ -264,6 +563,39 @@ class dict
 	}
 
 	int do_erase(int index, int hash)
+	{
+		return do_erase(index, hash, index_tag());
+	}
+
+	int do_erase(int index, int hash, std::true_type)
+	{
+		do_assert(index < int(entries.size()));
+		if (this->oindex.empty() || index < 0)
+			return 0;
+
+		int slot = this->oindex.find_index(hash, index);
+		do_assert(slot >= 0);
+		this->oindex.erase(hash, slot);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			int back_slot = this->oindex.find_index(ops.hash(entries[back_idx].udata.first), back_idx);
+			do_assert(back_slot >= 0);
+			this->oindex[back_slot] = index;
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			this->oindex.clear();
+
+		return 1;
+	}
+
+	int do_erase(int index, int hash, std::false_type)
 	{
 		do_assert(index < int(entries.size()));
 		if (hashtable.empty() || index < 0)
@@ -313,14 +645,22 @@ class dict
 	}
 
 	int do_lookup(const K &key, int &hash) const
+	{
+		return do_lookup(key, hash, index_tag());
+	}
+
+	int do_lookup(const K &key, int &hash, std::true_type) const
+	{
+		int slot = this->oindex.find(hash, [&](int i) { return ops.cmp(entries[i].udata.first, key); });
+		return slot < 0 ? -1 : this->oindex[slot];
+	}
+
+	int do_lookup(const K &key, int &hash, std::false_type) const
 	{
 		if (hashtable.empty())
 			return -1;
 
-		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
-			((dict*)this)->do_rehash();
-			hash = do_hash(key);
-		}
+		do_assert(entries.size() * hashtable_size_trigger <= hashtable.size());
 
 		int index = hashtable[hash];
 
@@ -332,43 +672,95 @@ class dict
 		return index;
 	}
 
+	// Rehashes as soon as an insertion exceeds the load factor instead of in
+	// the next lookup, so that lookups never modify the container and a
+	// container that is not changed can be read from several threads.
+	void do_grow(int &hash)
+	{
+		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
+			do_rehash();
+			hash = do_hash(entries.back().udata.first);
+		}
+	}
+
+	// adds the last entry to the open addressing index, rebuilding the index
+	// instead when it is full
+	int do_insert_back(int hash)
+	{
+		int index = entries.size() - 1;
+		if (this->oindex.full())
+			do_rehash();
+		else
+			this->oindex.insert(hash, index);
+		return index;
+	}
+
 	int do_insert(const K &key, int &hash)
+	{
+		return do_insert(key, hash, index_tag());
+	}
+
+	int do_insert(const K &key, int &hash, std::true_type)
+	{
+		entries.emplace_back(std::pair<K, T>(key, T()), -1);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(const K &key, int &hash, std::false_type)
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(std::pair<K, T>(key, T()), -1);
-			do_rehash();
-			hash = do_hash(key);
 		} else {
 			entries.emplace_back(std::pair<K, T>(key, T()), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		do_grow(hash);
 		return entries.size() - 1;
 	}
 
 	int do_insert(const std::pair<K, T> &value, int &hash)
+	{
+		return do_insert(value, hash, index_tag());
+	}
+
+	int do_insert(const std::pair<K, T> &value, int &hash, std::true_type)
+	{
+		entries.emplace_back(value, -1);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(const std::pair<K, T> &value, int &hash, std::false_type)
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(value, -1);
-			do_rehash();
-			hash = do_hash(value.first);
 		} else {
 			entries.emplace_back(value, hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		do_grow(hash);
 		return entries.size() - 1;
 	}
 
 	int do_insert(std::pair<K, T> &&rvalue, int &hash)
+	{
+		return do_insert(std::forward<std::pair<K, T>>(rvalue), hash, index_tag());
+	}
+
+	int do_insert(std::pair<K, T> &&rvalue, int &hash, std::true_type)
+	{
+		entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), -1);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(std::pair<K, T> &&rvalue, int &hash, std::false_type)
 	{
 		if (hashtable.empty()) {
-			auto key = rvalue.first;
 			entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), -1);
-			do_rehash();
-			hash = do_hash(key);
 		} else {
 			entries.emplace_back(std::forward<std::pair<K, T>>(rvalue), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		do_grow(hash);
 		return entries.size() - 1;
 	}
 
@@ -428,8 +820,7 @@ public:
 
 	dict(const dict &other)
 	{
-		entries = other.entries;
-		do_rehash();
+		do_copy(other);
 	}
 
 	dict(dict &&other)
@@ -438,8 +829,7 @@ public:
 	}
 
 	dict &operator=(const dict &other) {
-		entries = other.entries;
-		do_rehash();
+		do_copy(other);
 		return *this;
 	}
 
@@ -631,6 +1021,7 @@ public:
 	{
 		hashtable.swap(other.hashtable);
 		entries.swap(other.entries);
+		this->swap_open_index(other);
 	}
 
 	bool operator==(const dict &other) const {
@@ -660,7 +1051,7 @@ public:
 	void reserve(size_t n) { entries.reserve(n); }
 	size_t size() const { return entries.size(); }
 	bool empty() const { return entries.empty(); }
-	void clear() { hashtable.clear(); entries.clear(); }
+	void clear() { hashtable.clear(); this->clear_open_index(); entries.clear(); }
 
 	iterator begin() { return iterator(this, int(entries.size())-1); }
 	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
@@ -672,7 +1063,7 @@ public:
 };
 
 template<typename K, typename OPS>
-class pool
+class pool : open_index_base<use_open_index<OPS>::value>
 {
 	template<typename, int, typename> friend class idict;
 
@@ -687,6 +1078,8 @@ protected:
 		entry_t(K &&udata, int next) : udata(std::move(udata)), next(next) { }
 	};
 
+	typedef typename use_open_index<OPS>::type index_tag;
+
 	std::vector<int> hashtable;
 	std::vector<entry_t> entries;
 	OPS ops;
@@ -701,13 +1094,37 @@ protected:
 
 	int do_hash(const K &key) const
 	{
+		if (index_tag::value)
+			return ops.hash(key);
 		unsigned int hash = 0;
 		if (!hashtable.empty())
 			hash = ops.hash(key) % (unsigned int)(hashtable.size());
 		return hash;
 	}
 
+	// copies the index along with the entries instead of rehashing them
+	void do_copy(const pool &other)
+	{
+		if (this == &other)
+			return;
+		entries = other.entries;
+		hashtable = other.hashtable;
+		this->copy_open_index(other);
+	}
+
 	void do_rehash()
+	{
+		do_rehash(index_tag());
+	}
+
+	void do_rehash(std::true_type)
+	{
+		this->oindex.reset(entries.size());
+		for (int i = 0; i < int(entries.size()); i++)
+			this->oindex.insert(ops.hash(entries[i].udata), i);
+	}
+
+	void do_rehash(std::false_type)
 	{
 		hashtable.clear();
 		hashtable.resize(hashtable_size(entries.capacity() * hashtable_size_factor), -1);
@@ -721,6 +1138,39 @@ protected:
 	}
 
 	int do_erase(int index, int hash)
+	{
+		return do_erase(index, hash, index_tag());
+	}
+
+	int do_erase(int index, int hash, std::true_type)
+	{
+		do_assert(index < int(entries.size()));
+		if (this->oindex.empty() || index < 0)
+			return 0;
+
+		int slot = this->oindex.find_index(hash, index);
+		do_assert(slot >= 0);
+		this->oindex.erase(hash, slot);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			int back_slot = this->oindex.find_index(ops.hash(entries[back_idx].udata), back_idx);
+			do_assert(back_slot >= 0);
+			this->oindex[back_slot] = index;
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			this->oindex.clear();
+
+		return 1;
+	}
+
+	int do_erase(int index, int hash, std::false_type)
 	{
 		do_assert(index < int(entries.size()));
 		if (hashtable.empty() || index < 0)
@@ -766,14 +1216,22 @@ protected:
 	}
 
 	int do_lookup(const K &key, int &hash) const
+	{
+		return do_lookup(key, hash, index_tag());
+	}
+
+	int do_lookup(const K &key, int &hash, std::true_type) const
+	{
+		int slot = this->oindex.find(hash, [&](int i) { return ops.cmp(entries[i].udata, key); });
+		return slot < 0 ? -1 : this->oindex[slot];
+	}
+
+	int do_lookup(const K &key, int &hash, std::false_type) const
 	{
 		if (hashtable.empty())
 			return -1;
 
-		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
-			((pool*)this)->do_rehash();
-			hash = do_hash(key);
-		}
+		do_assert(entries.size() * hashtable_size_trigger <= hashtable.size());
 
 		int index = hashtable[hash];
 
@@ -785,29 +1243,70 @@ protected:
 		return index;
 	}
 
+	// see dict::do_grow()
+	void do_grow(int &hash)
+	{
+		if (entries.size() * hashtable_size_trigger > hashtable.size()) {
+			do_rehash();
+			hash = do_hash(entries.back().udata);
+		}
+	}
+
+	// adds the last entry to the open addressing index, rebuilding the index
+	// instead when it is full
+	int do_insert_back(int hash)
+	{
+		int index = entries.size() - 1;
+		if (this->oindex.full())
+			do_rehash();
+		else
+			this->oindex.insert(hash, index);
+		return index;
+	}
+
 	int do_insert(const K &value, int &hash)
+	{
+		return do_insert(value, hash, index_tag());
+	}
+
+	int do_insert(const K &value, int &hash, std::true_type)
+	{
+		entries.emplace_back(value, -1);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(const K &value, int &hash, std::false_type)
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(value, -1);
-			do_rehash();
-			hash = do_hash(value);
 		} else {
 			entries.emplace_back(value, hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		do_grow(hash);
 		return entries.size() - 1;
 	}
 
 	int do_insert(K &&rvalue, int &hash)
+	{
+		return do_insert(std::forward<K>(rvalue), hash, index_tag());
+	}
+
+	int do_insert(K &&rvalue, int &hash, std::true_type)
+	{
+		entries.emplace_back(std::forward<K>(rvalue), -1);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(K &&rvalue, int &hash, std::false_type)
 	{
 		if (hashtable.empty()) {
 			entries.emplace_back(std::forward<K>(rvalue), -1);
-			do_rehash();
-			hash = do_hash(rvalue);
 		} else {
 			entries.emplace_back(std::forward<K>(rvalue), hashtable[hash]);
 			hashtable[hash] = entries.size() - 1;
 		}
+		do_grow(hash);
 		return entries.size() - 1;
 	}
 
@@ -863,8 +1362,7 @@ public:
 
 	pool(const pool &other)
 	{
-		entries = other.entries;
-		do_rehash();
+		do_copy(other);
 	}
 
 	pool(pool &&other)
@@ -873,8 +1371,7 @@ public:
 	}
 
 	pool &operator=(const pool &other) {
-		entries = other.entries;
-		do_rehash();
+		do_copy(other);
 		return *this;
 	}
 
@@ -1001,6 +1498,7 @@ public:
 	{
 		hashtable.swap(other.hashtable);
 		entries.swap(other.entries);
+		this->swap_open_index(other);
 	}
 
 	bool operator==(const pool &other) const {
@@ -1026,7 +1524,7 @@ public:
 	void reserve(size_t n) { entries.reserve(n); }
 	size_t size() const { return entries.size(); }
 	bool empty() const { return entries.empty(); }
-	void clear() { hashtable.clear(); entries.clear(); }
+	void clear() { hashtable.clear(); this->clear_open_index(); entries.clear(); }
 
 	iterator begin() { return iterator(this, int(entries.size())-1); }
 	iterator element(int n) { return iterator(this, int(entries.size())-1-n); }
@@ -1163,13 +1661,23 @@ public:
 
 		while (k != p) {
 			int next_k = parents[k];
-			parents[k] = p;
+			if (next_k != p)
+				parents[k] = p;
 			k = next_k;
 		}
 
 		return p;
 	}
 
+	// Points all elements directly to the representative of their set.
+	// Afterwards lookups only read the data structure (and can run
+	// concurrently) until the next merge or promote.
+	void compress() const
+	{
+		for (int i = 0; i < int(parents.size()); i++)
+			ifind(i);
+	}
+
 	void imerge(int i, int j)
 	{
 		i = ifind(i);
@@ -29,6 +29,10 @@
 #  include <dlfcn.h>
 #endif
 
+#if defined(__linux__)
+#  include <unistd.h>
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -36,6 +40,45 @@
 #include <vector>
 #include <list>
 
+#ifdef YOSYS_ENABLE_ALLOC_STATS
+// Replacements of the global allocation functions that count the requests
+// for MemoryStats. Atomic counters, because passes may run on several
+// threads with "yosys -j".
+static std::atomic<int64_t> alloc_stats_bytes, alloc_stats_count;
+
+void *operator new(std::size_t size)
+{
+	alloc_stats_bytes.fetch_add(size, std::memory_order_relaxed);
+	alloc_stats_count.fetch_add(1, std::memory_order_relaxed);
+	void *p = malloc(size ? size : 1);
+	if (p == nullptr)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	alloc_stats_bytes.fetch_add(size, std::memory_order_relaxed);
+	alloc_stats_count.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+	return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { free(p); }
+#endif
+
 YOSYS_NAMESPACE_BEGIN
 
 std::vector<FILE*> log_files;
@@ -63,7 +106,11 @@ void (*log_verific_callback)(int msg_type, const char *message_id, const char* f
 
 int log_make_debug = 0;
 int log_force_debug = 0;
+#ifdef YOSYS_ENABLE_THREADS
+thread_local int log_debug_suppressed = 0;
+#else
 int log_debug_suppressed = 0;
+#endif
 
 vector<int> header_count;
 vector<char*> log_id_cache;
@@ -74,6 +121,10 @@ static struct timeval initial_tv = { 0, 0 };
 static bool next_print_log = false;
 static int log_newline_count = 0;
 
+#ifdef YOSYS_ENABLE_THREADS
+static thread_local LogBuffer *log_buffer = nullptr;
+#endif
+
 static void log_id_cache_clear()
 {
 	for (auto p : log_id_cache)
@@ -103,6 +154,15 @@ int gettimeofday(struct timeval *tv, struct timezone *tz)
 
 void logv(const char *format, va_list ap)
 {
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer) {
+		if (log_make_debug && !ys_debug(1))
+			return;
+		log_buffer->entries.push_back({LogBuffer::LOG, std::string(), vstringf(format, ap)});
+		return;
+	}
+#endif
+
 	while (format[0] == '\n' && format[1] != 0) {
 		log("\n");
 		format++;
@@ -207,6 +267,11 @@ void logv_header(RTLIL::Design *design, const char *format, va_list ap)
 {
 	bool pop_errfile = false;
 
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer)
+		log_error("Log headers can not be printed from a parallel task.\n");
+#endif
+
 	log_spacer();
 	if (header_count.size() > 0)
 		header_count.back()++;
@@ -242,10 +307,8 @@ void logv_header(RTLIL::Design *design, const char *format, va_list ap)
 		log_files.pop_back();
 }
 
-static void logv_warning_with_prefix(const char *prefix,
-                                     const char *format, va_list ap)
+static void log_warning_message(const char *prefix, const std::string &message)
 {
-	std::string message = vstringf(format, ap);
 	bool suppressed = false;
 
 	for (auto &re : log_nowarn_regexes)
@@ -298,6 +361,18 @@ static void logv_warning_with_prefix(const char *prefix,
 	}
 }
 
+static void logv_warning_with_prefix(const char *prefix,
+                                     const char *format, va_list ap)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer) {
+		log_buffer->entries.push_back({LogBuffer::WARNING, prefix, vstringf(format, ap)});
+		return;
+	}
+#endif
+	log_warning_message(prefix, vstringf(format, ap));
+}
+
 void logv_warning(const char *format, va_list ap)
 {
 	logv_warning_with_prefix("Warning: ", format, ap);
@@ -334,6 +409,12 @@ void log_file_info(const std::string &filename, int lineno,
 static void logv_error_with_prefix(const char *prefix,
                                    const char *format, va_list ap)
 {
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer) {
+		log_buffer->entries.push_back({LogBuffer::ERROR, prefix, vstringf(format, ap)});
+		throw log_buffered_error_exception();
+	}
+#endif
 #ifdef EMSCRIPTEN
 	auto backup_log_files = log_files;
 #endif
@@ -457,6 +538,14 @@ void log_cmd_error(const char *format, ...)
 	va_list ap;
 	va_start(ap, format);
 
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer) {
+		log_buffer->entries.push_back({LogBuffer::CMD_ERROR, std::string(), vstringf(format, ap)});
+		va_end(ap);
+		throw log_buffered_error_exception();
+	}
+#endif
+
 	if (log_cmd_error_throw) {
 		log_last_error = vstringf(format, ap);
 		log("ERROR: %s", log_last_error.c_str());
@@ -478,6 +567,60 @@ void log_push()
 	header_count.push_back(0);
 }
 
+#ifdef YOSYS_ENABLE_THREADS
+[[noreturn]]
+static void log_error_with_prefix(const char *prefix, const char *format, ...)
+{
+	va_list ap;
+	va_start(ap, format);
+	logv_error_with_prefix(prefix, format, ap);
+}
+
+void LogBuffer::begin()
+{
+	log_assert(log_buffer == nullptr);
+	log_buffer = this;
+	saved_debug_suppressed = log_debug_suppressed;
+	log_debug_suppressed = 0;
+}
+
+void LogBuffer::end()
+{
+	log_assert(log_buffer == this);
+	log_buffer = nullptr;
+	debug_suppressed += log_debug_suppressed;
+	log_debug_suppressed = saved_debug_suppressed;
+	for (auto p : strings)
+		free(p);
+	strings.clear();
+}
+
+void LogBuffer::replay()
+{
+	log_assert(log_buffer == nullptr);
+	log_debug_suppressed += debug_suppressed;
+	debug_suppressed = 0;
+
+	std::vector<entry_t> replay_entries;
+	std::swap(replay_entries, entries);
+
+	for (auto &entry : replay_entries)
+		switch (entry.kind)
+		{
+		case LOG:
+			log("%s", entry.text.c_str());
+			break;
+		case WARNING:
+			log_warning_message(entry.prefix.c_str(), entry.text);
+			break;
+		case ERROR:
+			log_error_with_prefix(entry.prefix.c_str(), "%s", entry.text.c_str());
+		case CMD_ERROR:
+			log_cmd_error("%s", entry.text.c_str());
+		}
+}
+#endif
+
 void log_pop()
 {
 	header_count.pop_back();
@@ -596,6 +739,11 @@ void log_reset_stack()
 
 void log_flush()
 {
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer)
+		return;
+#endif
+
 	for (auto f : log_files)
 		fflush(f);
 
@@ -603,6 +751,47 @@ void log_flush()
 		f->flush();
 }
 
+bool MemoryStats::alloc_tracking()
+{
+#ifdef YOSYS_ENABLE_ALLOC_STATS
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool MemoryStats::sample_rss = false;
+
+MemoryStats MemoryStats::query()
+{
+	MemoryStats stats;
+
+#if defined(__linux__)
+	if (sample_rss) {
+		FILE *f = fopen("/proc/self/statm", "r");
+		if (f != nullptr) {
+			long long size, resident;
+			if (fscanf(f, "%lld %lld", &size, &resident) == 2)
+				stats.rss_bytes = resident * sysconf(_SC_PAGESIZE);
+			fclose(f);
+		}
+	}
+#endif
+
+#if defined(__linux__) || defined(__FreeBSD__)
+	struct rusage rusage;
+	if (getrusage(RUSAGE_SELF, &rusage) == 0)
+		stats.peak_rss_bytes = int64_t(rusage.ru_maxrss) * 1024;
+#endif
+
+#ifdef YOSYS_ENABLE_ALLOC_STATS
+	stats.alloc_bytes = alloc_stats_bytes.load(std::memory_order_relaxed);
+	stats.alloc_count = alloc_stats_count.load(std::memory_order_relaxed);
+#endif
+
+	return stats;
+}
+
 void log_dump_val_worker(RTLIL::IdString v) {
 	log("%s", log_id(v));
 }
@@ -615,11 +804,24 @@ void log_dump_val_worker(RTLIL::State v) {
 	log("%s", log_signal(v));
 }
 
+#ifdef YOSYS_ENABLE_THREADS
+static const char *log_buffer_string(const std::string &str)
+{
+	log_buffer->strings.push_back(strdup(str.c_str()));
+	return log_buffer->strings.back();
+}
+#endif
+
 const char *log_signal(const RTLIL::SigSpec &sig, bool autoint)
 {
 	std::stringstream buf;
 	RTLIL_BACKEND::dump_sigspec(buf, sig, autoint);
 
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer)
+		return log_buffer_string(buf.str());
+#endif
+
 	if (string_buf.size() < 100) {
 		string_buf.push_back(buf.str());
 		return string_buf.back().c_str();
@@ -638,6 +840,11 @@ const char *log_const(const RTLIL::Const &value, bool autoint)
 
 	std::string str = "\"" + value.decode_string() + "\"";
 
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer)
+		return log_buffer_string(str);
+#endif
+
 	if (string_buf.size() < 100) {
 		string_buf.push_back(str);
 		return string_buf.back().c_str();
@@ -651,8 +858,16 @@ const char *log_const(const RTLIL::Const &value, bool autoint)
 
 const char *log_id(const RTLIL::IdString &str)
 {
-	log_id_cache.push_back(strdup(str.c_str()));
-	const char *p = log_id_cache.back();
+	const char *p;
+#ifdef YOSYS_ENABLE_THREADS
+	if (log_buffer)
+		p = log_buffer_string(str.str());
+	else
+#endif
+	{
+		log_id_cache.push_back(strdup(str.c_str()));
+		p = log_id_cache.back();
+	}
 	if (p[0] != '\\')
 		return p;
 	if (p[1] == '$' || p[1] == '\\' || p[1] == 0)
@@ -742,6 +957,13 @@ void log_check_expected()
 dict<std::string, std::pair<std::string, int>> extra_coverage_data;
 
 void cover_extra(std::string parent, std::string id, bool increment) {
+#ifdef YOSYS_ENABLE_THREADS
+	// module local passes such as opt_expr may run on several threads
+	static std::mutex mutex;
+	std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+	if (yosys_threads_active)
+		lock.lock();
+#endif
 	if (extra_coverage_data.count(id) == 0) {
 		for (CoverData *p = __start_yosys_cover_list; p != __stop_yosys_cover_list; p++)
 			if (p->id == parent)
@@ -94,6 +94,12 @@ YOSYS_NAMESPACE_BEGIN
 
 struct log_cmd_error_exception { };
 
+#ifdef YOSYS_ENABLE_THREADS
+// Thrown by log_error() and log_cmd_error() while a LogBuffer is active, after
+// the error has been recorded in the buffer.
+struct log_buffered_error_exception { };
+#endif
+
 extern std::vector<FILE*> log_files;
 extern std::vector<std::ostream*> log_streams;
 extern std::vector<std::string> log_scratchpads;
@@ -117,7 +123,11 @@ extern void (*log_error_atexit)();
 
 extern int log_make_debug;
 extern int log_force_debug;
+#ifdef YOSYS_ENABLE_THREADS
+extern thread_local int log_debug_suppressed;
+#else
 extern int log_debug_suppressed;
+#endif
 
 void logv(const char *format, va_list ap);
 void logv_header(RTLIL::Design *design, const char *format, va_list ap);
@@ -185,6 +195,32 @@ void log_spacer();
 void log_push();
 void log_pop();
 
+#ifdef YOSYS_ENABLE_THREADS
+// Collects the log output of a task running concurrently with other tasks
+// (see Pass::run_on_modules). While a LogBuffer is active on a thread, log
+// messages, warnings and errors from that thread are recorded instead of being
+// written out. replay() emits them on the main thread, so that the log output
+// does not depend on how the tasks were scheduled.
+struct LogBuffer
+{
+	enum kind_t { LOG, WARNING, ERROR, CMD_ERROR };
+
+	struct entry_t {
+		kind_t kind;
+		std::string prefix, text;
+	};
+
+	std::vector<entry_t> entries;
+	std::vector<char*> strings;
+	int debug_suppressed = 0;
+	int saved_debug_suppressed = 0;
+
+	void begin();
+	void end();
+	void replay();
+};
+#endif
+
 void log_backtrace(const char *prefix, int levels);
 void log_reset_stack();
 void log_flush();
@@ -236,15 +272,19 @@ static inline void log_assert_worker(bool cond, const char *expr, const char *fi
 
 #if defined(YOSYS_ENABLE_COVER) && (defined(__linux__) || defined(__FreeBSD__))
 
+// The counters are incremented atomically as module local passes may run on
+// several threads. The entries of the section are read as an array, so they
+// must not be padded: the members of CoverData need no padding, and giving
+// the alignment explicitly keeps the compiler from raising it.
 #define cover(_id) do { \
-    static CoverData __d __attribute__((section("yosys_cover_list"), aligned(1), used)) = { __FILE__, __FUNCTION__, _id, __LINE__, 0 }; \
-    __d.counter++; \
+    static CoverData __d __attribute__((section("yosys_cover_list"), aligned(alignof(CoverData)), used)) = { __FILE__, __FUNCTION__, _id, __LINE__, 0 }; \
+    __atomic_fetch_add(&__d.counter, 1, __ATOMIC_RELAXED); \
 } while (0)
 
 struct CoverData {
 	const char *file, *func, *id;
 	int line, counter;
-} YS_ATTRIBUTE(packed);
+};
 
 // this two symbols are created by the linker for the "yosys_cover_list" ELF section
 extern "C" struct CoverData __start_yosys_cover_list[];
@@ -336,6 +376,25 @@ struct PerformanceTimer
 #endif
 };
 
+// memory use of the process, sampled around each pass for the statistics
+// printed with "yosys -d" and written with "yosys -B"
+struct MemoryStats
+{
+	int64_t rss_bytes = 0;
+	int64_t peak_rss_bytes = 0;
+
+	// only counted when built with ENABLE_ALLOC_STATS, see alloc_tracking()
+	int64_t alloc_bytes = 0;
+	int64_t alloc_count = 0;
+
+	// The current resident set size is only read from /proc if this is set,
+	// which the driver does when the statistics are printed.
+	static bool sample_rss;
+
+	static bool alloc_tracking();
+	static MemoryStats query();
+};
+
 // simple API for quickly dumping values when debugging
 
 static inline void log_dump_val_worker(short v) { log("%d", v); }
@@ -0,0 +1,146 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/netgraph.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+WireBitIndex::WireBitIndex(RTLIL::Module *module)
+{
+	offsets.reserve(GetSize(module->wires_));
+	for (auto &it : module->wires_) {
+		offsets[it.second] = size;
+		size += it.second->width;
+	}
+}
+
+NetGraph::NetGraph(RTLIL::Module *module) : module(module), sigmap(module)
+{
+	cells.reserve(GetSize(module->cells_));
+	for (auto &it : module->cells_)
+		cells.push_back(it.second);
+	build(nullptr, nullptr);
+}
+
+NetGraph::NetGraph(RTLIL::Module *module, const std::vector<RTLIL::Cell*> &cells, const CellTypes *ct,
+		std::function<bool(RTLIL::Cell*, RTLIL::IdString)> port_filter) : module(module), sigmap(module), cells(cells)
+{
+	build(ct, port_filter);
+}
+
+void NetGraph::build(const CellTypes *ct, const std::function<bool(RTLIL::Cell*, RTLIL::IdString)> &port_filter)
+{
+	// number the wire bits, and map each of them to the net of the bit that
+	// represents it under the sigmap
+	wire_bits = WireBitIndex(module);
+	wire_bit_nets.resize(wire_bits.size, -1);
+	for (auto &it : module->wires_) {
+		RTLIL::Wire *wire = it.second;
+		int offset = wire_bits.offsets.at(wire);
+		for (int i = 0; i < wire->width; i++) {
+			RTLIL::SigBit bit = sigmap(RTLIL::SigBit(wire, i));
+			if (bit.wire == nullptr)
+				continue;
+			int &rep_net = wire_bit_nets[wire_bits(bit)];
+			if (rep_net < 0) {
+				rep_net = GetSize(net_bits);
+				net_bits.push_back(bit);
+			}
+			wire_bit_nets[offset + i] = rep_net;
+		}
+	}
+
+	// collect the ports of all cells, and from them the nets each cell
+	// reads and drives
+	int n_cells = GetSize(cells);
+	cell_ids.reserve(n_cells);
+	cell_port_offsets.reserve(n_cells + 1);
+	fanin_offsets.reserve(n_cells + 1);
+	fanout_offsets.reserve(n_cells + 1);
+	cell_port_offsets.push_back(0);
+	fanin_offsets.push_back(0);
+	fanout_offsets.push_back(0);
+
+	// the last cell that had each net added to its fanin and fanout
+	std::vector<int> fanin_mark(num_nets(), -1), fanout_mark(num_nets(), -1);
+
+	for (int cell_idx = 0; cell_idx < n_cells; cell_idx++)
+	{
+		RTLIL::Cell *cell = cells[cell_idx];
+		cell_ids[cell] = cell_idx;
+
+		bool known = ct != nullptr && ct->cell_known(cell->type);
+
+		for (auto &conn : cell->connections())
+		{
+			if (port_filter && !port_filter(cell, conn.first))
+				continue;
+
+			int dir;
+			if (ct == nullptr)
+				dir = (cell->input(conn.first) ? PD_INPUT : 0) | (cell->output(conn.first) ? PD_OUTPUT : 0);
+			else if (known)
+				dir = (ct->cell_input(cell->type, conn.first) ? PD_INPUT : 0) | (ct->cell_output(cell->type, conn.first) ? PD_OUTPUT : 0);
+			else
+				dir = PD_INOUT;
+
+			cell_ports.push_back({conn.first, PortDir(dir), GetSize(port_nets), GetSize(conn.second)});
+
+			for (auto &bit : conn.second) {
+				int n = bit.wire == nullptr ? -1 : wire_bit_nets[wire_bits(bit)];
+				port_nets.push_back(n);
+				if (n < 0)
+					continue;
+				if ((dir & PD_INPUT) && fanin_mark[n] != cell_idx) {
+					fanin_mark[n] = cell_idx;
+					fanin_nets.push_back(n);
+				}
+				if ((dir & PD_OUTPUT) && fanout_mark[n] != cell_idx) {
+					fanout_mark[n] = cell_idx;
+					fanout_nets.push_back(n);
+				}
+			}
+		}
+
+		cell_port_offsets.push_back(GetSize(cell_ports));
+		fanin_offsets.push_back(GetSize(fanin_nets));
+		fanout_offsets.push_back(GetSize(fanout_nets));
+	}
+
+	// transpose the fanout and fanin lists into the driver and user lists
+	// of the nets
+	auto transpose = [&](const std::vector<int> &cell_offsets, const std::vector<int> &cell_nets,
+			std::vector<int> &net_offsets, std::vector<int> &net_cells) {
+		net_offsets.assign(num_nets() + 1, 0);
+		for (int n : cell_nets)
+			net_offsets[n + 1]++;
+		for (int i = 0; i < num_nets(); i++)
+			net_offsets[i + 1] += net_offsets[i];
+		net_cells.resize(GetSize(cell_nets));
+		std::vector<int> fill(net_offsets.begin(), net_offsets.end() - 1);
+		for (int cell_idx = 0; cell_idx < n_cells; cell_idx++)
+			for (int k = cell_offsets[cell_idx]; k < cell_offsets[cell_idx + 1]; k++)
+				net_cells[fill[cell_nets[k]]++] = cell_idx;
+	};
+
+	transpose(fanout_offsets, fanout_nets, driver_offsets, driver_cells);
+	transpose(fanin_offsets, fanin_nets, user_offsets, user_cells);
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,171 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef NETGRAPH_H
+#define NETGRAPH_H
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/celltypes.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Numbers the bits of all wires of a module densely from zero, so that passes
+// can keep their per-bit data in plain vectors. Wires that are removed from the
+// module later keep their range, wires that are added later have no index.
+struct WireBitIndex
+{
+	dict<RTLIL::Wire*, int> offsets;
+	int size = 0;
+
+	WireBitIndex() { }
+	WireBitIndex(RTLIL::Module *module);
+
+	int operator()(const RTLIL::SigBit &bit) const {
+		return offsets.at(bit.wire) + bit.offset;
+	}
+
+	// calls f with the index of every bit of sig that is not constant
+	template<typename F>
+	void for_each(const RTLIL::SigSpec &sig, F f) const {
+		for (auto &chunk : sig.chunks())
+			if (chunk.wire != nullptr) {
+				int base = offsets.at(chunk.wire) + chunk.offset;
+				for (int i = 0; i < chunk.width; i++)
+					f(base + i);
+			}
+	}
+};
+
+// A snapshot of the connectivity of a module, for analysis passes that walk
+// from cells to the nets they read or drive and back.
+//
+// Nets are the wire bits of the module under `sigmap`, cells are the cells the
+// graph was built from. Both are numbered densely from zero, so that passes
+// can keep their per-net and per-cell data in plain vectors, and all adjacency
+// is stored in flat (CSR) arrays. Building the graph takes time linear in the
+// size of the module.
+//
+// The graph doesn't follow changes to the module. Adding, removing or
+// renaming cells or wires, and changing cell or module connections all
+// invalidate it, and it has to be rebuilt before it is used again. A removed
+// cell is left as a dangling pointer in `cells`. Passes that modify the
+// module based on the graph should collect their changes first and apply them
+// after they are done with it. Changes to parameters and attributes don't
+// affect the graph.
+struct NetGraph
+{
+	enum PortDir : unsigned char {
+		PD_NONE = 0,
+		PD_INPUT = 1,
+		PD_OUTPUT = 2,
+		PD_INOUT = 3
+	};
+
+	struct Port {
+		RTLIL::IdString name;
+		PortDir dir;
+		int offset, width;
+	};
+
+	template<typename T>
+	struct Range {
+		const T *begin_, *end_;
+		const T *begin() const { return begin_; }
+		const T *end() const { return end_; }
+		int size() const { return end_ - begin_; }
+		bool empty() const { return begin_ == end_; }
+		const T &operator[](int i) const { return begin_[i]; }
+	};
+
+	RTLIL::Module *module;
+	SigMap sigmap;
+
+	std::vector<RTLIL::Cell*> cells;
+	std::vector<RTLIL::SigBit> net_bits;
+
+	// The ports of cell i are cell_ports[cell_port_offsets[i]] up to
+	// cell_ports[cell_port_offsets[i+1]], and the nets of a port are
+	// port_nets[port.offset] up to port_nets[port.offset+port.width], with
+	// -1 for constant bits. The other adjacency lists are laid out the same
+	// way and list each cell or net once.
+	std::vector<int> cell_port_offsets;
+	std::vector<Port> cell_ports;
+	std::vector<int> port_nets;
+	std::vector<int> fanin_offsets, fanin_nets;
+	std::vector<int> fanout_offsets, fanout_nets;
+	std::vector<int> driver_offsets, driver_cells;
+	std::vector<int> user_offsets, user_cells;
+
+	dict<RTLIL::Cell*, int> cell_ids;
+	WireBitIndex wire_bits;
+	// the net of each wire bit, or -1 for wire bits that are driven by a constant
+	std::vector<int> wire_bit_nets;
+
+	// Builds the graph over all cells of the module, with port directions
+	// as given by RTLIL::Cell::input() and RTLIL::Cell::output().
+	NetGraph(RTLIL::Module *module);
+
+	// Builds the graph over the given cells. With `ct` set, the port
+	// directions come from it, and all ports of cells that it doesn't know
+	// are inout. Otherwise they are given by RTLIL::Cell::input() and
+	// RTLIL::Cell::output(). Ports for which `port_filter` returns false are
+	// left out of the graph.
+	NetGraph(RTLIL::Module *module, const std::vector<RTLIL::Cell*> &cells, const CellTypes *ct = nullptr,
+			std::function<bool(RTLIL::Cell*, RTLIL::IdString)> port_filter = nullptr);
+
+	int num_cells() const { return GetSize(cells); }
+	int num_nets() const { return GetSize(net_bits); }
+
+	// Returns the id of a cell, or -1 if it is not part of the graph.
+	int cell_id(RTLIL::Cell *cell) const {
+		auto it = cell_ids.find(cell);
+		return it == cell_ids.end() ? -1 : it->second;
+	}
+
+	// Returns the id of the net of a bit, or -1 for constant bits.
+	int net(const RTLIL::SigBit &bit) const {
+		if (bit.wire == nullptr)
+			return -1;
+		return wire_bit_nets[wire_bits(bit)];
+	}
+
+	Range<Port> ports(int cell) const { return range(cell_ports, cell_port_offsets, cell); }
+	Range<int> nets(const Port &port) const { return {port_nets.data() + port.offset, port_nets.data() + port.offset + port.width}; }
+
+	// The nets read and driven by a cell. Nets of inout ports are in both.
+	Range<int> fanin(int cell) const { return range(fanin_nets, fanin_offsets, cell); }
+	Range<int> fanout(int cell) const { return range(fanout_nets, fanout_offsets, cell); }
+
+	// The cells that drive and read a net, in order of their ids.
+	Range<int> drivers(int net) const { return range(driver_cells, driver_offsets, net); }
+	Range<int> users(int net) const { return range(user_cells, user_offsets, net); }
+
+private:
+	template<typename T>
+	static Range<T> range(const std::vector<T> &items, const std::vector<int> &offsets, int i) {
+		return {items.data() + offsets[i], items.data() + offsets[i+1]};
+	}
+
+	void build(const CellTypes *ct, const std::function<bool(RTLIL::Cell*, RTLIL::IdString)> &port_filter);
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
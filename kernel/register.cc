@@ -28,23 +28,89 @@
 #ifdef YOSYS_ENABLE_ZLIB
 #include <zlib.h>
 
+USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
-#define GZ_BUFFER_SIZE 8192
-void decompress_gzip(const std::string &filename, std::stringstream &out)
-{
-	char buffer[GZ_BUFFER_SIZE];
-	int bytes_read;
-	gzFile gzf = gzopen(filename.c_str(), "rb");
-	while(!gzeof(gzf)) {
-		bytes_read = gzread(gzf, reinterpret_cast<void *>(buffer), GZ_BUFFER_SIZE);
-		out.write(buffer, bytes_read);
+#define GZ_BUFFER_SIZE 65536
+#define GZ_PUTBACK_SIZE 16
+#define GZ_BLOCK_SIZE (1 << 20)
+
+/*
+An input stream that inflates a gzip file on demand, so that frontends read
+the decompressed data as it is needed instead of all of it at once. A few
+characters before the read position are kept for unget(), and tellg() works,
+but seeking is not supported.
+*/
+class gzip_istream : public std::istream {
+public:
+	gzip_istream() : std::istream(nullptr)
+	{
+		rdbuf(&inbuf);
 	}
-	gzclose(gzf);
-}
+	bool open(const std::string &filename)
+	{
+		return inbuf.open(filename);
+	}
+private:
+	class gzip_streambuf : public std::streambuf {
+	public:
+		gzip_streambuf() { };
+		bool open(const std::string &filename)
+		{
+			this->filename = filename;
+			gzf = gzopen(filename.c_str(), "rb");
+			if (gzf == nullptr)
+				return false;
+			gzbuffer(gzf, GZ_BUFFER_SIZE);
+			return true;
+		}
+		virtual int_type underflow() override
+		{
+			if (gptr() < egptr())
+				return traits_type::to_int_type(*gptr());
+
+			int putback = std::min(int(gptr() - eback()), GZ_PUTBACK_SIZE);
+			memmove(buffer + GZ_PUTBACK_SIZE - putback, gptr() - putback, putback);
+
+			int bytes_read = gzread(gzf, buffer + GZ_PUTBACK_SIZE, GZ_BUFFER_SIZE);
+			if (bytes_read < 0) {
+				int errnum;
+				const char *msg = gzerror(gzf, &errnum);
+				log_error("Error while decompressing gzip file `%s': %s\n", filename.c_str(), msg);
+			}
+			if (bytes_read <= 0)
+				return traits_type::eof();
+
+			setg(buffer + GZ_PUTBACK_SIZE - putback, buffer + GZ_PUTBACK_SIZE, buffer + GZ_PUTBACK_SIZE + bytes_read);
+			return traits_type::to_int_type(*gptr());
+		}
+		virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override
+		{
+			// only position queries, as used by tellg()
+			if (off != 0 || dir != std::ios_base::cur || !(which & std::ios_base::in))
+				return pos_type(off_type(-1));
+			return pos_type(off_type(gztell(gzf) - (egptr() - gptr())));
+		}
+		virtual ~gzip_streambuf()
+		{
+			if (gzf != nullptr)
+				gzclose(gzf);
+		}
+	private:
+		std::string filename;
+		gzFile gzf = nullptr;
+		char buffer[GZ_PUTBACK_SIZE + GZ_BUFFER_SIZE];
+	} inbuf;
+};
 
 /*
-An output stream that uses a stringbuf to buffer data internally,
-using zlib to write gzip-compressed data every time the stream is flushed.
+An output stream that collects the data in blocks of GZ_BLOCK_SIZE bytes and
+compresses each block into a gzip member of its own. A gzip file may consist
+of several members, and the blocks are independent, so up to yosys_threads
+blocks are compressed in parallel. The output does not depend on the number
+of threads. Flushing the stream writes out the complete blocks, the data of
+the current block is compressed when the block is full or when the stream is
+closed, so that the output does not depend on how often it is flushed either.
+Errors put the stream into the bad state and are reported by close().
 */
 class gzip_ostream : public std::ostream  {
 public:
@@ -56,28 +122,125 @@ public:
 	{
 		return outbuf.open(filename);
 	}
+	// Writes the remaining data and closes the file. Reports errors with
+	// log_error(), which the destructor can't do.
+	void close()
+	{
+		std::string error = outbuf.close();
+		if (!error.empty())
+			log_error("%s\n", error.c_str());
+	}
 private:
-	class gzip_streambuf : public std::stringbuf {
+	class gzip_streambuf : public std::streambuf {
 	public:
 		gzip_streambuf() { };
 		bool open(const std::string &filename)
 		{
-			gzf = gzopen(filename.c_str(), "wb");
-			return gzf != nullptr;
+			f = fopen(filename.c_str(), "wb");
+			if (f == nullptr)
+				return false;
+			this->filename = filename;
+			blocks.emplace_back(GZ_BLOCK_SIZE);
+			setp(blocks.back().data(), blocks.back().data() + GZ_BLOCK_SIZE);
+			return true;
+		}
+		virtual int_type overflow(int_type c) override
+		{
+			if (f == nullptr || !error.empty())
+				return traits_type::eof();
+			if (GetSize(blocks) >= std::max(yosys_threads, 1)) {
+				if (!write_blocks(true))
+					return traits_type::eof();
+			} else {
+				blocks.emplace_back(GZ_BLOCK_SIZE);
+				setp(blocks.back().data(), blocks.back().data() + GZ_BLOCK_SIZE);
+			}
+			if (!traits_type::eq_int_type(c, traits_type::eof()))
+				sputc(traits_type::to_char_type(c));
+			return traits_type::not_eof(c);
 		}
 		virtual int sync() override
 		{
-			gzwrite(gzf, reinterpret_cast<const void *>(str().c_str()), unsigned(str().size()));
-			str("");
-			return 0;
+			if (f == nullptr || !error.empty())
+				return -1;
+			if (GetSize(blocks) > 1 && !write_blocks(false))
+				return -1;
+			return fflush(f) == 0 ? 0 : -1;
+		}
+		// returns the first error that occurred, or an empty string
+		std::string close()
+		{
+			if (f == nullptr)
+				return error;
+			if (error.empty())
+				write_blocks(true);
+			if (fclose(f) != 0 && error.empty())
+				error = stringf("Error while writing gzip file `%s': %s", filename.c_str(), strerror(errno));
+			f = nullptr;
+			return error;
 		}
 		virtual ~gzip_streambuf()
 		{
-			sync();
-			gzclose(gzf);
+			close();
 		}
 	private:
-		gzFile gzf = nullptr;
+		FILE *f = nullptr;
+		std::string filename;
+		std::string error;
+		std::vector<std::vector<char>> blocks;
+
+		// Compresses and writes the full blocks, i.e. all but the last one,
+		// and if `all` is set also the last one up to pptr(). The last
+		// block is then reused for the data that follows. Returns false
+		// and sets `error` if compressing or writing failed.
+		bool write_blocks(bool all)
+		{
+			int n = all ? GetSize(blocks) : GetSize(blocks) - 1;
+			size_t last_size = pptr() - pbase();
+			std::vector<std::vector<char>> members(n);
+			std::vector<const char*> errors(n);
+			yosys_parallel_for(n, [&](int i) {
+				size_t size = i == GetSize(blocks)-1 ? last_size : blocks[i].size();
+				if (size != 0)
+					errors[i] = compress_block(blocks[i].data(), size, members[i]);
+			});
+			for (int i = 0; i < n; i++) {
+				if (errors[i] != nullptr) {
+					error = stringf("Error while compressing gzip file `%s': %s", filename.c_str(), errors[i]);
+					return false;
+				}
+				if (fwrite(members[i].data(), 1, members[i].size(), f) != members[i].size()) {
+					error = stringf("Error while writing gzip file `%s': %s", filename.c_str(), strerror(errno));
+					return false;
+				}
+			}
+			// moving the vectors keeps their data, and thus pptr(), valid
+			blocks.erase(blocks.begin(), blocks.end() - 1);
+			if (all)
+				setp(blocks.back().data(), blocks.back().data() + GZ_BLOCK_SIZE);
+			return true;
+		}
+
+		// returns an error message, or nullptr on success
+		static const char *compress_block(const char *data, size_t size, std::vector<char> &member)
+		{
+			z_stream zs;
+			memset(&zs, 0, sizeof(zs));
+			// window bits 15 + 16 selects the gzip format
+			int ret = deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+			if (ret != Z_OK)
+				return zs.msg ? zs.msg : zError(ret);
+			member.resize(deflateBound(&zs, size));
+			zs.next_in = (Bytef*)data;
+			zs.avail_in = size;
+			zs.next_out = (Bytef*)member.data();
+			zs.avail_out = member.size();
+			ret = deflate(&zs, Z_FINISH);
+			const char *error = ret == Z_STREAM_END ? nullptr : zs.msg ? zs.msg : zError(ret);
+			member.resize(zs.total_out);
+			deflateEnd(&zs);
+			return error;
+		}
 	} outbuf;
 };
 PRIVATE_NAMESPACE_END
@@ -104,6 +267,10 @@ Pass::Pass(std::string name, std::string short_help) : pass_name(name), short_he
 	first_queued_pass = this;
 	call_counter = 0;
 	runtime_ns = 0;
+	rss_delta_bytes = 0;
+	peak_rss_delta_bytes = 0;
+	alloc_bytes = 0;
+	alloc_count = 0;
 }
 
 void Pass::run_register()
@@ -153,6 +320,7 @@ Pass::pre_post_exec_state_t Pass::pre_execute()
 	pre_post_exec_state_t state;
 	call_counter++;
 	state.begin_ns = PerformanceTimer::query();
+	state.begin_mem = MemoryStats::query();
 	state.parent_pass = current_pass;
 	current_pass = this;
 	clear_flags();
@@ -166,9 +334,71 @@ void Pass::post_execute(Pass::pre_post_exec_state_t state)
 
 	int64_t time_ns = PerformanceTimer::query() - state.begin_ns;
 	runtime_ns += time_ns;
+
+	MemoryStats mem = MemoryStats::query();
+	int64_t rss_delta = mem.rss_bytes - state.begin_mem.rss_bytes;
+	int64_t peak_rss_delta = mem.peak_rss_bytes - state.begin_mem.peak_rss_bytes;
+	int64_t alloc_delta = mem.alloc_bytes - state.begin_mem.alloc_bytes;
+	int64_t alloc_count_delta = mem.alloc_count - state.begin_mem.alloc_count;
+	rss_delta_bytes += rss_delta;
+	peak_rss_delta_bytes += peak_rss_delta;
+	alloc_bytes += alloc_delta;
+	alloc_count += alloc_count_delta;
+
 	current_pass = state.parent_pass;
-	if (current_pass)
+	if (current_pass) {
 		current_pass->runtime_ns -= time_ns;
+		current_pass->rss_delta_bytes -= rss_delta;
+		current_pass->peak_rss_delta_bytes -= peak_rss_delta;
+		current_pass->alloc_bytes -= alloc_delta;
+		current_pass->alloc_count -= alloc_count_delta;
+	}
+}
+
+void Pass::run_on_modules(const std::vector<RTLIL::Module*> &modules, const std::function<void(RTLIL::Module*)> &worker)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	bool parallel = module_local_flag && yosys_threads > 1 && GetSize(modules) > 1 && !yosys_threads_active;
+
+	// design level monitors would be notified from several threads at once
+	for (auto module : modules)
+		if (module->design && !module->design->monitors.empty())
+			parallel = false;
+
+	if (parallel)
+	{
+		std::vector<LogBuffer> buffers(GetSize(modules));
+		std::vector<std::exception_ptr> exceptions(GetSize(modules));
+
+		yosys_parallel_for(GetSize(modules), [&](int i) {
+			buffers[i].begin();
+			try {
+				worker(modules[i]);
+			} catch (log_buffered_error_exception&) {
+				// the error is replayed from the buffer below
+			} catch (...) {
+				exceptions[i] = std::current_exception();
+			}
+			buffers[i].end();
+		});
+
+		for (int i = 0; i < GetSize(modules); i++) {
+			buffers[i].replay();
+			if (exceptions[i])
+				std::rethrow_exception(exceptions[i]);
+		}
+		return;
+	}
+#endif
+
+	// number the new objects of each module like the parallel path does
+	if (module_local_flag) {
+		yosys_parallel_for(GetSize(modules), [&](int i) { worker(modules[i]); }, false);
+		return;
+	}
+
+	for (auto module : modules)
+		worker(module);
 }
 
 void Pass::help()
@@ -318,6 +548,11 @@ void Pass::call(RTLIL::Design *design, std::vector<std::string> args)
 	pass_register[args[0]]->post_execute(state);
 	while (design->selection_stack.size() > orig_sel_stack_pos)
 		design->selection_stack.pop_back();
+
+	// the callers of nested commands may still hold pointers to removed
+	// wires and cells, scripts like "synth" only hold their command list
+	if (current_pass == nullptr || dynamic_cast<ScriptPass*>(current_pass) != nullptr)
+		design->recycle_objects();
 }
 
 void Pass::call_on_selection(RTLIL::Design *design, const RTLIL::Selection &selection, std::string command)
@@ -553,9 +788,12 @@ void Frontend::extra_args(std::istream *&f, std::string &filename, std::vector<s
 						log_cmd_error("gzip file `%s' uses unsupported compression type %02x\n",
 							filename.c_str(), unsigned(magic[2]));
 					delete ff;
-					std::stringstream *df = new std::stringstream();
-					decompress_gzip(filename, *df);
-					f = df;
+					gzip_istream *gf = new gzip_istream;
+					if (!gf->open(filename)) {
+						delete gf;
+						log_cmd_error("Can't open input file `%s' for reading: %s\n", filename.c_str(), strerror(errno));
+					}
+					f = gf;
 	#else
 					log_cmd_error("File `%s' is a gzip file, but Yosys is compiled without zlib.\n", filename.c_str());
 	#endif
@@ -648,6 +886,10 @@ void Backend::execute(std::vector<std::string> args, RTLIL::Design *design)
 	std::ostream *f = NULL;
 	auto state = pre_execute();
 	execute(f, std::string(), args, design);
+#ifdef YOSYS_ENABLE_ZLIB
+	if (gzip_ostream *gf = dynamic_cast<gzip_ostream*>(f))
+		gf->close();
+#endif
 	post_execute(state);
 	if (f != &std::cout)
 		delete f;
@@ -37,15 +37,35 @@ struct Pass
 
 	int call_counter;
 	int64_t runtime_ns;
+
+	// memory statistics, excluding nested pass calls like runtime_ns
+	int64_t rss_delta_bytes, peak_rss_delta_bytes;
+	int64_t alloc_bytes, alloc_count;
 	bool experimental_flag = false;
+	bool module_local_flag = false;
 
 	void experimental() {
 		experimental_flag = true;
 	}
 
+	// Module-local passes only ever read and modify the module they are working
+	// on, and touch no global state other than the IdString table and autoidx.
+	// They can use run_on_modules() to process several modules in parallel.
+	void module_local() {
+		module_local_flag = true;
+	}
+
+	// Calls worker() for each of the given modules. For module-local passes with
+	// "yosys -j" set, the modules are processed in parallel and the log output of
+	// the workers is written in module order once all of them have finished.
+	// Module-local passes number the new objects of every module starting at
+	// the same autoidx, with and without threads (see yosys_parallel_for()).
+	void run_on_modules(const std::vector<RTLIL::Module*> &modules, const std::function<void(RTLIL::Module*)> &worker);
+
 	struct pre_post_exec_state_t {
 		Pass *parent_pass;
 		int64_t begin_ns;
+		MemoryStats begin_mem;
 	};
 
 	pre_post_exec_state_t pre_execute();
@@ -24,6 +24,7 @@
 #include "frontends/verilog/verilog_frontend.h"
 #include "frontends/verilog/preproc.h"
 #include "backends/rtlil/rtlil_backend.h"
+#include "backends/rtlil/rtlil_binary.h"
 
 #include <string.h>
 #include <algorithm>
@@ -32,12 +33,15 @@ YOSYS_NAMESPACE_BEGIN
 
 bool RTLIL::IdString::destruct_guard_ok = false;
 RTLIL::IdString::destruct_guard_t RTLIL::IdString::destruct_guard;
-std::vector<char*> RTLIL::IdString::global_id_storage_;
-dict<char*, int, hash_cstr_ops> RTLIL::IdString::global_id_index_;
+RTLIL::IdString::page_t *RTLIL::IdString::global_id_pages_[RTLIL::IdString::max_pages];
+int RTLIL::IdString::global_id_size_;
+RTLIL::IdString::shard_t RTLIL::IdString::global_id_shards_[RTLIL::IdString::shard_count];
 #ifndef YOSYS_NO_IDS_REFCNT
-std::vector<int> RTLIL::IdString::global_refcount_storage_;
 std::vector<int> RTLIL::IdString::global_free_idx_list_;
 #endif
+#ifdef YOSYS_ENABLE_THREADS
+std::mutex RTLIL::IdString::global_alloc_mutex_;
+#endif
 #ifdef YOSYS_USE_STICKY_IDS
 int RTLIL::IdString::last_created_idx_[8];
 int RTLIL::IdString::last_created_idx_ptr_;
@@ -49,6 +53,51 @@ int RTLIL::IdString::last_created_idx_ptr_;
 
 dict<std::string, std::string> RTLIL::constpad;
 
+// objects may be created by concurrently running tasks (see yosys_parallel_for),
+// which then draw their hashidx_ values from the same sequence
+static unsigned int next_hashidx(unsigned int &hashidx_count)
+{
+#ifdef YOSYS_ENABLE_THREADS
+	static std::mutex mutex;
+	std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+	if (yosys_threads_active)
+		lock.lock();
+#endif
+	hashidx_count = mkhash_xorshift(hashidx_count);
+	return hashidx_count;
+}
+
+RTLIL::Monitor::Monitor()
+{
+	static unsigned int hashidx_count = 123456789;
+	hashidx_ = next_hashidx(hashidx_count);
+}
+
+#if defined(YOSYS_ENABLE_THREADS) && !defined(YOSYS_NO_IDS_REFCNT)
+void RTLIL::IdString::put_reference_concurrent(int idx)
+{
+	refcount_t &refcount = global_refcount(idx);
+
+	// dropping a reference that is not the last one does not need a lock
+	int value = refcount.load(std::memory_order_relaxed);
+	while (value > 1)
+		if (refcount.compare_exchange_weak(value, value - 1, std::memory_order_release, std::memory_order_relaxed))
+			return;
+
+	// this might be the last reference: drop it while holding the shard lock, so
+	// that a concurrent lookup by name can not pick up the entry while it is freed
+	shard_t &shard = global_id_shard(hash_cstr_ops::hash(global_id_storage(idx)));
+	std::lock_guard<std::mutex> lock(shard.mutex);
+
+	value = refcount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+	if (value > 0)
+		return;
+
+	log_assert(value == 0);
+	free_reference(idx);
+}
+#endif
+
 const pool<IdString> &RTLIL::builtin_ff_cell_types() {
 	static const pool<IdString> res = {
 		ID($sr),
@@ -589,7 +638,7 @@ void RTLIL::Selection::optimize(RTLIL::Design *design)
 	for (auto &it : selected_members) {
 		del_list.clear();
 		for (auto memb_name : it.second)
-			if (design->modules_[it.first]->count_id(memb_name) == 0)
+			if (design->module(it.first)->count_id(memb_name) == 0)
 				del_list.push_back(memb_name);
 		for (auto memb_name : del_list)
 			it.second.erase(memb_name);
@@ -597,12 +646,13 @@ void RTLIL::Selection::optimize(RTLIL::Design *design)
 
 	del_list.clear();
 	add_list.clear();
-	for (auto &it : selected_members)
+	for (auto &it : selected_members) {
+		RTLIL::Module *mod = design->module(it.first);
 		if (it.second.size() == 0)
 			del_list.push_back(it.first);
-		else if (it.second.size() == design->modules_[it.first]->wires_.size() + design->modules_[it.first]->memories.size() +
-				design->modules_[it.first]->cells_.size() + design->modules_[it.first]->processes.size())
+		else if (it.second.size() == mod->wires_.size() + mod->memories.size() + mod->cells_.size() + mod->processes.size())
 			add_list.push_back(it.first);
+	}
 	for (auto mod_name : del_list)
 		selected_members.erase(mod_name);
 	for (auto mod_name : add_list) {
@@ -655,19 +705,52 @@ std::map<unsigned int, RTLIL::Design*> *RTLIL::Design::get_all_designs(void)
 }
 #endif
 
+// Decodes a module read with "read_rtlil -lazy" on its first access. Const
+// accessors return the decoded module too, and the workers of module-local
+// passes may access the same cell type module at once, so the flag is checked
+// again under the lock.
+static RTLIL::Module *load_lazy_module(const RTLIL::Module *stub)
+{
+	RTLIL::Module *module = const_cast<RTLIL::Module*>(stub);
+	if (module->lazy_stub_.load(std::memory_order_acquire)) {
+#ifdef YOSYS_ENABLE_THREADS
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		if (module->lazy_stub_.load(std::memory_order_relaxed)) {
+			RTLIL_BINARY::load_module(module);
+			module->lazy_stub_.store(false, std::memory_order_release);
+		}
+	}
+	return module;
+}
+
 RTLIL::ObjRange<RTLIL::Module*> RTLIL::Design::modules()
 {
+	for (auto &it : modules_)
+		load_lazy_module(it.second);
 	return RTLIL::ObjRange<RTLIL::Module*>(&modules_, &refcount_modules_);
 }
 
 RTLIL::Module *RTLIL::Design::module(const RTLIL::IdString& name)
 {
-	return modules_.count(name) ? modules_.at(name) : NULL;
+	auto it = modules_.find(name);
+	return it != modules_.end() ? load_lazy_module(it->second) : NULL;
 }
 
 const RTLIL::Module *RTLIL::Design::module(const RTLIL::IdString& name) const
 {
-	return modules_.count(name) ? modules_.at(name) : NULL;
+	auto it = modules_.find(name);
+	return it != modules_.end() ? load_lazy_module(it->second) : NULL;
+}
+
+std::vector<const RTLIL::Module*> RTLIL::Design::module_stubs() const
+{
+	std::vector<const RTLIL::Module*> result;
+	result.reserve(modules_.size());
+	for (auto &it : modules_)
+		result.push_back(it.second);
+	return result;
 }
 
 RTLIL::Module *RTLIL::Design::top_module()
@@ -847,6 +930,12 @@ void RTLIL::Design::optimize()
 		it.second.optimize(this);
 }
 
+void RTLIL::Design::recycle_objects()
+{
+	for (auto &it : modules_)
+		it.second->recycle_objects();
+}
+
 bool RTLIL::Design::selected_module(const RTLIL::IdString& mod_name) const
 {
 	if (!selected_active_module.empty() && mod_name != selected_active_module)
@@ -890,7 +979,7 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_modules() const
 	result.reserve(modules_.size());
 	for (auto &it : modules_)
 		if (selected_module(it.first) && !it.second->get_blackbox_attribute())
-			result.push_back(it.second);
+			result.push_back(load_lazy_module(it.second));
 	return result;
 }
 
@@ -900,7 +989,7 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules() const
 	result.reserve(modules_.size());
 	for (auto &it : modules_)
 		if (selected_whole_module(it.first) && !it.second->get_blackbox_attribute())
-			result.push_back(it.second);
+			result.push_back(load_lazy_module(it.second));
 	return result;
 }
 
@@ -912,13 +1001,63 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_whole_modules_warn(bool incl
 		if (it.second->get_blackbox_attribute(include_wb))
 			continue;
 		else if (selected_whole_module(it.first))
-			result.push_back(it.second);
+			result.push_back(load_lazy_module(it.second));
 		else if (selected_module(it.first))
 			log_warning("Ignoring partially selected module %s.\n", log_id(it.first));
 	return result;
 }
 
-RTLIL::Module::Module()
+ObjectArena::ObjectArena(size_t object_size) : slab_used(0), slab_capacity(0),
+		free_list(nullptr), released_head(nullptr), released_tail(nullptr)
+{
+	// every object must be able to hold the free list link and be suitably aligned
+	size_t align = alignof(std::max_align_t);
+	this->object_size = (std::max(object_size, sizeof(void*)) + align - 1) / align * align;
+}
+
+ObjectArena::~ObjectArena()
+{
+	for (auto slab : slabs)
+		::operator delete(slab);
+}
+
+void *ObjectArena::allocate()
+{
+	if (free_list != nullptr) {
+		void *ptr = free_list;
+		free_list = *(void**)ptr;
+		return ptr;
+	}
+
+	if (slab_used == slab_capacity) {
+		// start small, as many modules only have a handful of wires and cells
+		slab_capacity = slabs.empty() ? 8 : std::min(2 * slab_capacity, size_t(4096));
+		slabs.push_back((char*)::operator new(slab_capacity * object_size));
+		slab_used = 0;
+	}
+
+	return slabs.back() + object_size * slab_used++;
+}
+
+void ObjectArena::deallocate(void *ptr)
+{
+	*(void**)ptr = released_head;
+	if (released_head == nullptr)
+		released_tail = ptr;
+	released_head = ptr;
+}
+
+void ObjectArena::recycle()
+{
+	if (released_head == nullptr)
+		return;
+	*(void**)released_tail = free_list;
+	free_list = released_head;
+	released_head = nullptr;
+	released_tail = nullptr;
+}
+
+RTLIL::Module::Module() : wire_arena_(sizeof(RTLIL::Wire)), cell_arena_(sizeof(RTLIL::Cell))
 {
 	static unsigned int hashidx_count = 123456789;
 	hashidx_count = mkhash_xorshift(hashidx_count);
@@ -927,6 +1066,7 @@ RTLIL::Module::Module()
 	design = nullptr;
 	refcount_wires_ = 0;
 	refcount_cells_ = 0;
+	lazy_stub_ = false;
 
 #ifdef WITH_PYTHON
 	RTLIL::Module::get_all_modules()->insert(std::pair<unsigned int, RTLIL::Module*>(hashidx_, this));
@@ -936,11 +1076,11 @@ RTLIL::Module::Module()
 RTLIL::Module::~Module()
 {
 	for (auto &pr : wires_)
-		delete pr.second;
+		destroy(pr.second);
 	for (auto &pr : memories)
 		delete pr.second;
 	for (auto &pr : cells_)
-		delete pr.second;
+		destroy(pr.second);
 	for (auto &pr : processes)
 		delete pr.second;
 	for (auto binding : bindings_)
@@ -971,7 +1111,7 @@ void RTLIL::Module::makeblackbox()
 	memories.clear();
 
 	for (auto it = cells_.begin(); it != cells_.end(); ++it)
-		delete it->second;
+		destroy(it->second);
 	cells_.clear();
 
 	for (auto it = processes.begin(); it != processes.end(); ++it)
@@ -979,6 +1119,7 @@ void RTLIL::Module::makeblackbox()
 	processes.clear();
 
 	connections_.clear();
+	connections_changed();
 
 	remove(delwires);
 	set_bool_attribute(ID::blackbox);
@@ -2203,7 +2344,7 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 	for (auto &it : wires) {
 		log_assert(wires_.count(it->name) != 0);
 		wires_.erase(it->name);
-		delete it;
+		destroy(it);
 	}
 }
 
@@ -2215,7 +2356,25 @@ void RTLIL::Module::remove(RTLIL::Cell *cell)
 	log_assert(cells_.count(cell->name) != 0);
 	log_assert(refcount_cells_ == 0);
 	cells_.erase(cell->name);
-	delete cell;
+	destroy(cell);
+}
+
+void RTLIL::Module::destroy(RTLIL::Wire *wire)
+{
+	wire->~Wire();
+	wire_arena_.deallocate(wire);
+}
+
+void RTLIL::Module::destroy(RTLIL::Cell *cell)
+{
+	cell->~Cell();
+	cell_arena_.deallocate(cell);
+}
+
+void RTLIL::Module::recycle_objects()
+{
+	wire_arena_.recycle();
+	cell_arena_.recycle();
 }
 
 void RTLIL::Module::remove(RTLIL::Process *process)
@@ -2232,6 +2391,7 @@ void RTLIL::Module::rename(RTLIL::Wire *wire, RTLIL::IdString new_name)
 	wires_.erase(wire->name);
 	wire->name = new_name;
 	add(wire);
+	connections_changed();
 }
 
 void RTLIL::Module::rename(RTLIL::Cell *cell, RTLIL::IdString new_name)
@@ -2267,6 +2427,7 @@ void RTLIL::Module::swap_names(RTLIL::Wire *w1, RTLIL::Wire *w2)
 
 	wires_[w1->name] = w1;
 	wires_[w2->name] = w2;
+	connections_changed();
 }
 
 void RTLIL::Module::swap_names(RTLIL::Cell *c1, RTLIL::Cell *c2)
@@ -2378,6 +2539,11 @@ const std::vector<RTLIL::SigSig> &RTLIL::Module::connections() const
 	return connections_;
 }
 
+void RTLIL::Module::connections_changed()
+{
+	sigmap_cache_.reset();
+}
+
 void RTLIL::Module::fixup_ports()
 {
 	std::vector<RTLIL::Wire*> all_ports;
@@ -2399,7 +2565,7 @@ void RTLIL::Module::fixup_ports()
 
 RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, int width)
 {
-	RTLIL::Wire *wire = new RTLIL::Wire;
+	RTLIL::Wire *wire = new (wire_arena_.allocate()) RTLIL::Wire;
 	wire->name = name;
 	wire->width = width;
 	add(wire);
@@ -2422,7 +2588,7 @@ RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, const RTLIL::Wire *oth
 
 RTLIL::Cell *RTLIL::Module::addCell(RTLIL::IdString name, RTLIL::IdString type)
 {
-	RTLIL::Cell *cell = new RTLIL::Cell;
+	RTLIL::Cell *cell = new (cell_arena_.allocate()) RTLIL::Cell;
 	cell->name = name;
 	cell->type = type;
 	add(cell);
@@ -3409,8 +3575,7 @@ RTLIL::SigSpec RTLIL::Module::FutureFF(RTLIL::IdString name, const RTLIL::SigSpe
 RTLIL::Wire::Wire()
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	module = nullptr;
 	width = 1;
@@ -3444,8 +3609,7 @@ std::map<unsigned int, RTLIL::Wire*> *RTLIL::Wire::get_all_wires(void)
 RTLIL::Memory::Memory()
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	width = 1;
 	start_offset = 0;
@@ -3465,8 +3629,7 @@ RTLIL::Process::Process() : module(nullptr)
 RTLIL::Cell::Cell() : module(nullptr)
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	// log("#memtrace# %p\n", this);
 	memhasher();
@@ -3809,7 +3972,10 @@ RTLIL::SigSpec::SigSpec(const RTLIL::SigChunk &chunk)
 {
 	cover("kernel.rtlil.sigspec.init.chunk");
 
-	if (chunk.width != 0) {
+	if (chunk.width == 1) {
+		set_single(chunk);
+		width_ = 1;
+	} else if (chunk.width != 0) {
 		chunks_.emplace_back(chunk);
 		width_ = chunks_.back().width;
 	} else {
@@ -3823,7 +3989,10 @@ RTLIL::SigSpec::SigSpec(RTLIL::SigChunk &&chunk)
 {
 	cover("kernel.rtlil.sigspec.init.chunk.move");
 
-	if (chunk.width != 0) {
+	if (chunk.width == 1) {
+		set_single(chunk);
+		width_ = 1;
+	} else if (chunk.width != 0) {
 		chunks_.emplace_back(std::move(chunk));
 		width_ = chunks_.back().width;
 	} else {
@@ -3837,7 +4006,10 @@ RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire)
 {
 	cover("kernel.rtlil.sigspec.init.wire");
 
-	if (wire->width != 0) {
+	if (wire->width == 1) {
+		set_single(RTLIL::SigBit(wire));
+		width_ = 1;
+	} else if (wire->width != 0) {
 		chunks_.emplace_back(wire);
 		width_ = chunks_.back().width;
 	} else {
@@ -3851,7 +4023,10 @@ RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire, int offset, int width)
 {
 	cover("kernel.rtlil.sigspec.init.wire_part");
 
-	if (width != 0) {
+	if (width == 1) {
+		set_single(RTLIL::SigBit(wire, offset));
+		width_ = 1;
+	} else if (width != 0) {
 		chunks_.emplace_back(wire, offset, width);
 		width_ = chunks_.back().width;
 	} else {
@@ -3890,7 +4065,9 @@ RTLIL::SigSpec::SigSpec(RTLIL::State bit, int width)
 {
 	cover("kernel.rtlil.sigspec.init.state");
 
-	if (width != 0)
+	if (width == 1)
+		set_single(bit);
+	else if (width != 0)
 		chunks_.emplace_back(bit, width);
 	width_ = width;
 	hash_ = 0;
@@ -3901,7 +4078,9 @@ RTLIL::SigSpec::SigSpec(const RTLIL::SigBit &bit, int width)
 {
 	cover("kernel.rtlil.sigspec.init.bit");
 
-	if (width != 0) {
+	if (width == 1)
+		set_single(bit);
+	else if (width != 0) {
 		if (bit.wire == NULL)
 			chunks_.emplace_back(bit.data, width);
 		else
@@ -3971,6 +4150,11 @@ void RTLIL::SigSpec::pack() const
 {
 	RTLIL::SigSpec *that = (RTLIL::SigSpec*)this;
 
+	if (single()) {
+		that->chunks_.emplace_back(that->unset_single());
+		return;
+	}
+
 	if (that->bits_.empty())
 		return;
 
@@ -4007,6 +4191,13 @@ void RTLIL::SigSpec::unpack() const
 {
 	RTLIL::SigSpec *that = (RTLIL::SigSpec*)this;
 
+	if (single()) {
+		RTLIL::SigBit bit = that->unset_single();
+		that->bits_.push_back(bit);
+		that->hash_ = 0;
+		return;
+	}
+
 	if (that->chunks_.empty())
 		return;
 
@@ -4030,6 +4221,18 @@ void RTLIL::SigSpec::updhash() const
 		return;
 
 	cover("kernel.rtlil.sigspec.hash");
+
+	// same value as for the packed chunk of a single bit, without packing
+	if (single()) {
+		if (single_.wire == NULL)
+			that->hash_ = mkhash(mkhash_init, single_.data);
+		else
+			that->hash_ = mkhash(mkhash(mkhash(mkhash_init, single_.wire->name.index_), single_.offset), 1);
+		if (that->hash_ == 0)
+			that->hash_ = 1;
+		return;
+	}
+
 	that->pack();
 
 	that->hash_ = mkhash_init;
@@ -4374,7 +4577,17 @@ void RTLIL::SigSpec::replace(int offset, const RTLIL::SigSpec &with)
 
 void RTLIL::SigSpec::remove_const()
 {
-	if (packed())
+	if (single())
+	{
+		cover("kernel.rtlil.sigspec.remove_const.single");
+
+		if (single_.wire == NULL) {
+			unset_single();
+			width_ = 0;
+			hash_ = 0;
+		}
+	}
+	else if (packed())
 	{
 		cover("kernel.rtlil.sigspec.remove_const.packed");
 
@@ -4435,6 +4648,8 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(int offset, int length) const
 	log_assert(offset >= 0);
 	log_assert(length >= 0);
 	log_assert(offset + length <= width_);
+	if (length == 1 && single())
+		return *this;
 	unpack();
 	cover("kernel.rtlil.sigspec.extract_pos");
 	return std::vector<RTLIL::SigBit>(bits_.begin() + offset, bits_.begin() + offset + length);
@@ -4450,8 +4665,16 @@ void RTLIL::SigSpec::append(const RTLIL::SigSpec &signal)
 		return;
 	}
 
+	if (signal.single()) {
+		append(signal.single_);
+		return;
+	}
+
 	cover("kernel.rtlil.sigspec.append");
 
+	if (single())
+		pack();
+
 	if (packed() != signal.packed()) {
 		pack();
 		signal.pack();
@@ -4476,11 +4699,26 @@ void RTLIL::SigSpec::append(const RTLIL::SigSpec &signal)
 		bits_.insert(bits_.end(), signal.bits_.begin(), signal.bits_.end());
 
 	width_ += signal.width_;
+	hash_ = 0;
 	check();
 }
 
 void RTLIL::SigSpec::append(const RTLIL::SigBit &bit)
 {
+	if (width_ == 0 && chunks_.empty() && packed())
+	{
+		cover("kernel.rtlil.sigspec.append_bit.single");
+
+		set_single(bit);
+		width_ = 1;
+		hash_ = 0;
+		check();
+		return;
+	}
+
+	if (single())
+		pack();
+
 	if (packed())
 	{
 		cover("kernel.rtlil.sigspec.append_bit.packed");
@@ -4507,6 +4745,7 @@ void RTLIL::SigSpec::append(const RTLIL::SigBit &bit)
 	}
 
 	width_++;
+	hash_ = 0;
 	check();
 }
 
@@ -4546,6 +4785,17 @@ void RTLIL::SigSpec::check(Module *mod) const
 	{
 		cover("kernel.rtlil.sigspec.check.skip");
 	}
+	else if (single())
+	{
+		cover("kernel.rtlil.sigspec.check.single");
+
+		if (single_.wire != NULL) {
+			log_assert(single_.offset >= 0);
+			log_assert(single_.offset < single_.wire->width);
+			if (mod != nullptr)
+				log_assert(single_.wire->module == mod);
+		}
+	}
 	else if (packed())
 	{
 		cover("kernel.rtlil.sigspec.check.packed");
@@ -4600,6 +4850,20 @@ bool RTLIL::SigSpec::operator <(const RTLIL::SigSpec &other) const
 	if (width_ != other.width_)
 		return width_ < other.width_;
 
+	if (width_ == 1) {
+		updhash();
+		other.updhash();
+		if (hash_ != other.hash_)
+			return hash_ < other.hash_;
+		RTLIL::SigBit bit = first_bit(), other_bit = other.first_bit();
+		if (bit != other_bit) {
+			cover("kernel.rtlil.sigspec.comp_lt.hash_collision");
+			return RTLIL::SigChunk(bit) < RTLIL::SigChunk(other_bit);
+		}
+		cover("kernel.rtlil.sigspec.comp_lt.equal");
+		return false;
+	}
+
 	pack();
 	other.pack();
 
@@ -4638,6 +4902,9 @@ bool RTLIL::SigSpec::operator ==(const RTLIL::SigSpec &other) const
 	if (width_ == 0)
 		return true;
 
+	if (width_ == 1)
+		return first_bit() == other.first_bit();
+
 	pack();
 	other.pack();
 
@@ -4664,6 +4931,9 @@ bool RTLIL::SigSpec::is_wire() const
 {
 	cover("kernel.rtlil.sigspec.is_wire");
 
+	if (single())
+		return single_.wire != NULL && single_.wire->width == 1;
+
 	pack();
 	return GetSize(chunks_) == 1 && chunks_[0].wire && chunks_[0].wire->width == width_;
 }
@@ -4672,6 +4942,9 @@ bool RTLIL::SigSpec::is_chunk() const
 {
 	cover("kernel.rtlil.sigspec.is_chunk");
 
+	if (single())
+		return true;
+
 	pack();
 	return GetSize(chunks_) == 1;
 }
@@ -4680,6 +4953,9 @@ bool RTLIL::SigSpec::is_fully_const() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_const");
 
+	if (single())
+		return single_.wire == NULL;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
 		if (it->width > 0 && it->wire != NULL)
@@ -4691,6 +4967,9 @@ bool RTLIL::SigSpec::is_fully_zero() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_zero");
 
+	if (single())
+		return single_ == RTLIL::State::S0;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
 		if (it->width > 0 && it->wire != NULL)
@@ -4706,6 +4985,9 @@ bool RTLIL::SigSpec::is_fully_ones() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_ones");
 
+	if (single())
+		return single_ == RTLIL::State::S1;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
 		if (it->width > 0 && it->wire != NULL)
@@ -4721,6 +5003,9 @@ bool RTLIL::SigSpec::is_fully_def() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_def");
 
+	if (single())
+		return single_ == RTLIL::State::S0 || single_ == RTLIL::State::S1;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
 		if (it->width > 0 && it->wire != NULL)
@@ -4736,6 +5021,9 @@ bool RTLIL::SigSpec::is_fully_undef() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_undef");
 
+	if (single())
+		return single_ == RTLIL::State::Sx || single_ == RTLIL::State::Sz;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
 		if (it->width > 0 && it->wire != NULL)
@@ -4751,6 +5039,9 @@ bool RTLIL::SigSpec::has_const() const
 {
 	cover("kernel.rtlil.sigspec.has_const");
 
+	if (single())
+		return single_.wire == NULL;
+
 	pack();
 	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
 		if (it->width > 0 && it->wire == NULL)
@@ -4858,10 +5149,7 @@ RTLIL::SigBit RTLIL::SigSpec::as_bit() const
 	cover("kernel.rtlil.sigspec.as_bit");
 
 	log_assert(width_ == 1);
-	if (packed())
-		return RTLIL::SigBit(*chunks_.begin());
-	else
-		return bits_[0];
+	return first_bit();
 }
 
 bool RTLIL::SigSpec::match(const char* pattern) const
@@ -5096,7 +5384,7 @@ bool RTLIL::SigSpec::parse_rhs(const RTLIL::SigSpec &lhs, RTLIL::SigSpec &sig, R
 		return true;
 	}
 
-	if (lhs.chunks_.size() == 1) {
+	if (lhs.chunks_.size() == 1 || lhs.single()) {
 		char *p = (char*)str.c_str(), *endptr;
 		long int val = strtol(p, &endptr, 10);
 		if (endptr && endptr != p && *endptr == 0) {
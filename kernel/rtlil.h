@@ -85,6 +85,13 @@ namespace RTLIL
 		#undef YOSYS_NO_IDS_REFCNT
 
 		// the global id string cache
+		//
+		// Strings and refcounts are kept in fixed size pages that never move once
+		// allocated, so c_str() and the refcount of a live IdString can be accessed
+		// while other threads intern new strings. The name->index lookup is split
+		// into shards. While yosys_threads_active is set, each shard is protected
+		// by its own mutex and refcounts are updated atomically. Otherwise the
+		// table is accessed without any synchronization.
 
 		static bool destruct_guard_ok; // POD, will be initialized to zero
 		static struct destruct_guard_t {
@@ -92,27 +99,103 @@ namespace RTLIL
 			~destruct_guard_t() { destruct_guard_ok = false; }
 		} destruct_guard;
 
-		static std::vector<char*> global_id_storage_;
-		static dict<char*, int, hash_cstr_ops> global_id_index_;
+	#ifdef YOSYS_ENABLE_THREADS
+		typedef std::atomic<int> refcount_t;
+	#else
+		typedef int refcount_t;
+	#endif
+
+		static constexpr int page_bits = 14;
+		static constexpr int page_size = 1 << page_bits;
+		static constexpr int max_pages = 0x40000000 >> page_bits;
+		static constexpr int shard_count = 64;
+
+		struct page_t {
+			char *storage[page_size];
+		#ifndef YOSYS_NO_IDS_REFCNT
+			refcount_t refcount[page_size];
+		#endif
+		};
+
+		// the string hash is computed once per lookup and stored alongside the
+		// key, it selects the shard and is reused by the shard's dict
+		struct key_t {
+			const char *str;
+			unsigned int hash;
+			key_t(const char *str) : str(str), hash(hash_cstr_ops::hash(str)) { }
+			key_t(const char *str, unsigned int hash) : str(str), hash(hash) { }
+		};
+
+		struct key_ops_t {
+			static inline bool cmp(const key_t &a, const key_t &b) {
+				return a.hash == b.hash && strcmp(a.str, b.str) == 0;
+			}
+			static inline unsigned int hash(const key_t &a) {
+				return a.hash;
+			}
+		};
+
+		struct shard_t {
+			dict<key_t, int, key_ops_t> index;
+		#ifdef YOSYS_ENABLE_THREADS
+			std::mutex mutex;
+		#endif
+		};
+
+		static page_t *global_id_pages_[max_pages];
+		static int global_id_size_;
+		static shard_t global_id_shards_[shard_count];
 	#ifndef YOSYS_NO_IDS_REFCNT
-		static std::vector<int> global_refcount_storage_;
 		static std::vector<int> global_free_idx_list_;
 	#endif
+	#ifdef YOSYS_ENABLE_THREADS
+		static std::mutex global_alloc_mutex_;
+	#endif
 
 	#ifdef YOSYS_USE_STICKY_IDS
 		static int last_created_idx_ptr_;
 		static int last_created_idx_[8];
 	#endif
 
+		static inline char *&global_id_storage(int idx) {
+			return global_id_pages_[idx >> page_bits]->storage[idx & (page_size - 1)];
+		}
+
+	#ifndef YOSYS_NO_IDS_REFCNT
+		static inline refcount_t &global_refcount(int idx) {
+			return global_id_pages_[idx >> page_bits]->refcount[idx & (page_size - 1)];
+		}
+
+		static inline int refcount_value(int idx) {
+			return global_refcount(idx);
+		}
+
+		static inline void refcount_inc(int idx) {
+		#ifdef YOSYS_ENABLE_THREADS
+			refcount_t &refcount = global_refcount(idx);
+			if (yosys_threads_active)
+				refcount.fetch_add(1, std::memory_order_relaxed);
+			else
+				refcount.store(refcount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		#else
+			global_refcount(idx)++;
+		#endif
+		}
+	#endif
+
+		static inline shard_t &global_id_shard(unsigned int hash) {
+			return global_id_shards_[hash % shard_count];
+		}
+
 		static inline void xtrace_db_dump()
 		{
 		#ifdef YOSYS_XTRACE_GET_PUT
-			for (int idx = 0; idx < GetSize(global_id_storage_); idx++)
+			for (int idx = 0; idx < global_id_size_; idx++)
 			{
-				if (global_id_storage_.at(idx) == nullptr)
+				if (global_id_storage(idx) == nullptr)
 					log("#X# DB-DUMP index %d: FREE\n", idx);
 				else
-					log("#X# DB-DUMP index %d: '%s' (ref %d)\n", idx, global_id_storage_.at(idx), global_refcount_storage_.at(idx));
+					log("#X# DB-DUMP index %d: '%s' (ref %d)\n", idx, global_id_storage(idx), refcount_value(idx));
 			}
 		#endif
 		}
@@ -136,16 +219,47 @@ namespace RTLIL
 		{
 			if (idx) {
 		#ifndef YOSYS_NO_IDS_REFCNT
-				global_refcount_storage_[idx]++;
+				refcount_inc(idx);
 		#endif
 		#ifdef YOSYS_XTRACE_GET_PUT
 				if (yosys_xtrace)
-					log("#X# GET-BY-INDEX '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+					log("#X# GET-BY-INDEX '%s' (index %d, refcount %d)\n", global_id_storage(idx), idx, refcount_value(idx));
 		#endif
 			}
 			return idx;
 		}
 
+		// allocates a new index for a string, the caller must hold the lock of the
+		// shard the string belongs to
+		static int alloc_index()
+		{
+		#ifdef YOSYS_ENABLE_THREADS
+			std::unique_lock<std::mutex> lock(global_alloc_mutex_, std::defer_lock);
+			if (yosys_threads_active)
+				lock.lock();
+		#endif
+
+			if (global_id_size_ == 0) {
+				global_id_pages_[0] = new page_t();
+				global_id_storage(0) = (char*)"";
+				global_id_size_ = 1;
+			}
+
+		#ifndef YOSYS_NO_IDS_REFCNT
+			if (!global_free_idx_list_.empty()) {
+				int idx = global_free_idx_list_.back();
+				global_free_idx_list_.pop_back();
+				return idx;
+			}
+		#endif
+
+			log_assert(global_id_size_ < 0x40000000);
+			int idx = global_id_size_++;
+			if (global_id_pages_[idx >> page_bits] == nullptr)
+				global_id_pages_[idx >> page_bits] = new page_t();
+			return idx;
+		}
+
 		static int get_reference(const char *p)
 		{
 			log_assert(destruct_guard_ok);
@@ -153,61 +267,53 @@ namespace RTLIL
 			if (!p[0])
 				return 0;
 
-			auto it = global_id_index_.find((char*)p);
-			if (it != global_id_index_.end()) {
+			key_t key(p);
+			shard_t &shard = global_id_shard(key.hash);
+			int idx;
+
+			{
+		#ifdef YOSYS_ENABLE_THREADS
+				std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+				if (yosys_threads_active)
+					lock.lock();
+		#endif
+
+				auto it = shard.index.find(key);
+				if (it != shard.index.end()) {
 		#ifndef YOSYS_NO_IDS_REFCNT
-				global_refcount_storage_.at(it->second)++;
+					refcount_inc(it->second);
 		#endif
 		#ifdef YOSYS_XTRACE_GET_PUT
-				if (yosys_xtrace)
-					log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(it->second), it->second, global_refcount_storage_.at(it->second));
+					if (yosys_xtrace)
+						log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage(it->second), it->second, refcount_value(it->second));
 		#endif
-				return it->second;
-			}
+					return it->second;
+				}
 
-			log_assert(p[0] == '$' || p[0] == '\\');
-			log_assert(p[1] != 0);
-			for (const char *c = p; *c; c++)
-				if ((unsigned)*c <= (unsigned)' ')
-					log_error("Found control character or space (0x%02x) in string '%s' which is not allowed in RTLIL identifiers\n", *c, p);
+				log_assert(p[0] == '$' || p[0] == '\\');
+				log_assert(p[1] != 0);
+				for (const char *c = p; *c; c++)
+					if ((unsigned)*c <= (unsigned)' ')
+						log_error("Found control character or space (0x%02x) in string '%s' which is not allowed in RTLIL identifiers\n", *c, p);
 
+				idx = alloc_index();
+				char *str = strdup(p);
+				global_id_storage(idx) = str;
+				shard.index[key_t(str, key.hash)] = idx;
 		#ifndef YOSYS_NO_IDS_REFCNT
-			if (global_free_idx_list_.empty()) {
-				if (global_id_storage_.empty()) {
-					global_refcount_storage_.push_back(0);
-					global_id_storage_.push_back((char*)"");
-					global_id_index_[global_id_storage_.back()] = 0;
-				}
-				log_assert(global_id_storage_.size() < 0x40000000);
-				global_free_idx_list_.push_back(global_id_storage_.size());
-				global_id_storage_.push_back(nullptr);
-				global_refcount_storage_.push_back(0);
-			}
-
-			int idx = global_free_idx_list_.back();
-			global_free_idx_list_.pop_back();
-			global_id_storage_.at(idx) = strdup(p);
-			global_id_index_[global_id_storage_.at(idx)] = idx;
-			global_refcount_storage_.at(idx)++;
-		#else
-			if (global_id_storage_.empty()) {
-				global_id_storage_.push_back((char*)"");
-				global_id_index_[global_id_storage_.back()] = 0;
-			}
-			int idx = global_id_storage_.size();
-			global_id_storage_.push_back(strdup(p));
-			global_id_index_[global_id_storage_.back()] = idx;
+				global_refcount(idx) = 1;
 		#endif
 
-			if (yosys_xtrace) {
-				log("#X# New IdString '%s' with index %d.\n", p, idx);
-				log_backtrace("-X- ", yosys_xtrace-1);
-			}
+				if (yosys_xtrace) {
+					log("#X# New IdString '%s' with index %d.\n", p, idx);
+					log_backtrace("-X- ", yosys_xtrace-1);
+				}
 
 		#ifdef YOSYS_XTRACE_GET_PUT
-			if (yosys_xtrace)
-				log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+				if (yosys_xtrace)
+					log("#X# GET-BY-NAME '%s' (index %d, refcount %d)\n", global_id_storage(idx), idx, refcount_value(idx));
 		#endif
+			}
 
 		#ifdef YOSYS_USE_STICKY_IDS
 			// Avoid Create->Delete->Create pattern
@@ -225,34 +331,62 @@ namespace RTLIL
 		static inline void put_reference(int idx)
 		{
 			// put_reference() may be called from destructors after the destructor of
-			// global_refcount_storage_ has been run. in this case we simply do nothing.
+			// global_id_shards_ has been run. in this case we simply do nothing.
 			if (!destruct_guard_ok || !idx)
 				return;
 
 		#ifdef YOSYS_XTRACE_GET_PUT
 			if (yosys_xtrace) {
-				log("#X# PUT '%s' (index %d, refcount %d)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
+				log("#X# PUT '%s' (index %d, refcount %d)\n", global_id_storage(idx), idx, refcount_value(idx));
 			}
 		#endif
 
-			int &refcount = global_refcount_storage_[idx];
+		#ifdef YOSYS_ENABLE_THREADS
+			if (yosys_threads_active) {
+				put_reference_concurrent(idx);
+				return;
+			}
+
+			refcount_t &refcount = global_refcount(idx);
+			int value = refcount.load(std::memory_order_relaxed) - 1;
+			refcount.store(value, std::memory_order_relaxed);
+
+			if (value > 0)
+				return;
+
+			log_assert(value == 0);
+		#else
+			int &refcount = global_refcount(idx);
 
 			if (--refcount > 0)
 				return;
 
 			log_assert(refcount == 0);
+		#endif
 			free_reference(idx);
 		}
+	#ifdef YOSYS_ENABLE_THREADS
+		static void put_reference_concurrent(int idx);
+	#endif
+		// the caller must hold the lock of the shard the string belongs to
 		static inline void free_reference(int idx)
 		{
 			if (yosys_xtrace) {
-				log("#X# Removed IdString '%s' with index %d.\n", global_id_storage_.at(idx), idx);
+				log("#X# Removed IdString '%s' with index %d.\n", global_id_storage(idx), idx);
 				log_backtrace("-X- ", yosys_xtrace-1);
 			}
 
-			global_id_index_.erase(global_id_storage_.at(idx));
-			free(global_id_storage_.at(idx));
-			global_id_storage_.at(idx) = nullptr;
+			char *str = global_id_storage(idx);
+			key_t key(str);
+			global_id_shard(key.hash).index.erase(key);
+			global_id_storage(idx) = nullptr;
+			free(str);
+
+		#ifdef YOSYS_ENABLE_THREADS
+			std::unique_lock<std::mutex> lock(global_alloc_mutex_, std::defer_lock);
+			if (yosys_threads_active)
+				lock.lock();
+		#endif
 			global_free_idx_list_.push_back(idx);
 		}
 	#else
@@ -286,11 +420,11 @@ namespace RTLIL
 		}
 
 		inline const char *c_str() const {
-			return global_id_storage_.at(index_);
+			return global_id_storage(index_);
 		}
 
 		inline std::string str() const {
-			return std::string(global_id_storage_.at(index_));
+			return std::string(global_id_storage(index_));
 		}
 
 		inline bool operator<(const IdString &rhs) const {
@@ -842,29 +976,106 @@ struct RTLIL::SigSpec
 {
 private:
 	int width_;
-	unsigned long hash_;
+	unsigned int hash_;
 	std::vector<RTLIL::SigChunk> chunks_; // LSB at index 0
-	std::vector<RTLIL::SigBit> bits_; // LSB at index 0
+
+	// A single bit is kept in single_ instead of in chunks_ or bits_, so
+	// that the many one-bit signals of a netlist need no heap allocation.
+	// single_ shares its storage with bits_ and is_single_ tells which of
+	// the two is in use. pack() and unpack() switch back to the vectors when
+	// they are asked for.
+	union {
+		std::vector<RTLIL::SigBit> bits_ = {}; // LSB at index 0
+		RTLIL::SigBit single_;
+	};
+	bool is_single_ = false;
 
 	void pack() const;
 	void unpack() const;
 	void updhash() const;
 
+	inline bool single() const {
+		return is_single_;
+	}
+
 	inline bool packed() const {
-		return bits_.empty();
+		return is_single_ || bits_.empty();
+	}
+
+	inline void set_single(const RTLIL::SigBit &bit) {
+		if (!is_single_) {
+			bits_.~vector();
+			new (&single_) RTLIL::SigBit(bit);
+			is_single_ = true;
+		} else
+			single_ = bit;
+	}
+
+	inline RTLIL::SigBit unset_single() {
+		RTLIL::SigBit bit = single_;
+		new (&bits_) std::vector<RTLIL::SigBit>();
+		is_single_ = false;
+		return bit;
 	}
 
 	inline void inline_unpack() const {
-		if (!chunks_.empty())
+		if (!chunks_.empty() || single())
 			unpack();
 	}
 
+	inline RTLIL::SigBit first_bit() const {
+		return single() ? single_ : bits_.empty() ? RTLIL::SigBit(chunks_.front(), 0) : bits_.front();
+	}
+
 	// Only used by Module::remove(const pool<Wire*> &wires)
 	// but cannot be more specific as it isn't yet declared
 	friend struct RTLIL::Module;
 
 public:
 	SigSpec() : width_(0), hash_(0) {}
+	SigSpec(const RTLIL::SigSpec &other) : width_(other.width_), hash_(other.hash_), chunks_(other.chunks_) {
+		if (other.is_single_)
+			set_single(other.single_);
+		else
+			bits_ = other.bits_;
+	}
+	SigSpec(RTLIL::SigSpec &&other) : width_(other.width_), hash_(other.hash_), chunks_(std::move(other.chunks_)) {
+		if (other.is_single_)
+			set_single(other.single_);
+		else
+			bits_ = std::move(other.bits_);
+	}
+	~SigSpec() {
+		if (!is_single_)
+			bits_.~vector();
+	}
+
+	RTLIL::SigSpec &operator =(const RTLIL::SigSpec &other) {
+		width_ = other.width_;
+		hash_ = other.hash_;
+		chunks_ = other.chunks_;
+		if (other.is_single_)
+			set_single(other.single_);
+		else {
+			if (is_single_)
+				unset_single();
+			bits_ = other.bits_;
+		}
+		return *this;
+	}
+	RTLIL::SigSpec &operator =(RTLIL::SigSpec &&other) {
+		width_ = other.width_;
+		hash_ = other.hash_;
+		chunks_ = std::move(other.chunks_);
+		if (other.is_single_)
+			set_single(other.single_);
+		else {
+			if (is_single_)
+				unset_single();
+			bits_ = std::move(other.bits_);
+		}
+		return *this;
+	}
 	SigSpec(std::initializer_list<RTLIL::SigSpec> parts);
 
 	SigSpec(const RTLIL::Const &value);
@@ -894,8 +1105,14 @@ public:
 	inline int size() const { return width_; }
 	inline bool empty() const { return width_ == 0; }
 
-	inline RTLIL::SigBit &operator[](int index) { inline_unpack(); return bits_.at(index); }
-	inline const RTLIL::SigBit &operator[](int index) const { inline_unpack(); return bits_.at(index); }
+	inline RTLIL::SigBit &operator[](int index) {
+		if (index == 0 && single()) { hash_ = 0; return single_; }
+		inline_unpack(); return bits_.at(index);
+	}
+	inline const RTLIL::SigBit &operator[](int index) const {
+		if (index == 0 && single()) return single_;
+		inline_unpack(); return bits_.at(index);
+	}
 
 	inline RTLIL::SigSpecIterator begin() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = 0; return it; }
 	inline RTLIL::SigSpecIterator end() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = width_; return it; }
@@ -951,7 +1168,7 @@ public:
 
 	RTLIL::SigSpec repeat(int num) const;
 
-	void reverse() { inline_unpack(); std::reverse(bits_.begin(), bits_.end()); }
+	void reverse() { if (single()) return; inline_unpack(); std::reverse(bits_.begin(), bits_.end()); }
 
 	bool operator <(const RTLIL::SigSpec &other) const;
 	bool operator ==(const RTLIL::SigSpec &other) const;
@@ -1038,11 +1255,7 @@ struct RTLIL::Monitor
 	unsigned int hashidx_;
 	unsigned int hash() const { return hashidx_; }
 
-	Monitor() {
-		static unsigned int hashidx_count = 123456789;
-		hashidx_count = mkhash_xorshift(hashidx_count);
-		hashidx_ = hashidx_count;
-	}
+	Monitor();
 
 	virtual ~Monitor() { }
 	virtual void notify_module_add(RTLIL::Module*) { }
@@ -1078,9 +1291,17 @@ struct RTLIL::Design
 	Design();
 	~Design();
 
+	// Modules read with "read_rtlil -lazy" are only decoded when they are
+	// returned by module() or one of the selected_*modules*() functions.
+	// Until then modules_ holds a stub with the name, the attributes and the
+	// port wires of the module. modules() decodes all modules. Decoding is
+	// guarded by a lock, so module() can also be called from the workers of
+	// module-local passes. module_stubs() never decodes a module and returns
+	// the stubs of the modules that were not accessed yet.
 	RTLIL::ObjRange<RTLIL::Module*> modules();
 	RTLIL::Module *module(const RTLIL::IdString &name);
 	const RTLIL::Module *module(const RTLIL::IdString &name) const;
+	std::vector<const RTLIL::Module*> module_stubs() const;
 	RTLIL::Module *top_module();
 
 	bool has(const RTLIL::IdString &id) const {
@@ -1108,6 +1329,10 @@ struct RTLIL::Design
 	void check();
 	void optimize();
 
+	// makes the wires and cells removed since the last call available for
+	// reuse, must not be called while a pass may still hold pointers to them
+	void recycle_objects();
+
 	bool selected_module(const RTLIL::IdString &mod_name) const;
 	bool selected_whole_module(const RTLIL::IdString &mod_name) const;
 	bool selected_member(const RTLIL::IdString &mod_name, const RTLIL::IdString &memb_name) const;
@@ -1158,20 +1383,62 @@ struct RTLIL::Design
 #endif
 };
 
+// A slab allocator for objects of a fixed size. RTLIL::Module uses one for its
+// wires and one for its cells, so that creating and removing them does not call
+// malloc()/free() for every object, and all slabs are released at once when the
+// module is destroyed.
+//
+// Passes often keep Wire* and Cell* pointers in containers while they remove
+// and create objects, so the address of a removed object is not handed out
+// again right away. deallocate() only queues the object, and recycle() makes
+// the queued objects available to allocate(). Design::recycle_objects() calls
+// it between commands, see Pass::call().
+struct ObjectArena
+{
+	ObjectArena(size_t object_size);
+	~ObjectArena();
+
+	ObjectArena(const ObjectArena &other) = delete;
+	void operator=(const ObjectArena &other) = delete;
+
+	void *allocate();
+	void deallocate(void *ptr);
+	void recycle();
+
+private:
+	size_t object_size, slab_used, slab_capacity;
+	std::vector<char*> slabs;
+	void *free_list, *released_head, *released_tail;
+};
+
 struct RTLIL::Module : public RTLIL::AttrObject
 {
 	unsigned int hashidx_;
 	unsigned int hash() const { return hashidx_; }
 
 protected:
+	ObjectArena wire_arena_, cell_arena_;
+
 	void add(RTLIL::Wire *wire);
 	void add(RTLIL::Cell *cell);
 	void add(RTLIL::Process *process);
 
+	void destroy(RTLIL::Wire *wire);
+	void destroy(RTLIL::Cell *cell);
+
 public:
 	RTLIL::Design *design;
 	pool<RTLIL::Monitor*> monitors;
 
+	// the shared SigMap of the module, see ModSigMap in kernel/sigtools.h
+	std::unique_ptr<RTLIL::Monitor> sigmap_cache_;
+
+	// the encoded contents of a module read with "read_rtlil -lazy" that has
+	// not been accessed yet, see backends/rtlil/rtlil_binary.h; lazy_stub_ is
+	// set while the module is such a stub
+	std::string lazy_section_;
+	std::atomic<bool> lazy_stub_;
+
 	int refcount_wires_;
 	int refcount_cells_;
 
@@ -1198,6 +1465,7 @@ public:
 	virtual void sort();
 	virtual void check();
 	virtual void optimize();
+	void recycle_objects();
 	virtual void makeblackbox();
 
 	void connect(const RTLIL::SigSig &conn);
@@ -1205,6 +1473,12 @@ public:
 	void new_connections(const std::vector<RTLIL::SigSig> &new_conn);
 	const std::vector<RTLIL::SigSig> &connections() const;
 
+	// drops the shared SigMap of the module, must be called after modifying
+	// connections_ directly instead of with connect() or new_connections(), and
+	// after changing the name of a wire without rename() or swap_names(), as
+	// SigBits are hashed by the name of their wire
+	void connections_changed();
+
 	std::vector<RTLIL::IdString> ports;
 	void fixup_ports();
 
@@ -1732,6 +2006,7 @@ void RTLIL::Module::rewrite_sigspecs(T &functor)
 		functor(it.first);
 		functor(it.second);
 	}
+	connections_changed();
 }
 
 template<typename T>
@@ -1744,6 +2019,7 @@ void RTLIL::Module::rewrite_sigspecs2(T &functor)
 	for (auto &it : connections_) {
 		functor(it.first, it.second);
 	}
+	connections_changed();
 }
 
 template<typename T>
@@ -135,6 +135,12 @@ struct SigPool
 	}
 };
 
+// Maps SigBits to sets of values. The values of each bit are kept in a flat
+// vector. insert() appends to it, and the values that were appended out of
+// order are sorted by Compare and merged in when the bit is looked up the next
+// time, so iterating over the values of a bit visits them in the same order as
+// a std::set<T, Compare> would. Like with SigSpec, lookups may thus change the
+// internal representation, and a SigSet must not be used by several threads.
 template <typename T, class Compare = void>
 struct SigSet
 {
@@ -146,7 +152,43 @@ struct SigSet
 		unsigned int hash() const { return first->name.hash() + second; }
 	};
 
-	dict<bitDef_t, std::set<T, Compare>> bits;
+	struct values_t {
+		mutable std::vector<T> values;
+		// the values before this index are sorted and unique
+		mutable size_t sorted = 0;
+	};
+
+	dict<bitDef_t, values_t> bits;
+
+	static void insert_value(values_t &v, const T &data)
+	{
+		if (v.sorted == v.values.size() && (v.values.empty() || Compare()(v.values.back(), data)))
+			v.sorted++;
+		v.values.push_back(data);
+	}
+
+	static const std::vector<T> &sorted_values(const values_t &v)
+	{
+		if (v.sorted < v.values.size()) {
+			auto middle = v.values.begin() + v.sorted;
+			std::sort(middle, v.values.end(), Compare());
+			std::inplace_merge(v.values.begin(), middle, v.values.end(), Compare());
+			v.values.erase(std::unique(v.values.begin(), v.values.end(),
+					[](const T &a, const T &b) { return !Compare()(a, b); }), v.values.end());
+			v.sorted = v.values.size();
+		}
+		return v.values;
+	}
+
+	static void erase_value(values_t &v, const T &data)
+	{
+		sorted_values(v);
+		auto it = std::lower_bound(v.values.begin(), v.values.end(), data, Compare());
+		if (it != v.values.end() && !Compare()(data, *it)) {
+			v.values.erase(it);
+			v.sorted--;
+		}
+	}
 
 	void clear()
 	{
@@ -157,67 +199,92 @@ struct SigSet
 	{
 		for (const auto &bit : sig)
 			if (bit.wire != NULL)
-				bits[bit].insert(data);
+				insert_value(bits[bit], data);
 	}
 
 	void insert(const RTLIL::SigSpec& sig, const std::set<T> &data)
 	{
 		for (const auto &bit : sig)
-			if (bit.wire != NULL)
-				bits[bit].insert(data.begin(), data.end());
+			if (bit.wire != NULL) {
+				auto &values = bits[bit];
+				for (auto &it : data)
+					insert_value(values, it);
+			}
 	}
 
 	void erase(const RTLIL::SigSpec& sig)
 	{
 		for (const auto &bit : sig)
 			if (bit.wire != NULL)
-				bits[bit].clear();
+				bits.erase(bit);
 	}
 
 	void erase(const RTLIL::SigSpec &sig, T data)
 	{
 		for (const auto &bit : sig)
-			if (bit.wire != NULL)
-				bits[bit].erase(data);
+			if (bit.wire != NULL) {
+				auto it = bits.find(bit);
+				if (it != bits.end())
+					erase_value(it->second, data);
+			}
 	}
 
 	void erase(const RTLIL::SigSpec &sig, const std::set<T> &data)
 	{
 		for (const auto &bit : sig)
-			if (bit.wire != NULL)
-				bits[bit].erase(data.begin(), data.end());
+			if (bit.wire != NULL) {
+				auto it = bits.find(bit);
+				if (it != bits.end())
+					for (auto &it2 : data)
+						erase_value(it->second, it2);
+			}
 	}
 
-	void find(const RTLIL::SigSpec &sig, std::set<T> &result)
+	// returns a view of the values of a single bit that stays valid until the
+	// next insert() or erase(). This only matches SigBit arguments, so that
+	// e.g. a Wire* still converts to a SigSpec instead of being ambiguous.
+	template<typename B, typename = typename std::enable_if<std::is_same<B, RTLIL::SigBit>::value>::type>
+	const std::vector<T> &find(const B &bit) const
 	{
-		for (const auto &bit : sig)
-			if (bit.wire != NULL) {
-				auto &data = bits[bit];
-				result.insert(data.begin(), data.end());
-			}
+		static const std::vector<T> empty_values;
+		if (bit.wire == NULL)
+			return empty_values;
+		auto it = bits.find(bit);
+		return it == bits.end() ? empty_values : sorted_values(it->second);
 	}
 
-	void find(const RTLIL::SigSpec &sig, pool<T> &result)
+	void find(const RTLIL::SigSpec &sig, std::set<T> &result) const
 	{
-		for (const auto &bit : sig)
-			if (bit.wire != NULL) {
-				auto &data = bits[bit];
-				result.insert(data.begin(), data.end());
-			}
+		for (const auto &bit : sig) {
+			auto &values = find(bit);
+			result.insert(values.begin(), values.end());
+		}
 	}
 
-	std::set<T> find(const RTLIL::SigSpec &sig)
+	void find(const RTLIL::SigSpec &sig, pool<T> &result) const
+	{
+		for (const auto &bit : sig) {
+			auto &values = find(bit);
+			result.insert(values.begin(), values.end());
+		}
+	}
+
+	std::set<T> find(const RTLIL::SigSpec &sig) const
 	{
 		std::set<T> result;
 		find(sig, result);
 		return result;
 	}
 
-	bool has(const RTLIL::SigSpec &sig)
+	bool has(const RTLIL::SigSpec &sig) const
 	{
-		for (auto &bit : sig)
-			if (bit.wire != NULL && bits.count(bit))
+		for (auto &bit : sig) {
+			if (bit.wire == NULL)
+				continue;
+			auto it = bits.find(bit);
+			if (it != bits.end() && !it->second.values.empty())
 				return true;
+		}
 		return false;
 	}
 };
@@ -249,7 +316,11 @@ struct SigMap
 		database.clear();
 	}
 
-	void set(RTLIL::Module *module)
+	// uses the shared ModSigMap of the module (see below)
+	void set(RTLIL::Module *module);
+
+	// builds the map from the connections of the module
+	void build(RTLIL::Module *module)
 	{
 		int bitcount = 0;
 		for (auto &it : module->connections())
@@ -342,6 +413,109 @@ struct SigMap
 	}
 };
 
+// A SigMap for the connections of a module that is attached to the module as a
+// monitor and shared by all SigMap::set() calls for that module, so consecutive
+// passes do not have to rebuild it. Connections added with Module::connect() or
+// appended with Module::new_connections() are merged in as they are made. Any
+// other change made with new_connections() makes the next query rebuild the
+// map, and code that modifies Module::connections_ directly drops the map with
+// Module::connections_changed(). The map is also dropped when a wire is renamed,
+// because its hash tables are keyed by the wire names.
+struct ModSigMap : public RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	int num_connections;
+	bool valid;
+
+	ModSigMap(RTLIL::Module *module) : module(module), num_connections(0), valid(false)
+	{
+		module->monitors.insert(this);
+	}
+
+	~ModSigMap()
+	{
+		module->monitors.erase(this);
+	}
+
+	void add_connection(const RTLIL::SigSig &conn)
+	{
+		sigmap.add(conn.first, conn.second);
+		num_connections++;
+	}
+
+	void invalidate()
+	{
+		sigmap.clear();
+		valid = false;
+	}
+
+	const SigMap &update()
+	{
+		// the number of connections only catches a missing call to
+		// Module::connections_changed() after connections_ was resized
+		if (!valid || GetSize(module->connections()) != num_connections)
+		{
+			sigmap.build(module);
+			num_connections = GetSize(module->connections());
+			valid = true;
+		}
+		return sigmap;
+	}
+
+	// returns the up to date shared SigMap of the module
+	static const SigMap &get(RTLIL::Module *module)
+	{
+		if (module->sigmap_cache_ == nullptr)
+			module->sigmap_cache_.reset(new ModSigMap(module));
+		return static_cast<ModSigMap*>(module->sigmap_cache_.get())->update();
+	}
+
+	void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig &conn) override
+	{
+		log_assert(module == mod);
+
+		// Module::connect() calls itself again without the constant lhs bits
+		if (valid && !conn.first.has_const())
+			add_connection(conn);
+	}
+
+	void notify_connect(RTLIL::Module *mod, const std::vector<RTLIL::SigSig> &new_conn) override
+	{
+		log_assert(module == mod);
+
+		if (!valid)
+			return;
+
+		// this is called before the connections are replaced, so the map can
+		// be kept if the old connections are a prefix of the new ones
+		const std::vector<RTLIL::SigSig> &old_conn = module->connections();
+		bool is_prefix = num_connections == GetSize(old_conn) && GetSize(new_conn) >= GetSize(old_conn);
+		for (int i = 0; is_prefix && i < GetSize(old_conn); i++)
+			if (new_conn[i] != old_conn[i])
+				is_prefix = false;
+
+		if (!is_prefix) {
+			invalidate();
+			return;
+		}
+
+		for (int i = GetSize(old_conn); i < GetSize(new_conn); i++)
+			add_connection(new_conn[i]);
+	}
+
+	void notify_blackout(RTLIL::Module *mod) override
+	{
+		log_assert(module == mod);
+		invalidate();
+	}
+};
+
+inline void SigMap::set(RTLIL::Module *module)
+{
+	*this = ModSigMap::get(module);
+}
+
 YOSYS_NAMESPACE_END
 
 #endif /* SIGTOOLS_H */
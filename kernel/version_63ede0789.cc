@@ -0,0 +1 @@
+namespace Yosys { extern const char *yosys_version_str; const char *yosys_version_str="Yosys 0.40+25 (git sha1 63ede0789, g++ 12.2.0-14+deb12u1 -fPIC -Os)"; }
@@ -51,6 +51,12 @@
 #  endif
 #endif
 
+#if !defined(_WIN32) && !defined(__wasm)
+#  define YOSYS_MMAP_INPUT
+#  include <sys/mman.h>
+#  include <fcntl.h>
+#endif
+
 #if !defined(_WIN32) && defined(YOSYS_ENABLE_GLOB)
 #  include <glob.h>
 #endif
@@ -73,12 +79,24 @@
 #include <limits.h>
 #include <errno.h>
 
+#ifdef YOSYS_ENABLE_THREADS
+#  include <thread>
+#endif
+
 #include "libs/json11/json11.hpp"
 
 YOSYS_NAMESPACE_BEGIN
 
+#ifdef YOSYS_ENABLE_THREADS
+thread_local int autoidx = 1;
+#else
 int autoidx = 1;
+#endif
 int yosys_xtrace = 0;
+int yosys_threads = 1;
+#ifdef YOSYS_ENABLE_THREADS
+bool yosys_threads_active = false;
+#endif
 RTLIL::Design *yosys_design = NULL;
 CellTypes yosys_celltypes;
 
@@ -451,6 +469,62 @@ bool check_file_exists(std::string filename, bool is_exec)
 }
 #endif
 
+FileContents::~FileContents()
+{
+#ifdef YOSYS_MMAP_INPUT
+	if (mapped_)
+		munmap((void*)data_, size_);
+#endif
+}
+
+bool FileContents::map(const std::string &filename)
+{
+	log_assert(data_ == nullptr);
+#ifndef YOSYS_MMAP_INPUT
+	std::ifstream f(filename, std::ios::binary);
+	if (f.fail())
+		return false;
+	read(f);
+	return true;
+#else
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	if (st.st_size == 0) {
+		close(fd);
+		return true;
+	}
+
+	void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+#ifdef MADV_SEQUENTIAL
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+	data_ = (const char*)data;
+	size_ = st.st_size;
+	mapped_ = true;
+	return true;
+#endif
+}
+
+void FileContents::read(std::istream &f)
+{
+	log_assert(data_ == nullptr);
+	buffer_.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	data_ = buffer_.data();
+	size_ = buffer_.size();
+}
+
 bool is_absolute_path(std::string filename)
 {
 #ifdef _WIN32
@@ -654,6 +728,80 @@ RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std:
 	return stringf("$auto$%s:%d:%s$%s$%d", file.c_str(), line, func.c_str(), suffix.c_str(), autoidx++);
 }
 
+void yosys_parallel_for(int count, const std::function<void(int)> &task, bool allow_threads)
+{
+	// every task starts numbering new objects at the current autoidx, also
+	// when the tasks run one after another, so that the names of the objects
+	// don't depend on the number of threads. Afterwards autoidx continues
+	// after the highest index used by any task.
+	int base_autoidx = autoidx, max_autoidx = autoidx;
+
+#ifdef YOSYS_ENABLE_THREADS
+	int num_threads = allow_threads ? std::min(yosys_threads, count) : 1;
+
+	if (num_threads > 1 && !yosys_threads_active)
+	{
+		std::vector<std::exception_ptr> exceptions(count);
+		std::atomic<int> next_task(0);
+		std::mutex mutex;
+
+		auto run_tasks = [&]() {
+			int saved_autoidx = autoidx;
+			while (1) {
+				int i = next_task.fetch_add(1);
+				if (i >= count)
+					break;
+				autoidx = base_autoidx;
+				try {
+					task(i);
+				} catch (...) {
+					exceptions[i] = std::current_exception();
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				max_autoidx = std::max(max_autoidx, autoidx);
+			}
+			autoidx = saved_autoidx;
+		};
+
+		yosys_threads_active = true;
+
+		std::vector<std::thread> threads;
+		for (int i = 1; i < num_threads; i++) {
+			try {
+				threads.emplace_back(run_tasks);
+			} catch (std::system_error&) {
+				break;
+			}
+		}
+		run_tasks();
+		for (auto &thread : threads)
+			thread.join();
+
+		yosys_threads_active = false;
+		autoidx = max_autoidx;
+
+		for (auto &e : exceptions)
+			if (e)
+				std::rethrow_exception(e);
+		return;
+	}
+#else
+	(void)allow_threads;
+#endif
+
+	for (int i = 0; i < count; i++) {
+		autoidx = base_autoidx;
+		try {
+			task(i);
+		} catch (...) {
+			autoidx = std::max(max_autoidx, autoidx);
+			throw;
+		}
+		max_autoidx = std::max(max_autoidx, autoidx);
+	}
+	autoidx = max_autoidx;
+}
+
 RTLIL::Design *yosys_get_design()
 {
 	return yosys_design;
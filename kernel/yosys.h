@@ -69,6 +69,20 @@ const char *create_prompt(RTLIL::Design *design, int recursion_counter);
 std::vector<std::string> glob_filename(const std::string &filename_pattern);
 void rewrite_filename(std::string &filename);
 
+// number of threads (including the main thread) used by yosys_parallel_for()
+extern int yosys_threads;
+
+// Runs task(0) to task(count-1) on up to yosys_threads threads and returns
+// when all tasks have finished. The tasks run in order on the calling thread
+// when threading is disabled, allow_threads is false or when called from
+// within another parallel section. If tasks throw, the exception of the lowest
+// numbered failing task is rethrown after all tasks have finished.
+//
+// Every task numbers new objects (NEW_ID etc.) starting at the same autoidx,
+// however the tasks are run, so tasks that create objects must do so in
+// different modules.
+void yosys_parallel_for(int count, const std::function<void(int)> &task, bool allow_threads = true);
+
 void run_pass(std::string command, RTLIL::Design *design = nullptr);
 bool run_frontend(std::string filename, std::string command, RTLIL::Design *design = nullptr, std::string *from_to_label = nullptr);
 void run_backend(std::string filename, std::string command, RTLIL::Design *design = nullptr);
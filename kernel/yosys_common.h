@@ -34,6 +34,19 @@
 #include <memory>
 #include <cmath>
 #include <cstddef>
+#include <atomic>
+#include <limits>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif
+
+#ifdef YOSYS_ENABLE_THREADS
+#  include <mutex>
+#endif
 
 #include <sstream>
 #include <fstream>
@@ -196,6 +209,7 @@ using hashlib::hash_ops;
 using hashlib::hash_cstr_ops;
 using hashlib::hash_ptr_ops;
 using hashlib::hash_obj_ops;
+using hashlib::hash_open_ops;
 using hashlib::dict;
 using hashlib::idict;
 using hashlib::pool;
@@ -343,12 +357,55 @@ void remove_directory(std::string dirname);
 bool create_directory(const std::string& dirname);
 std::string escape_filename_spaces(const std::string& filename);
 
+// The contents of an input file, for parsers that work on the whole file at
+// once. Plain files are mapped into memory, other streams (compressed files,
+// here-documents, stdin) are read into a buffer.
+struct FileContents
+{
+	FileContents() { }
+	~FileContents();
+
+	FileContents(const FileContents &other) = delete;
+	void operator=(const FileContents &other) = delete;
+
+	// Returns false if the file can't be mapped, e.g. because it isn't a
+	// regular file.
+	bool map(const std::string &filename);
+	void read(std::istream &f);
+
+	const char *begin() const { return data_; }
+	const char *end() const { return data_ + size_; }
+	size_t size() const { return size_; }
+
+private:
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+	bool mapped_ = false;
+	std::string buffer_;
+};
+
 template<typename T> int GetSize(const T &obj) { return obj.size(); }
 inline int GetSize(RTLIL::Wire *wire);
 
+#ifdef YOSYS_ENABLE_THREADS
+// thread local, so that tasks run by yosys_parallel_for() number new objects
+// independently of how the tasks are scheduled
+extern thread_local int autoidx;
+#else
 extern int autoidx;
+#endif
 extern int yosys_xtrace;
 
+#ifdef YOSYS_ENABLE_THREADS
+// True while worker threads may be running kernel code concurrently with the
+// main thread. Only the main thread may change this, and only while no worker
+// threads are running. Shared kernel data structures (e.g. the IdString table)
+// skip all synchronization when this is false.
+extern bool yosys_threads_active;
+#else
+static const bool yosys_threads_active = false;
+#endif
+
 RTLIL::IdString new_id(std::string file, int line, std::string func);
 RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std::string suffix);
 
@@ -39,6 +39,7 @@ static void unset_drivers(RTLIL::Design *design, RTLIL::Module *module, SigMap &
 
 	for (auto &conn : module->connections_)
 		sigmap(conn.first).replace(sig, dummy_wire, &conn.first);
+	module->connections_changed();
 }
 
 struct ConnectPass : public Pass {
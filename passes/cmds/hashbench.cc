@@ -0,0 +1,206 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Copyright (C) 2012  Claire Xenia Wolf <claire@yosyshq.com>
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+#ifdef HASHLIB_MKHASH_MULXOR
+static const char *hash_core_name = "mulxor";
+#else
+static const char *hash_core_name = "djb2";
+#endif
+
+struct BenchStats
+{
+	int64_t keys = 0, collisions = 0;
+	double chain_probes = 0;
+	int max_chain = 0;
+	double lookup_ns = 0, open_lookup_ns = 0;
+};
+
+template<typename K, typename OPS>
+double time_lookups(const std::vector<K> &keys, int rounds)
+{
+	dict<K, int, OPS> db;
+	for (int i = 0; i < GetSize(keys); i++)
+		db[keys[i]] = i;
+
+	PerformanceTimer timer;
+	int64_t found = 0;
+
+	timer.begin();
+	for (int i = 0; i < rounds; i++)
+		for (auto &key : keys)
+			found += db.count(key);
+	timer.end();
+
+	log_assert(found == int64_t(rounds) * GetSize(keys));
+	return double(timer.total_ns) / rounds;
+}
+
+template<typename K>
+struct KeySet
+{
+	const char *name;
+	pool<K> keys;
+	BenchStats stats;
+
+	KeySet(const char *name) : name(name) { }
+
+	// hash tables are mostly per module, so are the benchmarks. This also
+	// keeps objects with the same name in different modules apart.
+	void bench_module(int rounds)
+	{
+		if (keys.empty())
+			return;
+
+		std::vector<K> key_vector(keys.begin(), keys.end());
+		int n = GetSize(key_vector);
+		pool<unsigned int> distinct;
+		std::vector<unsigned int> hashes;
+
+		for (auto &key : key_vector) {
+			hashes.push_back(hash_ops<K>::hash(key));
+			distinct.insert(hashes.back());
+		}
+
+		stats.keys += n;
+		stats.collisions += n - GetSize(distinct);
+
+		// chain lengths of the index used by dict<> and pool<>
+		std::vector<int> chains(hashlib::hashtable_size(n * hashlib::hashtable_size_factor));
+		for (auto h : hashes)
+			chains[h % GetSize(chains)]++;
+
+		for (auto len : chains) {
+			stats.chain_probes += len * (len + 1) / 2.0;
+			stats.max_chain = std::max(stats.max_chain, len);
+		}
+
+		stats.lookup_ns += time_lookups<K, hash_ops<K>>(key_vector, rounds);
+		stats.open_lookup_ns += time_lookups<K, hash_open_ops<hash_ops<K>>>(key_vector, rounds);
+		keys.clear();
+	}
+
+	void report()
+	{
+		if (stats.keys == 0)
+			return;
+
+		log("  %-9s %-7s %10lld %10lld %8.2f %7d %10.1f %10.1f\n", name, hash_core_name,
+				(long long)stats.keys, (long long)stats.collisions,
+				stats.chain_probes / stats.keys, stats.max_chain, stats.lookup_ns / stats.keys,
+				stats.open_lookup_ns / stats.keys);
+	}
+};
+
+struct HashbenchPass : public Pass {
+	HashbenchPass() : Pass("hashbench", "benchmark hash functions on the keys of a design") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    hashbench [options] [selection]\n");
+		log("\n");
+		log("This command measures how well the hash core that yosys was built with\n");
+		log("distributes keys taken from the selected modules. The key sets are the names\n");
+		log("of objects, the bits of wires and cell ports, the signals connected to cell\n");
+		log("ports and the cell parameter values. Each module is measured on its own and\n");
+		log("the results are summed up.\n");
+		log("\n");
+		log("For every key set the number of keys, the number of hash collisions, the\n");
+		log("average number of probed entries per lookup, the longest chain of the dict<>\n");
+		log("index and the time per lookup (ns) are reported. The lookup time is measured\n");
+		log("once with the default chained index and once with the open addressing index\n");
+		log("that is selected with hash_open_ops<> (see kernel/hashlib.h).\n");
+		log("\n");
+		log("The hash core is DJB2 by default. Building with ENABLE_HASH_MULXOR=1 selects\n");
+		log("the multiply-xorshift mixer instead (see HASHLIB_MKHASH_MULXOR in\n");
+		log("kernel/hashlib.h), so running this command with both builds compares them.\n");
+		log("\n");
+		log("    -rounds <N>\n");
+		log("        number of lookups per key when measuring lookup times (default: 10)\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		int rounds = 10;
+
+		log_header(design, "Executing HASHBENCH pass (benchmarking hash functions).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++) {
+			if (args[argidx] == "-rounds" && argidx+1 < args.size()) {
+				rounds = std::max(atoi(args[++argidx].c_str()), 1);
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		KeySet<RTLIL::IdString> idstrings("idstring");
+		KeySet<RTLIL::SigBit> sigbits("sigbit");
+		KeySet<RTLIL::SigSpec> sigspecs("sigspec");
+		KeySet<RTLIL::Const> consts("const");
+
+		for (auto module : design->selected_modules())
+		{
+			idstrings.keys.insert(module->name);
+
+			for (auto wire : module->selected_wires()) {
+				idstrings.keys.insert(wire->name);
+				for (auto bit : SigSpec(wire))
+					sigbits.keys.insert(bit);
+			}
+
+			for (auto cell : module->selected_cells()) {
+				idstrings.keys.insert(cell->name);
+				idstrings.keys.insert(cell->type);
+				for (auto &conn : cell->connections()) {
+					idstrings.keys.insert(conn.first);
+					sigspecs.keys.insert(conn.second);
+					for (auto bit : conn.second)
+						sigbits.keys.insert(bit);
+				}
+				for (auto &param : cell->parameters) {
+					idstrings.keys.insert(param.first);
+					consts.keys.insert(param.second);
+				}
+			}
+
+			idstrings.bench_module(rounds);
+			sigbits.bench_module(rounds);
+			sigspecs.bench_module(rounds);
+			consts.bench_module(rounds);
+		}
+
+		log("\n");
+		log("  %-9s %-7s %10s %10s %8s %7s %10s %10s\n", "keys", "core", "count", "collisions",
+				"probes", "chain", "lookup", "open");
+
+		idstrings.report();
+		sigbits.report();
+		sigspecs.report();
+		consts.report();
+	}
+} HashbenchPass;
+
+PRIVATE_NAMESPACE_END
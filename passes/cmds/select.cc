@@ -805,29 +805,34 @@ static void select_stmt(RTLIL::Design *design, std::string arg, bool disable_emp
 	}
 
 	sel.full_selection = false;
-	for (auto mod : design->modules())
+	// modules read with "read_rtlil -lazy" are only loaded when a member
+	// pattern has to be matched, the module patterns just need the name and
+	// the attributes of the module
+	for (auto stub : design->module_stubs())
 	{
-		if (!select_blackboxes && mod->get_blackbox_attribute())
+		if (!select_blackboxes && stub->get_blackbox_attribute())
 			continue;
 
 		if (arg_mod.compare(0, 2, "A:") == 0) {
-			if (!match_attr(mod->attributes, arg_mod.substr(2)))
+			if (!match_attr(stub->attributes, arg_mod.substr(2)))
 				continue;
 		} else
 		if (arg_mod.compare(0, 2, "N:") == 0) {
-			if (!match_ids(mod->name, arg_mod.substr(2)))
+			if (!match_ids(stub->name, arg_mod.substr(2)))
 				continue;
 		} else
-		if (!match_ids(mod->name, arg_mod))
+		if (!match_ids(stub->name, arg_mod))
 			continue;
 		else
 			arg_mod_found[arg_mod] = true;
 
 		if (arg_memb == "") {
-			sel.selected_modules.insert(mod->name);
+			sel.selected_modules.insert(stub->name);
 			continue;
 		}
 
+		RTLIL::Module *mod = design->module(stub->name);
+
 		if (arg_memb.compare(0, 2, "w:") == 0) {
 			for (auto wire : mod->wires())
 				if (match_ids(wire->name, arg_memb.substr(2)))
@@ -540,6 +540,8 @@ struct SetundefPass : public Pass {
 					}
 				}
 			}
+
+			module->connections_changed();
 		}
 	}
 } SetundefPass;
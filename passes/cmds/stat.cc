@@ -348,14 +348,18 @@ statdata_t hierarchy_worker(std::map<RTLIL::IdString, statdata_t> &mod_stat, RTL
 	return mod_data;
 }
 
-void read_liberty_cellarea(dict<IdString, cell_area_t> &cell_area, string liberty_file)
+void read_liberty_cellarea(dict<IdString, cell_area_t> &cell_area, string liberty_file, string cache_dir)
 {
+	static const std::set<std::string> liberty_filter = {
+		"/library/cell", "/library/cell/area", "/library/cell/ff"
+	};
+
 	std::ifstream f;
 	f.open(liberty_file.c_str());
 	yosys_input_files.insert(liberty_file);
 	if (f.fail())
 		log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-	LibertyParser libparser(f);
+	LibertyParser libparser(f, liberty_file, liberty_filter, cache_dir);
 	f.close();
 
 	for (auto cell : libparser.ast->children)
@@ -387,7 +391,8 @@ struct StatPass : public Pass {
 		log("        default value for this option.\n");
 		log("\n");
 		log("    -liberty <liberty_file>\n");
-		log("        use cell area information from the provided liberty file\n");
+		log("        use cell area information from the provided liberty file (see\n");
+		log("        'help read_liberty' for caching the parsed file)\n");
 		log("\n");
 		log("    -tech <technology>\n");
 		log("        print area estimate for the specified technology. Currently supported\n");
@@ -420,7 +425,7 @@ struct StatPass : public Pass {
 			if (args[argidx] == "-liberty" && argidx+1 < args.size()) {
 				string liberty_file = args[++argidx];
 				rewrite_filename(liberty_file);
-				read_liberty_cellarea(cell_area, liberty_file);
+				read_liberty_cellarea(cell_area, liberty_file, design->scratchpad_get_string("liberty.cache_dir"));
 				continue;
 			}
 			if (args[argidx] == "-tech" && argidx+1 < args.size()) {
@@ -19,7 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
-#include "kernel/sigtools.h"
+#include "kernel/netgraph.h"
 #include "kernel/utils.h"
 
 USING_YOSYS_NAMESPACE
@@ -70,39 +70,29 @@ struct TorderPass : public Pass {
 		{
 			log("module %s\n", log_id(module));
 
-			SigMap sigmap(module);
-			dict<SigBit, pool<IdString>> bit_drivers, bit_users;
-			TopoSort<IdString, RTLIL::sort_by_id_str> toposort;
-
-			for (auto cell : module->selected_cells())
-			for (auto conn : cell->connections())
-			{
-				if (stop_db.count(cell->type) && stop_db.at(cell->type).count(conn.first))
-					continue;
-
+			NetGraph graph(module, module->selected_cells(), nullptr, [&](Cell *cell, IdString port) {
+				if (stop_db.count(cell->type) && stop_db.at(cell->type).count(port))
+					return false;
 				if (!noautostop && yosys_celltypes.cell_known(cell->type)) {
-					if (conn.first.in(ID::Q, ID::CTRL_OUT, ID::RD_DATA))
-						continue;
-					if (cell->type.in(ID($memrd), ID($memrd_v2)) && conn.first == ID::DATA)
-						continue;
+					if (port.in(ID::Q, ID::CTRL_OUT, ID::RD_DATA))
+						return false;
+					if (cell->type.in(ID($memrd), ID($memrd_v2)) && port == ID::DATA)
+						return false;
 				}
+				return true;
+			});
 
-				if (cell->input(conn.first))
-					for (auto bit : sigmap(conn.second))
-						bit_users[bit].insert(cell->name);
-
-				if (cell->output(conn.first))
-					for (auto bit : sigmap(conn.second))
-						bit_drivers[bit].insert(cell->name);
+			TopoSort<IdString, RTLIL::sort_by_id_str> toposort;
+			std::vector<int> nodes(graph.num_cells(), -1);
 
-				toposort.node(cell->name);
-			}
+			for (int i = 0; i < graph.num_cells(); i++)
+				if (!graph.ports(i).empty())
+					nodes[i] = toposort.node(graph.cells[i]->name);
 
-			for (auto &it : bit_users)
-				if (bit_drivers.count(it.first))
-					for (auto driver_cell : bit_drivers.at(it.first))
-					for (auto user_cell : it.second)
-						toposort.edge(driver_cell, user_cell);
+			for (int net = 0; net < graph.num_nets(); net++)
+				for (int driver_cell : graph.drivers(net))
+				for (int user_cell : graph.users(net))
+					toposort.edge(nodes[driver_cell], nodes[user_cell]);
 
 			toposort.analyze_loops = true;
 			toposort.sort();
@@ -19,14 +19,255 @@
 
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "kernel/sigtools.h"
 #include <stdlib.h>
 #include <stdio.h>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+// Records which parts of a module the opt_* passes changed, so that the next
+// iteration of "opt -incremental" can be restricted to them. Wires and cells
+// are recorded by name, as opt_clean may delete them before we look at them.
+//
+// To find the cells and wires on a changed net without scanning the module,
+// the monitor keeps an index of the cell ports and module connections of every
+// wire bit, which it updates from the change notifications.
+struct OptChangeMonitor : public RTLIL::Monitor
+{
+	typedef std::pair<RTLIL::IdString, int> wire_bit_t;
+
+	RTLIL::Module *module;
+	pool<wire_bit_t> touched_bits;
+	pool<RTLIL::IdString> touched_cells;
+	pool<RTLIL::IdString> region_cells, region_wires;
+	std::unique_ptr<SigMap> old_nets;
+	bool all_touched = false;
+
+	// for every wire bit, how often each cell has it on one of its ports,
+	// and the wire bits it is connected to by module connections
+	dict<wire_bit_t, dict<RTLIL::IdString, int>> bit_cells;
+	dict<wire_bit_t, pool<wire_bit_t>> bit_links;
+
+	OptChangeMonitor(RTLIL::Module *module) : module(module)
+	{
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections())
+				index_cell_bits(cell->name, conn.second, 1);
+		for (auto &conn : module->connections())
+			index_link(conn);
+		module->monitors.insert(this);
+	}
+
+	~OptChangeMonitor()
+	{
+		module->monitors.erase(this);
+	}
+
+	void index_cell_bits(RTLIL::IdString cell_name, const RTLIL::SigSpec &sig, int delta)
+	{
+		for (auto &chunk : sig.chunks()) {
+			if (chunk.wire == nullptr)
+				continue;
+			for (int i = 0; i < chunk.width; i++) {
+				auto &cells = bit_cells[wire_bit_t(chunk.wire->name, chunk.offset + i)];
+				if ((cells[cell_name] += delta) == 0)
+					cells.erase(cell_name);
+			}
+		}
+	}
+
+	void index_link(const RTLIL::SigSig &sigsig)
+	{
+		for (int i = 0; i < GetSize(sigsig.first); i++) {
+			RTLIL::SigBit bit1 = sigsig.first[i], bit2 = sigsig.second[i];
+			if (bit1.wire == nullptr || bit2.wire == nullptr)
+				continue;
+			wire_bit_t key1(bit1.wire->name, bit1.offset), key2(bit2.wire->name, bit2.offset);
+			bit_links[key1].insert(key2);
+			bit_links[key2].insert(key1);
+		}
+	}
+
+	void touch(const RTLIL::SigSpec &sig)
+	{
+		for (auto &chunk : sig.chunks())
+			if (chunk.wire != nullptr)
+				for (int i = 0; i < chunk.width; i++)
+					touched_bits.insert(wire_bit_t(chunk.wire->name, chunk.offset + i));
+	}
+
+	void notify_connect(RTLIL::Cell *cell, const RTLIL::IdString &, const RTLIL::SigSpec &old_sig, const RTLIL::SigSpec &sig) override
+	{
+		index_cell_bits(cell->name, old_sig, -1);
+		index_cell_bits(cell->name, sig, 1);
+
+		// opt_clean maps the cell ports to the representatives of their
+		// nets, which doesn't change what they are connected to
+		if (old_nets != nullptr && GetSize(old_sig) == GetSize(sig) && (*old_nets)(old_sig) == (*old_nets)(sig))
+			return;
+
+		touched_cells.insert(cell->name);
+		touch(old_sig);
+		touch(sig);
+	}
+
+	void notify_connect(RTLIL::Module *, const RTLIL::SigSig &sigsig) override
+	{
+		index_link(sigsig);
+
+		if (old_nets == nullptr) {
+			touch(sigsig.first);
+			touch(sigsig.second);
+			return;
+		}
+
+		// opt_clean re-adds the connections it keeps, only record the
+		// ones that actually join two nets.
+		for (int i = 0; i < GetSize(sigsig.first); i++) {
+			RTLIL::SigBit bit1 = sigsig.first[i], bit2 = sigsig.second[i];
+			if ((*old_nets)(bit1) != (*old_nets)(bit2)) {
+				touch(bit1);
+				touch(bit2);
+			}
+		}
+	}
+
+	void notify_connect(RTLIL::Module *, const std::vector<RTLIL::SigSig> &new_conn) override
+	{
+		bit_links.clear();
+		for (auto &conn : new_conn)
+			index_link(conn);
+		all_touched = true;
+	}
+
+	void notify_blackout(RTLIL::Module *) override
+	{
+		bit_cells.clear();
+		bit_links.clear();
+		all_touched = true;
+	}
+
+	bool dirty() const
+	{
+		return all_touched || !touched_bits.empty() || !touched_cells.empty() ||
+				!region_cells.empty() || !region_wires.empty();
+	}
+
+	// Moves the recorded changes into the region: the touched cells, and all
+	// cells and wires connected to a touched net. The nets are walked along
+	// the module connections in the index.
+	void update_region()
+	{
+		if (touched_bits.empty() && touched_cells.empty())
+			return;
+
+		for (auto &name : touched_cells)
+			region_cells.insert(name);
+
+		pool<wire_bit_t> visited;
+		std::vector<wire_bit_t> queue;
+		for (auto &bit : touched_bits)
+			if (visited.insert(bit).second)
+				queue.push_back(bit);
+
+		while (!queue.empty()) {
+			wire_bit_t bit = queue.back();
+			queue.pop_back();
+			region_wires.insert(bit.first);
+
+			auto cells_it = bit_cells.find(bit);
+			if (cells_it != bit_cells.end())
+				for (auto &it : cells_it->second)
+					region_cells.insert(it.first);
+
+			auto links_it = bit_links.find(bit);
+			if (links_it != bit_links.end())
+				for (auto &other : links_it->second)
+					if (visited.insert(other).second)
+						queue.push_back(other);
+		}
+
+		touched_bits.clear();
+		touched_cells.clear();
+	}
+
+	// Called around opt_clean, which removes all connections of the module
+	// and adds back the ones it keeps.
+	void begin_clean()
+	{
+		update_region();
+		old_nets.reset(new SigMap(module));
+	}
+
+	// opt_clean drops the connections without a notification, so the links
+	// are rebuilt from the ones it kept
+	void end_clean()
+	{
+		old_nets.reset();
+		bit_links.clear();
+		for (auto &conn : module->connections())
+			index_link(conn);
+	}
+
+	void clear()
+	{
+		touched_bits.clear();
+		touched_cells.clear();
+		region_cells.clear();
+		region_wires.clear();
+		all_touched = false;
+	}
+};
+
 struct OptPass : public Pass {
 	OptPass() : Pass("opt", "perform simple optimizations") { }
+
+	// Selects the changed region for the passes that work on single cells,
+	// and the changed modules for the passes that need whole modules. Both
+	// are restricted to the current selection.
+	static void build_region(RTLIL::Design *design, const std::vector<std::unique_ptr<OptChangeMonitor>> &monitors,
+			RTLIL::Selection &region_sel, RTLIL::Selection &module_sel)
+	{
+		region_sel = RTLIL::Selection(false);
+		module_sel = RTLIL::Selection(false);
+
+		for (auto &mon : monitors)
+		{
+			RTLIL::Module *module = mon->module;
+			if (!mon->dirty())
+				continue;
+
+			if (design->selected_whole_module(module)) {
+				module_sel.select(module);
+			} else {
+				for (auto cell : module->selected_cells())
+					module_sel.select(module, cell);
+				for (auto wire : module->selected_wires())
+					module_sel.select(module, wire);
+			}
+
+			if (mon->all_touched) {
+				if (module_sel.selected_modules.count(module->name))
+					region_sel.select(module);
+				else if (module_sel.selected_members.count(module->name))
+					region_sel.selected_members[module->name] = module_sel.selected_members.at(module->name);
+				continue;
+			}
+
+			for (auto name : mon->region_cells) {
+				RTLIL::Cell *cell = module->cell(name);
+				if (cell != nullptr && design->selected(module, cell))
+					region_sel.select(module, cell);
+			}
+			for (auto name : mon->region_wires) {
+				RTLIL::Wire *wire = module->wire(name);
+				if (wire != nullptr && design->selected(module, wire))
+					region_sel.select(module, wire);
+			}
+		}
+	}
+
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -59,6 +300,13 @@ struct OptPass : public Pass {
 		log("        opt_clean [-purge]\n");
 		log("    while <changed design in opt_dff>\n");
 		log("\n");
+		log("When called with -incremental (and without -fast), the first iteration of the\n");
+		log("loop runs on the whole selection as usual, but the following iterations only\n");
+		log("revisit the cells that are connected to a signal changed in the previous\n");
+		log("iteration. opt_muxtree, opt_merge and opt_clean still see the whole module,\n");
+		log("but only in modules that changed. When such an iteration changes nothing, one\n");
+		log("more iteration on the whole selection confirms that nothing is left to do.\n");
+		log("\n");
 		log("Note: Options in square brackets (such as [-keepdc]) are passed through to\n");
 		log("the opt_* commands when given to 'opt'.\n");
 		log("\n");
@@ -74,6 +322,7 @@ struct OptPass : public Pass {
 		bool opt_share = false;
 		bool fast_mode = false;
 		bool noff_mode = false;
+		bool incremental_mode = false;
 
 		log_header(design, "Executing OPT pass (performing simple optimizations).\n");
 		log_push();
@@ -141,6 +390,10 @@ struct OptPass : public Pass {
 				noff_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-incremental") {
+				incremental_mode = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -164,19 +417,61 @@ struct OptPass : public Pass {
 		{
 			Pass::call(design, "opt_expr" + opt_expr_args);
 			Pass::call(design, "opt_merge -nomux" + opt_merge_args);
+
+			// the monitors detach themselves from their modules when they are
+			// destroyed, also if one of the passes throws
+			std::vector<std::unique_ptr<OptChangeMonitor>> monitors;
+			if (incremental_mode)
+				for (auto module : design->selected_modules())
+					monitors.emplace_back(new OptChangeMonitor(module));
+
+			bool full_iteration = true;
+			RTLIL::Selection region_sel(false), module_sel(false);
+
+			auto call = [&](const std::string &command, bool whole_modules) {
+				if (full_iteration)
+					Pass::call(design, command);
+				else
+					Pass::call_on_selection(design, whole_modules ? module_sel : region_sel, command);
+			};
+
 			while (1) {
+				if (!full_iteration)
+					build_region(design, monitors, region_sel, module_sel);
+				for (auto &mon : monitors)
+					mon->clear();
+
 				design->scratchpad_unset("opt.did_something");
-				Pass::call(design, "opt_muxtree");
-				Pass::call(design, "opt_reduce" + opt_reduce_args);
-				Pass::call(design, "opt_merge" + opt_merge_args);
+				call("opt_muxtree", true);
+				call("opt_reduce" + opt_reduce_args, false);
+				call("opt_merge" + opt_merge_args, true);
 				if (opt_share)
-					Pass::call(design, "opt_share");
+					call("opt_share", false);
 				if (!noff_mode)
-					Pass::call(design, "opt_dff" + opt_dff_args);
-				Pass::call(design, "opt_clean" + opt_clean_args);
-				Pass::call(design, "opt_expr" + opt_expr_args);
-				if (design->scratchpad_get_bool("opt.did_something") == false)
-					break;
+					call("opt_dff" + opt_dff_args, false);
+				for (auto &mon : monitors)
+					mon->begin_clean();
+				call("opt_clean" + opt_clean_args, true);
+				for (auto &mon : monitors)
+					mon->end_clean();
+				call("opt_expr" + opt_expr_args, false);
+				for (auto &mon : monitors)
+					mon->update_region();
+
+				if (design->scratchpad_get_bool("opt.did_something") == false) {
+					if (full_iteration)
+						break;
+					full_iteration = true;
+					log_header(design, "Rerunning OPT passes on the whole selection. (Checking that there is nothing left to do..)\n");
+					continue;
+				}
+
+				if (incremental_mode) {
+					full_iteration = true;
+					for (auto &mon : monitors)
+						if (mon->dirty())
+							full_iteration = false;
+				}
 				log_header(design, "Rerunning OPT passes. (Maybe there is more to do..)\n");
 			}
 		}
@@ -21,6 +21,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
+#include "kernel/netgraph.h"
 #include "kernel/ffinit.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -73,6 +74,15 @@ struct keep_cache_t
 		return cache[module];
 	}
 
+	// Fills in the cache for the cell types used in the given modules, so that
+	// the queries made while the modules are cleaned in parallel only read it.
+	void prefill(const std::vector<Module*> &modules)
+	{
+		for (auto module : modules)
+			for (auto cell : module->cells())
+				query(cell);
+	}
+
 	bool query(Cell *cell, bool ignore_specify = false)
 	{
 		if (cell->type.in(ID($assert), ID($assume), ID($live), ID($fair), ID($cover)))
@@ -102,110 +112,171 @@ struct keep_cache_t
 
 keep_cache_t keep_cache;
 CellTypes ct_reg, ct_all;
+
+#ifdef YOSYS_ENABLE_THREADS
+// modules are cleaned in parallel (see Pass::run_on_modules)
+thread_local int count_rm_cells, count_rm_wires;
+thread_local bool module_did_something;
+#else
 int count_rm_cells, count_rm_wires;
+bool module_did_something;
+#endif
+
+// Like SigPool, but with the bits stored in a bit vector over a WireBitIndex
+// (see kernel/netgraph.h), so that the signal sweeps below don't need hash sets.
+struct DenseSigPool
+{
+	const WireBitIndex &index;
+	std::vector<bool> bits;
+
+	DenseSigPool(const WireBitIndex &index) : index(index), bits(index.size) { }
+
+	void add(const RTLIL::SigSpec &sig)
+	{
+		index.for_each(sig, [&](int i) { bits[i] = true; });
+	}
+
+	bool check(const RTLIL::SigBit &bit) const
+	{
+		return bit.wire != nullptr && bits[index(bit)];
+	}
+
+	bool check_any(const RTLIL::SigSpec &sig) const
+	{
+		for (auto &bit : sig)
+			if (check(bit))
+				return true;
+		return false;
+	}
+
+	bool check_all(const RTLIL::SigSpec &sig) const
+	{
+		for (auto &bit : sig)
+			if (bit.wire != nullptr && !bits[index(bit)])
+				return false;
+		return true;
+	}
+};
 
 void rmunused_module_cells(Module *module, bool verbose)
 {
-	SigMap sigmap(module);
-	dict<IdString, pool<Cell*>> mem2cells;
+	std::vector<Cell*> cells;
+	cells.reserve(GetSize(module->cells_));
+	for (auto &it : module->cells_)
+		cells.push_back(it.second);
+
+	// all ports of cells that are unknown to ct_all count as inout
+	NetGraph graph(module, cells, &ct_all);
+	const SigMap &sigmap = graph.sigmap;
+
+	dict<IdString, vector<int>> mem2cells;
 	pool<IdString> mem_unused;
-	pool<Cell*> queue, unused;
-	pool<SigBit> used_raw_bits;
-	dict<SigBit, pool<Cell*>> wire2driver;
 	dict<SigBit, vector<string>> driver_driver_logs;
 	FfInitVals ffinit(&sigmap, module);
 
-	SigMap raw_sigmap;
-	for (auto &it : module->connections_) {
-		for (int i = 0; i < GetSize(it.second); i++) {
-			if (it.second[i].wire != nullptr)
-				raw_sigmap.add(it.first[i], it.second[i]);
-		}
-	}
-
 	for (auto &it : module->memories) {
 		mem_unused.insert(it.first);
 	}
 
-	for (Cell *cell : module->cells()) {
+	std::vector<int> worklist;
+	std::vector<bool> cell_used(graph.num_cells()), net_used(graph.num_nets());
+
+	// only needed to report driver-driver conflicts, so built on first use
+	SigMap raw_sigmap;
+	bool raw_sigmap_valid = false;
+
+	for (int cell_idx = 0; cell_idx < graph.num_cells(); cell_idx++) {
+		Cell *cell = cells[cell_idx];
 		if (cell->type.in(ID($memwr), ID($memwr_v2), ID($meminit), ID($meminit_v2))) {
 			IdString mem_id = cell->getParam(ID::MEMID).decode_string();
-			mem2cells[mem_id].insert(cell);
+			mem2cells[mem_id].push_back(cell_idx);
 		}
-	}
-
-	for (auto &it : module->cells_) {
-		Cell *cell = it.second;
-		for (auto &it2 : cell->connections()) {
-			if (ct_all.cell_known(cell->type) && !ct_all.cell_output(cell->type, it2.first))
+		if (keep_cache.query(cell)) {
+			cell_used[cell_idx] = true;
+			worklist.push_back(cell_idx);
+		}
+		if (!ct_all.cell_known(cell->type))
+			continue;
+		for (auto &port : graph.ports(cell_idx)) {
+			if (!(port.dir & NetGraph::PD_OUTPUT))
 				continue;
-			for (auto raw_bit : it2.second) {
+			const SigSpec *sig = nullptr;
+			for (int i = 0; i < port.width; i++) {
+				if (graph.nets(port)[i] >= 0)
+					continue;
+				if (sig == nullptr)
+					sig = &cell->getPort(port.name);
+				auto raw_bit = (*sig)[i];
 				if (raw_bit.wire == nullptr)
 					continue;
-				auto bit = sigmap(raw_bit);
-				if (bit.wire == nullptr && ct_all.cell_known(cell->type))
-					driver_driver_logs[raw_sigmap(raw_bit)].push_back(stringf("Driver-driver conflict "
-							"for %s between cell %s.%s and constant %s in %s: Resolved using constant.",
-							log_signal(raw_bit), log_id(cell), log_id(it2.first), log_signal(bit), log_id(module)));
-				if (bit.wire != nullptr)
-					wire2driver[bit].insert(cell);
+				if (!raw_sigmap_valid) {
+					for (auto &it : module->connections_) {
+						for (int k = 0; k < GetSize(it.second); k++) {
+							if (it.second[k].wire != nullptr)
+								raw_sigmap.add(it.first[k], it.second[k]);
+						}
+					}
+					raw_sigmap_valid = true;
+				}
+				driver_driver_logs[raw_sigmap(raw_bit)].push_back(stringf("Driver-driver conflict "
+						"for %s between cell %s.%s and constant %s in %s: Resolved using constant.",
+						log_signal(raw_bit), log_id(cell), log_id(port.name), log_signal(sigmap(raw_bit)), log_id(module)));
 			}
 		}
-		if (keep_cache.query(cell))
-			queue.insert(cell);
-		else
-			unused.insert(cell);
 	}
 
+	// Mark everything that is (transitively) used by a kept cell, an output
+	// port or a kept wire.
+	auto use_net = [&](int net) {
+		if (net < 0 || net_used[net])
+			return;
+		net_used[net] = true;
+		for (int driver_cell : graph.drivers(net))
+			if (!cell_used[driver_cell]) {
+				cell_used[driver_cell] = true;
+				worklist.push_back(driver_cell);
+			}
+	};
+
 	for (auto &it : module->wires_) {
 		Wire *wire = it.second;
-		if (wire->port_output || wire->get_bool_attribute(ID::keep)) {
-			for (auto bit : sigmap(wire))
-			for (auto c : wire2driver[bit])
-				queue.insert(c), unused.erase(c);
-			for (auto raw_bit : SigSpec(wire))
-				used_raw_bits.insert(raw_sigmap(raw_bit));
-		}
+		if (wire->port_output || wire->get_bool_attribute(ID::keep))
+			for (int i = 0; i < wire->width; i++)
+				use_net(graph.net(SigBit(wire, i)));
 	}
 
-	while (!queue.empty())
+	while (!worklist.empty())
 	{
-		pool<SigBit> bits;
-		pool<IdString> mems;
-		for (auto cell : queue) {
-			for (auto &it : cell->connections())
-				if (!ct_all.cell_known(cell->type) || ct_all.cell_input(cell->type, it.first))
-					for (auto bit : sigmap(it.second))
-						bits.insert(bit);
-
-			if (cell->type.in(ID($memrd), ID($memrd_v2))) {
-				IdString mem_id = cell->getParam(ID::MEMID).decode_string();
-				if (mem_unused.count(mem_id)) {
-					mem_unused.erase(mem_id);
-					mems.insert(mem_id);
-				}
-			}
-		}
-
-		queue.clear();
+		int cell_idx = worklist.back();
+		Cell *cell = cells[cell_idx];
+		worklist.pop_back();
 
-		for (auto bit : bits)
-		for (auto c : wire2driver[bit])
-			if (unused.count(c))
-				queue.insert(c), unused.erase(c);
+		for (int net : graph.fanin(cell_idx))
+			use_net(net);
 
-		for (auto mem : mems)
-		for (auto c : mem2cells[mem])
-			if (unused.count(c))
-				queue.insert(c), unused.erase(c);
+		if (cell->type.in(ID($memrd), ID($memrd_v2))) {
+			IdString mem_id = cell->getParam(ID::MEMID).decode_string();
+			if (mem_unused.count(mem_id)) {
+				mem_unused.erase(mem_id);
+				for (int cell_idx : mem2cells[mem_id])
+					if (!cell_used[cell_idx]) {
+						cell_used[cell_idx] = true;
+						worklist.push_back(cell_idx);
+					}
+			}
+		}
 	}
 
-	unused.sort(RTLIL::sort_by_name_id<RTLIL::Cell>());
+	std::vector<Cell*> unused;
+	for (int i = 0; i < GetSize(cells); i++)
+		if (!cell_used[i])
+			unused.push_back(cells[i]);
+	std::sort(unused.begin(), unused.end(), RTLIL::sort_by_name_id<RTLIL::Cell>());
 
 	for (auto cell : unused) {
 		if (verbose)
 			log_debug("  removing unused `%s' cell `%s'.\n", cell->type.c_str(), cell->name.c_str());
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		module_did_something = true;
 		if (RTLIL::builtin_ff_cell_types().count(cell->type))
 			ffinit.remove_init(cell->getPort(ID::Q));
 		module->remove(cell);
@@ -220,6 +291,17 @@ void rmunused_module_cells(Module *module, bool verbose)
 		module->memories.erase(it);
 	}
 
+	if (driver_driver_logs.empty())
+		return;
+
+	pool<SigBit> used_raw_bits;
+	for (auto &it : module->wires_) {
+		Wire *wire = it.second;
+		if (wire->port_output || wire->get_bool_attribute(ID::keep))
+			for (auto raw_bit : SigSpec(wire))
+				used_raw_bits.insert(raw_sigmap(raw_bit));
+	}
+
 	for (auto &it : module->cells_) {
 		Cell *cell = it.second;
 		for (auto &it2 : cell->connections()) {
@@ -247,8 +329,63 @@ int count_nontrivial_wire_attrs(RTLIL::Wire *w)
 	return count;
 }
 
+// The signals that decide between two public wires in compare_signals(). They
+// are only needed when such a choice comes up, so they are collected on first
+// use. That happens before any cell connection is rewritten, and the pool of
+// directly driven wires doesn't depend on which representatives assign_map
+// has picked so far.
+struct PublicSignalInfo
+{
+	RTLIL::Module *module;
+	const SigMap &assign_map;
+	bool purge_mode;
+	bool valid = false;
+
+	// `register_signals` and `connected_signals` will help us decide later on
+	// on picking representatives out of groups of connected signals
+	DenseSigPool register_signals;
+	DenseSigPool connected_signals;
+
+	// wires which are directly driven by a known celltype
+	pool<RTLIL::Wire*> direct_wires;
+
+	PublicSignalInfo(RTLIL::Module *module, const WireBitIndex &index, const SigMap &assign_map, bool purge_mode) :
+			module(module), assign_map(assign_map), purge_mode(purge_mode), register_signals(index), connected_signals(index) { }
+
+	void build()
+	{
+		valid = true;
+
+		if (!purge_mode)
+			for (auto &it : module->cells_) {
+				RTLIL::Cell *cell = it.second;
+				if (ct_reg.cell_known(cell->type)) {
+					bool clk2fflogic = cell->get_bool_attribute(ID(clk2fflogic));
+					for (auto &it2 : cell->connections())
+						if (clk2fflogic ? it2.first == ID::D : ct_reg.cell_output(cell->type, it2.first))
+							register_signals.add(it2.second);
+				}
+				for (auto &it2 : cell->connections())
+					connected_signals.add(it2.second);
+			}
+
+		pool<RTLIL::SigSpec> direct_sigs;
+		for (auto &it : module->cells_) {
+			RTLIL::Cell *cell = it.second;
+			if (ct_all.cell_known(cell->type))
+				for (auto &it2 : cell->connections())
+					if (ct_all.cell_output(cell->type, it2.first))
+						direct_sigs.insert(assign_map(it2.second));
+		}
+		for (auto &it : module->wires_) {
+			if (direct_sigs.count(assign_map(it.second)) || it.second->port_input)
+				direct_wires.insert(it.second);
+		}
+	}
+};
+
 // Should we pick `s2` over `s1` to represent a signal?
-bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, SigPool &regs, SigPool &conns, pool<RTLIL::Wire*> &direct_wires)
+bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, PublicSignalInfo &info)
 {
 	RTLIL::Wire *w1 = s1.wire;
 	RTLIL::Wire *w2 = s2.wire;
@@ -263,6 +400,10 @@ bool compare_signals(RTLIL::SigBit &s1, RTLIL::SigBit &s2, SigPool &regs, SigPoo
 		return !(w2->port_input && w2->port_output);
 
 	if (w1->name.isPublic() && w2->name.isPublic()) {
+		if (!info.valid)
+			info.build();
+		DenseSigPool &regs = info.register_signals, &conns = info.connected_signals;
+		pool<RTLIL::Wire*> &direct_wires = info.direct_wires;
 		if (regs.check(s1) != regs.check(s2))
 			return regs.check(s2);
 		if (direct_wires.count(w1) != direct_wires.count(w2))
@@ -298,44 +439,10 @@ bool check_public_name(RTLIL::IdString id)
 	return true;
 }
 
-bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbose)
+bool rmunused_module_signals(RTLIL::Module *module, const WireBitIndex &index, bool purge_mode, bool verbose)
 {
-	// `register_signals` and `connected_signals` will help us decide later on
-	// on picking representatives out of groups of connected signals
-	SigPool register_signals;
-	SigPool connected_signals;
-	if (!purge_mode)
-		for (auto &it : module->cells_) {
-			RTLIL::Cell *cell = it.second;
-			if (ct_reg.cell_known(cell->type)) {
-				bool clk2fflogic = cell->get_bool_attribute(ID(clk2fflogic));
-				for (auto &it2 : cell->connections())
-					if (clk2fflogic ? it2.first == ID::D : ct_reg.cell_output(cell->type, it2.first))
-						register_signals.add(it2.second);
-			}
-			for (auto &it2 : cell->connections())
-				connected_signals.add(it2.second);
-		}
-
 	SigMap assign_map(module);
-
-	// construct a pool of wires which are directly driven by a known celltype,
-	// this will influence our choice of representatives
-	pool<RTLIL::Wire*> direct_wires;
-	{
-		pool<RTLIL::SigSpec> direct_sigs;
-		for (auto &it : module->cells_) {
-			RTLIL::Cell *cell = it.second;
-			if (ct_all.cell_known(cell->type))
-				for (auto &it2 : cell->connections())
-					if (ct_all.cell_output(cell->type, it2.first))
-						direct_sigs.insert(assign_map(it2.second));
-		}
-		for (auto &it : module->wires_) {
-			if (direct_sigs.count(assign_map(it.second)) || it.second->port_input)
-				direct_wires.insert(it.second);
-		}
-	}
+	PublicSignalInfo public_info(module, index, assign_map, purge_mode);
 
 	// weight all options for representatives with `compare_signals`,
 	// the one that wins will be what `assign_map` maps to
@@ -343,30 +450,42 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		RTLIL::Wire *wire = it.second;
 		for (int i = 0; i < wire->width; i++) {
 			RTLIL::SigBit s1 = RTLIL::SigBit(wire, i), s2 = assign_map(s1);
-			if (!compare_signals(s1, s2, register_signals, connected_signals, direct_wires))
+			if (!compare_signals(s1, s2, public_info))
 				assign_map.add(s1);
 		}
 	}
 
 	// we are removing all connections
 	module->connections_.clear();
+	module->connections_changed();
 
 	// used signals sigmapped
-	SigPool used_signals;
+	DenseSigPool used_signals(index);
 	// used signals pre-sigmapped
-	SigPool raw_used_signals;
+	DenseSigPool raw_used_signals(index);
 	// used signals sigmapped, ignoring drivers (we keep track of this to set `unused_bits`)
-	SigPool used_signals_nodrivers;
+	DenseSigPool used_signals_nodrivers(index);
+
+	// monitors (e.g. of "opt -incremental") must see the remapped cell ports
+	bool notify = !module->monitors.empty() || (module->design && !module->design->monitors.empty());
 
 	// gather the usage information for cells
 	for (auto &it : module->cells_) {
 		RTLIL::Cell *cell = it.second;
 		for (auto &it2 : cell->connections_) {
-			assign_map.apply(it2.second); // modify the cell connection in place
-			raw_used_signals.add(it2.second);
-			used_signals.add(it2.second);
-			if (!ct_all.cell_output(cell->type, it2.first))
-				used_signals_nodrivers.add(it2.second);
+			if (notify)
+				cell->setPort(it2.first, assign_map(it2.second));
+			else
+				assign_map.apply(it2.second); // modify the cell connection in place
+			bool is_input = !ct_all.cell_output(cell->type, it2.first);
+			for (auto &bit : it2.second)
+				if (bit.wire != nullptr) {
+					int i = index(bit);
+					raw_used_signals.bits[i] = true;
+					used_signals.bits[i] = true;
+					if (is_input)
+						used_signals_nodrivers.bits[i] = true;
+				}
 		}
 	}
 
@@ -508,7 +627,7 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		log_debug("  removed %d unused temporary wires.\n", del_temp_wires_count);
 
 	if (!del_wires_queue.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		module_did_something = true;
 
 	return !del_wires_queue.empty();
 }
@@ -589,7 +708,7 @@ bool rmunused_module_init(RTLIL::Module *module, bool verbose)
 	}
 
 	if (did_something)
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		module_did_something = true;
 
 	return did_something;
 }
@@ -616,17 +735,47 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool
 		module->remove(cell);
 	}
 	if (!delcells.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+		module_did_something = true;
 
 	rmunused_module_cells(module, verbose);
-	while (rmunused_module_signals(module, purge_mode, verbose)) { }
+
+	// no wires are added from here on, so one index serves all sweeps
+	WireBitIndex index(module);
+
+	while (rmunused_module_signals(module, index, purge_mode, verbose)) { }
 
 	if (rminit && rmunused_module_init(module, verbose))
-		while (rmunused_module_signals(module, purge_mode, verbose)) { }
+		while (rmunused_module_signals(module, index, purge_mode, verbose)) { }
+}
+
+// Cleans the modules, in parallel where the pass allows it, and returns the
+// total number of removed cells and wires.
+void rmunused_modules(Pass *pass, RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules, bool purge_mode, bool verbose, int &rm_cells, int &rm_wires)
+{
+	keep_cache.prefill(modules);
+
+	std::atomic<int> total_rm_cells(0), total_rm_wires(0);
+	std::atomic<bool> did_something(false);
+
+	pass->run_on_modules(modules, [&](RTLIL::Module *module) {
+		count_rm_cells = 0;
+		count_rm_wires = 0;
+		module_did_something = false;
+		rmunused_module(module, purge_mode, verbose, true);
+		total_rm_cells += count_rm_cells;
+		total_rm_wires += count_rm_wires;
+		if (module_did_something)
+			did_something = true;
+	});
+
+	if (did_something)
+		design->scratchpad_set_bool("opt.did_something", true);
+	rm_cells = total_rm_cells;
+	rm_wires = total_rm_wires;
 }
 
 struct OptCleanPass : public Pass {
-	OptCleanPass() : Pass("opt_clean", "remove unused cells and wires") { }
+	OptCleanPass() : Pass("opt_clean", "remove unused cells and wires") { module_local(); }
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -669,17 +818,16 @@ struct OptCleanPass : public Pass {
 
 		ct_all.setup(design);
 
-		count_rm_cells = 0;
-		count_rm_wires = 0;
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules_warn())
+			if (!module->has_processes_warn())
+				modules.push_back(module);
 
-		for (auto module : design->selected_whole_modules_warn()) {
-			if (module->has_processes_warn())
-				continue;
-			rmunused_module(module, purge_mode, true, true);
-		}
+		int rm_cells, rm_wires;
+		rmunused_modules(this, design, modules, purge_mode, true, rm_cells, rm_wires);
 
-		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+		if (rm_cells > 0 || rm_wires > 0)
+			log("Removed %d unused cells and %d unused wires.\n", rm_cells, rm_wires);
 
 		design->optimize();
 		design->sort();
@@ -693,7 +841,7 @@ struct OptCleanPass : public Pass {
 } OptCleanPass;
 
 struct CleanPass : public Pass {
-	CleanPass() : Pass("clean", "remove unused cells and wires") { }
+	CleanPass() : Pass("clean", "remove unused cells and wires") { module_local(); }
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -731,18 +879,17 @@ struct CleanPass : public Pass {
 
 		ct_all.setup(design);
 
-		count_rm_cells = 0;
-		count_rm_wires = 0;
+		std::vector<RTLIL::Module*> modules;
+		for (auto module : design->selected_whole_modules())
+			if (!module->has_processes())
+				modules.push_back(module);
 
-		for (auto module : design->selected_whole_modules()) {
-			if (module->has_processes())
-				continue;
-			rmunused_module(module, purge_mode, ys_debug(), true);
-		}
+		int rm_cells, rm_wires;
+		rmunused_modules(this, design, modules, purge_mode, ys_debug(), rm_cells, rm_wires);
 
 		log_suppressed();
-		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+		if (rm_cells > 0 || rm_wires > 0)
+			log("Removed %d unused cells and %d unused wires.\n", rm_cells, rm_wires);
 
 		design->optimize();
 		design->sort();
@@ -29,7 +29,12 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
+#ifdef YOSYS_ENABLE_THREADS
+// modules are optimized in parallel (see Pass::run_on_modules)
+thread_local bool did_something;
+#else
 bool did_something;
+#endif
 
 void replace_undriven(RTLIL::Module *module, const CellTypes &ct)
 {
@@ -117,7 +122,7 @@ void replace_undriven(RTLIL::Module *module, const CellTypes &ct)
 }
 
 void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell,
-		const std::string &info, IdString out_port, RTLIL::SigSpec out_val)
+		const std::string &info, IdString out_port, RTLIL::SigSpec out_val, bool update_map = true)
 {
 	RTLIL::SigSpec Y = cell->getPort(out_port);
 	out_val.extend_u0(Y.size(), false);
@@ -126,12 +131,123 @@ void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell,
 			cell->type.c_str(), cell->name.c_str(), info.c_str(),
 			module->name.c_str(), log_signal(Y), log_signal(out_val));
 	// log_cell(cell);
-	assign_map.add(Y, out_val);
+	if (update_map)
+		assign_map.add(Y, out_val);
 	module->connect(Y, out_val);
 	module->remove(cell);
 	did_something = true;
 }
 
+// Applies the rules of the main loop of replace_const_cells() for $_NOT_,
+// $_AND_ and $_OR_ cells, but only returns the replacement for the output
+// (in info and out_val) instead of making it. This only reads the module,
+// assign_map (which must be compressed) and invert_bits, so it can be called
+// for several cells in parallel.
+bool fold_fine_gate(const RTLIL::Cell *cell, const SigMap &assign_map, const dict<RTLIL::SigBit, RTLIL::SigBit> &invert_bits,
+		bool consume_x, std::string &info, RTLIL::SigSpec &out_val)
+{
+#define FOLD_DO(_s_) do { cover("opt.opt_expr.action_" S__LINE__); info = input.as_string(); out_val = _s_; return true; } while (0)
+#define FOLD_DO_Y(_v_) FOLD_DO(RTLIL::SigSpec(RTLIL::State::S ## _v_))
+
+	if (cell->type == ID($_NOT_))
+	{
+		RTLIL::SigSpec input = assign_map(cell->getPort(ID::A));
+		if (GetSize(input) == 1 && GetSize(cell->getPort(ID::Y)) == 1 && invert_bits.count(input.as_bit())) {
+			cover_list("opt.opt_expr.invert.double", "$_NOT_", "$not", "$logic_not", cell->type.str());
+			info = "double_invert";
+			out_val = invert_bits.at(input.as_bit());
+			return true;
+		}
+		if (input.match("1")) FOLD_DO_Y(0);
+		if (input.match("0")) FOLD_DO_Y(1);
+		if (input.match("*")) FOLD_DO_Y(x);
+		return false;
+	}
+
+	bool is_and = cell->type == ID($_AND_);
+	pool<RTLIL::SigBit> input_bits = assign_map(cell->getPort(ID::A)).to_sigbit_pool();
+	bool found_zero = false, found_one = false, found_undef = false, found_inv = false, many_conconst = false;
+	RTLIL::SigBit non_const_input = State::Sm;
+
+	vector<RTLIL::SigBit> more_bits = assign_map(cell->getPort(ID::B)).to_sigbit_vector();
+	input_bits.insert(more_bits.begin(), more_bits.end());
+
+	for (auto bit : input_bits) {
+		if (bit.wire) {
+			if (invert_bits.count(bit) && input_bits.count(invert_bits.at(bit)))
+				found_inv = true;
+			if (non_const_input != State::Sm)
+				many_conconst = true;
+			non_const_input = many_conconst ? State::Sm : bit;
+		} else {
+			if (bit == State::S0)
+				found_zero = true;
+			else if (bit == State::S1)
+				found_one = true;
+			else
+				found_undef = true;
+		}
+	}
+
+	if (is_and && (found_zero || found_inv || (found_undef && consume_x))) {
+		cover("opt.opt_expr.const_and");
+		info = "const_and";
+		out_val = RTLIL::State::S0;
+		return true;
+	}
+
+	if (!is_and && (found_one || found_inv || (found_undef && consume_x))) {
+		cover("opt.opt_expr.const_or");
+		info = "const_or";
+		out_val = RTLIL::State::S1;
+		return true;
+	}
+
+	if (non_const_input != State::Sm && !found_undef) {
+		cover("opt.opt_expr.and_or_buffer");
+		info = "and_or_buffer";
+		out_val = non_const_input;
+		return true;
+	}
+
+	RTLIL::SigSpec input;
+	input.append(cell->getPort(ID::B));
+	input.append(cell->getPort(ID::A));
+	assign_map.apply(input);
+
+	if (is_and) {
+		if (input.match(" 0")) FOLD_DO_Y(0);
+		if (input.match("0 ")) FOLD_DO_Y(0);
+		if (input.match("11")) FOLD_DO_Y(1);
+		if (input.match("**")) FOLD_DO_Y(x);
+		if (input.match("1*")) FOLD_DO_Y(x);
+		if (input.match("*1")) FOLD_DO_Y(x);
+		if (consume_x) {
+			if (input.match(" *")) FOLD_DO_Y(0);
+			if (input.match("* ")) FOLD_DO_Y(0);
+		}
+		if (input.match(" 1")) FOLD_DO(input.extract(1, 1));
+		if (input.match("1 ")) FOLD_DO(input.extract(0, 1));
+	} else {
+		if (input.match(" 1")) FOLD_DO_Y(1);
+		if (input.match("1 ")) FOLD_DO_Y(1);
+		if (input.match("00")) FOLD_DO_Y(0);
+		if (input.match("**")) FOLD_DO_Y(x);
+		if (input.match("0*")) FOLD_DO_Y(x);
+		if (input.match("*0")) FOLD_DO_Y(x);
+		if (consume_x) {
+			if (input.match(" *")) FOLD_DO_Y(1);
+			if (input.match("* ")) FOLD_DO_Y(1);
+		}
+		if (input.match(" 0")) FOLD_DO(input.extract(1, 1));
+		if (input.match("0 ")) FOLD_DO(input.extract(0, 1));
+	}
+
+#undef FOLD_DO
+#undef FOLD_DO_Y
+	return false;
+}
+
 bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutative, SigMap &sigmap, bool keepdc)
 {
 	IdString b_name = cell->hasPort(ID::B) ? ID::B : ID::A;
@@ -403,45 +519,143 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 	dict<RTLIL::SigSpec, RTLIL::SigSpec> invert_map;
 
 	TopoSort<RTLIL::Cell*, RTLIL::IdString::compare_ptr_by_name<RTLIL::Cell>> cells;
-	dict<RTLIL::Cell*, std::set<RTLIL::SigBit>> cell_to_inbit;
-	dict<RTLIL::SigBit, std::set<RTLIL::Cell*>> outbit_to_cell;
+	cells.analyze_loops = false;
 
+	std::vector<RTLIL::Cell*> cell_list;
 	for (auto cell : module->cells())
-		if (design->selected(module, cell) && cell->type[0] == '$') {
-			if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
-					GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
-			if (cell->type.in(ID($mux), ID($_MUX_)) &&
-					cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
-				invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::S));
-			if (ct_combinational.cell_known(cell->type))
-				for (auto &conn : cell->connections()) {
-					RTLIL::SigSpec sig = assign_map(conn.second);
-					sig.remove_const();
-					if (ct_combinational.cell_input(cell->type, conn.first))
-						cell_to_inbit[cell].insert(sig.begin(), sig.end());
-					if (ct_combinational.cell_output(cell->type, conn.first))
-						for (auto &bit : sig)
-							outbit_to_cell[bit].insert(cell);
-				}
-                        cells.node(cell);
+		if (design->selected(module, cell) && cell->type[0] == '$')
+			cell_list.push_back(cell);
+
+	// Collect the (sigmapped, non-constant) input and output bits of the
+	// combinational cells. This only reads the module, so large modules are
+	// split into chunks that are processed in parallel.
+	std::vector<std::vector<RTLIL::SigBit>> cell_inbits(GetSize(cell_list)), cell_outbits(GetSize(cell_list));
+	const int chunk_size = 4096;
+	assign_map.database.compress();
+
+	yosys_parallel_for((GetSize(cell_list) + chunk_size - 1) / chunk_size, [&](int chunk) {
+		int end = std::min(GetSize(cell_list), (chunk + 1) * chunk_size);
+		for (int i = chunk * chunk_size; i < end; i++) {
+			RTLIL::Cell *cell = cell_list[i];
+			if (!ct_combinational.cell_known(cell->type))
+				continue;
+			for (auto &conn : cell->connections()) {
+				RTLIL::SigSpec sig = assign_map(conn.second);
+				sig.remove_const();
+				if (ct_combinational.cell_input(cell->type, conn.first))
+					cell_inbits[i].insert(cell_inbits[i].end(), sig.begin(), sig.end());
+				if (ct_combinational.cell_output(cell->type, conn.first))
+					cell_outbits[i].insert(cell_outbits[i].end(), sig.begin(), sig.end());
+			}
 		}
+	});
 
-        // Build the graph for the topological sort.
-	for (auto &it_right : cell_to_inbit) {
-          const int r_index = cells.node(it_right.first);
-          for (auto &it_sigbit : it_right.second) {
-            for (auto &it_left : outbit_to_cell[it_sigbit]) {
-              const int l_index = cells.node(it_left);
-              cells.edge(l_index, r_index);
-            }
-          }
-        }
+	std::vector<int> cell_index(GetSize(cell_list));
+	dict<RTLIL::SigBit, std::vector<int>> outbit_to_cell;
+
+	for (int i = 0; i < GetSize(cell_list); i++) {
+		RTLIL::Cell *cell = cell_list[i];
+		if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) &&
+				GetSize(cell->getPort(ID::A)) == 1 && GetSize(cell->getPort(ID::Y)) == 1)
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::A));
+		if (cell->type.in(ID($mux), ID($_MUX_)) &&
+				cell->getPort(ID::A) == SigSpec(State::S1) && cell->getPort(ID::B) == SigSpec(State::S0))
+			invert_map[assign_map(cell->getPort(ID::Y))] = assign_map(cell->getPort(ID::S));
+		for (auto &bit : cell_outbits[i])
+			outbit_to_cell[bit].push_back(i);
+		cell_index[i] = cells.node(cell);
+	}
+
+	// Build the graph for the topological sort.
+	for (int i = 0; i < GetSize(cell_list); i++)
+		for (auto &bit : cell_inbits[i]) {
+			auto it = outbit_to_cell.find(bit);
+			if (it != outbit_to_cell.end())
+				for (int j : it->second)
+					cells.edge(cell_index[j], cell_index[i]);
+		}
 
 	cells.sort();
 
-	for (auto cell : cells.sorted)
+	// In a flattened netlist most cells are $_NOT_, $_AND_ and $_OR_ gates, so
+	// these are folded first, level by level: a gate is put one level after
+	// the gates that drive its inputs, and is left to the main loop below if
+	// any of them is another cell or comes later in cells.sorted (a loop).
+	// The gates of one level are checked in parallel, and their outputs are
+	// mapped to the replacements before the next level is checked. The
+	// module itself is only changed when the main loop gets to the position
+	// of the gate in cells.sorted, so that the module connections are added
+	// in the same order as without the levels, independent of the number of
+	// threads.
+	int num_sorted = GetSize(cells.sorted);
+	std::vector<int> sorted_pos(num_sorted), fine_level(num_sorted, -1);
+	std::vector<bool> feeds_back(num_sorted);
+	std::vector<std::vector<int>> level_gates;
+	dict<int, std::pair<std::string, RTLIL::SigSpec>> fine_folds;
+
+	for (int i = 0; i < num_sorted; i++)
+		sorted_pos[cells.node(cells.sorted[i])] = i;
+
+	for (int i = 0; i < num_sorted; i++)
+		for (int j : cells.edges[cells.node(cells.sorted[i])])
+			if (sorted_pos[j] > i)
+				feeds_back[sorted_pos[j]] = true;
+
+	for (int i = 0; i < num_sorted; i++) {
+		RTLIL::Cell *cell = cells.sorted[i];
+		if (feeds_back[i] || !cell->type.in(ID($_NOT_), ID($_AND_), ID($_OR_)))
+			continue;
+		int level = 0;
+		for (int j : cells.edges[cells.node(cell)]) {
+			if (fine_level[sorted_pos[j]] < 0)
+				goto next_gate;
+			level = std::max(level, fine_level[sorted_pos[j]] + 1);
+		}
+		fine_level[i] = level;
+		if (level == GetSize(level_gates))
+			level_gates.emplace_back();
+		level_gates[level].push_back(i);
+	next_gate:;
+	}
+
+	if (!level_gates.empty())
 	{
+		dict<RTLIL::SigBit, RTLIL::SigBit> invert_bits;
+		for (auto &it : invert_map)
+			invert_bits[it.first.as_bit()] = it.second.as_bit();
+
+		for (auto &gates : level_gates)
+		{
+			std::vector<char> fold(GetSize(gates));
+			std::vector<std::string> info(GetSize(gates));
+			std::vector<RTLIL::SigSpec> out_val(GetSize(gates));
+			assign_map.database.compress();
+
+			yosys_parallel_for((GetSize(gates) + chunk_size - 1) / chunk_size, [&](int chunk) {
+				int end = std::min(GetSize(gates), (chunk + 1) * chunk_size);
+				for (int k = chunk * chunk_size; k < end; k++)
+					fold[k] = fold_fine_gate(cells.sorted[gates[k]], assign_map, invert_bits, consume_x, info[k], out_val[k]);
+			});
+
+			for (int k = 0; k < GetSize(gates); k++)
+				if (fold[k]) {
+					assign_map.add(cells.sorted[gates[k]]->getPort(ID::Y), out_val[k]);
+					fine_folds[gates[k]] = std::make_pair(info[k], out_val[k]);
+				}
+		}
+	}
+
+	for (int i = 0; i < num_sorted; i++)
+	{
+		RTLIL::Cell *cell = cells.sorted[i];
+
+		if (fine_level[i] >= 0) {
+			auto it = fine_folds.find(i);
+			if (it != fine_folds.end())
+				replace_cell(assign_map, module, cell, it->second.first, ID::Y, it->second.second, false);
+			continue;
+		}
+
 #define ACTION_DO(_p_, _s_) do { cover("opt.opt_expr.action_" S__LINE__); replace_cell(assign_map, module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
 #define ACTION_DO_Y(_v_) ACTION_DO(ID::Y, RTLIL::SigSpec(RTLIL::State::S ## _v_))
 
@@ -467,56 +681,61 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			if (cell->type.in(ID($dffe), ID($adffe), ID($aldffe), ID($sdffe), ID($sdffce), ID($dffsre), ID($dlatch), ID($adlatch), ID($dlatchsr)))
 				handle_polarity_inv(cell, ID::EN, ID::EN_POLARITY, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_SR_N?_", "$_SR_P?_", ID::S, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SR_?N_", "$_SR_?P_", ID::R, assign_map, invert_map);
+			// all cell types below are fine-grained FFs and latches, skip
+			// the pattern matching for everything else
+			if (RTLIL::builtin_ff_cell_types().count(cell->type))
+			{
+				handle_clkpol_celltype_swap(cell, "$_SR_N?_", "$_SR_P?_", ID::S, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SR_?N_", "$_SR_?P_", ID::R, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFF_N_", "$_DFF_P_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFF_N_", "$_DFF_P_", ID::C, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFFE_N?_", "$_DFFE_P?_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFE_?N_", "$_DFFE_?P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFE_N?_", "$_DFFE_P?_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFE_?N_", "$_DFFE_?P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFF_N??_", "$_DFF_P??_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFF_?N?_", "$_DFF_?P?_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFF_N??_", "$_DFF_P??_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFF_?N?_", "$_DFF_?P?_", ID::R, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFFE_N???_", "$_DFFE_P???_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFE_?N??_", "$_DFFE_?P??_", ID::R, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFE_???N_", "$_DFFE_???P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFE_N???_", "$_DFFE_P???_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFE_?N??_", "$_DFFE_?P??_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFE_???N_", "$_DFFE_???P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_SDFF_N??_", "$_SDFF_P??_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SDFF_?N?_", "$_SDFF_?P?_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFF_N??_", "$_SDFF_P??_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFF_?N?_", "$_SDFF_?P?_", ID::R, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_SDFFE_N???_", "$_SDFFE_P???_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SDFFE_?N??_", "$_SDFFE_?P??_", ID::R, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SDFFE_???N_", "$_SDFFE_???P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFE_N???_", "$_SDFFE_P???_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFE_?N??_", "$_SDFFE_?P??_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFE_???N_", "$_SDFFE_???P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_SDFFCE_N???_", "$_SDFFCE_P???_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SDFFCE_?N??_", "$_SDFFCE_?P??_", ID::R, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_SDFFCE_???N_", "$_SDFFCE_???P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFCE_N???_", "$_SDFFCE_P???_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFCE_?N??_", "$_SDFFCE_?P??_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_SDFFCE_???N_", "$_SDFFCE_???P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_ALDFF_N?_", "$_ALDFF_P?_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_ALDFF_?N_", "$_ALDFF_?P_", ID::L, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_ALDFF_N?_", "$_ALDFF_P?_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_ALDFF_?N_", "$_ALDFF_?P_", ID::L, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_ALDFFE_N??_", "$_ALDFFE_P??_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_ALDFFE_?N?_", "$_ALDFFE_?P?_", ID::L, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_ALDFFE_??N_", "$_ALDFFE_??P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_ALDFFE_N??_", "$_ALDFFE_P??_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_ALDFFE_?N?_", "$_ALDFFE_?P?_", ID::L, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_ALDFFE_??N_", "$_ALDFFE_??P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFFSR_N??_", "$_DFFSR_P??_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFSR_?N?_", "$_DFFSR_?P?_", ID::S, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFSR_??N_", "$_DFFSR_??P_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSR_N??_", "$_DFFSR_P??_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSR_?N?_", "$_DFFSR_?P?_", ID::S, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSR_??N_", "$_DFFSR_??P_", ID::R, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DFFSRE_N???_", "$_DFFSRE_P???_", ID::C, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFSRE_?N??_", "$_DFFSRE_?P??_", ID::S, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFSRE_??N?_", "$_DFFSRE_??P?_", ID::R, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DFFSRE_???N_", "$_DFFSRE_???P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSRE_N???_", "$_DFFSRE_P???_", ID::C, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSRE_?N??_", "$_DFFSRE_?P??_", ID::S, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSRE_??N?_", "$_DFFSRE_??P?_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DFFSRE_???N_", "$_DFFSRE_???P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DLATCH_N_", "$_DLATCH_P_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCH_N_", "$_DLATCH_P_", ID::E, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DLATCH_N??_", "$_DLATCH_P??_", ID::E, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DLATCH_?N?_", "$_DLATCH_?P?_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCH_N??_", "$_DLATCH_P??_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCH_?N?_", "$_DLATCH_?P?_", ID::R, assign_map, invert_map);
 
-			handle_clkpol_celltype_swap(cell, "$_DLATCHSR_N??_", "$_DLATCHSR_P??_", ID::E, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DLATCHSR_?N?_", "$_DLATCHSR_?P?_", ID::S, assign_map, invert_map);
-			handle_clkpol_celltype_swap(cell, "$_DLATCHSR_??N_", "$_DLATCHSR_??P_", ID::R, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCHSR_N??_", "$_DLATCHSR_P??_", ID::E, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCHSR_?N?_", "$_DLATCHSR_?P?_", ID::S, assign_map, invert_map);
+				handle_clkpol_celltype_swap(cell, "$_DLATCHSR_??N_", "$_DLATCHSR_??P_", ID::R, assign_map, invert_map);
+			}
 		}
 
 		bool detect_const_and = false;
@@ -2215,7 +2434,7 @@ void replace_const_connections(RTLIL::Module *module) {
 }
 
 struct OptExprPass : public Pass {
-	OptExprPass() : Pass("opt_expr", "perform const folding and simple expression rewriting") { }
+	OptExprPass() : Pass("opt_expr", "perform const folding and simple expression rewriting") { module_local(); }
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -2300,7 +2519,9 @@ struct OptExprPass : public Pass {
 		extra_args(args, argidx, design);
 
 		CellTypes ct(design);
-		for (auto module : design->selected_modules())
+		std::atomic<bool> module_did_something(false);
+
+		run_on_modules(design->selected_modules(), [&](RTLIL::Module *module)
 		{
 			log("Optimizing module %s.\n", log_id(module));
 
@@ -2308,7 +2529,7 @@ struct OptExprPass : public Pass {
 				did_something = false;
 				replace_undriven(module, ct);
 				if (did_something)
-					design->scratchpad_set_bool("opt.did_something", true);
+					module_did_something = true;
 			}
 
 			do {
@@ -2316,21 +2537,24 @@ struct OptExprPass : public Pass {
 					did_something = false;
 					replace_const_cells(design, module, false /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
 					if (did_something)
-						design->scratchpad_set_bool("opt.did_something", true);
+						module_did_something = true;
 				} while (did_something);
 				if (!keepdc)
 					replace_const_cells(design, module, true /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
 				if (did_something)
-					design->scratchpad_set_bool("opt.did_something", true);
+					module_did_something = true;
 			} while (did_something);
 
 			did_something = false;
 			replace_const_connections(module);
 			if (did_something)
-				design->scratchpad_set_bool("opt.did_something", true);
+				module_did_something = true;
 
 			log_suppressed();
-		}
+		});
+
+		if (module_did_something)
+			design->scratchpad_set_bool("opt.did_something", true);
 
 		log_pop();
 	}
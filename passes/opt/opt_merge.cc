@@ -22,7 +22,6 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
-#include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <set>
@@ -65,34 +64,15 @@ struct OptMergeWorker
 		}
 	}
 
-	std::string int_to_hash_string(unsigned int v)
+	unsigned int hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
 	{
-		if (v == 0)
-			return "0";
-		std::string str = "";
-		while (v > 0) {
-			str += 'a' + (v & 15);
-			v = v >> 4;
-		}
-		return str;
-	}
-
-        uint64_t hash_cell_parameters_and_connections(const RTLIL::Cell *cell)
-	{
-		vector<string> hash_conn_strings;
-		std::string hash_string = cell->type.str() + "\n";
-
 		const dict<RTLIL::IdString, RTLIL::SigSpec> *conn = &cell->connections();
 		dict<RTLIL::IdString, RTLIL::SigSpec> alt_conn;
+		bool commutative = false;
 
 		if (cell->type.in(ID($and), ID($or), ID($xor), ID($xnor), ID($add), ID($mul),
 				ID($logic_and), ID($logic_or), ID($_AND_), ID($_OR_), ID($_XOR_))) {
-			alt_conn = *conn;
-			if (assign_map(alt_conn.at(ID::A)) < assign_map(alt_conn.at(ID::B))) {
-				alt_conn[ID::A] = conn->at(ID::B);
-				alt_conn[ID::B] = conn->at(ID::A);
-			}
-			conn = &alt_conn;
+			commutative = true;
 		} else
 		if (cell->type.in(ID($reduce_xor), ID($reduce_xnor))) {
 			alt_conn = *conn;
@@ -115,6 +95,10 @@ struct OptMergeWorker
 			conn = &alt_conn;
 		}
 
+		// the connections and the parameters are summed up, so that their
+		// order doesn't matter, and the A and B inputs of commutative cells
+		// are hashed as if they were connected to the same port
+		unsigned int conn_hash = 0;
 		for (auto &it : *conn) {
 			RTLIL::SigSpec sig;
 			if (cell->output(it.first)) {
@@ -128,27 +112,15 @@ struct OptMergeWorker
 			}
 			else
 				sig = assign_map(it.second);
-			string s = "C " + it.first.str() + "=";
-			for (auto &chunk : sig.chunks()) {
-				if (chunk.wire)
-					s += "{" + chunk.wire->name.str() + " " +
-							int_to_hash_string(chunk.offset) + " " +
-							int_to_hash_string(chunk.width) + "}";
-				else
-					s += RTLIL::Const(chunk.data).as_string();
-			}
-			hash_conn_strings.push_back(s + "\n");
+			RTLIL::IdString port = commutative && it.first == ID::B ? ID::A : it.first;
+			conn_hash += mkhash(port.hash(), sig.hash());
 		}
 
+		unsigned int param_hash = 0;
 		for (auto &it : cell->parameters)
-			hash_conn_strings.push_back("P " + it.first.str() + "=" + it.second.as_string() + "\n");
-
-		std::sort(hash_conn_strings.begin(), hash_conn_strings.end());
-
-		for (auto it : hash_conn_strings)
-			hash_string += it;
+			param_hash += mkhash(it.first.hash(), it.second.hash());
 
-		return std::hash<std::string>{}(hash_string);
+		return mkhash(mkhash(cell->type.hash(), conn_hash), param_hash);
 	}
 
 	bool compare_cell_parameters_and_connections(const RTLIL::Cell *cell1, const RTLIL::Cell *cell2)
@@ -217,6 +189,61 @@ struct OptMergeWorker
 		return conn1 == conn2;
 	}
 
+	// The distinct cells by the hash of their normalized inputs, and the
+	// hash each of them was filed under. The hash of a cell is outdated once
+	// its inputs are redirected, so a cell is removed by its pointer and not
+	// by comparing it with the cells of its bucket.
+	dict<unsigned int, std::vector<RTLIL::Cell*>> sharemap;
+	dict<RTLIL::Cell*, unsigned int> hashed;
+	dict<RTLIL::SigBit, std::vector<RTLIL::Cell*>> readers;
+
+	// these also hold cells that were already removed from the module, so
+	// they must not be hashed with Cell::hash()
+	pool<RTLIL::Cell*, hash_ptr_ops> queued, removed;
+
+	// Connects the outputs of a merged cell to the outputs of the cell that
+	// replaces it, and queues the cells whose normalized inputs change.
+	void redirect(const RTLIL::SigSpec &sig, const RTLIL::SigSpec &other_sig, std::vector<RTLIL::Cell*> &queue)
+	{
+		std::vector<RTLIL::SigBit> old_bits = assign_map(sig).to_sigbit_vector();
+		std::vector<RTLIL::SigBit> other_old_bits = assign_map(other_sig).to_sigbit_vector();
+		old_bits.insert(old_bits.end(), other_old_bits.begin(), other_old_bits.end());
+
+		assign_map.add(sig, other_sig);
+
+		for (int i = 0; i < GetSize(old_bits); i++) {
+			RTLIL::SigBit old_bit = old_bits[i];
+			RTLIL::SigBit new_bit = assign_map(sig[i % GetSize(sig)]);
+			if (old_bit == new_bit)
+				continue;
+			auto it = readers.find(old_bit);
+			if (it == readers.end())
+				continue;
+			std::vector<RTLIL::Cell*> cells = std::move(it->second);
+			readers.erase(it);
+			for (auto cell : cells)
+				if (!removed.count(cell) && queued.insert(cell).second)
+					queue.push_back(cell);
+			if (new_bit.wire != nullptr) {
+				std::vector<RTLIL::Cell*> &new_readers = readers[new_bit];
+				new_readers.insert(new_readers.end(), cells.begin(), cells.end());
+			}
+		}
+	}
+
+	void unshare(RTLIL::Cell *cell)
+	{
+		auto hashed_it = hashed.find(cell);
+		if (hashed_it == hashed.end())
+			return;
+		auto bucket_it = sharemap.find(hashed_it->second);
+		std::vector<RTLIL::Cell*> &bucket = bucket_it->second;
+		bucket.erase(std::find(bucket.begin(), bucket.end(), cell));
+		if (bucket.empty())
+			sharemap.erase(bucket_it);
+		hashed.erase(hashed_it);
+	}
+
 	bool has_dont_care_initval(const RTLIL::Cell *cell)
 	{
 		if (!RTLIL::builtin_ff_cell_types().count(cell->type))
@@ -251,62 +278,82 @@ struct OptMergeWorker
 
 		initvals.set(&assign_map, module);
 
-		bool did_something = true;
-		while (did_something)
+		// cells are merged in module order first, and after that the cells
+		// whose inputs changed because the outputs of a merged cell were
+		// redirected are hashed and looked up again, until nothing changes
+		std::vector<RTLIL::Cell*> queue;
+		queue.reserve(module->cells_.size());
+		for (auto &it : module->cells_) {
+			RTLIL::Cell *cell = it.second;
+			if (!design->selected(module, cell))
+				continue;
+			if (mode_keepdc && has_dont_care_initval(cell))
+				continue;
+			if ((!mode_share_all && !ct.cell_known(cell->type)) || !cell->known())
+				continue;
+			if (cell->type == ID($scopeinfo))
+				continue;
+			queue.push_back(cell);
+			queued.insert(cell);
+			for (auto &conn : cell->connections())
+				if (!cell->output(conn.first))
+					for (auto bit : assign_map(conn.second))
+						if (bit.wire != nullptr)
+							readers[bit].push_back(cell);
+		}
+
+		for (int i = 0; i < GetSize(queue); i++)
 		{
-			std::vector<RTLIL::Cell*> cells;
-			cells.reserve(module->cells_.size());
-			for (auto &it : module->cells_) {
-				if (!design->selected(module, it.second))
-					continue;
-				if (mode_keepdc && has_dont_care_initval(it.second))
-					continue;
-				if (ct.cell_known(it.second->type) || (mode_share_all && it.second->known()))
-					cells.push_back(it.second);
-			}
+			RTLIL::Cell *cell = queue[i];
+			queued.erase(cell);
+			if (removed.count(cell))
+				continue;
 
-			did_something = false;
-                        dict<uint64_t, RTLIL::Cell*> sharemap;
-			for (auto cell : cells)
-			{
-				if ((!mode_share_all && !ct.cell_known(cell->type)) || !cell->known())
-					continue;
+			unshare(cell);
 
-				if (cell->type == ID($scopeinfo))
+			unsigned int hash = hash_cell_parameters_and_connections(cell);
+			RTLIL::Cell *other = nullptr;
+			auto bucket_it = sharemap.find(hash);
+			if (bucket_it != sharemap.end())
+				for (auto c : bucket_it->second)
+					if (compare_cell_parameters_and_connections(cell, c)) {
+						other = c;
+						break;
+					}
+
+			if (other == nullptr) {
+				sharemap[hash].push_back(cell);
+				hashed[cell] = hash;
+				continue;
+			}
+
+			if (cell->has_keep_attr()) {
+				if (other->has_keep_attr())
 					continue;
+				unshare(other);
+				sharemap[hash].push_back(cell);
+				hashed[cell] = hash;
+				std::swap(other, cell);
+			}
 
-				uint64_t hash = hash_cell_parameters_and_connections(cell);
-				auto r = sharemap.insert(std::make_pair(hash, cell));
-				if (!r.second) {
-					if (compare_cell_parameters_and_connections(cell, r.first->second)) {
-						if (cell->has_keep_attr()) {
-							if (r.first->second->has_keep_attr())
-								continue;
-							std::swap(r.first->second, cell);
-						}
-
-
-						did_something = true;
-						log_debug("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), r.first->second->name.c_str());
-						for (auto &it : cell->connections()) {
-							if (cell->output(it.first)) {
-								RTLIL::SigSpec other_sig = r.first->second->getPort(it.first);
-								log_debug("    Redirecting output %s: %s = %s\n", it.first.c_str(),
-										log_signal(it.second), log_signal(other_sig));
-								Const init = initvals(other_sig);
-								initvals.remove_init(it.second);
-								initvals.remove_init(other_sig);
-								module->connect(RTLIL::SigSig(it.second, other_sig));
-								assign_map.add(it.second, other_sig);
-								initvals.set_init(other_sig, init);
-							}
-						}
-						log_debug("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
-						module->remove(cell);
-						total_count++;
-					}
+			log_debug("  Cell `%s' is identical to cell `%s'.\n", cell->name.c_str(), other->name.c_str());
+			for (auto &it : cell->connections()) {
+				if (cell->output(it.first)) {
+					RTLIL::SigSpec other_sig = other->getPort(it.first);
+					log_debug("    Redirecting output %s: %s = %s\n", it.first.c_str(),
+							log_signal(it.second), log_signal(other_sig));
+					Const init = initvals(other_sig);
+					initvals.remove_init(it.second);
+					initvals.remove_init(other_sig);
+					module->connect(RTLIL::SigSig(it.second, other_sig));
+					redirect(it.second, other_sig, queue);
+					initvals.set_init(other_sig, init);
 				}
 			}
+			log_debug("    Removing %s cell `%s' from module `%s'.\n", cell->type.c_str(), cell->name.c_str(), module->name.c_str());
+			removed.insert(cell);
+			module->remove(cell);
+			total_count++;
 		}
 
 		log_suppressed();
@@ -314,7 +361,7 @@ struct OptMergeWorker
 };
 
 struct OptMergePass : public Pass {
-	OptMergePass() : Pass("opt_merge", "consolidate identical cells") { }
+	OptMergePass() : Pass("opt_merge", "consolidate identical cells") { module_local(); }
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -361,15 +408,15 @@ struct OptMergePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules()) {
+		std::atomic<int> total_count(0);
+		run_on_modules(design->selected_modules(), [&](RTLIL::Module *module) {
 			OptMergeWorker worker(design, module, mode_nomux, mode_share_all, mode_keepdc);
 			total_count += worker.total_count;
-		}
+		});
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
-		log("Removed a total of %d cells.\n", total_count);
+		log("Removed a total of %d cells.\n", int(total_count));
 	}
 } OptMergePass;
 
@@ -466,7 +466,7 @@ struct WreduceWorker
 };
 
 struct WreducePass : public Pass {
-	WreducePass() : Pass("wreduce", "reduce the word size of operations if possible") { }
+	WreducePass() : Pass("wreduce", "reduce the word size of operations if possible") { module_local(); }
 	void help() override
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
@@ -518,10 +518,10 @@ struct WreducePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		for (auto module : design->selected_modules())
+		run_on_modules(design->selected_modules(), [&](RTLIL::Module *module)
 		{
 			if (module->has_processes_warn())
-				continue;
+				return;
 
 			for (auto c : module->selected_cells())
 			{
@@ -592,7 +592,7 @@ struct WreducePass : public Pass {
 
 			WreduceWorker worker(&config, module);
 			worker.run();
-		}
+		});
 	}
 } WreducePass;
 
@@ -464,6 +464,9 @@ struct DfflibmapPass : public Pass {
 		log("This argument can be called multiple times with different cell names. This\n");
 		log("argument also supports simple glob patterns in the cell name.\n");
 		log("\n");
+		log("The scratchpad variable 'liberty.cache_dir' selects a cache directory for the\n");
+		log("parsed liberty file (see 'help read_liberty').\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -519,11 +522,18 @@ struct DfflibmapPass : public Pass {
 		if (liberty_file.empty())
 			log_cmd_error("Missing `-liberty liberty_file' option!\n");
 
+		// the parts of the library used by find_cell() and find_cell_sr()
+		static const std::set<std::string> liberty_filter = {
+			"/library/cell", "/library/cell/area", "/library/cell/dont_use",
+			"/library/cell/ff", "/library/cell/ff/*", "/library/cell/pin",
+			"/library/cell/pin/direction", "/library/cell/pin/function"
+		};
+
 		std::ifstream f;
 		f.open(liberty_file.c_str());
 		if (f.fail())
 			log_cmd_error("Can't open liberty file `%s': %s\n", liberty_file.c_str(), strerror(errno));
-		LibertyParser libparser(f);
+		LibertyParser libparser(f, liberty_file, liberty_filter, design->scratchpad_get_string("liberty.cache_dir"));
 		f.close();
 
 		find_cell(libparser.ast, ID($_DFF_N_), false, false, false, false, dont_use_cells);
@@ -28,6 +28,8 @@
 
 #ifndef FILTERLIB
 #include "kernel/log.h"
+#include "libs/sha1/sha1.h"
+#include <sys/stat.h>
 #endif
 
 using namespace Yosys;
@@ -35,13 +37,6 @@ using namespace Yosys;
 std::set<std::string> LibertyAst::blacklist;
 std::set<std::string> LibertyAst::whitelist;
 
-LibertyAst::~LibertyAst()
-{
-	for (auto child : children)
-		delete child;
-	children.clear();
-}
-
 LibertyAst *LibertyAst::find(std::string name)
 {
 	for (auto child : children)
@@ -83,106 +78,139 @@ void LibertyAst::dump(FILE *f, std::string indent, std::string path, bool path_o
 		fprintf(f, " ;\n");
 }
 
+LibertyParser::LibertyParser(std::istream &f) : line(1)
+{
+	read(f);
+	ast = parse();
+}
+
+LibertyAst *LibertyParser::new_node()
+{
+	if (node_count == node_blocks.size() * node_block_size)
+		node_blocks.emplace_back(new LibertyAst[node_block_size]);
+	LibertyAst *node = &node_blocks[node_count / node_block_size][node_count % node_block_size];
+	node_count++;
+	return node;
+}
+
+void LibertyParser::free_nodes(size_t count)
+{
+	while (node_count > count) {
+		node_count--;
+		node_blocks[node_count / node_block_size][node_count % node_block_size] = LibertyAst();
+	}
+}
+
+void LibertyParser::read(std::istream &f)
+{
+	char chunk[1 << 16];
+	buffer.clear();
+	while (f.read(chunk, sizeof(chunk)) || f.gcount() > 0)
+		buffer.append(chunk, f.gcount());
+	ptr = buffer.data();
+	end = ptr + buffer.size();
+}
+
 int LibertyParser::lexer(std::string &str)
 {
 	int c;
 
-	// eat whitespace
-	do {
-		c = f.get();
-	} while (c == ' ' || c == '\t' || c == '\r');
-
-	// search for identifiers, numbers, plus or minus.
-	if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-' || c == '+' || c == '.') {
-		str = static_cast<char>(c);
-		while (1) {
-			c = f.get();
-			if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-' || c == '+' || c == '.')
-				str += c;
-			else
-				break;
-		}
-		f.unget();
-		if (str == "+" || str == "-") {
-			/* Single operator is not an identifier */
-			// fprintf(stderr, "LEX: char >>%s<<\n", str.c_str());
-			return str[0];
+	while (1)
+	{
+		// eat whitespace
+		do {
+			c = ptr != end ? (unsigned char)*ptr++ : EOF;
+		} while (c == ' ' || c == '\t' || c == '\r');
+
+		// search for identifiers, numbers, plus or minus.
+		if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-' || c == '+' || c == '.') {
+			const char *start = ptr - 1;
+			while (ptr != end) {
+				c = *ptr;
+				if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_' || c == '-' || c == '+' || c == '.')
+					ptr++;
+				else
+					break;
+			}
+			str.assign(start, ptr);
+			if (str == "+" || str == "-") {
+				/* Single operator is not an identifier */
+				return str[0];
+			}
+			else {
+				return 'v';
+			}
 		}
-		else {
-			// fprintf(stderr, "LEX: identifier >>%s<<\n", str.c_str());
+
+		// if it wasn't an identifer, number of array range,
+		// maybe it's a string?
+		if (c == '"') {
+			const char *start = ptr;
+			while (ptr != end && *ptr != '"') {
+				if (*ptr == '\n')
+					line++;
+				ptr++;
+			}
+			str.assign(start, ptr);
+			if (ptr != end)
+				ptr++;
 			return 'v';
 		}
-	}
 
-	// if it wasn't an identifer, number of array range,
-	// maybe it's a string?
-	if (c == '"') {
-		str = "";
-		while (1) {
-			c = f.get();
-			if (c == '\n')
+		// if it wasn't a string, perhaps it's a comment or a forward slash?
+		if (c == '/') {
+			if (ptr != end && *ptr == '*') {         // start of '/*' block comment
+				for (ptr++; ptr != end; ptr++) {
+					if (*ptr == '\n')
+						line++;
+					if (*ptr == '/' && ptr[-1] == '*') {
+						ptr++;
+						break;
+					}
+				}
+				continue;
+			} else if (ptr != end && *ptr == '/') {  // start of '//' line comment
+				while (ptr != end && *ptr != '\n')
+					ptr++;
+				if (ptr != end)
+					ptr++;
 				line++;
-			if (c == '"')
-				break;
-			str += c;
+				continue;
+			}
+			return '/';             // a single '/' charater.
 		}
-		// fprintf(stderr, "LEX: string >>%s<<\n", str.c_str());
-		return 'v';
-	}
 
-	// if it wasn't a string, perhaps it's a comment or a forward slash?
-	if (c == '/') {
-		c = f.get();
-		if (c == '*') {         // start of '/*' block comment
-			int last_c = 0;
-			while (c > 0 && (last_c != '*' || c != '/')) {
-				last_c = c;
-				c = f.get();
-				if (c == '\n')
-					line++;
+		// check for a backslash
+		if (c == '\\') {
+			const char *next = ptr;
+			if (next != end && *next == '\r')
+				next++;
+			if (next != end && *next == '\n') {
+				ptr = next + 1;
+				line++;
+				continue;
 			}
-			return lexer(str);
-		} else if (c == '/') {  // start of '//' line comment
-			while (c > 0 && c != '\n')
-				c = f.get();
-			line++;
-			return lexer(str);
+			return '\\';
 		}
-		f.unget();
-		// fprintf(stderr, "LEX: char >>/<<\n");
-		return '/';             // a single '/' charater.
-	}
 
-	// check for a backslash
-	if (c == '\\') {
-		c = f.get();		
-		if (c == '\r')
-			c = f.get();
+		// check for a new line
 		if (c == '\n') {
 			line++;
-			return lexer(str);
+			return 'n';
 		}
-		f.unget();
-		return '\\';
-	}
 
-	// check for a new line
-	if (c == '\n') {
-		line++;
-		return 'n';
+		// anything else, such as ';' will get passed
+		// through as literal items.
+		return c;
 	}
+}
 
-	// anything else, such as ';' will get passed
-	// through as literal items.
-
-	// if (c >= 32 && c < 255)
-	// 	fprintf(stderr, "LEX: char >>%c<<\n", c);
-	// else
-	// 	fprintf(stderr, "LEX: char %d\n", c);
-	return c;
+bool LibertyParser::keep(const std::string &path, const std::string &id, bool path_ok)
+{
+	return path_ok || filter.count(id) > 0 || filter.count(path) > 0;
 }
 
-LibertyAst *LibertyParser::parse()
+LibertyAst *LibertyParser::parse(const std::string &parent_path, bool parent_ok)
 {
 	std::string str;
 
@@ -222,7 +250,7 @@ LibertyAst *LibertyParser::parse()
 		}
 	}
 
-	LibertyAst *ast = new LibertyAst;
+	LibertyAst *ast = new_node();
 	ast->id = str;
 
 	while (1)
@@ -260,13 +288,18 @@ LibertyAst *LibertyParser::parse()
 		}
 
 		if (tok == '(') {
+			size_t arg_mark = arg_stack.size();
 			while (1) {
 				std::string arg;
 				tok = lexer(arg);
 				if (tok == ',')
 					continue;
-				if (tok == ')')
+				if (tok == ')') {
+					ast->args.insert(ast->args.end(), std::make_move_iterator(arg_stack.begin() + arg_mark),
+							std::make_move_iterator(arg_stack.end()));
+					arg_stack.resize(arg_mark);
 					break;
+				}
 				
 				// FIXME: the AST needs to be extended to store
 				//        these vector ranges.
@@ -330,18 +363,31 @@ LibertyAst *LibertyParser::parse()
 						error();
 					}
 				}
-				ast->args.push_back(arg);
+				arg_stack.push_back(std::move(arg));
 			}
 			continue;
 		}
 
 		if (tok == '{') {
+			std::string path;
+			bool path_ok = parent_ok;
+			if (!filter.empty()) {
+				path = parent_path + "/" + ast->id;
+				path_ok = path_ok || filter.count(path + "/*") > 0;
+			}
+			size_t child_mark = child_stack.size();
 			while (1) {
-				LibertyAst *child = parse();
+				size_t node_mark = node_count;
+				LibertyAst *child = parse(path, path_ok);
 				if (child == NULL)
 					break;
-				ast->children.push_back(child);
+				if (filter.empty() || keep(path + "/" + child->id, child->id, path_ok))
+					child_stack.push_back(child);
+				else
+					free_nodes(node_mark);
 			}
+			ast->children.assign(child_stack.begin() + child_mark, child_stack.end());
+			child_stack.resize(child_mark);
 			break;
 		}
 
@@ -353,6 +399,243 @@ LibertyAst *LibertyParser::parse()
 
 #ifndef FILTERLIB
 
+/*
+The cache file holds the magic line, the cache key, the SHA1 hash of the
+contents of the liberty file and then the nodes in preorder. A node is stored as its id, value, the number of args and the args,
+and the number of children. Numbers are stored as LEB128 varints. A string is
+stored as twice its size followed by its contents when it is first used, and
+later as one plus twice the index of its first use, since the same ids and
+values come up over and over again in a liberty file.
+*/
+static const char liberty_cache_magic[] = "Yosys liberty cache 3\n";
+
+struct LibertyCacheWriter
+{
+	std::string out;
+	dict<std::string, size_t> strings;
+
+	void put_count(size_t count)
+	{
+		while (count >= 0x80) {
+			out += char(count | 0x80);
+			count >>= 7;
+		}
+		out += char(count);
+	}
+
+	void put_string(const std::string &str)
+	{
+		auto it = strings.find(str);
+		if (it != strings.end()) {
+			put_count(2 * it->second + 1);
+			return;
+		}
+		strings.emplace(str, strings.size());
+		put_count(2 * str.size());
+		out += str;
+	}
+
+	void put_node(const LibertyAst *node)
+	{
+		put_string(node->id);
+		put_string(node->value);
+		put_count(node->args.size());
+		for (auto &arg : node->args)
+			put_string(arg);
+		put_count(node->children.size());
+		for (auto child : node->children)
+			put_node(child);
+	}
+};
+
+struct Yosys::LibertyCacheReader
+{
+	const char *ptr, *end;
+	std::vector<std::string> strings;
+
+	bool get_count(size_t &count)
+	{
+		count = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (ptr == end)
+				return false;
+			unsigned char byte = *ptr++;
+			count |= size_t(byte & 0x7f) << shift;
+			if ((byte & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	bool get_string(std::string &str)
+	{
+		size_t code;
+		if (!get_count(code))
+			return false;
+		if (code & 1) {
+			if (code / 2 >= strings.size())
+				return false;
+			str = strings[code / 2];
+			return true;
+		}
+		if (code / 2 > size_t(end - ptr))
+			return false;
+		str.assign(ptr, code / 2);
+		ptr += code / 2;
+		strings.push_back(str);
+		return true;
+	}
+};
+
+LibertyParser::LibertyParser(std::istream &f, const std::string &filename, const std::set<std::string> &filter, const std::string &cache_dir) :
+		ptr(nullptr), end(nullptr), line(1), ast(nullptr), filter(filter)
+{
+	std::string key, cache_file;
+
+	if (!cache_dir.empty())
+		key = cache_key(filename);
+
+	if (!key.empty()) {
+		SHA1 sha1;
+		sha1.update(key);
+		cache_file = cache_dir + "/" + sha1.final() + ".libcache";
+	}
+
+	read(f);
+
+	if (!cache_file.empty() && load_cache(cache_file, key)) {
+		log("Loaded liberty file `%s' from cache file `%s'.\n", filename.c_str(), cache_file.c_str());
+		return;
+	}
+
+	ast = parse();
+
+	if (!cache_file.empty() && ast != nullptr && save_cache(cache_file, key))
+		log("Stored liberty file `%s' in cache file `%s'.\n", filename.c_str(), cache_file.c_str());
+}
+
+std::string LibertyParser::cache_key(const std::string &filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return std::string();
+
+	// a relative name refers to different files depending on the working
+	// directory, so the key uses the canonical absolute path
+#ifdef _WIN32
+	char *path = _fullpath(nullptr, filename.c_str(), 0);
+#else
+	char *path = realpath(filename.c_str(), nullptr);
+#endif
+	if (path == nullptr)
+		return std::string();
+	std::string abs_filename = path;
+	free(path);
+
+	// the modification time in seconds alone misses edits made within the
+	// same second as the previous write, so the nanoseconds are included
+	// where the platform provides them
+#if defined(__APPLE__)
+	long long mtime_nsec = st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+	long long mtime_nsec = 0;
+#else
+	long long mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+	std::string key = stringf("%s\n%lld\n%lld.%09lld\n", abs_filename.c_str(), (long long)st.st_size, (long long)st.st_mtime, mtime_nsec);
+	for (auto &path : filter)
+		key += path + "\n";
+	return key;
+}
+
+bool LibertyParser::load_cache(const std::string &cache_file, const std::string &key)
+{
+	FileContents contents;
+	if (!contents.map(cache_file))
+		return false;
+
+	size_t magic_size = strlen(liberty_cache_magic);
+	if (contents.size() < magic_size || memcmp(contents.begin(), liberty_cache_magic, magic_size) != 0)
+		return false;
+
+	LibertyCacheReader reader;
+	reader.ptr = contents.begin() + magic_size;
+	reader.end = contents.end();
+
+	std::string cached_key;
+	if (!reader.get_string(cached_key) || cached_key != key)
+		return false;
+
+	// the file has the same size and modification time, so it is most likely
+	// unchanged, but this is only known for sure after comparing the contents
+	std::string cached_hash;
+	if (!reader.get_string(cached_hash) || cached_hash != content_hash())
+		return false;
+
+	ast = new_node();
+	if (!load_node(reader, ast) || reader.ptr != reader.end) {
+		free_nodes(0);
+		ast = nullptr;
+		return false;
+	}
+	return true;
+}
+
+std::string LibertyParser::content_hash() const
+{
+	SHA1 sha1;
+	sha1.update(buffer);
+	return sha1.final();
+}
+
+bool LibertyParser::load_node(LibertyCacheReader &reader, LibertyAst *node)
+{
+	size_t count;
+	if (!reader.get_string(node->id) || !reader.get_string(node->value) || !reader.get_count(count))
+		return false;
+	if (count > size_t(reader.end - reader.ptr))
+		return false;
+	node->args.resize(count);
+	for (auto &arg : node->args)
+		if (!reader.get_string(arg))
+			return false;
+	if (!reader.get_count(count) || count > size_t(reader.end - reader.ptr))
+		return false;
+	node->children.resize(count);
+	for (auto &child : node->children) {
+		child = new_node();
+		if (!load_node(reader, child))
+			return false;
+	}
+	return true;
+}
+
+bool LibertyParser::save_cache(const std::string &cache_file, const std::string &key)
+{
+	LibertyCacheWriter writer;
+	writer.out = liberty_cache_magic;
+	writer.put_string(key);
+	writer.put_string(content_hash());
+	writer.put_node(ast);
+	const std::string &out = writer.out;
+
+	// write to a temporary file first, so that concurrent runs never see a
+	// partially written cache file
+	std::string cache_dir = cache_file.substr(0, cache_file.rfind('/'));
+	create_directory(cache_dir);
+	std::string temp_file = make_temp_file(cache_file + ".XXXXXX");
+	std::ofstream f(temp_file, std::ofstream::binary | std::ofstream::trunc);
+	f.write(out.data(), out.size());
+	f.close();
+
+	if (f.fail() || rename(temp_file.c_str(), cache_file.c_str()) != 0) {
+		remove(temp_file.c_str());
+		log_warning("Can't write liberty cache file `%s'.\n", cache_file.c_str());
+		return false;
+	}
+	return true;
+}
+
 void LibertyParser::error()
 {
 	log_error("Syntax error in liberty file on line %d.\n", line);
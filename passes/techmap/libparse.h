@@ -24,6 +24,7 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <memory>
 
 namespace Yosys
 {
@@ -31,21 +32,37 @@ namespace Yosys
 	{
 		std::string id, value;
 		std::vector<std::string> args;
+		// the nodes are owned by the LibertyParser that created them
 		std::vector<LibertyAst*> children;
-		~LibertyAst();
 		LibertyAst *find(std::string name);
 		void dump(FILE *f, std::string indent = "", std::string path = "", bool path_ok = false);
 		static std::set<std::string> blacklist;
 		static std::set<std::string> whitelist;
 	};
 
+	struct LibertyCacheReader;
+
 	struct LibertyParser
 	{
-		std::istream &f;
+		std::string buffer;
+		const char *ptr, *end;
 		int line;
 		LibertyAst *ast;
-		LibertyParser(std::istream &f) : f(f), line(1), ast(parse()) {}
-		~LibertyParser() { if (ast) delete ast; }
+
+		// Paths of the nodes to keep, using the syntax of the whitelist of
+		// LibertyAst::dump(). All nodes are kept if this is empty.
+		std::set<std::string> filter;
+
+		LibertyParser(std::istream &f);
+#ifndef FILTERLIB
+		// Like above, but only keeps the nodes selected by filter. If cache_dir
+		// is not empty, the kept nodes are also stored in a cache file in that
+		// directory, keyed by the absolute path, size and modification time
+		// (with nanoseconds) of the file and by the filter. A later parser for
+		// the same file and filter loads the nodes from the cache instead of
+		// parsing f, if the contents of f still have the same SHA1 hash.
+		LibertyParser(std::istream &f, const std::string &filename, const std::set<std::string> &filter, const std::string &cache_dir);
+#endif
         
         /* lexer return values:
            'v': identifier, string, array range [...] -> str holds the token string
@@ -54,9 +71,34 @@ namespace Yosys
         */
 		int lexer(std::string &str);
 		
-        LibertyAst *parse();
+        LibertyAst *parse(const std::string &parent_path = "", bool parent_ok = false);
 		void error();
         void error(const std::string &str);
+
+	private:
+		// The nodes are allocated in blocks of node_block_size nodes, which
+		// are freed together with the parser.
+		static const size_t node_block_size = 1024;
+		std::vector<std::unique_ptr<LibertyAst[]>> node_blocks;
+		size_t node_count = 0;
+
+		// args and children of the nodes that are being parsed
+		std::vector<std::string> arg_stack;
+		std::vector<LibertyAst*> child_stack;
+
+		LibertyAst *new_node();
+		// frees the nodes allocated after the first count nodes
+		void free_nodes(size_t count);
+
+		void read(std::istream &f);
+		bool keep(const std::string &path, const std::string &id, bool path_ok);
+#ifndef FILTERLIB
+		std::string cache_key(const std::string &filename);
+		std::string content_hash() const;
+		bool load_cache(const std::string &cache_file, const std::string &key);
+		bool load_node(LibertyCacheReader &reader, LibertyAst *node);
+		bool save_cache(const std::string &cache_file, const std::string &key);
+#endif
 	};
 }
 
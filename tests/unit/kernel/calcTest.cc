@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/rtlil.h"
+
+#include <random>
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+RTLIL::Const random_const(std::mt19937 &rng, int width, bool with_undef)
+{
+	RTLIL::Const val(RTLIL::State::S0, width);
+	for (auto &bit : val.bits) {
+		int r = rng() % (with_undef ? 8 : 2);
+		bit = r == 0 ? RTLIL::State::S0 : r == 1 ? RTLIL::State::S1 :
+				r < 5 ? RTLIL::State::S0 : r < 7 ? RTLIL::State::S1 : r == 7 ? RTLIL::State::Sx : RTLIL::State::Sz;
+	}
+	return val;
+}
+
+// Extends a constant past 64 bits without changing its value, which makes
+// the functions in calc.cc take their BigInteger path.
+RTLIL::Const widen(RTLIL::Const val, bool is_signed)
+{
+	RTLIL::State fill = is_signed && !val.bits.empty() ? val.bits.back() : RTLIL::State::S0;
+	val.bits.resize(70, fill);
+	return val;
+}
+
+RTLIL::State ref_and(RTLIL::State a, RTLIL::State b)
+{
+	if (a == RTLIL::State::S0 || b == RTLIL::State::S0) return RTLIL::State::S0;
+	if (a == RTLIL::State::S1 && b == RTLIL::State::S1) return RTLIL::State::S1;
+	return RTLIL::State::Sx;
+}
+
+RTLIL::State ref_or(RTLIL::State a, RTLIL::State b)
+{
+	if (a == RTLIL::State::S1 || b == RTLIL::State::S1) return RTLIL::State::S1;
+	if (a == RTLIL::State::S0 && b == RTLIL::State::S0) return RTLIL::State::S0;
+	return RTLIL::State::Sx;
+}
+
+RTLIL::State ref_xor(RTLIL::State a, RTLIL::State b)
+{
+	if (a != RTLIL::State::S0 && a != RTLIL::State::S1) return RTLIL::State::Sx;
+	if (b != RTLIL::State::S0 && b != RTLIL::State::S1) return RTLIL::State::Sx;
+	return a != b ? RTLIL::State::S1 : RTLIL::State::S0;
+}
+
+}
+
+TEST(KernelCalcTest, BitwiseMatchesPerBit)
+{
+	std::mt19937 rng(1);
+	for (int round = 0; round < 2000; round++) {
+		int width = 1 + rng() % 150;
+		RTLIL::Const a = random_const(rng, width, true);
+		RTLIL::Const b = random_const(rng, width, true);
+
+		RTLIL::Const y_and = RTLIL::const_and(a, b, false, false, width);
+		RTLIL::Const y_or = RTLIL::const_or(a, b, false, false, width);
+		RTLIL::Const y_xor = RTLIL::const_xor(a, b, false, false, width);
+		RTLIL::Const y_not = RTLIL::const_not(a, RTLIL::Const(), false, false, width);
+
+		for (int i = 0; i < width; i++) {
+			EXPECT_EQ(y_and.bits[i], ref_and(a.bits[i], b.bits[i]));
+			EXPECT_EQ(y_or.bits[i], ref_or(a.bits[i], b.bits[i]));
+			EXPECT_EQ(y_xor.bits[i], ref_xor(a.bits[i], b.bits[i]));
+			EXPECT_EQ(y_not.bits[i], ref_xor(a.bits[i], RTLIL::State::S1));
+		}
+	}
+}
+
+TEST(KernelCalcTest, WordPathMatchesBigInteger)
+{
+	typedef RTLIL::Const (*const_func_t)(const RTLIL::Const&, const RTLIL::Const&, bool, bool, int);
+	std::vector<const_func_t> funcs = {
+		RTLIL::const_add, RTLIL::const_sub, RTLIL::const_mul,
+		RTLIL::const_lt, RTLIL::const_le, RTLIL::const_ge, RTLIL::const_gt,
+	};
+
+	std::mt19937 rng(2);
+	for (int round = 0; round < 5000; round++) {
+		int width1 = 1 + rng() % 64, width2 = 1 + rng() % 64;
+		int result_len = 1 + rng() % 64;
+		bool signed1 = rng() % 2, signed2 = signed1;
+		RTLIL::Const a = random_const(rng, width1, round % 8 == 0);
+		RTLIL::Const b = random_const(rng, width2, round % 8 == 0);
+
+		for (auto func : funcs)
+			EXPECT_EQ(func(a, b, signed1, signed2, result_len), func(widen(a, signed1), widen(b, signed2), signed1, signed2, result_len));
+	}
+}
+
+TEST(KernelCalcTest, ShiftMatchesBigInteger)
+{
+	std::mt19937 rng(3);
+	for (int round = 0; round < 5000; round++) {
+		int width = 1 + rng() % 100;
+		int result_len = 1 + rng() % 100;
+		RTLIL::Const a = random_const(rng, width, round % 8 == 0);
+		RTLIL::Const b(int(rng() % 256) - 128, 9);
+
+		EXPECT_EQ(RTLIL::const_shl(a, b, false, false, result_len), RTLIL::const_shl(a, widen(b, false), false, false, result_len));
+		EXPECT_EQ(RTLIL::const_sshr(a, b, true, false, result_len), RTLIL::const_sshr(a, widen(b, false), true, false, result_len));
+		EXPECT_EQ(RTLIL::const_shift(a, b, false, true, result_len), RTLIL::const_shift(a, widen(b, true), false, true, result_len));
+		EXPECT_EQ(RTLIL::const_shiftx(a, b, false, true, result_len), RTLIL::const_shiftx(a, widen(b, true), false, true, result_len));
+	}
+}
+
+TEST(KernelCalcTest, HugeShiftAmount)
+{
+	RTLIL::Const a(0x5a, 8);
+
+	// the largest shift amounts that still take the 64-bit path
+	RTLIL::Const max_unsigned(RTLIL::State::S1, 63);
+	RTLIL::Const min_signed(RTLIL::State::S0, 63);
+	min_signed.bits.back() = RTLIL::State::S1;
+
+	EXPECT_EQ(RTLIL::const_shl(a, max_unsigned, false, false, 8), RTLIL::Const(0, 8));
+	EXPECT_EQ(RTLIL::const_shr(a, max_unsigned, false, false, 8), RTLIL::Const(0, 8));
+	EXPECT_EQ(RTLIL::const_shiftx(a, max_unsigned, false, false, 8), RTLIL::Const(RTLIL::State::Sx, 8));
+	EXPECT_EQ(RTLIL::const_shift(a, min_signed, false, true, 8), RTLIL::Const(0, 8));
+	EXPECT_EQ(RTLIL::const_shift(a, max_unsigned, false, true, 8), RTLIL::const_shift(a, widen(max_unsigned, true), false, true, 8));
+	EXPECT_EQ(RTLIL::const_sshr(RTLIL::Const(0x80, 8), max_unsigned, true, false, 8), RTLIL::Const(0xff, 8));
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/hashlib.h"
+
+#include <random>
+
+YOSYS_NAMESPACE_BEGIN
+
+TEST(KernelHashlibTest, openIndexMatchesChainedIndex)
+{
+	typedef hashlib::hash_open_ops<hashlib::hash_ops<int>> open_ops;
+
+	std::mt19937 rng(1);
+	dict<int, int> chained_dict;
+	dict<int, int, open_ops> open_dict;
+	pool<int> chained_pool;
+	pool<int, open_ops> open_pool;
+
+	for (int i = 0; i < 100000; i++) {
+		int key = rng() % 5000;
+		switch (rng() % 4) {
+		case 0:
+		case 1:
+			chained_dict[key] = i;
+			open_dict[key] = i;
+			chained_pool.insert(key);
+			open_pool.insert(key);
+			break;
+		case 2:
+			EXPECT_EQ(chained_dict.erase(key), open_dict.erase(key));
+			EXPECT_EQ(chained_pool.erase(key), open_pool.erase(key));
+			break;
+		case 3:
+			EXPECT_EQ(chained_dict.count(key), open_dict.count(key));
+			EXPECT_EQ(chained_pool.count(key), open_pool.count(key));
+			break;
+		}
+	}
+
+	// both kinds of index must iterate in the same (insertion) order
+	ASSERT_EQ(chained_dict.size(), open_dict.size());
+	auto open_it = open_dict.begin();
+	for (auto &it : chained_dict) {
+		EXPECT_EQ(it.first, open_it->first);
+		EXPECT_EQ(it.second, open_it->second);
+		++open_it;
+	}
+
+	ASSERT_EQ(chained_pool.size(), open_pool.size());
+	auto open_pool_it = open_pool.begin();
+	for (auto key : chained_pool) {
+		EXPECT_EQ(key, *open_pool_it);
+		++open_pool_it;
+	}
+
+	dict<int, int, open_ops> copy = open_dict;
+	for (auto &it : chained_dict)
+		EXPECT_EQ(copy.at(it.first), it.second);
+}
+
+// hashes that only differ in bits above the home chunk number put all keys into
+// a few chunks, which then overflow into their neighbours
+struct coarse_hash_ops : hashlib::hash_ops<int> {
+	static inline unsigned int hash(int a) { return a & ~1023; }
+};
+
+TEST(KernelHashlibTest, openIndexOverflowingChunks)
+{
+	std::mt19937 rng(2);
+	pool<int> chained_pool;
+	pool<int, hashlib::hash_open_ops<coarse_hash_ops>> open_pool;
+
+	for (int i = 0; i < 50000; i++) {
+		int key = rng() % 4096;
+		if (rng() % 3 == 0) {
+			EXPECT_EQ(chained_pool.erase(key), open_pool.erase(key));
+		} else {
+			chained_pool.insert(key);
+			open_pool.insert(key);
+		}
+		if (i % 8 == 0) {
+			int probe = rng() % 4096;
+			EXPECT_EQ(chained_pool.count(probe), open_pool.count(probe));
+		}
+	}
+
+	ASSERT_EQ(chained_pool.size(), open_pool.size());
+	for (int key = 0; key < 4096; key++)
+		EXPECT_EQ(chained_pool.count(key), open_pool.count(key));
+
+	pool<int, hashlib::hash_open_ops<coarse_hash_ops>> other;
+	other.swap(open_pool);
+	EXPECT_TRUE(open_pool.empty());
+	EXPECT_EQ(chained_pool.size(), other.size());
+	for (int key : chained_pool)
+		EXPECT_EQ(other.count(key), 1);
+
+	other.clear();
+	EXPECT_EQ(other.count(0), 0);
+	other.insert(0);
+	EXPECT_EQ(other.count(0), 1);
+}
+
+YOSYS_NAMESPACE_END
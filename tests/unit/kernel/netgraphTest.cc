@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/netgraph.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+class KernelNetGraphTest : public testing::Test
+{
+protected:
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	RTLIL::Wire *a, *b, *t, *u, *y;
+	RTLIL::Cell *and_cell, *not_cell, *box_cell;
+	CellTypes ct;
+
+	void SetUp() override
+	{
+		// the cell types and ID:: constants are set up with the kernel
+		yosys_setup();
+
+		// t = a & b, u is an alias of t, y = ~{1'b0, u[0]}
+		std::istringstream rtlil(R"(
+			module \top
+				wire width 2 \a
+				wire width 2 \b
+				wire width 2 \t
+				wire width 2 \u
+				wire width 2 \y
+				cell $and \and_cell
+					parameter \A_SIGNED 0
+					parameter \A_WIDTH 2
+					parameter \B_SIGNED 0
+					parameter \B_WIDTH 2
+					parameter \Y_WIDTH 2
+					connect \A \a
+					connect \B \b
+					connect \Y \t
+				end
+				connect \u \t
+				cell $not \not_cell
+					parameter \A_SIGNED 0
+					parameter \A_WIDTH 2
+					parameter \Y_WIDTH 2
+					connect \A { 1'0 \u [0] }
+					connect \Y \y
+				end
+				cell \box \box_cell
+					connect \P { \y [1] \t [0] }
+				end
+			end
+		)");
+
+		design = new RTLIL::Design;
+		Frontend::frontend_call(design, &rtlil, "<netgraph test>", "read_rtlil");
+		module = design->module(ID(top));
+		a = module->wire(ID(a));
+		b = module->wire(ID(b));
+		t = module->wire(ID(t));
+		u = module->wire(ID(u));
+		y = module->wire(ID(y));
+		and_cell = module->cell(ID(and_cell));
+		not_cell = module->cell(ID(not_cell));
+		box_cell = module->cell(ID(box_cell));
+
+		ct.setup_internals();
+	}
+
+	void TearDown() override
+	{
+		delete design;
+	}
+};
+
+TEST_F(KernelNetGraphTest, NetsFollowSigmap)
+{
+	NetGraph graph(module, {and_cell, not_cell, box_cell}, &ct);
+
+	EXPECT_EQ(graph.num_cells(), 3);
+	EXPECT_EQ(graph.num_nets(), 8);
+	EXPECT_EQ(graph.net(RTLIL::SigBit(t, 1)), graph.net(RTLIL::SigBit(u, 1)));
+	EXPECT_NE(graph.net(RTLIL::SigBit(t, 0)), graph.net(RTLIL::SigBit(t, 1)));
+	EXPECT_EQ(graph.net(RTLIL::State::S1), -1);
+	EXPECT_EQ(graph.net_bits[graph.net(RTLIL::SigBit(u, 0))], graph.sigmap(RTLIL::SigBit(u, 0)));
+	EXPECT_EQ(graph.cell_id(not_cell), 1);
+}
+
+TEST_F(KernelNetGraphTest, Adjacency)
+{
+	NetGraph graph(module, {and_cell, not_cell, box_cell}, &ct);
+	int t0 = graph.net(RTLIL::SigBit(t, 0));
+	int y1 = graph.net(RTLIL::SigBit(y, 1));
+
+	EXPECT_EQ(graph.fanin(0).size(), 4);
+	EXPECT_EQ(graph.fanout(0).size(), 2);
+	EXPECT_EQ(graph.fanin(1).size(), 1);
+
+	// the ports of unknown cells are inout
+	ASSERT_EQ(graph.ports(2).size(), 1);
+	EXPECT_EQ(graph.ports(2)[0].dir, NetGraph::PD_INOUT);
+
+	ASSERT_EQ(graph.drivers(t0).size(), 2);
+	EXPECT_EQ(graph.drivers(t0)[0], 0);
+	EXPECT_EQ(graph.drivers(t0)[1], 2);
+	ASSERT_EQ(graph.users(t0).size(), 2);
+	EXPECT_EQ(graph.users(t0)[0], 1);
+	EXPECT_EQ(graph.users(t0)[1], 2);
+
+	ASSERT_EQ(graph.drivers(y1).size(), 2);
+	EXPECT_EQ(graph.drivers(y1)[0], 1);
+
+	// constant bits have no net
+	for (auto &port : graph.ports(1))
+		if (port.name == ID::A) {
+			EXPECT_EQ(port.dir, NetGraph::PD_INPUT);
+			EXPECT_EQ(graph.nets(port)[0], t0);
+			EXPECT_EQ(graph.nets(port)[1], -1);
+		}
+}
+
+TEST_F(KernelNetGraphTest, PortFilter)
+{
+	NetGraph graph(module, {and_cell, not_cell, box_cell}, &ct, [](RTLIL::Cell *cell, RTLIL::IdString port) {
+		return cell->type != ID($and) || port != ID::B;
+	});
+
+	EXPECT_EQ(graph.ports(0).size(), 2);
+	EXPECT_EQ(graph.fanin(0).size(), 2);
+	EXPECT_TRUE(graph.users(graph.net(RTLIL::SigBit(b, 0))).empty());
+}
+
+YOSYS_NAMESPACE_END
@@ -2,6 +2,13 @@
 
 #include "kernel/yosys.h"
 #include "kernel/rtlil.h"
+#include "backends/rtlil/rtlil_binary.h"
+
+#include <sstream>
+
+#ifdef YOSYS_ENABLE_THREADS
+#include <thread>
+#endif
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -11,4 +18,89 @@ TEST(KernelRtlilTest, getReferenceValid)
 	EXPECT_EQ(33, 33);
 }
 
+TEST(KernelRtlilTest, RemovedObjectsReusedAfterRecycle)
+{
+	RTLIL::Design design;
+	RTLIL::Module *module = design.addModule(ID(top));
+
+	RTLIL::Wire *wire = module->addWire(ID(a));
+	RTLIL::Cell *cell = module->addCell(ID(c), ID($_NOT_));
+	void *old_wire = wire, *old_cell = cell;
+	module->remove({wire});
+	module->remove(cell);
+
+	// the addresses of removed objects are not handed out again right away
+	EXPECT_NE((void*)module->addWire(ID(b)), old_wire);
+	EXPECT_NE((void*)module->addCell(ID(d), ID($_NOT_)), old_cell);
+
+	design.recycle_objects();
+	EXPECT_EQ((void*)module->addWire(ID(e)), old_wire);
+	EXPECT_EQ((void*)module->addCell(ID(f), ID($_NOT_)), old_cell);
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+TEST(KernelRtlilTest, IdStringConcurrentInterning)
+{
+	yosys_threads_active = true;
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; t++)
+		threads.emplace_back([t]() {
+			for (int i = 0; i < 10000; i++) {
+				IdString shared(stringf("\\shared_%d", i % 100));
+				IdString own(stringf("\\thread_%d_%d", t, i));
+				IdString copy = shared;
+				EXPECT_EQ(copy, shared);
+				EXPECT_EQ(own.str(), stringf("\\thread_%d_%d", t, i));
+			}
+		});
+	for (auto &thread : threads)
+		thread.join();
+
+	yosys_threads_active = false;
+
+	IdString id("\\shared_42");
+	EXPECT_EQ(id.str(), "\\shared_42");
+	EXPECT_EQ(id, IdString("\\shared_42"));
+}
+
+TEST(KernelRtlilTest, LazyModuleConcurrentLoad)
+{
+	std::stringstream buf;
+	{
+		RTLIL::Design design;
+		RTLIL::Module *sub = design.addModule(ID(sub));
+		RTLIL::Wire *a = sub->addWire(ID(a), 4);
+		RTLIL::Wire *y = sub->addWire(ID(y), 4);
+		a->port_input = true;
+		y->port_output = true;
+		sub->fixup_ports();
+		sub->addNot(ID(inv), sub->addWire(ID(t), 4), y);
+		sub->addNot(ID(inv2), a, RTLIL::SigSpec(sub->wire(ID(t))));
+		RTLIL_BINARY::write_design(buf, &design, false);
+	}
+
+	RTLIL::Design design;
+	RTLIL_BINARY::read_design(buf, &design, false, false, false, true);
+	const RTLIL::Design *const_design = &design;
+
+	// the const accessor decodes the stub, also when several threads ask for
+	// it at once
+	yosys_threads_active = true;
+	std::vector<int> num_cells(8);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 8; t++)
+		threads.emplace_back([&, t]() {
+			num_cells[t] = GetSize(const_design->module(ID(sub))->cells_);
+		});
+	for (auto &thread : threads)
+		thread.join();
+	yosys_threads_active = false;
+
+	for (int t = 0; t < 8; t++)
+		EXPECT_EQ(num_cells[t], 2);
+	EXPECT_NE(design.module(ID(sub))->wire(ID(t)), nullptr);
+}
+#endif
+
 YOSYS_NAMESPACE_END
@@ -0,0 +1,58 @@
+#include "kernel/yosys.h"
+#include "kernel/rtlil.h"
+
+#include <stdio.h>
+
+USING_YOSYS_NAMESPACE
+
+// Times the operations on one-bit SigSpecs that are stored inline.
+int main()
+{
+	const int rounds = 200000;
+
+	RTLIL::Design design;
+	RTLIL::Module *module = design.addModule(ID(top));
+	RTLIL::Wire *a = module->addWire(ID(a));
+	RTLIL::Wire *b = module->addWire(ID(b), 8);
+	RTLIL::Wire *y = module->addWire(ID(y), 4);
+
+	std::vector<RTLIL::SigSpec> sigs;
+	PerformanceTimer timer;
+	int64_t total = 0;
+
+	auto report = [&](const char *what) {
+		timer.end();
+		printf("%-16s %8.2f ns/op\n", what, double(timer.total_ns) / rounds);
+		timer.reset();
+	};
+
+	timer.begin();
+	for (int i = 0; i < rounds; i++)
+		sigs.push_back(RTLIL::SigBit(b, i % 8));
+	report("construct");
+
+	RTLIL::SigSpec wide(b);
+	timer.begin();
+	for (int i = 0; i < rounds; i++)
+		total += GetSize(wide.extract(i % 8, 1));
+	report("extract");
+
+	timer.begin();
+	for (int i = 0; i < rounds; i++)
+		sigs[i].replace(RTLIL::SigSpec(b, i % 8), RTLIL::SigSpec(y, i % 4));
+	report("replace");
+
+	timer.begin();
+	for (int i = 0; i < rounds; i++)
+		sigs[i].sort_and_unify();
+	report("sort_and_unify");
+
+	timer.begin();
+	pool<RTLIL::SigSpec> unique;
+	for (int i = 0; i < rounds; i++)
+		unique.insert(RTLIL::SigSpec(a, 0, 1));
+	report("hash");
+
+	printf("sizeof(SigSpec) %d\n", int(sizeof(RTLIL::SigSpec)));
+	return total == rounds && GetSize(unique) == 1 ? 0 : 1;
+}
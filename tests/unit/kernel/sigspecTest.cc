@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/rtlil.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+class KernelSigSpecTest : public testing::Test
+{
+protected:
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	RTLIL::Wire *a, *b, *y;
+
+	void SetUp() override
+	{
+		design = new RTLIL::Design;
+		module = design->addModule(ID(top));
+		a = module->addWire(ID(a));
+		b = module->addWire(ID(b), 8);
+		y = module->addWire(ID(y), 4);
+	}
+
+	void TearDown() override
+	{
+		delete design;
+	}
+};
+
+TEST_F(KernelSigSpecTest, SingleBitMatchesPacked)
+{
+	// the same bits, built as single bits and from multi-bit chunks
+	std::vector<std::pair<RTLIL::SigSpec, RTLIL::SigSpec>> pairs = {
+		{RTLIL::SigSpec(a), RTLIL::SigSpec(RTLIL::SigChunk(a)).extract(0, 1)},
+		{RTLIL::SigSpec(b, 3), RTLIL::SigSpec(b).extract(3, 1)},
+		{RTLIL::SigSpec(RTLIL::SigBit(b, 5)), RTLIL::SigSpec(b, 4, 2).extract(1, 1)},
+		{RTLIL::SigSpec(RTLIL::State::S1), RTLIL::SigSpec(RTLIL::Const(3, 2)).extract(1, 1)},
+		{RTLIL::SigSpec(RTLIL::State::Sx), RTLIL::SigSpec(RTLIL::State::Sx, 4).extract(2, 1)},
+	};
+
+	for (auto &it : pairs) {
+		RTLIL::SigSpec packed = it.second;
+		packed.append(RTLIL::State::S0);
+		packed.remove(1);
+
+		EXPECT_EQ(it.first, packed);
+		EXPECT_FALSE(it.first < packed);
+		EXPECT_FALSE(packed < it.first);
+		EXPECT_EQ(it.first.hash(), packed.hash());
+		EXPECT_EQ(it.first.as_bit(), packed.as_bit());
+		EXPECT_EQ(it.first.chunks().size(), 1u);
+		EXPECT_EQ(it.first.is_wire(), packed.is_wire());
+		EXPECT_EQ(it.first.is_fully_const(), packed.is_fully_const());
+		EXPECT_EQ(it.first.is_fully_def(), packed.is_fully_def());
+		EXPECT_EQ(it.first.is_fully_undef(), packed.is_fully_undef());
+	}
+
+	EXPECT_NE(RTLIL::SigSpec(a), RTLIL::SigSpec(b, 0));
+	EXPECT_NE(RTLIL::SigSpec(RTLIL::State::S0), RTLIL::SigSpec(RTLIL::State::S1));
+	EXPECT_TRUE(RTLIL::SigSpec(a).is_wire());
+	EXPECT_FALSE(RTLIL::SigSpec(b, 0).is_wire());
+}
+
+TEST_F(KernelSigSpecTest, SingleBitEditing)
+{
+	RTLIL::SigSpec sig(a);
+	unsigned int hash = sig.hash();
+
+	sig[0] = RTLIL::SigBit(b, 2);
+	EXPECT_EQ(sig, RTLIL::SigSpec(b, 2));
+	EXPECT_NE(sig.hash(), hash);
+
+	sig.append(RTLIL::SigBit(b, 3));
+	EXPECT_EQ(sig, RTLIL::SigSpec(b, 2, 2));
+	EXPECT_EQ(sig.chunks().size(), 1u);
+
+	sig = RTLIL::SigSpec(a);
+	sig.append(RTLIL::SigSpec(b));
+	sig.append(RTLIL::SigSpec(y, 1));
+	EXPECT_EQ(GetSize(sig), 10);
+	EXPECT_EQ(sig.extract(0, 1), RTLIL::SigSpec(a));
+	EXPECT_EQ(sig.extract(9, 1), RTLIL::SigSpec(y, 1));
+
+	RTLIL::SigSpec bit(RTLIL::State::S1);
+	bit.remove_const();
+	EXPECT_TRUE(bit.empty());
+
+	bit = RTLIL::SigSpec(a);
+	bit.remove_const();
+	EXPECT_EQ(bit, RTLIL::SigSpec(a));
+
+	bit.replace(RTLIL::SigSpec(a), RTLIL::SigSpec(y, 3));
+	EXPECT_EQ(bit, RTLIL::SigSpec(y, 3));
+
+	bit.remove(RTLIL::SigSpec(y, 3));
+	EXPECT_TRUE(bit.empty());
+
+	RTLIL::SigSpec bits = {RTLIL::SigSpec(a), RTLIL::SigSpec(a), RTLIL::SigSpec(a)};
+	bits.sort_and_unify();
+	EXPECT_EQ(bits, RTLIL::SigSpec(a));
+	EXPECT_EQ(bits.hash(), RTLIL::SigSpec(a).hash());
+}
+
+TEST_F(KernelSigSpecTest, SingleBitStorage)
+{
+	// the single bit shares its storage with the bit vector
+	if (sizeof(void*) == 8) {
+		EXPECT_EQ(sizeof(RTLIL::SigSpec), 64u);
+	}
+
+	RTLIL::SigSpec single(a), wide(b), unpacked(b);
+	unpacked.bits();
+
+	RTLIL::SigSpec sig = single;
+	EXPECT_EQ(sig, RTLIL::SigSpec(a));
+	sig = wide;
+	EXPECT_EQ(sig, RTLIL::SigSpec(b));
+	sig = single;
+	EXPECT_EQ(sig, RTLIL::SigSpec(a));
+	sig = unpacked;
+	EXPECT_EQ(sig, RTLIL::SigSpec(b));
+	sig = std::move(single);
+	EXPECT_EQ(sig, RTLIL::SigSpec(a));
+	sig = RTLIL::SigSpec(y);
+	EXPECT_EQ(sig, RTLIL::SigSpec(y));
+
+	RTLIL::SigSpec moved(std::move(sig));
+	EXPECT_EQ(moved, RTLIL::SigSpec(y));
+	RTLIL::SigSpec copied(RTLIL::SigSpec(y, 2));
+	EXPECT_EQ(copied.bits().size(), 1u);
+	EXPECT_EQ(copied.chunks().size(), 1u);
+	EXPECT_EQ(copied, RTLIL::SigSpec(y, 2));
+
+	RTLIL::SigSpec bit(RTLIL::State::S0);
+	bit.remove_const();
+	bit.append(RTLIL::SigBit(y, 1));
+	EXPECT_EQ(bit, RTLIL::SigSpec(y, 1));
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+class KernelSigToolsTest : public testing::Test
+{
+protected:
+	RTLIL::Design *design;
+	RTLIL::Module *module;
+	RTLIL::Wire *a, *b, *c;
+
+	void SetUp() override
+	{
+		design = new RTLIL::Design;
+		module = design->addModule(ID(top));
+		a = module->addWire(ID(a), 2);
+		b = module->addWire(ID(b), 2);
+		c = module->addWire(ID(c), 2);
+	}
+
+	void TearDown() override
+	{
+		delete design;
+	}
+
+	bool aliased(RTLIL::Wire *w1, RTLIL::Wire *w2)
+	{
+		SigMap sigmap(module);
+		return sigmap(w1) == sigmap(w2);
+	}
+};
+
+TEST_F(KernelSigToolsTest, SharedSigMapSeesConnect)
+{
+	EXPECT_FALSE(aliased(a, b));
+	module->connect(b, a);
+	EXPECT_TRUE(aliased(a, b));
+	EXPECT_FALSE(aliased(a, c));
+	module->connect(c, b);
+	EXPECT_TRUE(aliased(a, c));
+}
+
+TEST_F(KernelSigToolsTest, SharedSigMapSeesNewConnections)
+{
+	module->connect(b, a);
+	EXPECT_TRUE(aliased(a, b));
+
+	// appending keeps the existing connections
+	std::vector<RTLIL::SigSig> conns = module->connections();
+	conns.push_back(RTLIL::SigSig(c, a));
+	module->new_connections(conns);
+	EXPECT_TRUE(aliased(a, b));
+	EXPECT_TRUE(aliased(a, c));
+
+	// replacing them with the same number of connections
+	module->new_connections({RTLIL::SigSig(c, b), RTLIL::SigSig(b, c)});
+	EXPECT_FALSE(aliased(a, b));
+	EXPECT_TRUE(aliased(b, c));
+}
+
+TEST_F(KernelSigToolsTest, SharedSigMapSeesDirectEdits)
+{
+	module->connect(b, a);
+	EXPECT_TRUE(aliased(a, b));
+
+	// the number of connections stays the same
+	module->connections_[0].second = c;
+	module->connections_changed();
+	EXPECT_FALSE(aliased(a, b));
+	EXPECT_TRUE(aliased(b, c));
+
+	// Module::rewrite_sigspecs() drops the shared SigMap itself
+	auto c_to_a = [&](RTLIL::SigSpec &sig) {
+		if (sig == RTLIL::SigSpec(c))
+			sig = a;
+	};
+	module->rewrite_sigspecs(c_to_a);
+	EXPECT_TRUE(aliased(a, b));
+	EXPECT_FALSE(aliased(b, c));
+}
+
+TEST_F(KernelSigToolsTest, SharedSigMapSeesRenamedWires)
+{
+	module->connect(b, a);
+	EXPECT_TRUE(aliased(a, b));
+
+	// bits are hashed by the name of their wire
+	module->rename(a, ID(a2));
+	module->rename(b, ID(b2));
+	EXPECT_TRUE(aliased(a, b));
+	EXPECT_FALSE(aliased(a, c));
+
+	module->swap_names(a, c);
+	EXPECT_TRUE(aliased(a, b));
+	EXPECT_FALSE(aliased(b, c));
+}
+
+TEST_F(KernelSigToolsTest, SigSetFindBit)
+{
+	SigSet<int> sigset;
+	sigset.insert(a, 3);
+	sigset.insert(a, 1);
+	sigset.insert(RTLIL::SigBit(a, 0), 3);
+	EXPECT_EQ(sigset.find(RTLIL::SigBit(a, 0)), std::vector<int>({1, 3}));
+	EXPECT_EQ(sigset.find(RTLIL::SigBit(a, 1)), std::vector<int>({1, 3}));
+
+	// values inserted after a lookup are merged in at the next lookup
+	sigset.insert(RTLIL::SigBit(a, 0), 2);
+	sigset.insert(RTLIL::SigBit(a, 0), 4);
+	sigset.insert(RTLIL::SigBit(a, 0), 0);
+	EXPECT_EQ(sigset.find(RTLIL::SigBit(a, 0)), std::vector<int>({0, 1, 2, 3, 4}));
+
+	sigset.erase(RTLIL::SigBit(a, 0), 2);
+	EXPECT_EQ(sigset.find(RTLIL::SigBit(a, 0)), std::vector<int>({0, 1, 3, 4}));
+	EXPECT_TRUE(sigset.find(RTLIL::SigBit(b, 0)).empty());
+	EXPECT_TRUE(sigset.find(RTLIL::SigBit(RTLIL::State::S0)).empty());
+}
+
+TEST_F(KernelSigToolsTest, SigSetFindSigSpec)
+{
+	SigSet<int> sigset;
+	sigset.insert(RTLIL::SigBit(a, 0), 2);
+	sigset.insert(RTLIL::SigBit(a, 1), 1);
+	sigset.insert(b, 2);
+
+	// arguments that convert to both SigBit and SigSpec still select the
+	// SigSpec overloads, which return the union of the values of all bits
+	static_assert(std::is_same<decltype(sigset.find(RTLIL::SigBit(a, 0))), const std::vector<int>&>::value, "");
+	static_assert(std::is_same<decltype(sigset.find(a)), std::set<int>>::value, "");
+	static_assert(std::is_same<decltype(sigset.find(RTLIL::SigChunk(a))), std::set<int>>::value, "");
+	EXPECT_EQ(sigset.find(a), std::set<int>({1, 2}));
+	EXPECT_EQ(sigset.find(RTLIL::SigSpec({c, b})), std::set<int>({2}));
+
+	pool<int> result;
+	sigset.find(RTLIL::SigSpec({b, a}), result);
+	EXPECT_EQ(result, pool<int>({1, 2}));
+}
+
+TEST_F(KernelSigToolsTest, SigSetHas)
+{
+	SigSet<int> sigset;
+	EXPECT_FALSE(sigset.has(a));
+	sigset.insert(RTLIL::SigBit(a, 1), 1);
+	EXPECT_TRUE(sigset.has(a));
+	EXPECT_FALSE(sigset.has(RTLIL::SigBit(a, 0)));
+
+	// a bit whose values were all erased is not reported any more
+	sigset.erase(a, 1);
+	EXPECT_FALSE(sigset.has(a));
+	sigset.insert(a, 2);
+	sigset.erase(a);
+	EXPECT_FALSE(sigset.has(a));
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+set -ex
+mkdir -p temp
+cat > temp/json_threads.v <<EOT
+module big(input [9999:0] a, b, output [9999:0] y, z);
+genvar i;
+for (i = 0; i < 10000; i = i + 1) begin : g
+	assign y[i] = a[i] & b[(i + 1) % 10000];
+	assign z[i] = a[i] ^ y[i];
+end
+endmodule
+module mid(input [7:0] a, b, output [7:0] y, output c);
+assign y = a + b;
+assign c = a < b;
+endmodule
+module small(input a, b, s, output y);
+assign y = s ? a : b;
+endmodule
+module top(input [7:0] a, b, output [7:0] y, output c);
+mid m (.a(a), .b(b), .y(y), .c(c));
+endmodule
+EOT
+# the writer renders several modules at once with -j, and flushes its buffer
+# in blocks, which must not change a single byte of the output
+for args in "" "-aig" "-compat-int"; do
+	../../yosys -q -p "read_verilog temp/json_threads.v; write_json $args temp/json_threads_seq.json"
+	../../yosys -q -j 4 -p "read_verilog temp/json_threads.v; write_json $args temp/json_threads_par.json"
+	cmp temp/json_threads_seq.json temp/json_threads_par.json
+done
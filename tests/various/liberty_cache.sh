@@ -0,0 +1,34 @@
+#!/usr/bin/env bash
+set -ex
+rm -rf temp/liberty_cache
+mkdir -p temp
+lib=../liberty/normal.lib
+cache='scratchpad -set liberty.cache_dir temp/liberty_cache'
+../../yosys -q -p "read_liberty -lib $lib; write_rtlil temp/liberty_cache_parsed.il"
+# the first run stores the parsed libraries, the second run loads them
+for i in 1 2; do
+	../../yosys -q -p "$cache; read_liberty -lib $lib; write_rtlil temp/liberty_cache_$i.il; dfflibmap -info -liberty $lib; stat -liberty $lib"
+	test $(ls temp/liberty_cache | wc -l) -eq 3
+	cmp temp/liberty_cache_parsed.il temp/liberty_cache_$i.il
+done
+# an edit that keeps the size and the modification time in seconds must not
+# hit the cache either
+cp $lib temp/liberty_cache.lib
+touch -d @1700000000.1 temp/liberty_cache.lib
+../../yosys -q -p "$cache; read_liberty -lib temp/liberty_cache.lib; select -assert-any =nand2"
+sed -i 's/cell (nand2)/cell (nand3)/' temp/liberty_cache.lib
+touch -d @1700000000.2 temp/liberty_cache.lib
+../../yosys -q -p "$cache; read_liberty -lib temp/liberty_cache.lib; select -assert-none =nand2; select -assert-any =nand3"
+# neither does an edit that keeps the modification time exactly
+sed -i 's/cell (nand3)/cell (nand4)/' temp/liberty_cache.lib
+touch -d @1700000000.2 temp/liberty_cache.lib
+../../yosys -q -p "$cache; read_liberty -lib temp/liberty_cache.lib; select -assert-none =nand3; select -assert-any =nand4"
+# the same relative name in another directory is a different file
+mkdir -p temp/liberty_cache_a temp/liberty_cache_b
+sed 's/cell (nand2)/cell (nand5)/' $lib > temp/liberty_cache_a/cells.lib
+sed 's/cell (nand2)/cell (nand6)/' $lib > temp/liberty_cache_b/cells.lib
+touch -d @1700000000 temp/liberty_cache_a/cells.lib temp/liberty_cache_b/cells.lib
+for d in a:nand5 b:nand6; do
+	(cd temp/liberty_cache_${d%:*} && ../../../../yosys -q -p "scratchpad -set liberty.cache_dir ../liberty_cache; read_liberty -lib cells.lib; select -assert-any =${d#*:}")
+done
+rm -rf temp/liberty_cache temp/liberty_cache_a temp/liberty_cache_b
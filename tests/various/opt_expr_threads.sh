@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -ex
+mkdir -p temp
+cat > temp/opt_expr_threads.v <<EOT
+module big(input [4999:0] a, b, output [4999:0] y, z);
+genvar i;
+for (i = 0; i < 5000; i = i + 1) begin : g
+	assign y[i] = (a[i] & 1'b1) ^ (b[i] | 1'b0);
+	assign z[i] = ~(~a[i]) & b[(i + 1) % 5000];
+end
+endmodule
+module small1(input [7:0] a, output [7:0] y);
+assign y = (a | 8'h00) + (8'h01 & 8'h03);
+endmodule
+module small2(input [7:0] a, b, output [7:0] y);
+assign y = (a ^ 8'hff) & (b | 8'hff);
+endmodule
+module small3(input a, b, output y, z);
+assign y = 1'b0 ? a : b;
+assign z = (a & 1'b0) | b;
+endmodule
+EOT
+# the first "opt_expr" only works on big, so that its cells are processed in
+# parallel chunks, the second one works on all modules in parallel. The names
+# of the new objects must not depend on the number of threads either.
+for opts in "" "-j 4"; do
+	../../yosys -q $opts -p "read_verilog temp/opt_expr_threads.v; opt_expr -fine big; opt_expr -fine; opt_clean; tee -q -o temp/opt_expr_threads.tmp stat; write_rtlil temp/opt_expr_threads.il"
+	grep -v "Printing statistics" temp/opt_expr_threads.tmp > temp/opt_expr_threads.log
+	if test -z "$opts"; then
+		mv temp/opt_expr_threads.log temp/opt_expr_threads_seq.log
+		mv temp/opt_expr_threads.il temp/opt_expr_threads_seq.il
+	else
+		cmp temp/opt_expr_threads_seq.log temp/opt_expr_threads.log
+		cmp temp/opt_expr_threads_seq.il temp/opt_expr_threads.il
+	fi
+done
@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+set -ex
+mkdir -p temp
+cat > temp/read_verilog_jobs_a.v <<EOT
+module leaf #(parameter W = 4) (input [W-1:0] a, b, output [W-1:0] y);
+assign y = a + b;
+endmodule
+\`define WIDTH 8
+EOT
+cat > temp/read_verilog_jobs_b.v <<EOT
+module mid(input clk, input [\`WIDTH-1:0] a, output reg [\`WIDTH-1:0] q);
+wire [\`WIDTH-1:0] y;
+leaf #(.W(\`WIDTH)) u (.a(a), .b(q), .y(y));
+always @(posedge clk) q <= y;
+endmodule
+EOT
+cat > temp/read_verilog_jobs_c.v <<EOT
+module top(input clk, input [\`WIDTH-1:0] a, output [\`WIDTH-1:0] q);
+mid m (.clk(clk), .a(a), .q(q));
+endmodule
+EOT
+files="temp/read_verilog_jobs_a.v temp/read_verilog_jobs_b.v temp/read_verilog_jobs_c.v"
+# the files only differ in the names derived from autoidx, which stat doesn't print
+for opts in "" "-j 2" "-j 4" "-defer -j 3"; do
+	../../yosys -q -p "read_verilog $opts $files; hierarchy -top top; proc; flatten; tee -q -o temp/read_verilog_jobs.tmp stat top"
+	grep -v "Printing statistics" temp/read_verilog_jobs.tmp > temp/read_verilog_jobs.log
+	if test -z "$opts"; then
+		mv temp/read_verilog_jobs.log temp/read_verilog_jobs_seq.log
+	else
+		cmp temp/read_verilog_jobs_seq.log temp/read_verilog_jobs.log
+	fi
+done
+# the number of jobs must be a positive integer
+for jobs in 0 -2 x 2x; do
+	../../yosys -q -p "logger -expect error \"Invalid number of jobs: $jobs\" 1; read_verilog -j $jobs $files"
+done
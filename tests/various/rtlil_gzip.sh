@@ -0,0 +1,26 @@
+#!/usr/bin/env bash
+set -ex
+mkdir -p temp
+cat > temp/rtlil_gzip.v <<EOT
+module top(input [19999:0] a, b, output [19999:0] y);
+genvar i;
+for (i = 0; i < 20000; i = i + 1) begin : g
+	assign y[i] = a[i] ^ b[(i + 7) % 20000];
+end
+endmodule
+EOT
+# the design is large enough for the output to span several compressed blocks
+for opts in "" "-j 4"; do
+	../../yosys -q $opts -p "read_verilog temp/rtlil_gzip.v; write_rtlil temp/rtlil_gzip.il; write_rtlil temp/rtlil_gzip.il.gz"
+	gzip -dc temp/rtlil_gzip.il.gz | cmp - temp/rtlil_gzip.il
+	../../yosys -q $opts -p "read_rtlil temp/rtlil_gzip.il.gz; write_rtlil temp/rtlil_gzip_2.il"
+	cmp temp/rtlil_gzip.il temp/rtlil_gzip_2.il
+done
+# write errors are reported when the file is closed
+if [ -w /dev/full ]; then
+	ln -sf /dev/full temp/rtlil_gzip_full.il.gz
+	if ../../yosys -q -p "read_verilog temp/rtlil_gzip.v; write_rtlil temp/rtlil_gzip_full.il.gz" 2> temp/rtlil_gzip_full.err; then
+		exit 1
+	fi
+	grep -q "Error while writing gzip file" temp/rtlil_gzip_full.err
+fi
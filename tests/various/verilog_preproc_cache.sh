@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+set -ex
+rm -rf temp/preproc_cache temp/preproc_cache_inc
+mkdir -p temp/preproc_cache_inc
+cat > temp/preproc_cache_inc/defs.vh <<EOT
+\`define ADD(a, b=1) ((a) + (b))
+\`define W 8
+EOT
+cat > temp/preproc_cache_top.v <<EOT
+\`include "defs.vh"
+module top(input [\`W-1:0] a, output [\`W-1:0] y);
+assign y = \`ADD(a);
+endmodule
+EOT
+cat > temp/preproc_cache_user.v <<EOT
+module user(input [\`W-1:0] a, output [\`W-1:0] y);
+assign y = \`ADD(a, 2);
+endmodule
+EOT
+read="read_verilog -Itemp/preproc_cache_inc temp/preproc_cache_top.v temp/preproc_cache_user.v"
+cache='scratchpad -set verilog.preproc_cache_dir temp/preproc_cache'
+../../yosys -q -p "$read; write_rtlil temp/preproc_cache_ref.il"
+# the first run stores the preprocessed files, the second run loads them and
+# still sees the defines from the include file in the second file
+for i in 1 2; do
+	../../yosys -p "$cache; $read; write_rtlil temp/preproc_cache_$i.il" > temp/preproc_cache_$i.log
+	test $(ls temp/preproc_cache | wc -l) -eq 2
+	cmp temp/preproc_cache_ref.il temp/preproc_cache_$i.il
+done
+grep -q "Stored preprocessed" temp/preproc_cache_1.log
+test $(grep -c "Stored preprocessed" temp/preproc_cache_2.log) -eq 0
+# changing an included file invalidates the cache
+sed -i 's/`define W 8/`define W 4/' temp/preproc_cache_inc/defs.vh
+../../yosys -q -p "$read; write_rtlil temp/preproc_cache_ref.il"
+../../yosys -q -p "$cache; $read; write_rtlil temp/preproc_cache_3.il"
+cmp temp/preproc_cache_ref.il temp/preproc_cache_3.il
+test $(ls temp/preproc_cache | wc -l) -eq 3
+rm -rf temp/preproc_cache temp/preproc_cache_inc